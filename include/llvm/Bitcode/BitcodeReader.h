@@ -58,8 +58,8 @@ namespace llvm {
           IdentificationBit(IdentificationBit), ModuleBit(ModuleBit) {}
 
     // Calls the ctor.
-    friend Expected<std::vector<BitcodeModule>>
-    getBitcodeModuleList(MemoryBufferRef Buffer);
+    friend Expected<struct BitcodeFileContents>
+    getBitcodeFileContents(MemoryBufferRef Buffer);
 
     Expected<std::unique_ptr<Module>> getModuleImpl(LLVMContext &Context,
                                                     bool MaterializeAll,
@@ -91,6 +91,16 @@ namespace llvm {
     Expected<std::unique_ptr<ModuleSummaryIndex>> getSummary();
   };
 
+  /// The top-level contents of a bitcode file.
+  struct BitcodeFileContents {
+    std::vector<BitcodeModule> Mods;
+    /// The blob of the SYMTAB_BLOCK of the file, empty if it has none.
+    StringRef Symtab;
+  };
+
+  /// Returns the modules and the symbol table of the specified bitcode buffer.
+  Expected<BitcodeFileContents> getBitcodeFileContents(MemoryBufferRef Buffer);
+
   /// Returns a list of modules in the specified bitcode buffer.
   Expected<std::vector<BitcodeModule>>
   getBitcodeModuleList(MemoryBufferRef Buffer);
@@ -16,6 +16,7 @@
 
 #include "llvm/IR/ModuleSummaryIndex.h"
 #include <string>
+#include <vector>
 
 namespace llvm {
   class BitstreamWriter;
@@ -26,6 +27,9 @@ namespace llvm {
     SmallVectorImpl<char> &Buffer;
     std::unique_ptr<BitstreamWriter> Stream;
 
+    // The modules written so far, for the symbol table.
+    std::vector<Module *> Mods;
+
    public:
     /// Create a BitcodeWriter that writes to Buffer.
     BitcodeWriter(SmallVectorImpl<char> &Buffer);
@@ -46,6 +50,15 @@ namespace llvm {
     void writeModule(const Module *M, bool ShouldPreserveUseListOrder = false,
                      const ModuleSummaryIndex *Index = nullptr,
                      bool GenerateHash = false);
+
+    /// Write the symbol table of the modules written so far. It lets linkers
+    /// resolve the symbols of the file without creating any IR. Call this
+    /// after the last module is written, while the modules are still alive.
+    ///
+    /// The table is left out if a module has inline asm that cannot be parsed
+    /// because the asm parser of its target is not registered. Readers then
+    /// build the table from the modules.
+    void writeSymtab();
   };
 
   /// \brief Write the specified module to the specified raw output stream.
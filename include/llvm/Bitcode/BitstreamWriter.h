@@ -81,6 +81,22 @@ class BitstreamWriter {
     return Offset / 4;
   }
 
+  void PopBlockScope() {
+    const Block &B = BlockScope.back();
+
+    // Compute the size of the block, in words, not counting the size field.
+    size_t SizeInWords = GetWordIndex() - B.StartSizeWord - 1;
+    uint64_t BitNo = uint64_t(B.StartSizeWord) * 32;
+
+    // Update the block size field in the header of this sub-block.
+    BackpatchWord(BitNo, SizeInWords);
+
+    // Restore the inner block's code size and abbrev table.
+    CurCodeSize = B.PrevCodeSize;
+    CurAbbrevs = std::move(B.PrevAbbrevs);
+    BlockScope.pop_back();
+  }
+
 public:
   explicit BitstreamWriter(SmallVectorImpl<char> &O)
     : Out(O), CurBit(0), CurValue(0), CurCodeSize(2) {}
@@ -228,24 +244,30 @@ public:
 
   void ExitBlock() {
     assert(!BlockScope.empty() && "Block scope imbalance!");
-    const Block &B = BlockScope.back();
 
     // Block tail:
     //    [END_BLOCK, <align4bytes>]
     EmitCode(bitc::END_BLOCK);
     FlushToWord();
+    PopBlockScope();
+  }
 
-    // Compute the size of the block, in words, not counting the size field.
-    size_t SizeInWords = GetWordIndex() - B.StartSizeWord - 1;
-    uint64_t BitNo = uint64_t(B.StartSizeWord) * 32;
-
-    // Update the block size field in the header of this sub-block.
-    BackpatchWord(BitNo, SizeInWords);
+  /// Exit the current block, emitting \p Contents as its body. \p Contents
+  /// must have been encoded by another writer sharing this block info, from
+  /// right after EnterSubblock() to right after ExitBlock(), END_BLOCK
+  /// included.
+  void ExitBlockWithContents(ArrayRef<char> Contents) {
+    assert(!BlockScope.empty() && "Block scope imbalance!");
+    assert(CurBit == 0 && (Contents.size() & 3) == 0 && "Not 32-bit aligned");
+    Out.append(Contents.begin(), Contents.end());
+    PopBlockScope();
+  }
 
-    // Restore the inner block's code size and abbrev table.
-    CurCodeSize = B.PrevCodeSize;
-    CurAbbrevs = std::move(B.PrevAbbrevs);
-    BlockScope.pop_back();
+  /// Use the abbreviations defined by the BLOCKINFO_BLOCK of \p Other, so that
+  /// blocks encoded by this writer can be emitted into \p Other with
+  /// ExitBlockWithContents().
+  void CopyBlockInfo(const BitstreamWriter &Other) {
+    BlockInfoRecords = Other.BlockInfoRecords;
   }
 
   //===--------------------------------------------------------------------===//
@@ -52,7 +52,11 @@ enum BlockIDs {
 
   OPERAND_BUNDLE_TAGS_BLOCK_ID,
 
-  METADATA_KIND_BLOCK_ID
+  METADATA_KIND_BLOCK_ID,
+
+  // Top-level block holding the symbol table of the modules of the file, see
+  // llvm/Object/IRSymtab.h.
+  SYMTAB_BLOCK_ID
 };
 
 /// Identification block contains a string that describes the producer details,
@@ -553,6 +557,10 @@ enum ComdatSelectionKindCodes {
   COMDAT_SELECTION_KIND_SAME_SIZE = 5,
 };
 
+enum SymtabCodes {
+  SYMTAB_BLOB = 1, // SYMTAB_BLOB: [blob]
+};
+
 } // End bitc namespace
 } // End llvm namespace
 
@@ -42,6 +42,7 @@
 #include "llvm/MC/MachineLocation.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/DataTypes.h"
+#include <mutex>
 
 namespace llvm {
 
@@ -142,18 +143,43 @@ class MachineModuleInfo : public ImmutablePass {
   const Function *LastRequest = nullptr; ///< Used for shortcut/cache.
   MachineFunction *LastResult = nullptr; ///< Used for shortcut/cache.
 
+  /// The MachineModuleInfo owning the MachineFunctions and the MCContext if
+  /// this one serves a thread of parallel codegen, null otherwise.
+  MachineModuleInfo *Owner = nullptr;
+
+  /// Serializes the changes machine function passes make to the LLVMContext
+  /// while they run on several threads, see lockContext().
+  std::mutex ContextMutex;
+  bool ThreadSafe = false;
+
 public:
   static char ID; // Pass identification, replacement for typeid
 
   explicit MachineModuleInfo(const TargetMachine *TM = nullptr);
+  /// Create a MachineModuleInfo for one thread of parallel codegen. It looks up
+  /// the MachineFunctions of \p Owner, which must not create any while the
+  /// threads run, and shares its MCContext.
+  explicit MachineModuleInfo(MachineModuleInfo &Owner);
   ~MachineModuleInfo() override;
 
   // Initialization and Finalization
   bool doInitialization(Module &) override;
   bool doFinalization(Module &) override;
 
-  const MCContext &getContext() const { return Context; }
-  MCContext &getContext() { return Context; }
+  const MCContext &getContext() const {
+    return Owner ? Owner->Context : Context;
+  }
+  MCContext &getContext() { return Owner ? Owner->Context : Context; }
+
+  /// Set while machine function passes run on several functions at once, see
+  /// -codegen-threads. This makes the MCContext thread-safe as well.
+  void setThreadSafe(bool Value);
+  bool isThreadSafe() const { return ThreadSafe; }
+
+  /// Machine function passes creating constants, types or instructions in the
+  /// LLVMContext, or emitting diagnostics, must hold this lock while doing so.
+  /// It is only taken when the MachineModuleInfo is thread-safe.
+  std::unique_lock<std::mutex> lockContext();
 
   void setModule(const Module *M) { TheModule = M; }
   const Module *getModule() const { return TheModule; }
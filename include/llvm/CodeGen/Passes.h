@@ -153,6 +153,12 @@ namespace llvm {
   ///
   FunctionPass *createBasicRegisterAllocator();
 
+  /// LinearScanRegisterAllocation Pass - This pass assigns registers to live
+  /// intervals in the order they start, splitting around blocks before it
+  /// spills. It sits between the fast and the greedy allocators.
+  ///
+  FunctionPass *createLinearScanRegisterAllocator();
+
   /// Greedy register allocation pass - This pass implements a global register
   /// allocator for optimized builds.
   ///
@@ -402,6 +408,11 @@ namespace llvm {
 
   /// This pass frees the memory occupied by the MachineFunction.
   FunctionPass *createFreeMachineFunctionPass();
+
+  /// This pass runs the machine function passes from the expansion of the ISel
+  /// pseudo-instructions through register allocation on \p NumThreads threads,
+  /// each compiling different functions of the module.
+  ModulePass *createParallelMachinePassesPass(unsigned NumThreads);
 } // End llvm namespace
 
 /// Target machine pass initializer for passes with dependencies. Use with
@@ -519,6 +519,10 @@ private:
   /// Source line information.
   DebugLoc debugLoc;
 
+  /// Position of this node in the worklist of the DAGCombiner, -1 if it is not
+  /// in the worklist, or -2 if it is not but has been combined already.
+  int CombinerWorklistIndex;
+
   /// Return a pointer to the specified value type.
   static const EVT *getValueTypeList(EVT VT);
 
@@ -599,6 +603,13 @@ public:
   /// Set unique node id.
   void setNodeId(int Id) { NodeId = Id; }
 
+  /// Return the position of this node in the DAGCombiner worklist, see
+  /// CombinerWorklistIndex.
+  int getCombinerWorklistIndex() const { return CombinerWorklistIndex; }
+
+  /// Set the position of this node in the DAGCombiner worklist.
+  void setCombinerWorklistIndex(int Index) { CombinerWorklistIndex = Index; }
+
   /// Return the node ordering.
   unsigned getIROrder() const { return IROrder; }
 
@@ -902,7 +913,7 @@ protected:
   SDNode(unsigned Opc, unsigned Order, DebugLoc dl, SDVTList VTs)
       : NodeType(Opc), NodeId(-1), OperandList(nullptr), ValueList(VTs.VTs),
         UseList(nullptr), NumOperands(0), NumValues(VTs.NumVTs), IROrder(Order),
-        debugLoc(std::move(dl)) {
+        debugLoc(std::move(dl)), CombinerWorklistIndex(-1) {
     memset(&RawSDNodeBits, 0, sizeof(RawSDNodeBits));
     assert(debugLoc.hasTrivialDestructor() && "Expected trivial destructor");
     assert(NumValues == VTs.NumVTs &&
@@ -19,6 +19,7 @@
 
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/ValueMap.h"
 #include "llvm/Pass.h"
@@ -31,21 +32,9 @@ class PHINode;
 
 class StackProtector : public FunctionPass {
 public:
-  /// SSPLayoutKind.  Stack Smashing Protection (SSP) rules require that
-  /// vulnerable stack allocations are located close the stack protector.
-  enum SSPLayoutKind {
-    SSPLK_None,       ///< Did not trigger a stack protector.  No effect on data
-                      ///< layout.
-    SSPLK_LargeArray, ///< Array or nested array >= SSP-buffer-size.  Closest
-                      ///< to the stack protector.
-    SSPLK_SmallArray, ///< Array or nested array < SSP-buffer-size. 2nd closest
-                      ///< to the stack protector.
-    SSPLK_AddrOf      ///< The address of this allocation is exposed and
-                      ///< triggered protection.  3rd closest to the protector.
-  };
-
   /// A mapping of AllocaInsts to their required SSP layout.
-  typedef ValueMap<const AllocaInst *, SSPLayoutKind> SSPLayoutMap;
+  typedef ValueMap<const AllocaInst *, MachineFrameInfo::SSPLayoutKind>
+      SSPLayoutMap;
 
 private:
   const TargetMachine *TM;
@@ -125,13 +114,13 @@ public:
     AU.addPreserved<DominatorTreeWrapperPass>();
   }
 
-  SSPLayoutKind getSSPLayout(const AllocaInst *AI) const;
+  /// Record the SSPLayoutKind of the allocas in the stack objects of \p MFI,
+  /// where the machine function passes find it.
+  void copyToMachineFrameInfo(MachineFrameInfo &MFI) const;
 
   // Return true if StackProtector is supposed to be handled by SelectionDAG.
   bool shouldEmitSDCheck(const BasicBlock &BB) const;
 
-  void adjustForColoring(const AllocaInst *From, const AllocaInst *To);
-
   bool runOnFunction(Function &Fn) override;
 };
 } // end namespace llvm
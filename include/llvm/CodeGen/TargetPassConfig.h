@@ -102,6 +102,9 @@ private:
   bool Stopped;
   bool AddingMachinePasses;
 
+  void insertPrintMachineInstrsPass();
+  bool useParallelMachinePasses() const;
+
 protected:
   TargetMachine *TM;
   PassConfigImpl *Impl; // Internal data structures
@@ -253,6 +256,11 @@ public:
   /// Fully developed targets will not generally override this.
   virtual void addMachinePasses();
 
+  /// Add to \p PM the passes that addMachinePasses runs on several functions
+  /// at once with -codegen-threads, configured by a new TargetPassConfig of the
+  /// target. \p PM must also get the MachineModuleInfo owning the functions.
+  void addParallelMachinePasses(PassManagerBase &PM) const;
+
   /// Create an instance of ScheduleDAGInstrs to be run within the standard
   /// MachineScheduler pass for this function and target at the current
   /// optimization level.
@@ -402,6 +410,10 @@ protected:
   /// addMachinePasses helper to create the target-selected or overriden
   /// regalloc pass.
   FunctionPass *createRegAllocPass(bool Optimized);
+
+  /// addMachinePasses helper adding the passes from the expansion of the ISel
+  /// pseudo-instructions through register allocation.
+  void addMachinePassesThroughRegAlloc();
 };
 
 } // end namespace llvm
@@ -35,6 +35,7 @@
 #include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <utility>
 
 namespace llvm {
@@ -69,6 +70,11 @@ class DWARFContext : public DIContext {
   std::unique_ptr<DWARFDebugAbbrev> AbbrevDWO;
   std::unique_ptr<DWARFDebugLocDWO> LocDWO;
 
+  /// Set by setThreadSafe().
+  bool ThreadSafe = false;
+  /// Protects the line table cache when the context is thread-safe.
+  std::mutex LineTableLock;
+
   /// Read compile units from the debug_info section (if necessary)
   /// and store them in CUs.
   void parseCompileUnits();
@@ -94,6 +100,20 @@ public:
     return DICtx->getKind() == CK_DWARF;
   }
 
+  /// Allow this context to be queried from several threads at once.
+  ///
+  /// The unit headers and the address ranges index are parsed eagerly by
+  /// this call, while the DIEs, line tables and .dwo files of the units are
+  /// still parsed lazily, once, under a per-unit (or per-context) lock.
+  /// Once this returns, getLineInfoForAddress(),
+  /// getLineInfoForAddressRange() and getInliningInfoForAddress() can be
+  /// called concurrently. The rest of the API (notably dump()) must still be
+  /// used from a single thread.
+  void setThreadSafe();
+
+  /// Returns true if setThreadSafe() has been called on this context.
+  bool isThreadSafe() const { return ThreadSafe; }
+
   void dump(raw_ostream &OS, DIDumpType DumpType = DIDT_All,
             bool DumpEH = false, bool SummarizeTypes = false) override;
 
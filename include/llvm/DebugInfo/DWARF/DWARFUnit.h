@@ -20,6 +20,8 @@
 #include "llvm/DebugInfo/DWARF/DWARFRelocMap.h"
 #include "llvm/DebugInfo/DWARF/DWARFSection.h"
 #include "llvm/DebugInfo/DWARF/DWARFUnitIndex.h"
+#include <atomic>
+#include <mutex>
 #include <vector>
 
 namespace llvm {
@@ -143,6 +145,14 @@ class DWARFUnit {
 
   const DWARFUnitIndex::Entry *IndexEntry;
 
+  /// When the context is thread-safe (see DWARFContext::setThreadSafe()),
+  /// the DIEs are extracted all at once under ExtractLock, and
+  /// AllDIEsExtracted is set when they can be read without locking.
+  std::mutex ExtractLock;
+  std::atomic<bool> AllDIEsExtracted;
+  /// Protects DWO when the context is thread-safe.
+  std::mutex DWOLock;
+
   uint32_t getDIEIndex(const DWARFDebugInfoEntry *Die) {
     auto First = DieArray.data();
     assert(Die >= First && Die < First + DieArray.size());
@@ -243,6 +253,11 @@ public:
   void getInlinedChainForAddress(uint64_t Address,
                                  SmallVectorImpl<DWARFDie> &InlinedChain);
 
+  /// prepareForThreadSafeAccess - Called by DWARFContext::setThreadSafe().
+  /// Drops a partially extracted DIE array (it can't be completed while other
+  /// threads are reading it), and records whether the DIEs are all extracted.
+  void prepareForThreadSafeAccess();
+
   /// getUnitSection - Return the DWARFUnitSection containing this unit.
   const DWARFUnitSectionBase &getUnitSection() const { return UnitSection; }
 
@@ -301,6 +316,14 @@ public:
     return die_iterator_range(DieArray.begin(), DieArray.end());
   }
 
+  /// \brief Returns true if DIEs other than the unit DIE have been parsed.
+  bool hasExtractedDIEs() const { return DieArray.size() > 1; }
+
+  /// clearDIEs - Clear parsed DIEs to keep memory usage low. The DIEs are
+  /// parsed again when needed, but the DWARFDie objects referring to them
+  /// are invalidated.
+  void clearDIEs(bool KeepCUDie);
+
 private:
   /// Size in bytes of the .debug_info data associated with this compile unit.
   size_t getDebugInfoSize() const { return Length + 4 - getHeaderSize(); }
@@ -308,16 +331,19 @@ private:
   /// extractDIEsIfNeeded - Parses a compile unit and indexes its DIEs if it
   /// hasn't already been done. Returns the number of DIEs parsed at this call.
   size_t extractDIEsIfNeeded(bool CUDieOnly);
+  size_t extractDIEsIfNeededImpl(bool CUDieOnly);
   /// extractDIEsToVector - Appends all parsed DIEs to a vector.
   void extractDIEsToVector(bool AppendCUDie, bool AppendNonCUDIEs,
                            std::vector<DWARFDebugInfoEntry> &DIEs) const;
-  /// clearDIEs - Clear parsed DIEs to keep memory usage low.
-  void clearDIEs(bool KeepCUDie);
 
   /// parseDWO - Parses .dwo file for current compile unit. Returns true if
   /// it was actually constructed.
   bool parseDWO();
 
+  /// getDWOUnit - Parses the .dwo file for the current compile unit if
+  /// necessary, and returns the unit it contains or null if there is none.
+  DWARFUnit *getDWOUnit();
+
   /// getSubprogramForAddress - Returns subprogram DIE with address range
   /// encompassing the provided address. The pointer is alive as long as parsed
   /// compile unit DIEs are not cleared.
@@ -13,7 +13,9 @@
 #ifndef LLVM_DEBUGINFO_SYMBOLIZE_SYMBOLIZABLEMODULE_H
 #define LLVM_DEBUGINFO_SYMBOLIZE_SYMBOLIZABLEMODULE_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/DebugInfo/DIContext.h"
+#include <vector>
 
 namespace llvm {
 namespace object {
@@ -37,12 +39,38 @@ public:
                                               bool UseSymbolTable) const = 0;
   virtual DIGlobal symbolizeData(uint64_t ModuleOffset) const = 0;
 
+  // Symbolize the code at each of ModuleOffsets, which are sorted in
+  // increasing order.
+  virtual std::vector<DILineInfo>
+  symbolizeCodeBatch(ArrayRef<uint64_t> ModuleOffsets, FunctionNameKind FNKind,
+                     bool UseSymbolTable) const {
+    std::vector<DILineInfo> Res;
+    Res.reserve(ModuleOffsets.size());
+    for (uint64_t ModuleOffset : ModuleOffsets)
+      Res.push_back(symbolizeCode(ModuleOffset, FNKind, UseSymbolTable));
+    return Res;
+  }
+  virtual std::vector<DIInliningInfo>
+  symbolizeInlinedCodeBatch(ArrayRef<uint64_t> ModuleOffsets,
+                            FunctionNameKind FNKind,
+                            bool UseSymbolTable) const {
+    std::vector<DIInliningInfo> Res;
+    Res.reserve(ModuleOffsets.size());
+    for (uint64_t ModuleOffset : ModuleOffsets)
+      Res.push_back(symbolizeInlinedCode(ModuleOffset, FNKind, UseSymbolTable));
+    return Res;
+  }
+
   // Return true if this is a 32-bit x86 PE COFF module.
   virtual bool isWin32Module() const = 0;
 
   // Returns the preferred base of the module, i.e. where the loader would place
   // it in memory assuming there were no conflicts.
   virtual uint64_t getModulePreferredBase() const = 0;
+
+  // Prepare the module to be symbolized from several threads at once. Returns
+  // false if the module only supports queries from a single thread.
+  virtual bool setThreadSafe() { return false; }
 };
 
 }  // namespace symbolize
@@ -13,15 +13,22 @@
 #ifndef LLVM_DEBUGINFO_SYMBOLIZE_SYMBOLIZE_H
 #define LLVM_DEBUGINFO_SYMBOLIZE_SYMBOLIZE_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/DebugInfo/Symbolize/SymbolizableModule.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/ErrorOr.h"
+#include <cstdint>
+#include <list>
 #include <map>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace llvm {
+
+class ThreadPool;
+
 namespace symbolize {
 
 using namespace object;
@@ -36,18 +43,28 @@ public:
     bool RelativeAddresses : 1;
     std::string DefaultArch;
     std::vector<std::string> DsymHints;
+    /// Number of threads used by the batch symbolization methods.
+    unsigned Threads;
+    /// Size in bytes above which the least recently used binaries (and the
+    /// modules built from them) are evicted from the cache, 0 for no limit.
+    /// The size of a binary is the size of its file.
+    uint64_t MaxCacheSize;
     Options(FunctionNameKind PrintFunctions = FunctionNameKind::LinkageName,
             bool UseSymbolTable = true, bool Demangle = true,
             bool RelativeAddresses = false, std::string DefaultArch = "")
         : PrintFunctions(PrintFunctions), UseSymbolTable(UseSymbolTable),
           Demangle(Demangle), RelativeAddresses(RelativeAddresses),
-          DefaultArch(std::move(DefaultArch)) {}
+          DefaultArch(std::move(DefaultArch)), Threads(1), MaxCacheSize(0) {}
   };
 
-  LLVMSymbolizer(const Options &Opts = Options()) : Opts(Opts) {}
-  ~LLVMSymbolizer() {
-    flush();
-  }
+  /// A (module, offset) pair to symbolize with the batch methods.
+  struct Request {
+    std::string ModuleName;
+    uint64_t ModuleOffset;
+  };
+
+  LLVMSymbolizer(const Options &Opts = Options());
+  ~LLVMSymbolizer();
 
   Expected<DILineInfo> symbolizeCode(const std::string &ModuleName,
                                      uint64_t ModuleOffset);
@@ -55,6 +72,17 @@ public:
                                                 uint64_t ModuleOffset);
   Expected<DIGlobal> symbolizeData(const std::string &ModuleName,
                                    uint64_t ModuleOffset);
+
+  /// Batch versions of symbolizeCode() and symbolizeInlinedCode(). The
+  /// requests are grouped by module and sorted by offset, and the requests
+  /// of each module are resolved on Options::Threads threads when the debug
+  /// info of the module supports concurrent queries. The results are returned
+  /// in the order of \p Requests.
+  std::vector<Expected<DILineInfo>>
+  symbolizeCodeBatch(ArrayRef<Request> Requests);
+  std::vector<Expected<DIInliningInfo>>
+  symbolizeInlinedCodeBatch(ArrayRef<Request> Requests);
+
   void flush();
   static std::string DemangleName(const std::string &Name,
                                   const SymbolizableModule *ModInfo);
@@ -64,6 +92,40 @@ private:
   // corresponding debug info. These objects can be the same.
   typedef std::pair<ObjectFile*, ObjectFile*> ObjectPair;
 
+  /// A parsed binary, or a null binary for a parsing error.
+  struct CachedBinary {
+    OwningBinary<Binary> Bin;
+    /// Size of the file the binary was read from.
+    uint64_t Size = 0;
+    /// Position in LRUBinaries, valid if Bin holds a binary.
+    std::list<std::string>::iterator LRUPosition;
+  };
+
+  /// Symbolize \p ModuleOffsets, sorted in increasing order, in \p Info.
+  std::vector<DILineInfo>
+  symbolizeCodeInModule(const SymbolizableModule &Info,
+                        ArrayRef<uint64_t> ModuleOffsets) const;
+  std::vector<DIInliningInfo>
+  symbolizeInlinedCodeInModule(const SymbolizableModule &Info,
+                               ArrayRef<uint64_t> ModuleOffsets) const;
+
+  template <typename T>
+  std::vector<Expected<T>> symbolizeBatch(
+      ArrayRef<Request> Requests,
+      std::vector<T> (LLVMSymbolizer::*Symbolize)(const SymbolizableModule &,
+                                                  ArrayRef<uint64_t>) const);
+
+  /// Mark the binary at \p Path as the most recently used one.
+  void recordAccess(const std::string &Path);
+
+  /// Remove the binary at \p Path from the cache, along with the objects and
+  /// modules built from it.
+  void evictBinary(const std::string &Path);
+
+  /// Evict the least recently used binaries until the cache size is below
+  /// Options::MaxCacheSize. The most recently used binary is always kept.
+  void pruneCache();
+
   /// Returns a SymbolizableModule or an error if loading debug info failed.
   /// Only one attempt is made to load a module, and errors during loading are
   /// only reported once. Subsequent calls to get module info for a module that
@@ -95,7 +157,20 @@ private:
       ObjectPairForPathArch;
 
   /// \brief Contains parsed binary for each path, or parsing error.
-  std::map<std::string, OwningBinary<Binary>> BinaryForPath;
+  std::map<std::string, CachedBinary> BinaryForPath;
+
+  /// \brief Paths of the binaries in BinaryForPath, the most recently used
+  /// first.
+  std::list<std::string> LRUBinaries;
+
+  /// \brief Total size of the binaries in LRUBinaries.
+  uint64_t CacheSize = 0;
+
+  /// \brief Paths of the binaries each module in Modules was built from.
+  std::map<std::string, std::vector<std::string>> ModuleBinaries;
+
+  /// \brief Thread pool used by the batch methods, created on demand.
+  std::unique_ptr<ThreadPool> Pool;
 
   /// \brief Parsed object file for path/architecture pair, where "path" refers
   /// to Mach-O universal binary.
@@ -197,6 +197,13 @@ public:
     return getUnnamedAddr() != UnnamedAddr::None;
   }
 
+  /// Returns true if this value can be left out of the object symbol table.
+  /// This is the case for linkonce_odr values whose address is not
+  /// significant. While legal, it is not normally profitable to omit them from
+  /// the .o symbol table. Using this makes sense when the information can be
+  /// passed down to the linker or we are in LTO.
+  bool canBeOmittedFromSymbolTable() const;
+
   UnnamedAddr getUnnamedAddr() const {
     return UnnamedAddr(UnnamedAddrVal);
   }
@@ -20,6 +20,7 @@
 namespace llvm {
 
 class DataLayout;
+class Triple;
 template <typename T> class SmallVectorImpl;
 class Twine;
 class raw_ostream;
@@ -46,6 +47,9 @@ public:
                                 const Twine &GVName, const DataLayout &DL);
 };
 
+void emitLinkerFlagsForGlobalCOFF(raw_ostream &OS, const GlobalValue *GV,
+                                  const Triple &TT, Mangler &Mangler);
+
 } // End llvm namespace
 
 #endif
@@ -480,6 +480,13 @@ private:
   /// name (may be duplicates in the COMDAT case, e.g.).
   GlobalValueSummaryMapTy GlobalValueMap;
 
+  /// Flat hash table from GUID to its entry in GlobalValueMap, built by
+  /// buildGUIDTable(). Lookups in the ordered map chase pointers through a
+  /// tree of a million nodes or more on large combined indexes, while this
+  /// table answers them with a probe or two into one array. It is dropped as
+  /// soon as a summary is added or removed.
+  DenseMap<GlobalValue::GUID, const_gvsummary_iterator> GUIDTable;
+
   /// Holds strings for combined index, mapping to the corresponding module ID.
   ModulePathStringTableTy ModulePathStringTable;
 
@@ -500,34 +507,45 @@ public:
 
   /// Get the list of global value summary objects for a given value name.
   const GlobalValueSummaryList &getGlobalValueSummaryList(StringRef ValueName) {
+    GUIDTable.clear();
     return GlobalValueMap[GlobalValue::getGUID(ValueName)];
   }
 
   /// Get the list of global value summary objects for a given value name.
   const const_gvsummary_iterator
   findGlobalValueSummaryList(StringRef ValueName) const {
-    return GlobalValueMap.find(GlobalValue::getGUID(ValueName));
+    return findGlobalValueSummaryList(GlobalValue::getGUID(ValueName));
   }
 
   /// Get the list of global value summary objects for a given value GUID.
   const const_gvsummary_iterator
   findGlobalValueSummaryList(GlobalValue::GUID ValueGUID) const {
-    return GlobalValueMap.find(ValueGUID);
+    if (GUIDTable.empty())
+      return GlobalValueMap.find(ValueGUID);
+    auto I = GUIDTable.find(ValueGUID);
+    return I == GUIDTable.end() ? end() : I->second;
   }
 
   /// Add a global value summary for a value of the given name.
   void addGlobalValueSummary(StringRef ValueName,
                              std::unique_ptr<GlobalValueSummary> Summary) {
-    GlobalValueMap[GlobalValue::getGUID(ValueName)].push_back(
-        std::move(Summary));
+    addGlobalValueSummary(GlobalValue::getGUID(ValueName), std::move(Summary));
   }
 
   /// Add a global value summary for a value of the given GUID.
   void addGlobalValueSummary(GlobalValue::GUID ValueGUID,
                              std::unique_ptr<GlobalValueSummary> Summary) {
+    GUIDTable.clear();
     GlobalValueMap[ValueGUID].push_back(std::move(Summary));
   }
 
+  /// Index the summaries by GUID in a flat hash table to speed up the lookups
+  /// of findGlobalValueSummaryList and findSummaryInModule, e.g. once the thin
+  /// link merged all the per-module summaries into a combined index. The
+  /// table is dropped when the set of summaries changes. Lookups, with or
+  /// without the table, are safe to perform from several threads.
+  void buildGUIDTable();
+
   /// Find the summary for global \p GUID in module \p ModuleId, or nullptr if
   /// not found.
   GlobalValueSummary *findSummaryInModule(GlobalValue::GUID ValueGUID,
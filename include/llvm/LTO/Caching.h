@@ -16,6 +16,7 @@
 #define LLVM_LTO_CACHING_H
 
 #include "llvm/LTO/LTO.h"
+#include <chrono>
 #include <string>
 
 namespace llvm {
@@ -27,9 +28,36 @@ namespace lto {
 /// File callbacks must be thread safe.
 typedef std::function<void(unsigned Task, StringRef Path)> AddFileFn;
 
+/// Options of the local file system cache.
+struct LocalCacheOptions {
+  /// Store each distinct object file once, in a blob named by the hash of its
+  /// content, and make the entry of each cache key a hard link to its blob.
+  /// This deduplicates the objects reached through different keys, e.g. from
+  /// modules only differing by options that don't affect code generation.
+  bool ContentAddressed = false;
+
+  /// Store the blobs compressed with zlib, and the entry of each cache key as
+  /// a small file naming its blob. This implies ContentAddressed. The files
+  /// passed to the file callback are then decompressed temporary files, which
+  /// are removed when the cache is destroyed. This is ignored if zlib is not
+  /// available.
+  bool Compress = false;
+
+  /// The pruning policy of the cache directory, applied when the cache is
+  /// destroyed. The directory is pruned at most once per PruningInterval. See
+  /// CachePruning for the limits, a limit of 0 is disabled and nothing is
+  /// pruned if both are. As in ThinLTOCodeGenerator, setting a limit tracks
+  /// the entries with a manifest instead of walking the directory on every
+  /// pruning.
+  std::chrono::seconds PruningInterval = std::chrono::seconds(1200);
+  uint64_t MaxSizeBytes = 0;
+  uint64_t MaxSizeFiles = 0;
+};
+
 /// Create a local file system cache which uses the given cache directory and
 /// file callback.
-NativeObjectCache localCache(StringRef CacheDirectoryPath, AddFileFn AddFile);
+NativeObjectCache localCache(StringRef CacheDirectoryPath, AddFileFn AddFile,
+                             LocalCacheOptions Options = LocalCacheOptions());
 
 } // namespace lto
 } // namespace llvm
@@ -68,6 +68,11 @@ struct Config {
   /// Sample PGO profile path.
   std::string SampleProfile;
 
+  /// If this field is set, the thin link records its import lists in this file,
+  /// and the next link using the same file only computes again the import
+  /// lists that may have changed. See IncrementalImportState.
+  std::string ThinLTOImportStatePath;
+
   /// Optimization remarks file path.
   std::string RemarksFilename = "";
 
@@ -126,6 +126,8 @@ public:
     int PruningInterval = 1200;          // seconds, -1 to disable pruning.
     unsigned int Expiration = 7 * 24 * 3600;     // seconds (1w default).
     unsigned MaxPercentageOfAvailableSpace = 75; // percentage.
+    uint64_t MaxSizeBytes = 0;                   // bytes, 0 for no limit.
+    uint64_t MaxSizeFiles = 0;                   // files, 0 for no limit.
   };
 
   /// Provide a path to a directory where to store the cached files for
@@ -164,6 +166,18 @@ public:
       CacheOptions.MaxPercentageOfAvailableSpace = Percentage;
   }
 
+  /// Cache policy: the maximum size of the cache directory, in bytes. A value
+  /// of 0 (default) disables this limit.
+  void setCacheMaxSizeBytes(uint64_t Bytes) {
+    CacheOptions.MaxSizeBytes = Bytes;
+  }
+
+  /// Cache policy: the maximum number of files in the cache directory. A
+  /// value of 0 (default) disables this limit.
+  void setCacheMaxSizeFiles(uint64_t Files) {
+    CacheOptions.MaxSizeFiles = Files;
+  }
+
   /**@}*/
 
   /// Set the path to a directory where to save temporaries at various stages of
@@ -178,6 +192,15 @@ public:
     SavedObjectsDirectoryPath = std::move(Path);
   }
 
+  /// Set the path to a file where run() records its import lists, so that the
+  /// next run using the same file only computes again the import lists that
+  /// may have changed. See IncrementalImportState. The single-module actions
+  /// (crossModuleImport(), promote(), ...) compute the import list of one
+  /// module and don't use this file.
+  void setImportStatePath(std::string Path) {
+    ImportStatePath = std::move(Path);
+  }
+
   /// CPU to use to initialize the TargetMachine
   void setCpu(std::string Cpu) { TMBuilder.MCpu = std::move(Cpu); }
 
@@ -298,6 +321,9 @@ private:
   /// Path to a directory to save the generated object files.
   std::string SavedObjectsDirectoryPath;
 
+  /// Path to the file holding the import lists of the previous run.
+  std::string ImportStatePath;
+
   /// Flag to enable/disable CodeGen. When set to true, the process stops after
   /// optimizations and a bitcode is produced.
   bool DisableCodeGen = false;
@@ -24,6 +24,7 @@
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/raw_ostream.h"
 #include <map>
+#include <mutex>
 #include <tuple>
 #include <vector> // FIXME: Shouldn't be needed.
 
@@ -171,6 +172,13 @@ namespace llvm {
     bool AllowTemporaryLabels;
     bool UseNamesOnTempLabels = true;
 
+    /// Serializes the creation and lookup of symbols when set, so that they
+    /// can be used from the threads of parallel codegen. Sections and DWARF
+    /// state must not be created in the meantime. The mutex is recursive
+    /// because some symbol creators call others.
+    bool ThreadSafe = false;
+    mutable std::recursive_mutex SymbolsMutex;
+
     /// The Compile Unit ID that we are currently processing.
     unsigned DwarfCompileUnitID;
 
@@ -223,6 +231,15 @@ namespace llvm {
 
     bool HadError;
 
+    /// Lock the symbol table if the context is thread-safe.
+    std::unique_lock<std::recursive_mutex> lockSymbols() const {
+      std::unique_lock<std::recursive_mutex> Lock(SymbolsMutex,
+                                                  std::defer_lock);
+      if (ThreadSafe)
+        Lock.lock();
+      return Lock;
+    }
+
     MCSymbol *createSymbolImpl(const StringMapEntry<bool> *Name,
                                bool CanBeUnnamed);
     MCSymbol *createSymbol(StringRef Name, bool AlwaysAddSuffix,
@@ -259,6 +276,9 @@ namespace llvm {
     void setAllowTemporaryLabels(bool Value) { AllowTemporaryLabels = Value; }
     void setUseNamesOnTempLabels(bool Value) { UseNamesOnTempLabels = Value; }
 
+    void setThreadSafe(bool Value) { ThreadSafe = Value; }
+    bool isThreadSafe() const { return ThreadSafe; }
+
     /// \name Module Lifetime Management
     /// @{
 
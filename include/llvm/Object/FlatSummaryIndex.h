@@ -0,0 +1,243 @@
+//===- FlatSummaryIndex.h - Memory-mappable combined summary index -*- C++ -*-//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares a columnar on-disk format for the combined ThinLTO
+// summary index, and a reader that answers queries directly out of the
+// (memory-mapped) file.
+//
+// The bitcode encoding of a combined index has to be decoded entirely into
+// heap-allocated summaries before any of it can be used, which dominates the
+// startup of a distributed backend that only needs the handful of summaries
+// its imports refer to. The flat format stores every field of the summaries in
+// its own fixed-width little-endian column, with the GUIDs sorted, so a lookup
+// is a binary search over one array and reading a summary touches only the
+// pages it lives on. A single thin-link output can then be mapped read-only by
+// any number of backend processes.
+//
+// The format carries every field of the summaries: the module table, the
+// summary flags and original names, instruction counts, reference and call
+// edges (with hotness), aliasees, and the type tests and virtual calls of
+// function summaries.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OBJECT_FLATSUMMARYINDEX_H
+#define LLVM_OBJECT_FLATSUMMARYINDEX_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/iterator.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+
+namespace llvm {
+class raw_ostream;
+
+namespace object {
+
+/// Write \p Index to \p OS in the flat summary index format. The output only
+/// depends on the content of the index, not on the order summaries or modules
+/// were added to it.
+void writeFlatSummaryIndex(const ModuleSummaryIndex &Index, raw_ostream &OS);
+
+/// A read-only view of a combined summary index in the flat format. Nothing is
+/// decoded up front: the object holds pointers to the columns of the buffer,
+/// and every query reads the columns it needs.
+class FlatSummaryIndex {
+public:
+  typedef support::ulittle64_t ulittle64_t;
+  typedef support::ulittle32_t ulittle32_t;
+
+  /// On-disk file header. All the columns follow it, in the order documented
+  /// in FlatSummaryIndex.cpp, each one starting on an 8-byte boundary.
+  struct Header {
+    char Magic[8];
+    ulittle32_t Version;
+    ulittle32_t NumModules;
+    ulittle32_t NumGUIDs;
+    ulittle32_t NumSummaries;
+    ulittle32_t NumCalls;
+    ulittle32_t NumRefs;
+    ulittle32_t StringTableSize;
+    ulittle32_t NumTypeInfo;
+  };
+
+  static const uint32_t CurrentVersion = 2;
+
+  /// A call edge of a function summary.
+  struct CallEdge {
+    GlobalValue::GUID Callee;
+    CalleeInfo::HotnessType Hotness;
+  };
+
+  /// A lightweight handle on one summary of the index.
+  class Summary {
+    const FlatSummaryIndex *Index;
+    uint32_t Idx;
+
+  public:
+    Summary(const FlatSummaryIndex *Index, uint32_t Idx)
+        : Index(Index), Idx(Idx) {}
+
+    /// The position of this summary in the summary columns.
+    uint32_t getIndex() const { return Idx; }
+
+    GlobalValueSummary::SummaryKind getKind() const;
+    GlobalValueSummary::GVFlags getFlags() const;
+    GlobalValue::LinkageTypes getLinkage() const;
+    bool notEligibleToImport() const;
+    bool liveRoot() const;
+
+    /// The hash of the name of the value in its original module.
+    GlobalValue::GUID getOriginalName() const;
+
+    /// The index, into the module table, of the module defining this value.
+    uint32_t getModule() const;
+    StringRef getModulePath() const;
+
+    /// The instruction count of a function summary, 0 for other kinds.
+    uint32_t getInstCount() const;
+
+    /// The GUIDs referenced by this summary.
+    ArrayRef<ulittle64_t> refs() const;
+
+    /// The number of call edges of a function summary.
+    uint32_t getNumCalls() const;
+    CallEdge getCall(uint32_t I) const;
+
+    /// The summary of the aliasee of an alias summary.
+    Summary getAliasee() const;
+  };
+
+  /// Iterates over the summaries recorded for one GUID.
+  class summary_iterator
+      : public iterator_facade_base<summary_iterator,
+                                    std::random_access_iterator_tag, Summary,
+                                    std::ptrdiff_t, Summary, Summary> {
+    const FlatSummaryIndex *Index = nullptr;
+    uint32_t Idx = 0;
+
+  public:
+    summary_iterator() = default;
+    summary_iterator(const FlatSummaryIndex *Index, uint32_t Idx)
+        : Index(Index), Idx(Idx) {}
+
+    Summary operator*() const { return Summary(Index, Idx); }
+    bool operator==(const summary_iterator &RHS) const {
+      return Idx == RHS.Idx;
+    }
+    bool operator<(const summary_iterator &RHS) const { return Idx < RHS.Idx; }
+    std::ptrdiff_t operator-(const summary_iterator &RHS) const {
+      return std::ptrdiff_t(Idx) - std::ptrdiff_t(RHS.Idx);
+    }
+    summary_iterator &operator+=(std::ptrdiff_t N) {
+      Idx += N;
+      return *this;
+    }
+    summary_iterator &operator-=(std::ptrdiff_t N) {
+      Idx -= N;
+      return *this;
+    }
+  };
+
+  /// Returns true if \p Buffer starts with the flat summary index magic.
+  static bool isFlatSummaryIndex(StringRef Buffer);
+
+  /// Create a view of the index in \p Buffer, which must outlive the returned
+  /// object.
+  static Expected<std::unique_ptr<FlatSummaryIndex>>
+  create(MemoryBufferRef Buffer);
+
+  /// Map the index stored in the file at \p Path.
+  static Expected<std::unique_ptr<FlatSummaryIndex>>
+  createFromFile(const Twine &Path);
+
+  uint32_t getNumModules() const { return NumModules; }
+  StringRef getModulePath(uint32_t Module) const;
+  uint64_t getModuleId(uint32_t Module) const;
+  ModuleHash getModuleHash(uint32_t Module) const;
+
+  uint32_t getNumGUIDs() const { return NumGUIDs; }
+  uint32_t getNumSummaries() const { return NumSummaries; }
+
+  /// The sorted GUIDs having at least one summary.
+  ArrayRef<ulittle64_t> guids() const {
+    return makeArrayRef(GUIDs, NumGUIDs);
+  }
+
+  /// Returns the summaries recorded for \p GUID, an empty range if it is not
+  /// in the index.
+  iterator_range<summary_iterator> lookup(GlobalValue::GUID GUID) const;
+
+  /// Returns the summary for \p GUID defined in the module at \p ModulePath,
+  /// or None.
+  Optional<Summary> findSummaryInModule(GlobalValue::GUID GUID,
+                                        StringRef ModulePath) const;
+
+  /// Decode the summaries of \p GUID into \p Index, registering the modules
+  /// defining them. The aliasees of alias summaries are decoded as well when
+  /// \p Index does not already hold them. This lets a backend build the small
+  /// in-memory index it needs without decoding the rest of the file. Returns
+  /// an error if one of the decoded summaries is malformed.
+  Error materialize(GlobalValue::GUID GUID, ModuleSummaryIndex &Index) const;
+
+  /// Decode into \p Index the summaries that computing the imports of the
+  /// module at \p ModulePath looks at: the ones of the values it defines, and
+  /// transitively the ones of every value they call.
+  Error materializeForModule(StringRef ModulePath,
+                             ModuleSummaryIndex &Index) const;
+
+private:
+  friend class Summary;
+
+  FlatSummaryIndex() = default;
+
+  /// Returns the GUID owning the summary at position \p Idx.
+  GlobalValue::GUID getGUIDForSummary(uint32_t Idx) const;
+
+  /// Decode the summary at position \p Idx into \p Index, unless it is there
+  /// already, and return the in-memory summary.
+  Expected<GlobalValueSummary *>
+  materializeSummary(uint32_t Idx, ModuleSummaryIndex &Index) const;
+
+  std::unique_ptr<MemoryBuffer> OwnedBuffer;
+
+  uint32_t NumModules = 0;
+  uint32_t NumGUIDs = 0;
+  uint32_t NumSummaries = 0;
+
+  const ulittle64_t *ModuleIds = nullptr;
+  const ulittle32_t *ModuleNameOffsets = nullptr;
+  const ulittle32_t *ModuleNameSizes = nullptr;
+  const ulittle32_t *ModuleHashes = nullptr;
+  const ulittle64_t *GUIDs = nullptr;
+  const ulittle32_t *GUIDSummaryStarts = nullptr;
+  const ulittle64_t *SummaryOriginalNames = nullptr;
+  const ulittle32_t *SummaryFlags = nullptr;
+  const ulittle32_t *SummaryModules = nullptr;
+  const ulittle32_t *SummaryInstCounts = nullptr;
+  const ulittle32_t *SummaryAliasees = nullptr;
+  const ulittle32_t *SummaryCallStarts = nullptr;
+  const ulittle32_t *SummaryRefStarts = nullptr;
+  const ulittle64_t *CallGUIDs = nullptr;
+  const uint8_t *CallHotness = nullptr;
+  const ulittle64_t *RefGUIDs = nullptr;
+  const ulittle32_t *SummaryTypeInfoStarts = nullptr;
+  const ulittle64_t *TypeInfo = nullptr;
+  StringRef StringTable;
+};
+
+} // end namespace object
+} // end namespace llvm
+
+#endif // LLVM_OBJECT_FLATSUMMARYINDEX_H
@@ -0,0 +1,244 @@
+//===- IRSymtab.h - Symbol table of bitcode files ---------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the symbol table stored in the SYMTAB_BLOCK of bitcode
+// files, and a reader for it.
+//
+// Enumerating the symbols of a bitcode file with ModuleSymbolTable requires
+// creating a context, a Module and every global value of it, and parsing the
+// module inline asm. A linker resolving the symbols of thousands of archive
+// members pays that for every member it looks at. The bitcode writer instead
+// computes the symbols once, with their mangled name, flags, comdat and
+// visibility, and stores them in a self-contained flat table which is read
+// without constructing any IR.
+//
+// The table is a little-endian blob made of 32-bit words:
+//
+//   storage::Header
+//   storage::Module  Modules[]
+//   storage::Comdat  Comdats[]
+//   storage::Symbol  Symbols[]
+//   char             Strings[]
+//
+// Ranges and strings are referenced by their byte offset in the blob.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OBJECT_IRSYMTAB_H
+#define LLVM_OBJECT_IRSYMTAB_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/Object/SymbolicFile.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include <vector>
+
+namespace llvm {
+namespace irsymtab {
+
+namespace storage {
+
+typedef support::ulittle32_t Word;
+
+/// A reference to a string in the table.
+struct Str {
+  Word Offset, Size;
+
+  StringRef get(StringRef Symtab) const {
+    return Symtab.substr(Offset, Size);
+  }
+};
+
+/// A reference to an array of objects in the table.
+template <typename T> struct Range {
+  Word Offset, Size;
+
+  ArrayRef<T> get(StringRef Symtab) const {
+    return {reinterpret_cast<const T *>(Symtab.data() + Offset), Size};
+  }
+};
+
+/// The range of the symbols of one module of the file.
+struct Module {
+  Word Begin, End;
+};
+
+struct Comdat {
+  Str Name;
+};
+
+struct Symbol {
+  /// The mangled name of the symbol.
+  Str Name;
+
+  /// The name of the global value, empty for a symbol of module inline asm.
+  Str IRName;
+
+  /// The index of the comdat of the symbol in the comdat table, -1 if it isn't
+  /// in a comdat, and -2 if the comdat of an alias can't be determined.
+  Word ComdatIndex;
+
+  /// The object::BasicSymbolRef::Flags of the symbol.
+  Word Flags;
+
+  /// The FB_* bits below and the visibility.
+  Word Attributes;
+
+  enum AttributeBits {
+    FB_visibility = 0, // 2 bits
+    FB_has_gv = 2,
+    FB_tls,
+    FB_may_omit,
+    FB_unnamed_addr,
+    FB_used,
+  };
+
+  /// The size and alignment of a common symbol.
+  support::ulittle64_t CommonSize;
+  Word CommonAlign;
+
+  /// The name of the fallback of a COFF weak external.
+  Str COFFWeakExternFallbackName;
+};
+
+struct Header {
+  /// The version of the table. The table of a file written with a different
+  /// version is ignored, and built again from the modules of the file.
+  Word Version;
+  enum { kCurrentVersion = 2 };
+
+  /// The LLVM version that wrote the table. The table of a file written by
+  /// another version is built again as well, in case the symbols it would
+  /// compute differ.
+  Str Producer;
+
+  Range<Module> Modules;
+  Range<Comdat> Comdats;
+  Range<Symbol> Symbols;
+
+  /// The target triple and source file name of the first module.
+  Str TargetTriple, SourceFileName;
+
+  /// The linker options of the modules, and the COFF export directives of
+  /// their dllexport symbols.
+  Str COFFLinkerOpts;
+};
+
+} // end namespace storage
+
+/// Build the symbol table of \p Mods into \p Symtab. Only the symbols that are
+/// global and not format specific are recorded.
+Error build(ArrayRef<Module *> Mods, SmallVector<char, 0> &Symtab);
+
+/// A decoded symbol of the table.
+struct Symbol {
+  StringRef Name, IRName, COFFWeakExternFallbackName;
+  int ComdatIndex;
+  uint32_t Flags, Attributes;
+  uint64_t CommonSize;
+  uint32_t CommonAlign;
+
+  /// Returns the mangled name of the symbol.
+  StringRef getName() const { return Name; }
+
+  /// Returns the name of the global value of the symbol, empty for a symbol of
+  /// module inline asm.
+  StringRef getIRName() const { return IRName; }
+
+  uint32_t getFlags() const { return Flags; }
+  GlobalValue::VisibilityTypes getVisibility() const {
+    return GlobalValue::VisibilityTypes(
+        (Attributes >> storage::Symbol::FB_visibility) & 3);
+  }
+  bool isTLS() const { return hasAttribute(storage::Symbol::FB_tls); }
+  bool canBeOmittedFromSymbolTable() const {
+    return hasAttribute(storage::Symbol::FB_may_omit);
+  }
+  bool isUsed() const { return hasAttribute(storage::Symbol::FB_used); }
+  bool hasGlobalUnnamedAddr() const {
+    return hasAttribute(storage::Symbol::FB_unnamed_addr);
+  }
+
+  /// Returns true if the symbol is a global value, false for a symbol of module
+  /// inline asm.
+  bool isGV() const { return hasAttribute(storage::Symbol::FB_has_gv); }
+
+  uint64_t getCommonSize() const {
+    assert(Flags & object::BasicSymbolRef::SF_Common);
+    return CommonSize;
+  }
+  uint32_t getCommonAlignment() const {
+    assert(Flags & object::BasicSymbolRef::SF_Common);
+    return CommonAlign;
+  }
+
+  /// For COFF weak externals, returns the name of the symbol that is used as a
+  /// fallback if the weak external remains undefined.
+  StringRef getCOFFWeakExternalFallback() const {
+    assert((Flags & object::BasicSymbolRef::SF_Weak) &&
+           (Flags & object::BasicSymbolRef::SF_Indirect) &&
+           "symbol is not a weak external");
+    return COFFWeakExternFallbackName;
+  }
+
+private:
+  bool hasAttribute(unsigned Bit) const { return Attributes & (1u << Bit); }
+};
+
+/// Reads the symbol table. The table must outlive the reader.
+class Reader {
+  StringRef Symtab;
+  const storage::Header *Header = nullptr;
+
+public:
+  Reader() = default;
+
+  /// Create a reader for \p Symtab, checking that it is well formed: the
+  /// symbols of the modules must follow each other and cover the whole table.
+  /// Returns an error if it isn't, or if it was written with another version.
+  static Expected<Reader> create(StringRef Symtab);
+
+  unsigned getNumModules() const;
+
+  /// Returns the range of the symbols of the module \p I.
+  std::pair<size_t, size_t> getModuleSymbols(unsigned I) const;
+
+  size_t getNumSymbols() const;
+  Symbol getSymbol(size_t I) const;
+
+  std::vector<StringRef> getComdatTable() const;
+
+  StringRef getProducer() const;
+  StringRef getTargetTriple() const;
+  StringRef getSourceFileName() const;
+  StringRef getCOFFLinkerOpts() const;
+};
+
+/// The modules of a bitcode file with the reader of their symbol table.
+struct FileContents {
+  /// The table when it was built for the file, rather than read from it.
+  SmallVector<char, 0> OwnedSymtab;
+  std::vector<BitcodeModule> Mods;
+  Reader TheReader;
+};
+
+/// Read the modules and the symbol table of the bitcode file \p BC. If the
+/// file has no usable table, i.e. no table, a malformed one, or one written by
+/// another producer or for a different number of modules, it is built from
+/// its modules.
+Expected<FileContents> readBitcode(MemoryBufferRef BC);
+
+} // end namespace irsymtab
+} // end namespace llvm
+
+#endif // LLVM_OBJECT_IRSYMTAB_H
@@ -24,6 +24,7 @@
 #include "llvm/ProfileData/InstrProf.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Endian.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <system_error>
 #include <tuple>
@@ -450,9 +451,23 @@ public:
     return load(ArrayRef<StringRef>(ObjectFilename), ProfileFilename, Arch);
   }
 
+  /// \brief Load the coverage mapping from the given files. If
+  /// \p CacheDirectory is not empty, the decoded mapping is read from the
+  /// cache file of these inputs in it when there is one, and saved there
+  /// otherwise. Cache files are named after a hash of the contents of the
+  /// inputs and of \p Arch.
   static Expected<std::unique_ptr<CoverageMapping>>
   load(ArrayRef<StringRef> ObjectFilenames, StringRef ProfileFilename,
-       StringRef Arch = StringRef());
+       StringRef Arch = StringRef(), StringRef CacheDirectory = StringRef());
+
+  /// \brief Serialize the decoded coverage mapping, in the format read by
+  /// readCache().
+  void writeCache(raw_ostream &OS) const;
+
+  /// \brief Load a coverage mapping serialized by writeCache(). The result
+  /// doesn't refer to \p Buffer.
+  static Expected<std::unique_ptr<CoverageMapping>>
+  readCache(MemoryBufferRef Buffer);
 
   /// \brief The number of functions that couldn't have their profiles mapped.
   ///
@@ -16,14 +16,17 @@
 #define LLVM_PROFILEDATA_INSTRPROFREADER_H
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ProfileData/InstrProf.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/EndianStream.h"
 #include "llvm/Support/LineIterator.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/OnDiskHashTable.h"
 #include "llvm/Support/raw_ostream.h"
 #include <iterator>
+#include <memory>
 
 namespace llvm {
 
@@ -248,6 +251,23 @@ private:
 typedef RawInstrProfReader<uint32_t> RawInstrProfReader32;
 typedef RawInstrProfReader<uint64_t> RawInstrProfReader64;
 
+/// A read-only view of a single function record in an indexed profile.
+///
+/// Unlike InstrProfRecord, nothing is decoded or copied: the counters and the
+/// serialized value profile data point directly into the profile buffer of
+/// the reader that produced the view, and stay valid as long as that reader.
+struct InstrProfRecordView {
+  /// The name of the function, as stored in the profile.
+  StringRef Name;
+  /// The structural hash of the function.
+  uint64_t Hash = 0;
+  /// The function's counters, stored little-endian in the profile.
+  ArrayRef<support::ulittle64_t> Counts;
+  /// The serialized ValueProfData of the record, or empty if the profile
+  /// carries no value profile data.
+  ArrayRef<uint8_t> ValueData;
+};
+
 namespace IndexedInstrProf {
 enum class HashT : uint32_t;
 }
@@ -297,10 +317,18 @@ public:
                               const unsigned char *const End);
   data_type ReadData(StringRef K, const unsigned char *D, offset_type N);
 
+  /// Split the payload of one key into record views without decoding it.
+  /// Return false if the payload is malformed.
+  bool ReadDataViews(const unsigned char *D, offset_type N,
+                     SmallVectorImpl<InstrProfRecordView> &Views) const;
+
   // Used for testing purpose only.
   void setValueProfDataEndianness(support::endianness Endianness) {
     ValueProfDataEndianness = Endianness;
   }
+  support::endianness getValueProfDataEndianness() const {
+    return ValueProfDataEndianness;
+  }
 };
 
 struct InstrProfReaderIndexBase {
@@ -310,9 +338,15 @@ struct InstrProfReaderIndexBase {
   // Read all the profile records with the key equal to FuncName
   virtual Error getRecords(StringRef FuncName,
                                      ArrayRef<InstrProfRecord> &Data) = 0;
+  // Return views of all the profile records with the key equal to FuncName.
+  // Unlike getRecords, this does not touch any state of the index and can be
+  // called concurrently.
+  virtual Error getRecordViews(StringRef FuncName,
+                               SmallVectorImpl<InstrProfRecordView> &Views) = 0;
   virtual void advanceToNextKey() = 0;
   virtual bool atEnd() const = 0;
   virtual void setValueProfDataEndianness(support::endianness Endianness) = 0;
+  virtual support::endianness getValueProfDataEndianness() const = 0;
   virtual ~InstrProfReaderIndexBase() {}
   virtual uint64_t getVersion() const = 0;
   virtual bool isIRLevelProfile() const = 0;
@@ -339,6 +373,8 @@ public:
   Error getRecords(ArrayRef<InstrProfRecord> &Data) override;
   Error getRecords(StringRef FuncName,
                    ArrayRef<InstrProfRecord> &Data) override;
+  Error getRecordViews(StringRef FuncName,
+                       SmallVectorImpl<InstrProfRecordView> &Views) override;
   void advanceToNextKey() override { RecordIterator++; }
   bool atEnd() const override {
     return RecordIterator == HashTable->data_end();
@@ -346,6 +382,9 @@ public:
   void setValueProfDataEndianness(support::endianness Endianness) override {
     HashTable->getInfoObj().setValueProfDataEndianness(Endianness);
   }
+  support::endianness getValueProfDataEndianness() const override {
+    return HashTable->getInfoObj().getValueProfDataEndianness();
+  }
   ~InstrProfReaderIndex() override {}
   uint64_t getVersion() const override { return GET_VERSION(FormatVersion); }
   bool isIRLevelProfile() const override {
@@ -365,6 +404,9 @@ private:
   std::unique_ptr<InstrProfReaderIndexBase> Index;
   /// Profile summary data.
   std::unique_ptr<ProfileSummary> Summary;
+  /// The index of the next record to read among the records of the current
+  /// function name.
+  unsigned RecordIndex = 0;
 
   IndexedInstrProfReader(const IndexedInstrProfReader &) = delete;
   IndexedInstrProfReader &operator=(const IndexedInstrProfReader &) = delete;
@@ -394,6 +436,12 @@ public:
   Expected<InstrProfRecord> getInstrProfRecord(StringRef FuncName,
                                                uint64_t FuncHash);
 
+  /// \brief Return a view of the record associated with FuncName and
+  /// FuncHash without decoding it. The view points into the profile buffer
+  /// and is valid as long as this reader.
+  Expected<InstrProfRecordView> getInstrProfRecordView(StringRef FuncName,
+                                                       uint64_t FuncHash);
+
   /// Fill Counts with the profile data for the given function name.
   Error getFunctionCounts(StringRef FuncName, uint64_t FuncHash,
                           std::vector<uint64_t> &Counts);
@@ -408,6 +456,21 @@ public:
   static Expected<std::unique_ptr<IndexedInstrProfReader>>
   create(std::unique_ptr<MemoryBuffer> Buffer);
 
+  /// \brief Return a reader for the indexed profile at \p Path that is shared
+  /// with every other caller in the process asking for the same, unmodified
+  /// file. The process keeps the readers of the last few profiles it used
+  /// alive until the files change or releaseSharedReaders is called.
+  ///
+  /// Only getInstrProfRecord, getInstrProfRecordView and the summary
+  /// accessors may be used on a shared reader; they are safe to call from
+  /// several threads at once. Iterating with readNextRecord is not.
+  static Expected<std::shared_ptr<IndexedInstrProfReader>>
+  getShared(const Twine &Path);
+
+  /// \brief Drop the references getShared keeps to its readers. A reader is
+  /// destroyed once its last user drops it.
+  static void releaseSharedReaders();
+
   // Used for testing purpose only.
   void setValueProfDataEndianness(support::endianness Endianness) {
     Index->setValueProfDataEndianness(Endianness);
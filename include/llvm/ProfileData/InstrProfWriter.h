@@ -20,12 +20,16 @@
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace llvm {
 
 /// Writer for instrumentation based profile data.
 class ProfOStream;
 class InstrProfRecordWriterTrait;
+class InstrProfSummaryBuilder;
 
 class InstrProfWriter {
 public:
@@ -49,8 +53,16 @@ public:
   Error addRecord(InstrProfRecord &&I, uint64_t Weight = 1);
   /// Merge existing function counts from the given writer.
   Error mergeRecordsFromWriter(InstrProfWriter &&IPW);
+  /// Return the number of distinct function names with counts.
+  size_t getNumFunctions() const { return FunctionData.size(); }
+  /// Drop all the function counts. The profile kind is kept.
+  void clearRecords() { FunctionData.clear(); }
   /// Write the profile to \c OS
   void write(raw_fd_ostream &OS);
+  /// Write the profile to \c OS with the functions laid out in the order of
+  /// \c InstrProfStreamWriter::precedes, so that reading it back with an
+  /// \c IndexedInstrProfReader yields the functions in that order.
+  void writeInStreamOrder(raw_fd_ostream &OS);
   /// Write the profile in text format to \c OS
   void writeText(raw_fd_ostream &OS);
   /// Write \c Record in text format to \c OS
@@ -80,6 +92,48 @@ private:
   void writeImpl(ProfOStream &OS);
 };
 
+/// Writer for an indexed profile whose functions are added one at a time, so
+/// that the whole profile never has to be held in memory. The functions must
+/// be added in the order of \c precedes, which keeps the functions of each
+/// bucket of the on-disk hash table together whatever the number of buckets.
+class InstrProfStreamWriter {
+  ProfOStream *OS;
+  bool Sparse;
+  InstrProfRecordWriterTrait *InfoObj;
+  std::unique_ptr<InstrProfSummaryBuilder> ISB;
+  uint64_t HashTableStartFieldOffset;
+  uint64_t SummaryOffset;
+  uint64_t NumEntries = 0;
+  /// The offset of each bucket of the hash table, 0 for an empty bucket.
+  std::vector<uint64_t> BucketOffsets;
+  /// The bucket being written, and its items which are buffered until the
+  /// bucket is complete.
+  uint64_t CurBucket = 0;
+  uint16_t CurBucketLength = 0;
+  std::string CurBucketData;
+
+  void flushBucket();
+
+public:
+  /// Start writing a profile to \c OS. \p MaxNumFunctions is an upper bound
+  /// of the number of functions that will be added, used to size the hash
+  /// table.
+  InstrProfStreamWriter(raw_fd_ostream &OS, bool IsIRLevel, bool Sparse,
+                        uint64_t MaxNumFunctions);
+  ~InstrProfStreamWriter();
+
+  /// Return true if the function \p LHS must be added before \p RHS.
+  static bool precedes(StringRef LHS, StringRef RHS);
+  /// Add the records of the function \p Name.
+  void addFunction(StringRef Name, const InstrProfWriter::ProfilingData &PD);
+  /// Write the hash table and the profile summary. No function can be added
+  /// afterwards.
+  void finish();
+
+  // Internal interface for testing purpose only.
+  void setValueProfDataEndianness(support::endianness Endianness);
+};
+
 } // end namespace llvm
 
 #endif
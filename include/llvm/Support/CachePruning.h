@@ -53,16 +53,62 @@ public:
     return *this;
   }
 
+  /// Define the maximum size of the files in the cache directory, in bytes.
+  /// A value of 0 disables this limit.
+  CachePruning &setMaxSizeBytes(uint64_t Bytes) {
+    MaxSizeBytes = Bytes;
+    return *this;
+  }
+
+  /// Define the maximum number of files in the cache directory. A value of 0
+  /// disables this limit.
+  CachePruning &setMaxEntries(uint64_t Entries) {
+    MaxEntries = Entries;
+    return *this;
+  }
+
+  /// Keep track of the cache entries in a manifest file instead of walking and
+  /// stat-ing the whole directory on every pruning. The clients of the cache
+  /// report the entries they add or use with recordAccess(), which appends to
+  /// a journal that the next pruning folds into the manifest. The directory is
+  /// walked again when there is no manifest, or when it is more than a day
+  /// old, which also picks up the entries whose record was missed.
+  CachePruning &setUseManifest(bool Use) {
+    UseManifest = Use;
+    return *this;
+  }
+
   /// Peform pruning using the supplied options, returns true if pruning
   /// occured, i.e. if PruningInterval was expired.
+  ///
+  /// Entries are evicted least recently used first until the cache fits in all
+  /// the size limits. Entries that are hard links to the same file count its
+  /// size once, and removing one of them frees nothing while another link is
+  /// left. Only one process prunes a given directory at a time;
+  /// the others return false immediately. Entries are removed with a single
+  /// unlink, so a concurrent reader keeps its open file, and a concurrent
+  /// writer's rename of a new entry is not affected.
   bool prune();
 
+  /// Record that the entry \p EntryName of \p Size bytes was just added to, or
+  /// used from, the cache directory \p Path. This does nothing unless the
+  /// cache is pruned with a manifest. It is safe to call from several threads
+  /// and processes at the same time.
+  static void recordAccess(StringRef Path, StringRef EntryName, uint64_t Size);
+
+  /// Returns true if recordAccess() records the accesses to the cache
+  /// directory \p Path, i.e. if the cache is pruned with a manifest.
+  static bool isRecordingAccesses(StringRef Path);
+
 private:
   // Options that matches the setters above.
   std::string Path;
   std::chrono::seconds Expiration = std::chrono::seconds::zero();
   std::chrono::seconds Interval = std::chrono::seconds::zero();
   unsigned PercentageOfAvailableSpace = 0;
+  uint64_t MaxSizeBytes = 0;
+  uint64_t MaxEntries = 0;
+  bool UseManifest = false;
 };
 
 } // namespace llvm
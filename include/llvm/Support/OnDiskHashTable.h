@@ -331,6 +331,7 @@ public:
 
     data_type operator*() const { return InfoObj->ReadData(Key, Data, Len); }
 
+    const internal_key_type &getInternalKey() const { return Key; }
     const unsigned char *getDataPtr() const { return Data; }
     offset_type getDataLen() const { return Len; }
 
@@ -402,6 +403,7 @@ public:
   iterator end() const { return iterator(); }
 
   Info &getInfoObj() { return InfoObj; }
+  const Info &getInfoObj() const { return InfoObj; }
 
   /// \brief Create the hash table.
   ///
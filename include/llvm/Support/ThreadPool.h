@@ -35,19 +35,32 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <utility>
+#include <vector>
 
 namespace llvm {
 
+class ThreadPoolTaskGroup;
+
 /// A ThreadPool for asynchronous parallel execution on a defined number of
 /// threads.
 ///
-/// The pool keeps a vector of threads alive, waiting on a condition variable
-/// for some work to become available.
+/// The pool is a work-stealing scheduler: every worker thread owns a deque of
+/// tasks. Tasks submitted from outside the pool are distributed round-robin to
+/// the back of the worker deques, while tasks submitted by a running task are
+/// pushed to the front of the current worker's deque so that nested work is
+/// processed depth-first. An idle worker first drains its own deque from the
+/// front, then steals from the back of the other workers' deques, and finally
+/// sleeps on a condition variable until new work is queued.
+///
+/// Tasks can be collected in a ThreadPoolTaskGroup, which can be waited on
+/// independently of the rest of the pool. Waiting on a group from a worker
+/// thread executes queued tasks instead of blocking ("help while waiting"), so
+/// nested parallelism does not deadlock even with a single worker thread.
 class ThreadPool {
 public:
 #ifndef _MSC_VER
@@ -78,45 +91,104 @@ public:
   inline std::shared_future<VoidTy> async(Function &&F, Args &&... ArgList) {
     auto Task =
         std::bind(std::forward<Function>(F), std::forward<Args>(ArgList)...);
-#ifndef _MSC_VER
-    return asyncImpl(std::move(Task));
-#else
-    // This lambda has to be marked mutable because MSVC 2013's std::bind call
-    // operator isn't const qualified.
-    return asyncImpl([Task](VoidTy) mutable -> VoidTy {
-      Task();
-      return VoidTy();
-    });
-#endif
+    return async(std::move(Task));
   }
 
   /// Asynchronous submission of a task to the pool. The returned future can be
   /// used to wait for the task to finish and is *non-blocking* on destruction.
   template <typename Function>
   inline std::shared_future<VoidTy> async(Function &&F) {
-#ifndef _MSC_VER
-    return asyncImpl(std::forward<Function>(F));
-#else
-    return asyncImpl([F] (VoidTy) -> VoidTy { F(); return VoidTy(); });
-#endif
+    return asyncImpl(wrapTask(std::forward<Function>(F)), nullptr);
+  }
+
+  /// Asynchronous submission of a task belonging to \p Group. The task is
+  /// accounted for by ThreadPoolTaskGroup::wait() in addition to wait().
+  template <typename Function>
+  inline std::shared_future<VoidTy> async(ThreadPoolTaskGroup &Group,
+                                          Function &&F) {
+    return asyncImpl(wrapTask(std::forward<Function>(F)), &Group);
   }
 
   /// Blocking wait for all the threads to complete and the queue to be empty.
-  /// It is an error to try to add new tasks while blocking on this call.
+  /// It is an error to try to add new tasks while blocking on this call, and
+  /// it must not be called from one of the pool's tasks: use a
+  /// ThreadPoolTaskGroup to join nested work instead.
   void wait();
 
+  /// Blocking wait for all the tasks submitted to \p Group to complete. When
+  /// called from a worker thread of this pool, the calling thread runs queued
+  /// tasks while the group is not finished instead of blocking.
+  void wait(ThreadPoolTaskGroup &Group);
+
+  /// Returns the number of worker threads in the pool.
+  unsigned getThreadCount() const { return ThreadCount; }
+
+  /// Returns true if the current thread is a worker thread of this pool.
+  bool isWorkerThread() const;
+
 private:
+  /// A queued task along with the group it belongs to, if any.
+  struct QueuedTask {
+    PackagedTaskTy Task;
+    ThreadPoolTaskGroup *Group;
+  };
+
+  /// The per-thread double-ended task queue. The owner consumes from the
+  /// front and thieves steal from the back.
+  struct WorkerQueue {
+    std::mutex Lock;
+    std::deque<QueuedTask> Tasks;
+  };
+
+  template <typename Function> static TaskTy wrapTask(Function &&F) {
+#ifndef _MSC_VER
+    return std::forward<Function>(F);
+#else
+    // This lambda has to be marked mutable because MSVC 2013's std::bind call
+    // operator isn't const qualified.
+    return [F](VoidTy) mutable -> VoidTy {
+      F();
+      return VoidTy();
+    };
+#endif
+  }
+
   /// Asynchronous submission of a task to the pool. The returned future can be
   /// used to wait for the task to finish and is *non-blocking* on destruction.
-  std::shared_future<VoidTy> asyncImpl(TaskTy F);
+  std::shared_future<VoidTy> asyncImpl(TaskTy F, ThreadPoolTaskGroup *Group);
+
+  /// Pop one task, looking first at the queue of the worker \p Self (if it
+  /// is a valid worker index), then trying to steal from the other workers.
+  /// Returns false if every queue was found empty.
+  bool popTask(unsigned Self, QueuedTask &Result);
+
+  /// Run \p Task and update the pool and group accounting.
+  void runTask(QueuedTask &Task);
+
+  /// Main loop of the worker thread \p ThreadID.
+  void workerLoop(unsigned ThreadID);
+
+  /// Number of worker threads.
+  unsigned ThreadCount;
 
   /// Threads in flight
   std::vector<llvm::thread> Threads;
 
-  /// Tasks waiting for execution in the pool.
-  std::queue<PackagedTaskTy> Tasks;
+  /// Task queues, one per worker thread (a single one when threads are
+  /// disabled).
+  std::unique_ptr<WorkerQueue[]> Queues;
+
+  /// Round-robin cursor used to distribute tasks submitted from outside the
+  /// pool.
+  std::atomic<unsigned> NextQueue;
+
+  /// Number of tasks sitting in one of the queues.
+  std::atomic<unsigned> QueuedTasks;
 
-  /// Locking and signaling for accessing the Tasks queue.
+  /// Number of tasks submitted but not yet completed.
+  std::atomic<unsigned> OutstandingTasks;
+
+  /// Locking and signaling for idle workers waiting on new tasks.
   std::mutex QueueLock;
   std::condition_variable QueueCondition;
 
@@ -124,14 +196,57 @@ private:
   std::mutex CompletionLock;
   std::condition_variable CompletionCondition;
 
-  /// Keep track of the number of thread actually busy
-  std::atomic<unsigned> ActiveThreads;
-
 #if LLVM_ENABLE_THREADS // avoids warning for unused variable
   /// Signal for the destruction of the pool, asking thread to exit.
   bool EnableFlag;
 #endif
 };
+
+/// A group of tasks submitted to a ThreadPool that can be waited on
+/// independently of the other tasks in the pool, including from a task
+/// running on the pool itself.
+///
+/// \code
+///   ThreadPoolTaskGroup Group(Pool);
+///   for (auto &Item : Items)
+///     Group.async([&] { process(Item); });
+///   Group.wait();
+/// \endcode
+class ThreadPoolTaskGroup {
+public:
+  explicit ThreadPoolTaskGroup(ThreadPool &Pool) : Pool(Pool), Pending(0) {}
+
+  /// Blocking destructor: waits for all the tasks of the group to complete.
+  ~ThreadPoolTaskGroup() { wait(); }
+
+  ThreadPoolTaskGroup(const ThreadPoolTaskGroup &) = delete;
+  ThreadPoolTaskGroup &operator=(const ThreadPoolTaskGroup &) = delete;
+
+  /// Submit a task to the underlying pool as part of this group.
+  template <typename Function, typename... Args>
+  inline std::shared_future<ThreadPool::VoidTy> async(Function &&F,
+                                                      Args &&... ArgList) {
+    return Pool.async(*this, std::bind(std::forward<Function>(F),
+                                       std::forward<Args>(ArgList)...));
+  }
+
+  /// Wait for all the tasks of this group to complete. See
+  /// ThreadPool::wait(ThreadPoolTaskGroup &).
+  void wait() { Pool.wait(*this); }
+
+  /// Returns true if every task submitted to this group has completed.
+  bool isFinished() const { return Pending == 0; }
+
+  ThreadPool &getPool() const { return Pool; }
+
+private:
+  friend class ThreadPool;
+
+  ThreadPool &Pool;
+
+  /// Number of tasks of this group submitted but not yet completed.
+  std::atomic<unsigned> Pending;
+};
 }
 
 #endif // LLVM_SUPPORT_THREAD_POOL_H
@@ -18,8 +18,10 @@
 
 #include <functional>
 #include <map>
+#include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace llvm {
 class LLVMContext;
@@ -70,6 +72,45 @@ public:
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
 };
 
+/// The import lists computed by an earlier thin link, with what each of them
+/// was computed from. Given to ComputeCrossModuleImport(), it lets a link over
+/// mostly unchanged modules compute again only the import lists that may
+/// differ: the ones of the modules that changed, and of the modules that looked
+/// up the summaries of a global defined (or no longer defined) by a module that
+/// changed. Modules are compared through the module hash recorded in their
+/// summary; the import lists of modules without a hash are always computed.
+struct IncrementalImportState {
+  struct ModuleState {
+    /// The hash of the module when its import list was computed.
+    ModuleHash Hash;
+    /// The globals defined by the module, sorted.
+    std::vector<GlobalValue::GUID> DefinedGUIDs;
+    /// The globals whose summaries were looked up while computing the import
+    /// list, sorted.
+    std::vector<GlobalValue::GUID> Dependencies;
+    FunctionImporter::ImportMapTy ImportList;
+  };
+
+  /// The importing options the state was computed with. The state is only
+  /// reused under the same options.
+  std::string Options;
+  /// The dead symbols of the link, sorted.
+  std::vector<GlobalValue::GUID> DeadSymbols;
+  StringMap<ModuleState> Modules;
+
+  /// The number of import lists the last ComputeCrossModuleImport() call
+  /// reused.
+  unsigned NumReused = 0;
+
+  /// Read the state saved at \p Path. If it can't be read, e.g. there is no
+  /// such file yet, the state is empty.
+  static IncrementalImportState load(StringRef Path);
+
+  /// Atomically replace the file at \p Path with this state, so that several
+  /// links sharing a path never see a partially written state.
+  Error save(StringRef Path) const;
+};
+
 /// Compute all the imports and exports for every module in the Index.
 ///
 /// \p ModuleToDefinedGVSummaries contains for each Module a map
@@ -85,12 +126,16 @@ public:
 ///
 /// \p DeadSymbols (optional) contains a list of GUID that are deemed "dead" and
 /// will be ignored for the purpose of importing.
+///
+/// \p State (optional) holds the import lists of an earlier link, reused for
+/// the modules they are still valid for. It is updated to this link's results.
 void ComputeCrossModuleImport(
     const ModuleSummaryIndex &Index,
     const StringMap<GVSummaryMapTy> &ModuleToDefinedGVSummaries,
     StringMap<FunctionImporter::ImportMapTy> &ImportLists,
     StringMap<FunctionImporter::ExportSetTy> &ExportLists,
-    const DenseSet<GlobalValue::GUID> *DeadSymbols = nullptr);
+    const DenseSet<GlobalValue::GUID> *DeadSymbols = nullptr,
+    IncrementalImportState *State = nullptr);
 
 /// Compute all the imports for the given module using the Index.
 ///
@@ -71,6 +71,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -93,12 +94,90 @@ static cl::opt<bool> PrintSummaryGUIDs(
     cl::desc(
         "Print the global id for each value when reading the module summary"));
 
+static cl::opt<unsigned> ReaderThreads(
+    "bitcode-reader-threads", cl::init(0), cl::Hidden,
+    cl::desc("Number of threads decoding the function blocks ahead of their "
+             "parsing when materializing a whole module (0 = disabled)"));
+
 namespace {
 
 enum {
   SWITCH_INST_MAGIC = 0x4B5 // May 2012 => 1205 => Hex
 };
 
+/// The top-level entries of a function block, decoded ahead of the parsing of
+/// the function by a worker thread. The nested blocks are not decoded, only
+/// their position is kept so that the reader parses them from its own cursor.
+struct DecodedFunctionBlock {
+  struct Entry {
+    /// Set for records, nested blocks and the end of the block are read from
+    /// the stream.
+    bool IsRecord;
+    /// The code of a record.
+    unsigned Code;
+    /// The position of the abbreviation ID of a nested block or of the end of
+    /// the function block.
+    uint64_t BitNo;
+    /// The range of the operands of a record in Ops.
+    unsigned OpsBegin, OpsEnd;
+  };
+
+  std::vector<Entry> Entries;
+  std::vector<uint64_t> Ops;
+  /// Set if the block is malformed. The function is then parsed from the
+  /// stream to report the error.
+  bool Failed = false;
+};
+
+/// Decode the function block at \p BitNo in \p Bytes into \p Block. This
+/// doesn't touch the context and can run on any thread.
+void decodeFunctionBlock(ArrayRef<uint8_t> Bytes, BitstreamBlockInfo *BlockInfo,
+                         uint64_t BitNo, DecodedFunctionBlock &Block) {
+  BitstreamCursor Cursor(Bytes);
+  Cursor.setBlockInfo(BlockInfo);
+  Cursor.JumpToBit(BitNo);
+  if (Cursor.EnterSubBlock(bitc::FUNCTION_BLOCK_ID)) {
+    Block.Failed = true;
+    return;
+  }
+
+  SmallVector<uint64_t, 64> Record;
+  while (true) {
+    uint64_t EntryBitNo = Cursor.GetCurrentBitNo();
+    BitstreamEntry Entry =
+        Cursor.advance(BitstreamCursor::AF_DontAutoprocessAbbrevs);
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+      Block.Failed = true;
+      return;
+    case BitstreamEntry::EndBlock:
+      Block.Entries.push_back({false, 0, EntryBitNo, 0, 0});
+      return;
+    case BitstreamEntry::SubBlock:
+      Block.Entries.push_back({false, 0, EntryBitNo, 0, 0});
+      if (Cursor.SkipBlock()) {
+        Block.Failed = true;
+        return;
+      }
+      continue;
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    if (Entry.ID == bitc::DEFINE_ABBREV) {
+      Cursor.ReadAbbrevRecord();
+      continue;
+    }
+    Record.clear();
+    unsigned Code = Cursor.readRecord(Entry.ID, Record);
+    unsigned OpsBegin = Block.Ops.size();
+    Block.Ops.insert(Block.Ops.end(), Record.begin(), Record.end());
+    Block.Entries.push_back(
+        {true, Code, EntryBitNo, OpsBegin, (unsigned)Block.Ops.size()});
+  }
+}
+
 Error error(const Twine &Message) {
   return make_error<StringError>(
       Message, make_error_code(BitcodeError::CorruptedBitcode));
@@ -448,6 +527,21 @@ class BitcodeReader : public BitcodeReaderBase, public GVMaterializer {
   /// where to find deferred function body in the stream.
   DenseMap<Function*, uint64_t> DeferredFunctionInfo;
 
+  /// A function block being decoded ahead of time by DecodePool.
+  struct PendingFunctionBlock {
+    std::shared_future<ThreadPool::VoidTy> Done;
+    std::unique_ptr<DecodedFunctionBlock> Block;
+  };
+
+  /// When materializing the whole module with -bitcode-reader-threads, the
+  /// functions whose blocks are decoded ahead of their parsing, in order, and
+  /// the blocks in flight. Only a bounded window of blocks is in flight to
+  /// bound the memory used by the decoded records.
+  std::vector<Function *> FunctionsToDecode;
+  unsigned NextFunctionToDecode = 0;
+  DenseMap<Function *, PendingFunctionBlock> PendingFunctionBlocks;
+  std::unique_ptr<ThreadPool> DecodePool;
+
   /// When Metadata block is initially scanned when parsing the module, we may
   /// choose to defer parsing of the metadata. This vector contains info about
   /// which Metadata blocks are deferred.
@@ -614,6 +708,10 @@ private:
   Error rememberAndSkipMetadata();
   Error typeCheckLoadStoreInst(Type *ValType, Type *PtrType);
   Error parseFunctionBody(Function *F);
+  void startDecodingFunctionBlocks();
+  void decodeFunctionBlocksAhead();
+  std::unique_ptr<DecodedFunctionBlock> takeDecodedFunctionBlock(Function *F);
+  void stopDecodingFunctionBlocks();
   Error globalCleanup();
   Error resolveGlobalAndIndirectSymbolInits();
   Error parseUseLists();
@@ -3141,11 +3239,25 @@ Error BitcodeReader::parseFunctionBody(Function *F) {
 
   std::vector<OperandBundleDef> OperandBundles;
 
+  // The records of the function, if they were decoded ahead of time.
+  std::unique_ptr<DecodedFunctionBlock> Decoded = takeDecodedFunctionBlock(F);
+  const DecodedFunctionBlock::Entry *NextDecoded =
+      Decoded ? Decoded->Entries.data() : nullptr;
+
   // Read all the records.
   SmallVector<uint64_t, 64> Record;
 
   while (true) {
-    BitstreamEntry Entry = Stream.advance();
+    BitstreamEntry Entry;
+    if (!Decoded) {
+      Entry = Stream.advance();
+    } else if (NextDecoded->IsRecord) {
+      Entry = BitstreamEntry::getRecord(0);
+    } else {
+      Stream.JumpToBit(NextDecoded->BitNo);
+      Entry = Stream.advance();
+      ++NextDecoded;
+    }
 
     switch (Entry.Kind) {
     case BitstreamEntry::Error:
@@ -3193,7 +3305,15 @@ Error BitcodeReader::parseFunctionBody(Function *F) {
     // Read a record.
     Record.clear();
     Instruction *I = nullptr;
-    unsigned BitCode = Stream.readRecord(Entry.ID, Record);
+    unsigned BitCode;
+    if (Decoded) {
+      BitCode = NextDecoded->Code;
+      Record.append(Decoded->Ops.begin() + NextDecoded->OpsBegin,
+                    Decoded->Ops.begin() + NextDecoded->OpsEnd);
+      ++NextDecoded;
+    } else {
+      BitCode = Stream.readRecord(Entry.ID, Record);
+    }
     switch (BitCode) {
     default: // Default behavior: reject
       return error("Invalid value");
@@ -4393,6 +4513,70 @@ OutOfRecordLoop:
   return Error::success();
 }
 
+/// Start decoding the blocks of the functions that are still on disk on
+/// ReaderThreads worker threads, in the order of the module.
+void BitcodeReader::startDecodingFunctionBlocks() {
+  for (Function &F : *TheModule) {
+    if (!F.isMaterializable())
+      continue;
+    auto DFII = DeferredFunctionInfo.find(&F);
+    // The position of the body isn't known yet for old bitcode without a
+    // function index: it is parsed from the stream.
+    if (DFII != DeferredFunctionInfo.end() && DFII->second)
+      FunctionsToDecode.push_back(&F);
+  }
+  if (FunctionsToDecode.size() < 2)
+    return;
+  DecodePool = llvm::make_unique<ThreadPool>(ReaderThreads);
+  decodeFunctionBlocksAhead();
+}
+
+/// Submit the next functions to decode to DecodePool, up to the size of the
+/// window.
+void BitcodeReader::decodeFunctionBlocksAhead() {
+  const unsigned Window = 4 * DecodePool->getThreadCount();
+  while (NextFunctionToDecode != FunctionsToDecode.size() &&
+         PendingFunctionBlocks.size() < Window) {
+    Function *F = FunctionsToDecode[NextFunctionToDecode++];
+    // A function materialized out of order, e.g. because of a block address,
+    // was parsed from the stream: its block would never be taken.
+    if (!F->isMaterializable())
+      continue;
+    PendingFunctionBlock &Pending = PendingFunctionBlocks[F];
+    Pending.Block = llvm::make_unique<DecodedFunctionBlock>();
+    DecodedFunctionBlock *Block = Pending.Block.get();
+    ArrayRef<uint8_t> Bytes = Stream.getBitcodeBytes();
+    BitstreamBlockInfo *Info = &BlockInfo;
+    uint64_t BitNo = DeferredFunctionInfo[F];
+    Pending.Done = DecodePool->async(
+        [=]() { decodeFunctionBlock(Bytes, Info, BitNo, *Block); });
+  }
+}
+
+/// Return the decoded block of \p F, waiting for it if needed, or null if the
+/// function is parsed from the stream.
+std::unique_ptr<DecodedFunctionBlock>
+BitcodeReader::takeDecodedFunctionBlock(Function *F) {
+  auto I = PendingFunctionBlocks.find(F);
+  if (I == PendingFunctionBlocks.end())
+    return nullptr;
+  I->second.Done.wait();
+  std::unique_ptr<DecodedFunctionBlock> Block = std::move(I->second.Block);
+  PendingFunctionBlocks.erase(I);
+  decodeFunctionBlocksAhead();
+  if (Block->Failed)
+    return nullptr;
+  return Block;
+}
+
+/// Wait for the workers and drop the blocks that weren't parsed.
+void BitcodeReader::stopDecodingFunctionBlocks() {
+  DecodePool.reset();
+  PendingFunctionBlocks.clear();
+  FunctionsToDecode.clear();
+  NextFunctionToDecode = 0;
+}
+
 /// Find the function body in the bitcode stream
 Error BitcodeReader::findFunctionInStream(
     Function *F,
@@ -4417,9 +4601,16 @@ Error BitcodeReader::findFunctionInStream(
 
 Error BitcodeReader::materialize(GlobalValue *GV) {
   Function *F = dyn_cast<Function>(GV);
-  // If it's not a function or is already material, ignore the request.
-  if (!F || !F->isMaterializable())
-    return Error::success();
+  // If it's not a function or is already material, only load the metadata
+  // attachments, if that was deferred.
+  if (!F || !F->isMaterializable()) {
+    auto *GO = dyn_cast<GlobalObject>(GV);
+    if (!GO)
+      return Error::success();
+    if (Error Err = materializeMetadata())
+      return Err;
+    return MDLoader->parseDeferredGlobalObjectAttachment(*GO);
+  }
 
   DenseMap<Function*, uint64_t>::iterator DFII = DeferredFunctionInfo.find(F);
   assert(DFII != DeferredFunctionInfo.end() && "Deferred function not found!");
@@ -4488,12 +4679,21 @@ Error BitcodeReader::materializeModule() {
   // Promise to materialize all forward references.
   WillMaterializeAllForwardRefs = true;
 
+  // Decode the function blocks on worker threads ahead of their parsing,
+  // the reader only builds the IR from the decoded records: this is the part
+  // touching the context.
+  if (ReaderThreads)
+    startDecodingFunctionBlocks();
+
   // Iterate over the module, deserializing any functions that are still on
   // disk.
   for (Function &F : *TheModule) {
-    if (Error Err = materialize(&F))
+    if (Error Err = materialize(&F)) {
+      stopDecodingFunctionBlocks();
       return Err;
+    }
   }
+  stopDecodingFunctionBlocks();
   // At this point, if there are any function bodies, parse the rest of
   // the bits in the module past the last function block we have recorded
   // through either lazy scanning or the VST.
@@ -5198,12 +5398,47 @@ const std::error_category &llvm::BitcodeErrorCategory() {
 
 Expected<std::vector<BitcodeModule>>
 llvm::getBitcodeModuleList(MemoryBufferRef Buffer) {
+  Expected<BitcodeFileContents> FOrErr = getBitcodeFileContents(Buffer);
+  if (!FOrErr)
+    return FOrErr.takeError();
+  return std::move(FOrErr->Mods);
+}
+
+/// Read the blob of the SYMTAB_BLOCK the stream is in.
+static Expected<StringRef> readSymtabBlock(BitstreamCursor &Stream) {
+  if (Stream.EnterSubBlock(bitc::SYMTAB_BLOCK_ID))
+    return error("Malformed block");
+
+  StringRef Symtab;
+  SmallVector<uint64_t, 1> Record;
+  while (true) {
+    BitstreamEntry Entry = Stream.advance();
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock:
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return Symtab;
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    Record.clear();
+    StringRef Blob;
+    if (Stream.readRecord(Entry.ID, Record, &Blob) == bitc::SYMTAB_BLOB)
+      Symtab = Blob;
+  }
+}
+
+Expected<BitcodeFileContents>
+llvm::getBitcodeFileContents(MemoryBufferRef Buffer) {
   Expected<BitstreamCursor> StreamOrErr = initStream(Buffer);
   if (!StreamOrErr)
     return StreamOrErr.takeError();
   BitstreamCursor &Stream = *StreamOrErr;
 
-  std::vector<BitcodeModule> Modules;
+  BitcodeFileContents F;
+  std::vector<BitcodeModule> &Modules = F.Mods;
   while (true) {
     uint64_t BCBegin = Stream.getCurrentByteNo();
 
@@ -5211,7 +5446,7 @@ llvm::getBitcodeModuleList(MemoryBufferRef Buffer) {
     // of the bitcode stream (e.g. Apple's ar tool). If we are close enough to
     // the end that there cannot possibly be another module, stop looking.
     if (BCBegin + 8 >= Stream.getBitcodeBytes().size())
-      return Modules;
+      return F;
 
     BitstreamEntry Entry = Stream.advance();
     switch (Entry.Kind) {
@@ -5244,6 +5479,14 @@ llvm::getBitcodeModuleList(MemoryBufferRef Buffer) {
         continue;
       }
 
+      if (Entry.ID == bitc::SYMTAB_BLOCK_ID) {
+        Expected<StringRef> SymtabOrErr = readSymtabBlock(Stream);
+        if (!SymtabOrErr)
+          return SymtabOrErr.takeError();
+        F.Symtab = *SymtabOrErr;
+        continue;
+      }
+
       if (Stream.SkipBlock())
         return error("Malformed block");
       continue;
@@ -438,6 +438,27 @@ class MetadataLoader::MetadataLoaderImpl {
   /// populated.
   void lazyLoadOneMetadata(unsigned Idx, PlaceholderQueue &Placeholders);
 
+  /// Read the record of the lazy-loadable metadata \p ID into \p Record,
+  /// without loading it, and return its code.
+  unsigned readLazyRecord(unsigned ID, SmallVectorImpl<uint64_t> &Record);
+
+  /// Returns true if \p ID is a lazy-loadable metadata.
+  bool isLazyLoadable(unsigned ID) const {
+    return ID >= MDStringRef.size() &&
+           ID < MDStringRef.size() + GlobalMetadataBitPosIndex.size();
+  }
+
+  /// Find the imported entities local to a function in the list \p ListID (as
+  /// stored in a compile unit record), without loading the list. Returns false
+  /// if the list can't be inspected, or if it only has local entities.
+  bool findFunctionLocalImportedEntities(uint64_t ListID,
+                                         SmallVectorImpl<unsigned> &IDs);
+
+  /// When importing, the metadata attachments of the global variables and
+  /// function declarations, which are only loaded for the globals that are
+  /// materialized.
+  DenseMap<GlobalObject *, SmallVector<uint64_t, 2>> DeferredGlobalAttachments;
+
   // Keep mapping of seens pair of old-style CU <-> SP, and update pointers to
   // point from SP to CU after a block is completly parsed.
   std::vector<std::pair<DICompileUnit *, Metadata *>> CUSubprograms;
@@ -497,18 +518,21 @@ class MetadataLoader::MetadataLoaderImpl {
       }
 
     // Upgrade variables attached to globals.
-    for (auto &GV : TheModule.globals()) {
-      SmallVector<MDNode *, 1> MDs, NewMDs;
-      GV.getMetadata(LLVMContext::MD_dbg, MDs);
-      GV.eraseMetadata(LLVMContext::MD_dbg);
-      for (auto *MD : MDs)
-        if (auto *DGV = dyn_cast_or_null<DIGlobalVariable>(MD)) {
-          auto *DGVE =
-              DIGlobalVariableExpression::getDistinct(Context, DGV, nullptr);
-          GV.addMetadata(LLVMContext::MD_dbg, *DGVE);
-        } else
-          GV.addMetadata(LLVMContext::MD_dbg, *MD);
-    }
+    for (auto &GV : TheModule.globals())
+      upgradeGlobalVariableAttachments(GV);
+  }
+
+  void upgradeGlobalVariableAttachments(GlobalVariable &GV) {
+    SmallVector<MDNode *, 1> MDs, NewMDs;
+    GV.getMetadata(LLVMContext::MD_dbg, MDs);
+    GV.eraseMetadata(LLVMContext::MD_dbg);
+    for (auto *MD : MDs)
+      if (auto *DGV = dyn_cast_or_null<DIGlobalVariable>(MD)) {
+        auto *DGVE =
+            DIGlobalVariableExpression::getDistinct(Context, DGV, nullptr);
+        GV.addMetadata(LLVMContext::MD_dbg, *DGVE);
+      } else
+        GV.addMetadata(LLVMContext::MD_dbg, *MD);
   }
 
   void upgradeDebugInfo() {
@@ -558,6 +582,8 @@ public:
   Error parseMetadataAttachment(
       Function &F, const SmallVectorImpl<Instruction *> &InstructionList);
 
+  Error parseDeferredGlobalObjectAttachment(GlobalObject &GO);
+
   Error parseMetadataKinds();
 
   void setStripTBAA(bool Value) { StripTBAA = Value; }
@@ -687,10 +713,11 @@ MetadataLoader::MetadataLoaderImpl::lazyLoadModuleMetadataBlock() {
         unsigned ValueID = Record[0];
         if (ValueID >= ValueList.size())
           return error("Invalid record");
+        // The debug info attached to the globals would pull in the types of
+        // every global of the module: wait for the global to be materialized.
         if (auto *GO = dyn_cast<GlobalObject>(ValueList[ValueID]))
-          if (Error Err = parseGlobalObjectAttachment(
-                  *GO, ArrayRef<uint64_t>(Record).slice(1)))
-            return std::move(Err);
+          DeferredGlobalAttachments[GO].append(Record.begin() + 1,
+                                               Record.end());
         break;
       }
       case bitc::METADATA_KIND:
@@ -840,6 +867,55 @@ void MetadataLoader::MetadataLoaderImpl::lazyLoadOneMetadata(
     report_fatal_error("Can't lazyload MD");
 }
 
+unsigned MetadataLoader::MetadataLoaderImpl::readLazyRecord(
+    unsigned ID, SmallVectorImpl<uint64_t> &Record) {
+  assert(isLazyLoadable(ID));
+  IndexCursor.JumpToBit(GlobalMetadataBitPosIndex[ID - MDStringRef.size()]);
+  auto Entry = IndexCursor.advanceSkippingSubblocks();
+  Record.clear();
+  return IndexCursor.readRecord(Entry.ID, Record);
+}
+
+bool MetadataLoader::MetadataLoaderImpl::findFunctionLocalImportedEntities(
+    uint64_t ListID, SmallVectorImpl<unsigned> &IDs) {
+  if (!ListID || !isLazyLoadable(ListID - 1) ||
+      MetadataList.lookup(ListID - 1))
+    return false;
+  SmallVector<uint64_t, 64> List, Record;
+  if (readLazyRecord(ListID - 1, List) != bitc::METADATA_NODE)
+    return false;
+
+  bool HasNonLocal = false;
+  for (uint64_t EntityID : List) {
+    if (!EntityID || !isLazyLoadable(EntityID - 1))
+      return false;
+    if (readLazyRecord(EntityID - 1, Record) !=
+            bitc::METADATA_IMPORTED_ENTITY ||
+        Record.size() != 6 || !Record[2])
+      return false;
+    // Look at the kind of the scope without loading it.
+    uint64_t ScopeID = Record[2] - 1;
+    bool IsLocal;
+    if (Metadata *Scope = MetadataList.lookup(ScopeID)) {
+      if (isa<MDNode>(Scope) && cast<MDNode>(Scope)->isTemporary())
+        return false;
+      IsLocal = isa<DILocalScope>(Scope);
+    } else {
+      if (!isLazyLoadable(ScopeID))
+        return false;
+      unsigned ScopeCode = readLazyRecord(ScopeID, Record);
+      IsLocal = ScopeCode == bitc::METADATA_SUBPROGRAM ||
+                ScopeCode == bitc::METADATA_LEXICAL_BLOCK ||
+                ScopeCode == bitc::METADATA_LEXICAL_BLOCK_FILE;
+    }
+    if (IsLocal)
+      IDs.push_back(EntityID - 1);
+    else
+      HasNonLocal = true;
+  }
+  return HasNonLocal;
+}
+
 /// Ensure that all forward-references and placeholders are resolved.
 /// Iteratively lazy-loading metadata on-demand if needed.
 void MetadataLoader::MetadataLoaderImpl::resolveForwardRefsAndPlaceholders(
@@ -1246,15 +1322,42 @@ Error MetadataLoader::MetadataLoaderImpl::parseOneMetadata(
     if (Record.size() < 14 || Record.size() > 18)
       return error("Invalid record");
 
+    // When importing, the importing module only needs the imported entities
+    // local to a function from the lists of the compile unit: the rest is
+    // left to the module defining it (see
+    // IRLinker::prepareCompileUnitsForImport). Don't load the other lists,
+    // which would bring in the debug info of the whole module.
+    bool IsLazyImporting = IsImporting && !GlobalMetadataBitPosIndex.empty();
+    SmallVector<unsigned, 8> LocalImportedEntities;
+    bool TrimImportedEntities =
+        IsLazyImporting &&
+        findFunctionLocalImportedEntities(Record[13], LocalImportedEntities);
+    Metadata *ImportedEntities = nullptr;
+    if (TrimImportedEntities && !LocalImportedEntities.empty()) {
+      SmallVector<Metadata *, 8> Elts;
+      for (unsigned ID : LocalImportedEntities) {
+        // Create a temporary for the compile unit, which the entities may
+        // reference through their scope.
+        MetadataList.getMetadataFwdRef(NextMetadataNo);
+        lazyLoadOneMetadata(ID, Placeholders);
+        Elts.push_back(MetadataList.lookup(ID));
+      }
+      ImportedEntities = MDTuple::get(Context, Elts);
+    }
+
     // Ignore Record[0], which indicates whether this compile unit is
     // distinct.  It's always distinct.
     IsDistinct = true;
+    if (!TrimImportedEntities)
+      ImportedEntities = getMDOrNull(Record[13]);
     auto *CU = DICompileUnit::getDistinct(
         Context, Record[1], getMDOrNull(Record[2]), getMDString(Record[3]),
         Record[4], getMDString(Record[5]), Record[6], getMDString(Record[7]),
-        Record[8], getMDOrNull(Record[9]), getMDOrNull(Record[10]),
-        getMDOrNull(Record[12]), getMDOrNull(Record[13]),
-        Record.size() <= 15 ? nullptr : getMDOrNull(Record[15]),
+        Record[8], IsLazyImporting ? nullptr : getMDOrNull(Record[9]),
+        IsLazyImporting ? nullptr : getMDOrNull(Record[10]),
+        IsLazyImporting ? nullptr : getMDOrNull(Record[12]), ImportedEntities,
+        Record.size() <= 15 || IsLazyImporting ? nullptr
+                                               : getMDOrNull(Record[15]),
         Record.size() <= 14 ? 0 : Record[14],
         Record.size() <= 16 ? true : Record[16],
         Record.size() <= 17 ? false : Record[17]);
@@ -1662,6 +1765,24 @@ Error MetadataLoader::MetadataLoaderImpl::parseGlobalObjectAttachment(
   return Error::success();
 }
 
+Error MetadataLoader::MetadataLoaderImpl::parseDeferredGlobalObjectAttachment(
+    GlobalObject &GO) {
+  auto I = DeferredGlobalAttachments.find(&GO);
+  if (I == DeferredGlobalAttachments.end())
+    return Error::success();
+  SmallVector<uint64_t, 2> Record = std::move(I->second);
+  DeferredGlobalAttachments.erase(I);
+
+  if (Error Err = parseGlobalObjectAttachment(GO, Record))
+    return Err;
+  PlaceholderQueue Placeholders;
+  resolveForwardRefsAndPlaceholders(Placeholders);
+  if (NeedUpgradeToDIGlobalVariableExpression)
+    if (auto *GV = dyn_cast<GlobalVariable>(&GO))
+      upgradeGlobalVariableAttachments(*GV);
+  return Error::success();
+}
+
 /// Parse metadata attachments.
 Error MetadataLoader::MetadataLoaderImpl::parseMetadataAttachment(
     Function &F, const SmallVectorImpl<Instruction *> &InstructionList) {
@@ -1839,6 +1960,10 @@ Error MetadataLoader::parseMetadataAttachment(
   return Pimpl->parseMetadataAttachment(F, InstructionList);
 }
 
+Error MetadataLoader::parseDeferredGlobalObjectAttachment(GlobalObject &GO) {
+  return Pimpl->parseDeferredGlobalObjectAttachment(GO);
+}
+
 Error MetadataLoader::parseMetadataKinds() {
   return Pimpl->parseMetadataKinds();
 }
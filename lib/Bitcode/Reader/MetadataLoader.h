@@ -26,6 +26,7 @@ class BitstreamCursor;
 class DISubprogram;
 class Error;
 class Function;
+class GlobalObject;
 class Instruction;
 class Metadata;
 class MDNode;
@@ -74,6 +75,10 @@ public:
   Error parseMetadataAttachment(
       Function &F, const SmallVectorImpl<Instruction *> &InstructionList);
 
+  /// Parse the metadata attachments of a global variable or function
+  /// declaration, if their loading was deferred to its materialization.
+  Error parseDeferredGlobalObjectAttachment(GlobalObject &GO);
+
   /// Parse a `METADATA_KIND` block for the current module.
   Error parseMetadataKinds();
 
@@ -28,10 +28,13 @@
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/UseListOrder.h"
 #include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/Object/IRSymtab.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/SHA1.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cctype>
 #include <map>
@@ -43,6 +46,12 @@ cl::opt<unsigned>
     IndexThreshold("bitcode-mdindex-threshold", cl::Hidden, cl::init(25),
                    cl::desc("Number of metadatas above which we emit an index "
                             "to enable lazy-loading"));
+
+cl::opt<unsigned> WriterThreads(
+    "bitcode-writer-threads", cl::Hidden, cl::init(0),
+    cl::desc("Number of threads encoding the function blocks (0 = encode "
+             "them with the rest of the module)"));
+
 /// These are manifest constants used by the bitcode writer. They do not need to
 /// be kept in sync with the reader, but need to be consistent within this file.
 enum {
@@ -153,6 +162,14 @@ public:
   void write();
 
 private:
+  /// Constructs a ModuleBitcodeWriter encoding the function blocks of the
+  /// module of \p Parent to \p Stream, with a copy of its enumeration.
+  ModuleBitcodeWriter(const ModuleBitcodeWriter &Parent,
+                      SmallVectorImpl<char> &Buffer, BitstreamWriter &Stream)
+      : BitcodeWriterBase(Stream), Buffer(Buffer), M(Parent.M), VE(Parent.VE),
+        Index(nullptr), GenerateHash(false), BitcodeStartBit(0),
+        GlobalValueId(Parent.GlobalValueId) {}
+
   uint64_t bitcodeStartBit() { return BitcodeStartBit; }
 
   void writeAttributeGroupTable();
@@ -259,6 +276,9 @@ private:
   void
   writeFunction(const Function &F,
                 DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
+  void writeFunctionBlockContents(const Function &F);
+  void writeFunctionsInParallel(
+      DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
   void writeBlockInfo();
   void writePerModuleFunctionSummaryRecord(SmallVector<uint64_t, 64> &NameVals,
                                            GlobalValueSummary *Summary,
@@ -3044,6 +3064,12 @@ void ModuleBitcodeWriter::writeFunction(
   FunctionToBitcodeIndex[&F] = Stream.GetCurrentBitNo();
 
   Stream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, 4);
+  writeFunctionBlockContents(F);
+  Stream.ExitBlock();
+}
+
+/// Emit the records and nested blocks of the function block of \p F.
+void ModuleBitcodeWriter::writeFunctionBlockContents(const Function &F) {
   VE.incorporateFunction(F);
 
   SmallVector<unsigned, 64> Vals;
@@ -3110,7 +3136,91 @@ void ModuleBitcodeWriter::writeFunction(
   if (VE.shouldPreserveUseListOrder())
     writeUseListBlock(&F);
   VE.purgeFunction();
-  Stream.ExitBlock();
+}
+
+/// Encode the function blocks on WriterThreads threads, and emit them in the
+/// order of the module. The functions are split in contiguous chunks of about
+/// the same number of instructions, each chunk is encoded to its own buffer by
+/// a writer with a copy of the enumeration. The blocks are word aligned and
+/// don't reference their position, so the output is the same as when they are
+/// encoded in place.
+void ModuleBitcodeWriter::writeFunctionsInParallel(
+    DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex) {
+  std::vector<const Function *> Functions;
+  uint64_t NumInsts = 0;
+  for (const Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    Functions.push_back(&F);
+    for (const BasicBlock &BB : F)
+      NumInsts += BB.size();
+  }
+
+  // The use-list orders of the functions are on a stack, in the order of the
+  // module: hand them out to the function they belong to before copying the
+  // enumeration.
+  std::vector<UseListOrderStack> UseListOrders(Functions.size());
+  if (VE.shouldPreserveUseListOrder()) {
+    for (unsigned I = 0, E = Functions.size(); I != E; ++I) {
+      while (!VE.UseListOrders.empty() &&
+             VE.UseListOrders.back().F == Functions[I]) {
+        UseListOrders[I].push_back(std::move(VE.UseListOrders.back()));
+        VE.UseListOrders.pop_back();
+      }
+      std::reverse(UseListOrders[I].begin(), UseListOrders[I].end());
+    }
+  }
+
+  struct Chunk {
+    unsigned Begin, End;
+    SmallVector<char, 0> Buffer;
+    /// The contents of the block of each function of the chunk in Buffer.
+    std::vector<std::pair<size_t, size_t>> Contents;
+  };
+  std::vector<Chunk> Chunks;
+  uint64_t ChunkInsts = NumInsts / WriterThreads + 1;
+  for (unsigned I = 0, E = Functions.size(); I != E;) {
+    Chunks.emplace_back();
+    Chunks.back().Begin = I;
+    uint64_t Insts = 0;
+    do {
+      for (const BasicBlock &BB : *Functions[I])
+        Insts += BB.size();
+      ++I;
+    } while (I != E && Insts < ChunkInsts);
+    Chunks.back().End = I;
+  }
+
+  {
+    ThreadPool Pool(WriterThreads);
+    for (Chunk &C : Chunks) {
+      Chunk *CP = &C;
+      Pool.async([this, CP, &Functions, &UseListOrders]() {
+        BitstreamWriter ChunkStream(CP->Buffer);
+        ChunkStream.CopyBlockInfo(Stream);
+        ModuleBitcodeWriter Writer(*this, CP->Buffer, ChunkStream);
+        for (unsigned I = CP->Begin; I != CP->End; ++I) {
+          Writer.VE.UseListOrders = std::move(UseListOrders[I]);
+          ChunkStream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, 4);
+          size_t Begin = CP->Buffer.size();
+          Writer.writeFunctionBlockContents(*Functions[I]);
+          ChunkStream.ExitBlock();
+          CP->Contents.push_back({Begin, CP->Buffer.size()});
+        }
+      });
+    }
+  }
+
+  for (Chunk &C : Chunks) {
+    for (unsigned I = C.Begin; I != C.End; ++I) {
+      FunctionToBitcodeIndex[Functions[I]] = Stream.GetCurrentBitNo();
+      Stream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, 4);
+      const auto &Contents = C.Contents[I - C.Begin];
+      Stream.ExitBlockWithContents(
+          makeArrayRef(C.Buffer.data() + Contents.first,
+                       C.Buffer.data() + Contents.second));
+    }
+  }
 }
 
 // Emit blockinfo, which defines the standard abbreviations etc.
@@ -3823,9 +3933,12 @@ void ModuleBitcodeWriter::write() {
 
   // Emit function bodies.
   DenseMap<const Function *, uint64_t> FunctionToBitcodeIndex;
-  for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
-    if (!F->isDeclaration())
-      writeFunction(*F, FunctionToBitcodeIndex);
+  if (WriterThreads > 1)
+    writeFunctionsInParallel(FunctionToBitcodeIndex);
+  else
+    for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+      if (!F->isDeclaration())
+        writeFunction(*F, FunctionToBitcodeIndex);
 
   // Need to write after the above call to WriteFunction which populates
   // the summary information in the index.
@@ -3929,11 +4042,56 @@ void BitcodeWriter::writeModule(const Module *M,
                                 bool ShouldPreserveUseListOrder,
                                 const ModuleSummaryIndex *Index,
                                 bool GenerateHash) {
+  // irsymtab::build takes non-const modules, since it materializes the
+  // metadata of lazily loaded ones. The modules written here are not changed.
+  Mods.push_back(const_cast<Module *>(M));
+
   ModuleBitcodeWriter ModuleWriter(
       M, Buffer, *Stream, ShouldPreserveUseListOrder, Index, GenerateHash);
   ModuleWriter.write();
 }
 
+void BitcodeWriter::writeSymtab() {
+  if (Mods.empty())
+    return;
+
+  // The symbols of module inline asm are found with the asm parser of the
+  // target. Without it, the table would be missing them.
+  for (Module *M : Mods) {
+    if (M->getModuleInlineAsm().empty())
+      continue;
+
+    std::string Err;
+    const Triple TT(M->getTargetTriple());
+    const Target *T = TargetRegistry::lookupTarget(TT.str(), Err);
+    if (!T || !T->hasMCAsmParser())
+      return;
+  }
+
+  SmallVector<char, 0> Symtab;
+  // The irsymtab::build function may be unable to create a symbol table if the
+  // module is malformed (e.g. it contains an invalid alias). Writing a symbol
+  // table is not required for correctness, but we still want to be able to
+  // write malformed modules to bitcode files, so swallow the error.
+  if (Error E = irsymtab::build(Mods, Symtab)) {
+    consumeError(std::move(E));
+    return;
+  }
+
+  Stream->EnterSubblock(bitc::SYMTAB_BLOCK_ID, 3);
+
+  auto Abbv = std::make_shared<BitCodeAbbrev>();
+  Abbv->Add(BitCodeAbbrevOp(bitc::SYMTAB_BLOB));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+  unsigned SymtabAbbrev = Stream->EmitAbbrev(std::move(Abbv));
+
+  uint64_t Vals[] = {bitc::SYMTAB_BLOB};
+  Stream->EmitRecordWithBlob(SymtabAbbrev, Vals,
+                             StringRef(Symtab.data(), Symtab.size()));
+
+  Stream->ExitBlock();
+}
+
 /// WriteBitcodeToFile - Write the specified module to the specified output
 /// stream.
 void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
@@ -3951,6 +4109,7 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
 
   BitcodeWriter Writer(Buffer);
   Writer.writeModule(M, ShouldPreserveUseListOrder, Index, GenerateHash);
+  Writer.writeSymtab();
 
   if (TT.isOSDarwin() || TT.isOSBinFormatMachO())
     emitDarwinBCHeaderAndTrailer(Buffer, TT);
@@ -283,6 +283,22 @@ static UseListOrderStack predictUseListOrder(const Module &M) {
   return Stack;
 }
 
+ValueEnumerator::ValueEnumerator(const ValueEnumerator &VE)
+    : TypeMap(VE.TypeMap), Types(VE.Types), ValueMap(VE.ValueMap),
+      Values(VE.Values), Comdats(VE.Comdats), MDs(VE.MDs),
+      FunctionMDs(VE.FunctionMDs), MetadataMap(VE.MetadataMap),
+      FunctionMDInfo(VE.FunctionMDInfo),
+      ShouldPreserveUseListOrder(VE.ShouldPreserveUseListOrder),
+      AttributeGroupMap(VE.AttributeGroupMap),
+      AttributeGroups(VE.AttributeGroups), AttributeMap(VE.AttributeMap),
+      Attribute(VE.Attribute), GlobalBasicBlockIDs(VE.GlobalBasicBlockIDs),
+      InstructionCount(0), NumModuleValues(VE.NumModuleValues),
+      NumModuleMDs(VE.NumModuleMDs), NumMDStrings(VE.NumMDStrings),
+      FirstFuncConstantID(VE.FirstFuncConstantID),
+      FirstInstID(VE.FirstInstID) {
+  assert(VE.BasicBlocks.empty() && "Function still incorporated");
+}
+
 static bool isIntOrIntVectorValue(const std::pair<const Value*, unsigned> &V) {
   return V.first->getType()->isIntOrIntVectorTy();
 }
@@ -20,6 +20,7 @@
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/StackProtector.h"
 #include "llvm/CodeGen/TargetPassConfig.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/DebugInfo.h"
@@ -40,6 +41,7 @@ char IRTranslator::ID = 0;
 INITIALIZE_PASS_BEGIN(IRTranslator, DEBUG_TYPE, "IRTranslator LLVM IR -> MI",
                 false, false)
 INITIALIZE_PASS_DEPENDENCY(TargetPassConfig)
+INITIALIZE_PASS_DEPENDENCY(StackProtector)
 INITIALIZE_PASS_END(IRTranslator, DEBUG_TYPE, "IRTranslator LLVM IR -> MI",
                 false, false)
 
@@ -56,6 +58,8 @@ IRTranslator::IRTranslator() : MachineFunctionPass(ID), MRI(nullptr) {
 
 void IRTranslator::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<TargetPassConfig>();
+  AU.addRequired<StackProtector>();
+  AU.addPreserved<StackProtector>();
   MachineFunctionPass::getAnalysisUsage(AU);
 }
 
@@ -1107,6 +1111,10 @@ bool IRTranslator::runOnMachineFunction(MachineFunction &CurMF) {
            "New entry wasn't next in the list of basic block!");
   }
 
+  // Record the stack protector layout of the allocas on their stack objects
+  // for the stack slot allocation passes.
+  getAnalysis<StackProtector>().copyToMachineFrameInfo(MF->getFrameInfo());
+
   finalizeFunction();
 
   return false;
@@ -2220,8 +2220,10 @@ void MachineInstr::emitError(StringRef Msg) const {
   }
 
   if (const MachineBasicBlock *MBB = getParent())
-    if (const MachineFunction *MF = MBB->getParent())
+    if (const MachineFunction *MF = MBB->getParent()) {
+      auto ContextLock = MF->getMMI().lockContext();
       return MF->getMMI().getModule()->getContext().emitError(LocCookie, Msg);
+    }
   report_fatal_error(Msg);
 }
 
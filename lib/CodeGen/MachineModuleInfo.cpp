@@ -196,6 +196,14 @@ MachineModuleInfo::MachineModuleInfo(const TargetMachine *TM)
   initializeMachineModuleInfoPass(*PassRegistry::getPassRegistry());
 }
 
+MachineModuleInfo::MachineModuleInfo(MachineModuleInfo &Owner)
+  : ImmutablePass(ID), TM(Owner.TM),
+    Context(TM.getMCAsmInfo(), TM.getMCRegisterInfo(),
+            TM.getObjFileLowering(), nullptr, false),
+    Owner(&Owner) {
+  initializeMachineModuleInfoPass(*PassRegistry::getPassRegistry());
+}
+
 MachineModuleInfo::~MachineModuleInfo() {
 }
 
@@ -256,12 +264,34 @@ void MachineModuleInfo::addPersonality(const Function *Personality) {
 
 /// \}
 
+void MachineModuleInfo::setThreadSafe(bool Value) {
+  ThreadSafe = Value;
+  Context.setThreadSafe(Value);
+}
+
+std::unique_lock<std::mutex> MachineModuleInfo::lockContext() {
+  std::unique_lock<std::mutex> Lock(ContextMutex, std::defer_lock);
+  if (ThreadSafe)
+    Lock.lock();
+  return Lock;
+}
+
 MachineFunction &MachineModuleInfo::getMachineFunction(const Function &F) {
   // Shortcut for the common case where a sequence of MachineFunctionPasses
   // all query for the same Function.
   if (LastRequest == &F)
     return *LastResult;
 
+  if (Owner) {
+    // The owner's map isn't modified while the threads run.
+    auto I = Owner->MachineFunctions.find(&F);
+    assert(I != Owner->MachineFunctions.end() &&
+           "Function not selected before parallel codegen");
+    LastRequest = &F;
+    LastResult = I->second.get();
+    return *LastResult;
+  }
+
   auto I = MachineFunctions.insert(
       std::make_pair(&F, std::unique_ptr<MachineFunction>()));
   MachineFunction *MF;
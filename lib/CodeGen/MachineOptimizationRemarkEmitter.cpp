@@ -15,6 +15,7 @@
 
 #include "llvm/CodeGen/MachineOptimizationRemarkEmitter.h"
 #include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/LLVMContext.h"
@@ -41,6 +42,7 @@ void MachineOptimizationRemarkEmitter::emit(
   auto &OptDiag = cast<DiagnosticInfoMIROptimization>(OptDiagCommon);
   computeHotness(OptDiag);
 
+  auto ContextLock = MF.getMMI().lockContext();
   LLVMContext &Ctx = MF.getFunction()->getContext();
   yaml::Output *Out = Ctx.getDiagnosticsOutputFile();
   if (Out) {
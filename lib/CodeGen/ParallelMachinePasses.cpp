@@ -0,0 +1,136 @@
+//===-- ParallelMachinePasses.cpp - Run machine passes on threads ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+/// \file
+/// This file implements the pass running the machine function passes from the
+/// expansion of the ISel pseudo-instructions through register allocation on
+/// several functions at once, as requested with -codegen-threads. All the
+/// functions of the module are selected on the calling thread before, and the
+/// passes after register allocation emit them in order afterwards.
+///
+/// The code is the same as with a serial run, but the temporary labels the
+/// selection creates, e.g. for the calls that may throw, are numbered before
+/// the ones of the AsmPrinter instead of being interleaved with them. The
+/// numbering still does not depend on how the threads are scheduled.
+///
+/// Each thread runs its own instances of the passes, in a pass manager set up
+/// by TargetPassConfig::addParallelMachinePasses with a MachineModuleInfo that
+/// looks up the MachineFunctions of the module's. The passes hold
+/// MachineModuleInfo::lockContext() while they change the LLVMContext, and the
+/// MCContext serializes the creation of symbols.
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
+#include <atomic>
+using namespace llvm;
+
+#define DEBUG_TYPE "parallel-machine-passes"
+
+namespace {
+class ParallelMachinePasses : public ModulePass {
+  unsigned NumThreads;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  ParallelMachinePasses(unsigned NumThreads = 1)
+      : ModulePass(ID), NumThreads(NumThreads) {
+    initializeParallelMachinePassesPass(*PassRegistry::getPassRegistry());
+  }
+
+  StringRef getPassName() const override { return "Parallel Machine Passes"; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<MachineModuleInfo>();
+    AU.addRequired<TargetPassConfig>();
+    AU.setPreservesAll();
+  }
+
+  bool runOnModule(Module &M) override;
+};
+} // end anonymous namespace
+
+char ParallelMachinePasses::ID = 0;
+INITIALIZE_PASS_BEGIN(ParallelMachinePasses, DEBUG_TYPE,
+                      "Run machine passes on several threads", false, false)
+INITIALIZE_PASS_DEPENDENCY(MachineModuleInfo)
+INITIALIZE_PASS_DEPENDENCY(TargetPassConfig)
+INITIALIZE_PASS_END(ParallelMachinePasses, DEBUG_TYPE,
+                    "Run machine passes on several threads", false, false)
+
+ModulePass *llvm::createParallelMachinePassesPass(unsigned NumThreads) {
+  return new ParallelMachinePasses(NumThreads);
+}
+
+bool ParallelMachinePasses::runOnModule(Module &M) {
+  MachineModuleInfo &MMI = getAnalysis<MachineModuleInfo>();
+  const TargetPassConfig &PassConfig = getAnalysis<TargetPassConfig>();
+
+  // The functions that have a MachineFunction, see
+  // MachineFunctionPass::runOnFunction.
+  std::vector<Function *> Functions;
+  for (Function &F : M)
+    if (!F.isDeclaration() && !F.hasAvailableExternallyLinkage())
+      Functions.push_back(&F);
+  if (Functions.empty())
+    return false;
+
+  unsigned NumPMs = std::min<size_t>(NumThreads, Functions.size());
+  DEBUG(dbgs() << "Running machine passes on " << Functions.size()
+               << " functions with " << NumPMs << " threads\n");
+
+  std::vector<std::unique_ptr<legacy::FunctionPassManager>> PMs;
+  std::vector<AssumptionCacheTracker *> ACTs;
+  for (unsigned I = 0; I != NumPMs; ++I) {
+    auto PM = llvm::make_unique<legacy::FunctionPassManager>(&M);
+    ACTs.push_back(new AssumptionCacheTracker());
+    PM->add(ACTs.back());
+    PM->add(new MachineModuleInfo(MMI));
+    PassConfig.addParallelMachinePasses(*PM);
+    PM->doInitialization();
+    PMs.push_back(std::move(PM));
+  }
+
+  // Every thread takes the next function not compiled yet until none is left.
+  std::atomic<size_t> NextFunction(0);
+  MMI.setThreadSafe(true);
+  {
+    ThreadPool Pool(NumPMs);
+    for (unsigned I = 0; I != NumPMs; ++I) {
+      legacy::FunctionPassManager *FPM = PMs[I].get();
+      AssumptionCacheTracker *ACT = ACTs[I];
+      Pool.async([FPM, ACT, &MMI, &Functions, &NextFunction]() {
+        for (size_t I = NextFunction++; I < Functions.size();
+             I = NextFunction++) {
+          Function &F = *Functions[I];
+          // Alias analysis registers value handles in the LLVMContext when it
+          // first scans the assumptions of a function, so scan them first,
+          // under the lock.
+          {
+            auto ContextLock = MMI.lockContext();
+            ACT->getAssumptionCache(F).assumptions();
+          }
+          FPM->run(F);
+        }
+      });
+    }
+    Pool.wait();
+  }
+  MMI.setThreadSafe(false);
+
+  for (auto &PM : PMs)
+    PM->doFinalization();
+  return true;
+}
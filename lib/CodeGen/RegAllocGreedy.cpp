@@ -57,6 +57,8 @@ using namespace llvm;
 STATISTIC(NumGlobalSplits, "Number of split global live ranges");
 STATISTIC(NumLocalSplits,  "Number of split local live ranges");
 STATISTIC(NumEvicted,      "Number of interferences evicted");
+STATISTIC(NumBudgetStepDowns, "Number of fallbacks to cheaper strategies "
+                              "after exceeding the work budget");
 
 static cl::opt<SplitEditor::ComplementSpillMode> SplitSpillMode(
     "split-spill-mode", cl::Hidden,
@@ -96,6 +98,13 @@ static cl::opt<bool> EnableDeferredSpilling(
              "variable because of other evicted variables."),
     cl::init(false));
 
+static cl::opt<unsigned> WorkBudget(
+    "regalloc-work-budget", cl::Hidden,
+    cl::desc("Work the greedy register allocator may spend on a function, "
+             "in interference checks, split candidate blocks and evictions, "
+             "before falling back to cheaper strategies (0 = unlimited)"),
+    cl::init(0));
+
 // FIXME: Find a good default for this flag and remove the flag.
 static cl::opt<unsigned>
 CSRFirstTimeCost("regalloc-csr-first-time-cost",
@@ -195,6 +204,25 @@ class RAGreedy : public MachineFunctionPass,
 
   uint8_t CutOffInfo;
 
+  // Enum BudgetLevel to keep track of how much of -regalloc-work-budget the
+  // current function used. Each level gives up more of the expensive
+  // strategies, which bounds the allocation time of huge functions.
+  enum BudgetLevel {
+    // Within budget, all strategies are used.
+    BL_Normal,
+
+    // Over budget: no region splitting, and only unspillable ranges evict.
+    BL_LocalSplit,
+
+    // Twice over budget: ranges that cannot be assigned are spilled.
+    BL_Spill
+  };
+
+  BudgetLevel Budget;
+
+  /// Work done on the current function, see chargeWork().
+  uint64_t WorkDone;
+
 #ifndef NDEBUG
   static const char *const StageName[];
 #endif
@@ -345,6 +373,8 @@ private:
   unsigned selectOrSplitImpl(LiveInterval &, SmallVectorImpl<unsigned> &,
                              SmallVirtRegSet &, unsigned = 0);
 
+  void chargeWork(unsigned Units);
+
   bool LRE_CanEraseVirtReg(unsigned) override;
   void LRE_WillShrinkVirtReg(unsigned) override;
   void LRE_DidCloneVirtReg(unsigned, unsigned) override;
@@ -753,6 +783,8 @@ bool RAGreedy::shouldEvict(LiveInterval &A, bool IsHint,
 /// @returns True when interference can be evicted cheaper than MaxCost.
 bool RAGreedy::canEvictInterference(LiveInterval &VirtReg, unsigned PhysReg,
                                     bool IsHint, EvictionCost &MaxCost) {
+  chargeWork(1);
+
   // It is only possible to evict virtual register interference.
   if (Matrix->checkInterference(VirtReg, PhysReg) > LiveRegMatrix::IK_VirtReg)
     return false;
@@ -854,6 +886,8 @@ void RAGreedy::evictInterference(LiveInterval &VirtReg, unsigned PhysReg,
     Intfs.append(IVR.begin(), IVR.end());
   }
 
+  chargeWork(Intfs.size());
+
   // Evict them second. This will invalidate the queries.
   for (unsigned i = 0, e = Intfs.size(); i != e; ++i) {
     LiveInterval *Intf = Intfs[i];
@@ -1445,6 +1479,7 @@ unsigned RAGreedy::calculateRegionSplitCost(LiveInterval &VirtReg,
       GlobalCand.resize(NumCands+1);
     GlobalSplitCandidate &Cand = GlobalCand[NumCands];
     Cand.reset(IntfCache, PhysReg);
+    chargeWork(SA->getNumLiveBlocks());
 
     SpillPlacer->prepare(Cand.LiveBundles);
     BlockFrequency Cost;
@@ -1838,6 +1873,8 @@ unsigned RAGreedy::tryLocalSplit(LiveInterval &VirtReg, AllocationOrder &Order,
 
   Order.rewind();
   while (unsigned PhysReg = Order.next()) {
+    chargeWork(NumGaps);
+
     // Keep track of the largest spill weight that would need to be evicted in
     // order to make use of PhysReg between UseSlots[i] and UseSlots[i+1].
     calcGapWeights(PhysReg, GapWeight);
@@ -1985,6 +2022,10 @@ unsigned RAGreedy::trySplit(LiveInterval &VirtReg, AllocationOrder &Order,
   if (getStage(VirtReg) >= RS_Spill)
     return 0;
 
+  // Too much work was done on this function to afford splitting anymore.
+  if (Budget == BL_Spill)
+    return 0;
+
   // Local intervals are handled separately.
   if (LIS->intervalIsInOneMBB(VirtReg)) {
     NamedRegionTimer T("local_split", "Local Splitting", TimerGroupName,
@@ -2014,8 +2055,9 @@ unsigned RAGreedy::trySplit(LiveInterval &VirtReg, AllocationOrder &Order,
 
   // First try to split around a region spanning multiple blocks. RS_Split2
   // ranges already made dubious progress with region splitting, so they go
-  // straight to single block splitting.
-  if (getStage(VirtReg) < RS_Split2) {
+  // straight to single block splitting, as do all ranges once the function is
+  // over budget.
+  if (getStage(VirtReg) < RS_Split2 && Budget == BL_Normal) {
     unsigned PhysReg = tryRegionSplit(VirtReg, Order, NewVRegs);
     if (PhysReg || !NewVRegs.empty())
       return PhysReg;
@@ -2141,6 +2183,7 @@ unsigned RAGreedy::tryLastChanceRecoloring(LiveInterval &VirtReg,
   while (unsigned PhysReg = Order.next()) {
     DEBUG(dbgs() << "Try to assign: " << VirtReg << " to "
                  << PrintReg(PhysReg, TRI) << '\n');
+    chargeWork(1);
     RecoloringCandidates.clear();
     VirtRegToPhysReg.clear();
     CurrentNewVRegs.clear();
@@ -2535,6 +2578,35 @@ void RAGreedy::tryHintsRecoloring() {
   }
 }
 
+/// Account for \p Units of work done on the current function, and step down to
+/// the next BudgetLevel when -regalloc-work-budget is exceeded. A unit is an
+/// interference check, a block of a split candidate, an evicted range or a
+/// gap of a local split candidate.
+void RAGreedy::chargeWork(unsigned Units) {
+  WorkDone += Units;
+  if (!WorkBudget || Budget == BL_Spill || WorkDone <= WorkBudget)
+    return;
+
+  BudgetLevel NewBudget =
+      WorkDone > 2 * uint64_t(WorkBudget) ? BL_Spill : BL_LocalSplit;
+  if (NewBudget == Budget)
+    return;
+  Budget = NewBudget;
+  ++NumBudgetStepDowns;
+  DEBUG(dbgs() << "Work budget exceeded after " << WorkDone << " units, "
+               << (Budget == BL_Spill ? "spilling" : "only splitting locally")
+               << " from now on\n");
+
+  using namespace ore;
+  MachineOptimizationRemarkMissed R(DEBUG_TYPE, "WorkBudget", DebugLoc(),
+                                    &MF->front());
+  R << "exceeded " << (Budget == BL_Spill ? "twice " : "")
+    << "the work budget of " << NV("WorkBudget", WorkBudget) << " units, "
+    << (Budget == BL_Spill ? "spilling" : "splitting only locally")
+    << " from now on";
+  ORE->emit(R);
+}
+
 unsigned RAGreedy::selectOrSplitImpl(LiveInterval &VirtReg,
                                      SmallVectorImpl<unsigned> &NewVRegs,
                                      SmallVirtRegSet &FixedRegisters,
@@ -2564,8 +2636,9 @@ unsigned RAGreedy::selectOrSplitImpl(LiveInterval &VirtReg,
 
   // Try to evict a less worthy live range, but only for ranges from the primary
   // queue. The RS_Split ranges already failed to do this, and they should not
-  // get a second chance until they have been split.
-  if (Stage != RS_Split)
+  // get a second chance until they have been split. Over budget, eviction is
+  // left to the ranges that cannot be spilled.
+  if (Stage != RS_Split && (Budget == BL_Normal || !VirtReg.isSpillable()))
     if (unsigned PhysReg =
             tryEvict(VirtReg, Order, NewVRegs, CostPerUseLimit)) {
       unsigned Hint = MRI->getSimpleHint(VirtReg.reg);
@@ -2737,6 +2810,8 @@ bool RAGreedy::runOnMachineFunction(MachineFunction &mf) {
   IntfCache.init(MF, Matrix->getLiveUnions(), Indexes, LIS, TRI);
   GlobalCand.resize(32);  // This will grow as needed.
   SetOfBrokenHints.clear();
+  Budget = BL_Normal;
+  WorkDone = 0;
 
   allocatePhysRegs();
   tryHintsRecoloring();
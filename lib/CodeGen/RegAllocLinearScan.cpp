@@ -0,0 +1,446 @@
+//===-- RegAllocLinearScan.cpp - Linear Scan Register Allocator -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the RALinearScan function pass, a register allocator that
+// visits the live intervals in the order they start. It is meant for clients,
+// like a JIT or -O1 builds, that want better code than the fast allocator
+// produces without paying for the global splitting of the greedy allocator.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/Passes.h"
+#include "AllocationOrder.h"
+#include "LiveDebugVariables.h"
+#include "RegAllocBase.h"
+#include "Spiller.h"
+#include "SplitKit.h"
+#include "llvm/ADT/IndexedMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/CodeGen/CalcSpillWeights.h"
+#include "llvm/CodeGen/LiveIntervalAnalysis.h"
+#include "llvm/CodeGen/LiveRangeEdit.h"
+#include "llvm/CodeGen/LiveRegMatrix.h"
+#include "llvm/CodeGen/LiveStackAnalysis.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/RegAllocRegistry.h"
+#include "llvm/CodeGen/VirtRegMap.h"
+#include "llvm/PassAnalysisSupport.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+#include <queue>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "regalloc"
+
+STATISTIC(NumLSEvicted, "Number of intervals evicted by linear scan");
+STATISTIC(NumLSBlockSplits, "Number of intervals split around blocks");
+
+static RegisterRegAlloc linearScanRegAlloc("linearscan",
+                                           "linear scan register allocator",
+                                           createLinearScanRegisterAllocator);
+
+namespace {
+/// RALinearScan assigns the live intervals in the order of their start index,
+/// as a linear scan over the function would see them.
+///
+/// When no register is free, the interval takes the register whose interfering
+/// intervals have the smallest spill weight, provided they all weigh less than
+/// it does. An interval that is evicted for the first time goes back in the
+/// queue, evicting it again spills it. An interval that does not get a register
+/// and spans several blocks is split around the blocks that use it, and the
+/// rest of it is spilled. There is no region splitting and no recoloring, so
+/// every interval is looked at a bounded number of times.
+class RALinearScan : public MachineFunctionPass,
+                     public RegAllocBase,
+                     private LiveRangeEdit::Delegate {
+  // context
+  MachineFunction *MF;
+
+  // analyses
+  MachineLoopInfo *Loops;
+  LiveDebugVariables *DebugVars;
+
+  // state
+  std::unique_ptr<Spiller> SpillerInstance;
+  std::unique_ptr<SplitAnalysis> SA;
+  std::unique_ptr<SplitEditor> SE;
+
+  /// The queue holds the unassigned virtual registers, the one starting first
+  /// on top.
+  typedef std::pair<SlotIndex, unsigned> QueueEntry;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>> Queue;
+
+  /// What to do with a live range that does not get a register.
+  enum LiveRangeStage {
+    /// Try to assign it, and put it back in the queue when it is evicted.
+    RS_Assign,
+
+    /// Split it around the blocks using it when it has to give up its
+    /// register again.
+    RS_Split,
+
+    /// Spill it when it runs out of registers.
+    RS_Spill
+  };
+
+  IndexedMap<LiveRangeStage, VirtReg2IndexFunctor> Stages;
+
+  LiveRangeStage getStage(const LiveInterval &VirtReg) const {
+    return Stages[VirtReg.reg];
+  }
+
+  void setStage(const LiveInterval &VirtReg, LiveRangeStage Stage) {
+    Stages.grow(VirtReg.reg);
+    Stages[VirtReg.reg] = Stage;
+  }
+
+public:
+  RALinearScan();
+
+  /// Return the pass name.
+  StringRef getPassName() const override {
+    return "Linear Scan Register Allocator";
+  }
+
+  /// RALinearScan analysis usage.
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+  void releaseMemory() override;
+
+  Spiller &spiller() override { return *SpillerInstance; }
+
+  void enqueue(LiveInterval *LI) override;
+  LiveInterval *dequeue() override;
+
+  unsigned selectOrSplit(LiveInterval &VirtReg,
+                         SmallVectorImpl<unsigned> &NewVRegs) override;
+
+  /// Perform register allocation.
+  bool runOnMachineFunction(MachineFunction &mf) override;
+
+  MachineFunctionProperties getRequiredProperties() const override {
+    return MachineFunctionProperties().set(
+        MachineFunctionProperties::Property::NoPHIs);
+  }
+
+  static char ID;
+
+private:
+  bool LRE_CanEraseVirtReg(unsigned) override;
+  void LRE_WillShrinkVirtReg(unsigned) override;
+  void LRE_DidCloneVirtReg(unsigned, unsigned) override;
+
+  float getEvictionCost(LiveInterval &VirtReg, unsigned PhysReg);
+  void evictInterference(LiveInterval &VirtReg, unsigned PhysReg,
+                         SmallVectorImpl<unsigned> &NewVRegs);
+  void spill(LiveInterval &VirtReg, SmallVectorImpl<unsigned> &NewVRegs);
+  bool trySplit(LiveInterval &VirtReg, SmallVectorImpl<unsigned> &NewVRegs);
+};
+
+char RALinearScan::ID = 0;
+
+} // end anonymous namespace
+
+RALinearScan::RALinearScan() : MachineFunctionPass(ID) {
+  initializeLiveDebugVariablesPass(*PassRegistry::getPassRegistry());
+  initializeLiveIntervalsPass(*PassRegistry::getPassRegistry());
+  initializeSlotIndexesPass(*PassRegistry::getPassRegistry());
+  initializeRegisterCoalescerPass(*PassRegistry::getPassRegistry());
+  initializeMachineSchedulerPass(*PassRegistry::getPassRegistry());
+  initializeLiveStacksPass(*PassRegistry::getPassRegistry());
+  initializeMachineDominatorTreePass(*PassRegistry::getPassRegistry());
+  initializeMachineLoopInfoPass(*PassRegistry::getPassRegistry());
+  initializeVirtRegMapPass(*PassRegistry::getPassRegistry());
+  initializeLiveRegMatrixPass(*PassRegistry::getPassRegistry());
+}
+
+void RALinearScan::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesCFG();
+  AU.addRequired<AAResultsWrapperPass>();
+  AU.addPreserved<AAResultsWrapperPass>();
+  AU.addRequired<LiveIntervals>();
+  AU.addPreserved<LiveIntervals>();
+  AU.addRequired<SlotIndexes>();
+  AU.addPreserved<SlotIndexes>();
+  AU.addRequired<LiveDebugVariables>();
+  AU.addPreserved<LiveDebugVariables>();
+  AU.addRequired<LiveStacks>();
+  AU.addPreserved<LiveStacks>();
+  AU.addRequired<MachineBlockFrequencyInfo>();
+  AU.addPreserved<MachineBlockFrequencyInfo>();
+  AU.addRequired<MachineDominatorTree>();
+  AU.addPreserved<MachineDominatorTree>();
+  AU.addRequired<MachineLoopInfo>();
+  AU.addPreserved<MachineLoopInfo>();
+  AU.addRequired<VirtRegMap>();
+  AU.addPreserved<VirtRegMap>();
+  AU.addRequired<LiveRegMatrix>();
+  AU.addPreserved<LiveRegMatrix>();
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
+
+void RALinearScan::releaseMemory() {
+  SpillerInstance.reset();
+  SA.reset();
+  SE.reset();
+  Stages.clear();
+}
+
+//===----------------------------------------------------------------------===//
+//                     LiveRangeEdit delegate methods
+//===----------------------------------------------------------------------===//
+
+bool RALinearScan::LRE_CanEraseVirtReg(unsigned VirtReg) {
+  if (VRM->hasPhys(VirtReg)) {
+    LiveInterval &LI = LIS->getInterval(VirtReg);
+    Matrix->unassign(LI);
+    aboutToRemoveInterval(LI);
+    return true;
+  }
+  // Unassigned virtreg is probably in the queue.
+  // RegAllocBase will erase it after dequeueing.
+  return false;
+}
+
+void RALinearScan::LRE_WillShrinkVirtReg(unsigned VirtReg) {
+  if (!VRM->hasPhys(VirtReg))
+    return;
+
+  // Register is assigned, put it back on the queue for reassignment.
+  LiveInterval &LI = LIS->getInterval(VirtReg);
+  Matrix->unassign(LI);
+  enqueue(&LI);
+}
+
+void RALinearScan::LRE_DidCloneVirtReg(unsigned New, unsigned Old) {
+  // Cloning a register we haven't even heard about yet?  Just ignore it.
+  if (!Stages.inBounds(Old))
+    return;
+
+  // The components of a live range broken up by dead code elimination stay
+  // in the stage of the original.
+  Stages.grow(New);
+  Stages[New] = Stages[Old];
+}
+
+//===----------------------------------------------------------------------===//
+//                              Queue
+//===----------------------------------------------------------------------===//
+
+void RALinearScan::enqueue(LiveInterval *LI) {
+  Stages.grow(LI->reg);
+  SlotIndex Start = LI->empty() ? LIS->getSlotIndexes()->getZeroIndex()
+                                 : LI->beginIndex();
+  Queue.push(std::make_pair(Start, LI->reg));
+}
+
+LiveInterval *RALinearScan::dequeue() {
+  if (Queue.empty())
+    return nullptr;
+  LiveInterval *LI = &LIS->getInterval(Queue.top().second);
+  Queue.pop();
+  return LI;
+}
+
+//===----------------------------------------------------------------------===//
+//                              Eviction
+//===----------------------------------------------------------------------===//
+
+/// Return the largest spill weight of the virtual registers assigned to
+/// PhysReg that interfere with VirtReg, or a huge value if evicting them is not
+/// allowed: they must all be spillable and weigh less than VirtReg.
+float RALinearScan::getEvictionCost(LiveInterval &VirtReg, unsigned PhysReg) {
+  float MaxWeight = 0;
+  for (MCRegUnitIterator Units(PhysReg, TRI); Units.isValid(); ++Units) {
+    LiveIntervalUnion::Query &Q = Matrix->query(VirtReg, *Units);
+    Q.collectInterferingVRegs();
+    if (Q.seenUnspillableVReg())
+      return huge_valf;
+    for (LiveInterval *Intf : Q.interferingVRegs()) {
+      if (!Intf->isSpillable() || Intf->weight >= VirtReg.weight)
+        return huge_valf;
+      MaxWeight = std::max(MaxWeight, Intf->weight);
+    }
+  }
+  return MaxWeight;
+}
+
+/// Unassign the virtual registers interfering with VirtReg from PhysReg. The
+/// ones evicted for the first time go back to the queue, the others are
+/// spilled.
+void RALinearScan::evictInterference(LiveInterval &VirtReg, unsigned PhysReg,
+                                     SmallVectorImpl<unsigned> &NewVRegs) {
+  // Collect all interfering virtregs first.
+  SmallVector<LiveInterval*, 8> Intfs;
+  for (MCRegUnitIterator Units(PhysReg, TRI); Units.isValid(); ++Units) {
+    LiveIntervalUnion::Query &Q = Matrix->query(VirtReg, *Units);
+    Q.collectInterferingVRegs();
+    ArrayRef<LiveInterval*> IVR = Q.interferingVRegs();
+    Intfs.append(IVR.begin(), IVR.end());
+  }
+
+  for (LiveInterval *Intf : Intfs) {
+    // The same VirtReg may be present in multiple RegUnits. Skip duplicates.
+    if (!VRM->hasPhys(Intf->reg))
+      continue;
+    DEBUG(dbgs() << "evicting " << PrintReg(Intf->reg, TRI) << " from "
+                 << PrintReg(PhysReg, TRI) << '\n');
+    Matrix->unassign(*Intf);
+    ++NumLSEvicted;
+    if (getStage(*Intf) == RS_Assign) {
+      setStage(*Intf, RS_Split);
+      NewVRegs.push_back(Intf->reg);
+    } else {
+      spill(*Intf, NewVRegs);
+    }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                          Splitting and Spilling
+//===----------------------------------------------------------------------===//
+
+void RALinearScan::spill(LiveInterval &VirtReg,
+                         SmallVectorImpl<unsigned> &NewVRegs) {
+  DEBUG(dbgs() << "spilling: " << VirtReg << '\n');
+  LiveRangeEdit LRE(&VirtReg, NewVRegs, *MF, *LIS, VRM, this, &DeadRemats);
+  spiller().spill(LRE);
+}
+
+/// Split VirtReg into a local interval for each block using it, if it lives
+/// in several blocks. The remaining interval, live through the other blocks,
+/// is left to be spilled.
+bool RALinearScan::trySplit(LiveInterval &VirtReg,
+                            SmallVectorImpl<unsigned> &NewVRegs) {
+  if (LIS->intervalIsInOneMBB(VirtReg))
+    return false;
+
+  unsigned Reg = VirtReg.reg;
+  SA->analyze(&VirtReg);
+  bool SingleInstrs = RegClassInfo.isProperSubClass(MRI->getRegClass(Reg));
+  LiveRangeEdit LREdit(&VirtReg, NewVRegs, *MF, *LIS, VRM, this, &DeadRemats);
+  SE->reset(LREdit, SplitEditor::SM_Speed);
+  for (const SplitAnalysis::BlockInfo &BI : SA->getUseBlocks())
+    if (SA->shouldSplitSingleBlock(BI, SingleInstrs))
+      SE->splitSingleBlock(BI);
+  // No blocks were split.
+  if (LREdit.empty()) {
+    SA->clear();
+    return false;
+  }
+
+  SE->finish();
+  SA->clear();
+  ++NumLSBlockSplits;
+
+  // Tell LiveDebugVariables about the new ranges.
+  DebugVars->splitRegister(Reg, LREdit.regs(), *LIS);
+
+  // Neither the local intervals nor the remainder are split again.
+  for (unsigned NewReg : LREdit.regs())
+    setStage(LIS->getInterval(NewReg), RS_Spill);
+
+  if (VerifyEnabled)
+    MF->verify(this, "After splitting live range around basic blocks");
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                            Main Entry Point
+//===----------------------------------------------------------------------===//
+
+unsigned RALinearScan::selectOrSplit(LiveInterval &VirtReg,
+                                     SmallVectorImpl<unsigned> &NewVRegs) {
+  // Look for a free register, and remember the cheapest one to evict.
+  unsigned BestPhys = 0;
+  float BestCost = huge_valf;
+  AllocationOrder Order(VirtReg.reg, *VRM, RegClassInfo, Matrix);
+  while (unsigned PhysReg = Order.next()) {
+    switch (Matrix->checkInterference(VirtReg, PhysReg)) {
+    case LiveRegMatrix::IK_Free:
+      return PhysReg;
+
+    case LiveRegMatrix::IK_VirtReg: {
+      float Cost = getEvictionCost(VirtReg, PhysReg);
+      if (Cost < BestCost) {
+        BestPhys = PhysReg;
+        BestCost = Cost;
+      }
+      continue;
+    }
+
+    default:
+      // RegMask or RegUnit interference.
+      continue;
+    }
+  }
+
+  if (BestPhys) {
+    evictInterference(VirtReg, BestPhys, NewVRegs);
+    assert(!Matrix->checkInterference(VirtReg, BestPhys) &&
+           "Interference after eviction.");
+    return BestPhys;
+  }
+
+  if (!VirtReg.isSpillable())
+    return ~0u;
+
+  if (getStage(VirtReg) != RS_Spill && trySplit(VirtReg, NewVRegs))
+    return 0;
+
+  spill(VirtReg, NewVRegs);
+  return 0;
+}
+
+bool RALinearScan::runOnMachineFunction(MachineFunction &mf) {
+  DEBUG(dbgs() << "********** LINEAR SCAN REGISTER ALLOCATION **********\n"
+               << "********** Function: " << mf.getName() << '\n');
+
+  MF = &mf;
+  RegAllocBase::init(getAnalysis<VirtRegMap>(),
+                     getAnalysis<LiveIntervals>(),
+                     getAnalysis<LiveRegMatrix>());
+
+  if (VerifyEnabled)
+    MF->verify(this, "Before linear scan register allocator");
+
+  Loops = &getAnalysis<MachineLoopInfo>();
+  DebugVars = &getAnalysis<LiveDebugVariables>();
+  MachineBlockFrequencyInfo &MBFI = getAnalysis<MachineBlockFrequencyInfo>();
+  calculateSpillWeightsAndHints(*LIS, *MF, VRM, *Loops, MBFI);
+
+  SpillerInstance.reset(createInlineSpiller(*this, *MF, *VRM));
+  SA.reset(new SplitAnalysis(*VRM, *LIS, *Loops));
+  SE.reset(new SplitEditor(
+      *SA, getAnalysis<AAResultsWrapperPass>().getAAResults(), *LIS, *VRM,
+      getAnalysis<MachineDominatorTree>(), MBFI));
+  Stages.clear();
+  Stages.resize(MRI->getNumVirtRegs());
+
+  allocatePhysRegs();
+  postOptimization();
+
+  // Diagnostic output before rewriting
+  DEBUG(dbgs() << "Post alloc VirtRegMap:\n" << *VRM << "\n");
+
+  releaseMemory();
+  return true;
+}
+
+FunctionPass *llvm::createLinearScanRegisterAllocator() {
+  return new RALinearScan();
+}
@@ -23,6 +23,7 @@
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/PseudoSourceValue.h"
 #include "llvm/CodeGen/RegisterPressure.h"
@@ -86,15 +87,19 @@ static void dumpSUList(ScheduleDAGInstrs::SUList &L) {
 #endif
 }
 
+static UndefValue *getUnknownValue(MachineFunction &MF) {
+  // Other threads of parallel codegen may be uniquing constants too.
+  auto ContextLock = MF.getMMI().lockContext();
+  return UndefValue::get(Type::getVoidTy(MF.getFunction()->getContext()));
+}
+
 ScheduleDAGInstrs::ScheduleDAGInstrs(MachineFunction &mf,
                                      const MachineLoopInfo *mli,
                                      bool RemoveKillFlags)
     : ScheduleDAG(mf), MLI(mli), MFI(mf.getFrameInfo()),
       RemoveKillFlags(RemoveKillFlags), CanHandleTerminators(false),
       TrackLaneMasks(false), AAForDep(nullptr), BarrierChain(nullptr),
-      UnknownValue(UndefValue::get(
-                     Type::getVoidTy(mf.getFunction()->getContext()))),
-      FirstDbgValue(nullptr) {
+      UnknownValue(getUnknownValue(mf)), FirstDbgValue(nullptr) {
   DbgValues.clear();
 
   const TargetSubtargetInfo &ST = mf.getSubtarget();
@@ -33,7 +33,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetLowering.h"
 #include "llvm/Target/TargetOptions.h"
@@ -50,6 +52,7 @@ STATISTIC(PostIndexedNodes, "Number of post-indexed nodes created");
 STATISTIC(OpsNarrowed     , "Number of load/op/store narrowed");
 STATISTIC(LdStFP2Int      , "Number of fp load/store pairs transformed to int");
 STATISTIC(SlicedLoads, "Number of load sliced");
+STATISTIC(NodesVisited    , "Number of dag nodes visited by the combiner");
 
 namespace {
   static cl::opt<bool>
@@ -83,6 +86,18 @@ namespace {
     MaySplitLoadIndex("combiner-split-load-index", cl::Hidden, cl::init(true),
                       cl::desc("DAG combiner may split indexing from loads"));
 
+  static cl::opt<bool>
+    TopologicalSweep("combiner-topological-sweep", cl::Hidden,
+                     cl::desc("Seed the DAG combiner worklist so that the "
+                              "operands of a node are combined before it"),
+                     cl::init(false));
+
+  static cl::opt<bool>
+    PrintCombineCosts("combiner-print-costs", cl::Hidden,
+                      cl::desc("Print the visits, combines and time spent "
+                               "per opcode after each DAG combine"),
+                      cl::init(false));
+
 //------------------------------ DAGCombiner ---------------------------------//
 
   class DAGCombiner {
@@ -101,20 +116,23 @@ namespace {
     ///
     /// The worklist will not contain duplicates but may contain null entries
     /// due to nodes being deleted from the underlying DAG.
-    SmallVector<SDNode *, 64> Worklist;
-
-    /// \brief Mapping from an SDNode to its position on the worklist.
     ///
-    /// This is used to find and remove nodes from the worklist (by nulling
-    /// them) when they are deleted from the underlying DAG. It relies on
-    /// stable indices of nodes within the worklist.
-    DenseMap<SDNode *, unsigned> WorklistMap;
+    /// Each node records its position on the worklist, or whether it has
+    /// been combined already, in its CombinerWorklistIndex. This is used to
+    /// find and remove nodes from the worklist (by nulling them) when they are
+    /// deleted from the underlying DAG, and to reliably add any operands of a
+    /// DAG node which have not yet been combined to the worklist.
+    SmallVector<SDNode *, 64> Worklist;
 
-    /// \brief Set of nodes which have been combined (at least once).
-    ///
-    /// This is used to allow us to reliably add any operands of a DAG node
-    /// which have not yet been combined to the worklist.
-    SmallPtrSet<SDNode *, 32> CombinedNodes;
+    /// \brief What visiting the nodes of one opcode has cost, for
+    /// -combiner-print-costs.
+    struct CombineCost {
+      std::string Name;
+      unsigned Visits = 0;
+      unsigned Combines = 0;
+      double Seconds = 0;
+    };
+    DenseMap<unsigned, CombineCost> CombineCosts;
 
     // AA - Used for DAG load/store alias analysis.
     AliasAnalysis &AA;
@@ -138,23 +156,42 @@ namespace {
       if (N->getOpcode() == ISD::HANDLENODE)
         return;
 
-      if (WorklistMap.insert(std::make_pair(N, Worklist.size())).second)
-        Worklist.push_back(N);
+      if (N->getCombinerWorklistIndex() >= 0)
+        return; // Already in the worklist.
+
+      N->setCombinerWorklistIndex(Worklist.size());
+      Worklist.push_back(N);
     }
 
     /// Remove all instances of N from the worklist.
     void removeFromWorklist(SDNode *N) {
-      CombinedNodes.erase(N);
-
-      auto It = WorklistMap.find(N);
-      if (It == WorklistMap.end())
+      int Index = N->getCombinerWorklistIndex();
+      N->setCombinerWorklistIndex(-1);
+      if (Index < 0)
         return; // Not in the worklist.
 
       // Null out the entry rather than erasing it to avoid a linear operation.
-      Worklist[It->second] = nullptr;
-      WorklistMap.erase(It);
+      Worklist[Index] = nullptr;
     }
 
+    /// Pop the next node to combine off the worklist, or return null if there
+    /// is none left.
+    SDNode *getNextWorklistEntry() {
+      // The Worklist holds the SDNodes in order, but it may contain null
+      // entries.
+      SDNode *N = nullptr;
+      while (!N && !Worklist.empty())
+        N = Worklist.pop_back_val();
+      if (N) {
+        assert(N->getCombinerWorklistIndex() == (int)Worklist.size() &&
+               "Found a worklist entry with a stale index!");
+        N->setCombinerWorklistIndex(-1);
+      }
+      return N;
+    }
+
+    void printCombineCosts(raw_ostream &OS) const;
+
     void deleteAndRecombine(SDNode *N);
     bool recursivelyDeleteUnusedNodes(SDNode *N);
 
@@ -1290,9 +1327,16 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
   LegalOperations = Level >= AfterLegalizeVectorOps;
   LegalTypes = Level >= AfterLegalizeTypes;
 
-  // Add all the dag nodes to the worklist.
-  for (SDNode &Node : DAG.allnodes())
-    AddToWorklist(&Node);
+  // Add all the dag nodes to the worklist. For a topological sweep, add them
+  // users first so that the operands of a node are popped before it.
+  if (TopologicalSweep) {
+    DAG.AssignTopologicalOrder();
+    for (SDNode &Node : reverse(DAG.allnodes()))
+      AddToWorklist(&Node);
+  } else {
+    for (SDNode &Node : DAG.allnodes())
+      AddToWorklist(&Node);
+  }
 
   // Create a dummy node (which is not added to allnodes), that adds a reference
   // to the root node, preventing it from being deleted, and tracking any
@@ -1300,18 +1344,7 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
   HandleSDNode Dummy(DAG.getRoot());
 
   // While the worklist isn't empty, find a node and try to combine it.
-  while (!WorklistMap.empty()) {
-    SDNode *N;
-    // The Worklist holds the SDNodes in order, but it may contain null entries.
-    do {
-      N = Worklist.pop_back_val();
-    } while (!N);
-
-    bool GoodWorklistEntry = WorklistMap.erase(N);
-    (void)GoodWorklistEntry;
-    assert(GoodWorklistEntry &&
-           "Found a worklist entry without a corresponding map entry!");
-
+  while (SDNode *N = getNextWorklistEntry()) {
     // If N has no uses, it is dead.  Make sure to revisit all N's operands once
     // N is deleted from the DAG, since they too may now be dead or may have a
     // reduced number of uses, allowing other xforms.
@@ -1339,12 +1372,26 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
     // Add any operands of the new node which have not yet been combined to the
     // worklist as well. Because the worklist uniques things already, this
     // won't repeatedly process the same operand.
-    CombinedNodes.insert(N);
+    N->setCombinerWorklistIndex(-2);
     for (const SDValue &ChildN : N->op_values())
-      if (!CombinedNodes.count(ChildN.getNode()))
+      if (ChildN->getCombinerWorklistIndex() != -2)
         AddToWorklist(ChildN.getNode());
 
-    SDValue RV = combine(N);
+    ++NodesVisited;
+    SDValue RV;
+    if (PrintCombineCosts) {
+      CombineCost &Cost = CombineCosts[N->getOpcode()];
+      if (Cost.Name.empty())
+        Cost.Name = N->getOperationName(&DAG);
+      double Start = TimeRecord::getCurrentTime(true).getWallTime();
+      RV = combine(N);
+      Cost.Seconds += TimeRecord::getCurrentTime(false).getWallTime() - Start;
+      ++Cost.Visits;
+      if (RV.getNode())
+        ++Cost.Combines;
+    } else {
+      RV = combine(N);
+    }
 
     if (!RV.getNode())
       continue;
@@ -1388,6 +1435,32 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
   // If the root changed (e.g. it was a dead load, update the root).
   DAG.setRoot(Dummy.getValue());
   DAG.RemoveDeadNodes();
+
+  // Forget which nodes were combined, so that the next run starts afresh.
+  for (SDNode &Node : DAG.allnodes())
+    Node.setCombinerWorklistIndex(-1);
+
+  if (PrintCombineCosts)
+    printCombineCosts(dbgs());
+}
+
+void DAGCombiner::printCombineCosts(raw_ostream &OS) const {
+  std::vector<const CombineCost *> Costs;
+  for (const auto &Entry : CombineCosts)
+    Costs.push_back(&Entry.second);
+  std::sort(Costs.begin(), Costs.end(),
+            [](const CombineCost *A, const CombineCost *B) {
+              return A->Seconds > B->Seconds ||
+                     (A->Seconds == B->Seconds && A->Name < B->Name);
+            });
+
+  OS << "DAG combine costs at level " << Level << " in '"
+     << DAG.getMachineFunction().getName() << "':\n";
+  OS << "  Visits  Combined  Wall time (us)  Opcode\n";
+  for (const CombineCost *Cost : Costs)
+    OS << format("  %6u  %8u  %14.1f  ", Cost->Visits, Cost->Combines,
+                 Cost->Seconds * 1e6)
+       << Cost->Name << '\n';
 }
 
 SDValue DAGCombiner::visit(SDNode *N) {
@@ -27,6 +27,7 @@
 #include "llvm/Analysis/BranchProbabilityInfo.h"
 #include "llvm/Analysis/CFG.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/CodeGen/Analysis.h"
 #include "llvm/CodeGen/FastISel.h"
 #include "llvm/CodeGen/FunctionLoweringInfo.h"
 #include "llvm/CodeGen/GCMetadata.h"
@@ -48,6 +49,7 @@
 #include "llvm/CodeGen/StackProtector.h"
 #include "llvm/CodeGen/ValueTypes.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DebugLoc.h"
@@ -99,6 +101,7 @@ STATISTIC(NumFastIselSuccess, "Number of instructions fast isel selected");
 STATISTIC(NumFastIselBlocks, "Number of blocks selected entirely by fast isel");
 STATISTIC(NumDAGBlocks, "Number of blocks selected using DAG");
 STATISTIC(NumDAGIselRetries,"Number of times dag isel has to try another path");
+STATISTIC(NumDAGBlockCuts, "Number of times a block was cut into several DAGs");
 STATISTIC(NumEntryBlocks, "Number of entry blocks encountered");
 STATISTIC(NumFastIselFailLowerArguments,
           "Number of entry blocks where fast isel failed to lower arguments");
@@ -214,6 +217,11 @@ UseMBPI("use-mbpi",
         cl::desc("use Machine Branch Probability Info"),
         cl::init(true), cl::Hidden);
 
+static cl::opt<unsigned>
+MaxDAGBlockSize("isel-max-block-size", cl::Hidden, cl::init(0),
+                cl::desc("Select larger basic blocks in several DAGs of "
+                         "about this many instructions (0 = unlimited)"));
+
 #ifndef NDEBUG
 static cl::opt<std::string>
 FilterDAGBasicBlockName("filter-view-dags", cl::Hidden,
@@ -535,6 +543,10 @@ bool SelectionDAGISel::runOnMachineFunction(MachineFunction &mf) {
 
   SelectAllBasicBlocks(Fn);
 
+  // Record the stack protector layout of the allocas on their stack objects
+  // for the stack slot allocation passes.
+  getAnalysis<StackProtector>().copyToMachineFrameInfo(MF->getFrameInfo());
+
   // If the first basic block in the function has live ins that need to be
   // copied into vregs, emit the copies into the top of the block before
   // emitting the code for the block.
@@ -698,21 +710,203 @@ bool SelectionDAGISel::runOnMachineFunction(MachineFunction &mf) {
   return true;
 }
 
+/// Return true if a value of type Ty can be carried in virtual registers from
+/// one DAG to another.
+static bool canLiveInVRegs(const FunctionLoweringInfo &FuncInfo, Type *Ty) {
+  if (Ty->isTokenTy())
+    return false;
+  const TargetLowering &TLI = *FuncInfo.TLI;
+  SmallVector<EVT, 4> ValueVTs;
+  ComputeValueVTs(TLI, FuncInfo.Fn->getParent()->getDataLayout(), Ty,
+                  ValueVTs);
+  for (EVT VT : ValueVTs) {
+    if (!TLI.isTypeLegal(TLI.getRegisterType(Ty->getContext(), VT)))
+      return false;
+    // The register counts of TargetLowering wrap for the vectors split into
+    // 256 registers or more.
+    EVT IntermediateVT;
+    MVT RegisterVT;
+    unsigned NumIntermediates;
+    if (VT.isVector() &&
+        TLI.getVectorTypeBreakdown(Ty->getContext(), VT, IntermediateVT,
+                                   NumIntermediates, RegisterVT) !=
+            TLI.getNumRegisters(Ty->getContext(), VT))
+      return false;
+  }
+  return true;
+}
+
+/// Find where to cut the instructions [Begin, End) of a basic block into
+/// pieces of about MaxDAGBlockSize instructions, so that each piece can be
+/// selected as a DAG of its own.
+///
+/// A piece ends after an instruction with side effects, where the DAG is
+/// chained anyway, and never while a value that cannot live in virtual
+/// registers, like a token, is live, between an inline asm, stack map or
+/// patch point and the instructions computing its operands, or between an
+/// intrinsic that needs a frame index and the casts of the alloca it takes.
+/// The last
+/// instruction with side effects and the ones after it stay with the
+/// terminator: the terminator can still fold them, and a tail call always ends
+/// up in the last piece. The values used across a cut get a virtual register,
+/// which SelectionDAGBuilder copies them to and reads them from like the values
+/// used in other blocks.
+static void
+findDAGCutPoints(BasicBlock::const_iterator Begin,
+                 BasicBlock::const_iterator End, FunctionLoweringInfo &FuncInfo,
+                 SmallVectorImpl<BasicBlock::const_iterator> &Cuts) {
+  // Number the instructions, and find the last one with side effects.
+  DenseMap<const Instruction *, unsigned> Position;
+  unsigned Size = 0, LastChained = 0, NumInsts = 0;
+  for (BasicBlock::const_iterator I = Begin; I != End; ++I, ++NumInsts) {
+    Position[&*I] = NumInsts;
+    if (isa<DbgInfoIntrinsic>(I))
+      continue;
+    ++Size;
+    if (!isa<TerminatorInst>(I) &&
+        (I->mayHaveSideEffects() || I->mayReadOrWriteMemory()))
+      LastChained = NumInsts;
+  }
+  if (Size <= MaxDAGBlockSize)
+    return;
+
+  // Find how far the values that must stay in one DAG are used. The arguments
+  // used in the entry block are defined before its first instruction.
+  auto getLastUse = [&](const Value &V) {
+    unsigned LastUse = 0;
+    for (const User *U : V.users()) {
+      auto UI = Position.find(cast<Instruction>(U));
+      if (UI != Position.end())
+        LastUse = std::max(LastUse, UI->second);
+    }
+    return LastUse;
+  };
+  SmallVector<unsigned, 64> PinnedUntil(NumInsts, 0);
+  for (const Instruction &I : make_range(Begin, End)) {
+    if (!I.use_empty() && !canLiveInVRegs(FuncInfo, I.getType()))
+      PinnedUntil[Position[&I]] = getLastUse(I);
+
+    // Inline asm folds the address computations of its memory operands, and
+    // stack maps and patch points encode their operands as constants when the
+    // DAG folds them to one; the callee of a patch point must be one.
+    ImmutableCallSite CS(&I);
+    if (!CS)
+      continue;
+    Intrinsic::ID IID = CS.getIntrinsicID();
+    if (CS.isInlineAsm() || IID == Intrinsic::experimental_stackmap ||
+        IID == Intrinsic::experimental_patchpoint_void ||
+        IID == Intrinsic::experimental_patchpoint_i64) {
+      for (const Value *Op : CS.args()) {
+        auto OI = Position.find(dyn_cast<Instruction>(Op));
+        if (OI != Position.end())
+          PinnedUntil[OI->second] =
+              std::max(PinnedUntil[OI->second], Position[&I]);
+      }
+      continue;
+    }
+
+    // These intrinsics take static allocas, which are lowered to frame
+    // indices in every piece, but a cast or an address computation of one
+    // read from a virtual register is no longer a frame index.
+    if (IID != Intrinsic::x86_seh_ehregnode &&
+        IID != Intrinsic::x86_seh_ehguard && IID != Intrinsic::localescape &&
+        IID != Intrinsic::stackprotector && IID != Intrinsic::gcroot)
+      continue;
+    for (const Value *Op : CS.args()) {
+      while (isa<CastInst>(Op) || isa<GetElementPtrInst>(Op)) {
+        auto OI = Position.find(cast<Instruction>(Op));
+        if (OI == Position.end())
+          break;
+        PinnedUntil[OI->second] =
+            std::max(PinnedUntil[OI->second], Position[&I]);
+        Op = cast<Instruction>(Op)->getOperand(0);
+      }
+    }
+  }
+  if (Begin->getParent() == &FuncInfo.Fn->getEntryBlock())
+    for (const Argument &Arg : FuncInfo.Fn->args())
+      if (!FuncInfo.ValueMap.count(&Arg) &&
+          !canLiveInVRegs(FuncInfo, Arg.getType()))
+        PinnedUntil[0] = std::max(PinnedUntil[0], getLastUse(Arg));
+
+  // Cut once a piece is large enough, after an instruction with side effects
+  // if one comes before the piece doubles in size.
+  SmallVector<unsigned, 8> CutPositions;
+  unsigned PieceSize = 0, LivePinnedUntil = 0, Pos = 0;
+  for (BasicBlock::const_iterator I = Begin; Pos < LastChained; ++I, ++Pos) {
+    LivePinnedUntil = std::max(LivePinnedUntil, PinnedUntil[Pos]);
+    if (isa<DbgInfoIntrinsic>(I))
+      continue;
+    if (++PieceSize < MaxDAGBlockSize || LivePinnedUntil > Pos)
+      continue;
+    if (!I->mayHaveSideEffects() && !I->mayReadOrWriteMemory() &&
+        PieceSize < 2 * MaxDAGBlockSize)
+      continue;
+    Cuts.push_back(std::next(I));
+    CutPositions.push_back(Pos + 1);
+    PieceSize = 0;
+  }
+  if (Cuts.empty())
+    return;
+  NumDAGBlockCuts += Cuts.size();
+  DEBUG(dbgs() << "Cutting " << Begin->getParent()->getName() << " into "
+               << Cuts.size() + 1 << " DAGs\n");
+
+  // Give a virtual register to the values used in a later piece.
+  auto getPiece = [&](unsigned P) {
+    return std::upper_bound(CutPositions.begin(), CutPositions.end(), P) -
+           CutPositions.begin();
+  };
+  for (const Instruction &I : make_range(Begin, End)) {
+    if (I.use_empty() || FuncInfo.ValueMap.count(&I) ||
+        !canLiveInVRegs(FuncInfo, I.getType()))
+      continue;
+    if (const AllocaInst *AI = dyn_cast<AllocaInst>(&I))
+      if (FuncInfo.StaticAllocaMap.count(AI))
+        continue;
+    auto Piece = getPiece(Position[&I]);
+    if (getPiece(getLastUse(I)) != Piece)
+      FuncInfo.InitializeRegForValue(&I);
+  }
+}
+
 void SelectionDAGISel::SelectBasicBlock(BasicBlock::const_iterator Begin,
                                         BasicBlock::const_iterator End,
                                         bool &HadTailCall) {
-  // Lower the instructions. If a call is emitted as a tail call, cease emitting
-  // nodes for this block.
-  for (BasicBlock::const_iterator I = Begin; I != End && !SDB->HasTailCall; ++I)
-    SDB->visit(*I);
-
-  // Make sure the root of the DAG is up-to-date.
-  CurDAG->setRoot(SDB->getControlRoot());
-  HadTailCall = SDB->HasTailCall;
-  SDB->clear();
-
-  // Final step, emit the lowered DAG as machine code.
-  CodeGenAndEmitDAG();
+  // Select a huge block a piece at a time to bound the size of its DAGs.
+  SmallVector<BasicBlock::const_iterator, 4> Cuts;
+  if (MaxDAGBlockSize)
+    findDAGCutPoints(Begin, End, *FuncInfo, Cuts);
+
+  // The arguments only used in the entry block were lowered into the DAG of
+  // its first piece, export them to the others.
+  if (!Cuts.empty() && Begin->getParent() == &FuncInfo->Fn->getEntryBlock())
+    for (const Argument &Arg : FuncInfo->Fn->args())
+      if (!Arg.use_empty() &&
+          !(Arg.hasSwiftErrorAttr() && TLI->supportSwiftError()) &&
+          !FuncInfo->ValueMap.count(&Arg) &&
+          canLiveInVRegs(*FuncInfo, Arg.getType())) {
+        FuncInfo->InitializeRegForValue(&Arg);
+        SDB->CopyToExportRegsIfNeeded(&Arg);
+      }
+  Cuts.push_back(End);
+
+  for (BasicBlock::const_iterator PieceEnd : Cuts) {
+    // Lower the instructions. If a call is emitted as a tail call, cease
+    // emitting nodes for this block.
+    for (BasicBlock::const_iterator I = Begin;
+         I != PieceEnd && !SDB->HasTailCall; ++I)
+      SDB->visit(*I);
+
+    // Make sure the root of the DAG is up-to-date.
+    CurDAG->setRoot(SDB->getControlRoot());
+    HadTailCall = SDB->HasTailCall;
+    SDB->clear();
+
+    // Final step, emit the lowered DAG as machine code.
+    CodeGenAndEmitDAG();
+    Begin = PieceEnd;
+  }
 }
 
 void SelectionDAGISel::ComputeLiveOutVRegInfo() {
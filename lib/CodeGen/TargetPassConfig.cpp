@@ -20,6 +20,8 @@
 #include "llvm/Analysis/CallGraphSCCPass.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Analysis/ScopedNoAliasAA.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Analysis/TypeBasedAliasAnalysis.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/RegAllocRegistry.h"
@@ -118,6 +120,12 @@ cl::opt<bool> MISchedPostRA("misched-postra", cl::Hidden,
 static cl::opt<bool> EarlyLiveIntervals("early-live-intervals", cl::Hidden,
     cl::desc("Run live interval analysis earlier in the pipeline"));
 
+static cl::opt<unsigned> CodeGenThreads(
+    "codegen-threads", cl::Hidden, cl::init(0),
+    cl::desc("Number of threads running the machine function passes through "
+             "register allocation on different functions (0 = run them with "
+             "the rest of the pipeline)"));
+
 // Experimental option to use CFL-AA in codegen
 enum class CFLAAType { None, Steensgaard, Andersen, Both };
 static cl::opt<CFLAAType> UseCFLAA(
@@ -571,16 +579,7 @@ void TargetPassConfig::addMachinePasses() {
   AddingMachinePasses = true;
 
   // Insert a machine instr printer pass after the specified pass.
-  if (!StringRef(PrintMachineInstrs.getValue()).equals("") &&
-      !StringRef(PrintMachineInstrs.getValue()).equals("option-unspecified")) {
-    const PassRegistry *PR = PassRegistry::getPassRegistry();
-    const PassInfo *TPI = PR->getPassInfo(PrintMachineInstrs.getValue());
-    const PassInfo *IPI = PR->getPassInfo(StringRef("machineinstr-printer"));
-    assert (TPI && IPI && "Pass ID not registered!");
-    const char *TID = (const char *)(TPI->getTypeInfo());
-    const char *IID = (const char *)(IPI->getTypeInfo());
-    insertPass(TID, IID);
-  }
+  insertPrintMachineInstrsPass();
 
   // Print the instruction selected machine code...
   printAndVerify("After Instruction Selection");
@@ -588,27 +587,12 @@ void TargetPassConfig::addMachinePasses() {
   if (TM->Options.EnableIPRA)
     addPass(createRegUsageInfoPropPass());
 
-  // Expand pseudo-instructions emitted by ISel.
-  addPass(&ExpandISelPseudosID);
-
-  // Add passes that optimize machine instructions in SSA form.
-  if (getOptLevel() != CodeGenOpt::None) {
-    addMachineSSAOptimization();
-  } else {
-    // If the target requests it, assign local variables to stack slots relative
-    // to one another and simplify frame index references where possible.
-    addPass(&LocalStackSlotAllocationID, false);
-  }
-
-  // Run pre-ra passes.
-  addPreRegAlloc();
-
-  // Run register allocation and passes that are tightly coupled with it,
-  // including phi elimination and scheduling.
-  if (getOptimizeRegAlloc())
-    addOptimizedRegAlloc(createRegAllocPass(true));
+  // Run the passes through register allocation, possibly on several functions
+  // at once.
+  if (useParallelMachinePasses())
+    addPass(createParallelMachinePassesPass(CodeGenThreads), false, false);
   else
-    addFastRegAlloc(createRegAllocPass(false));
+    addMachinePassesThroughRegAlloc();
 
   // Run post-ra passes.
   addPostRegAlloc();
@@ -677,6 +661,78 @@ void TargetPassConfig::addMachinePasses() {
   AddingMachinePasses = false;
 }
 
+/// Add the passes from the expansion of the ISel pseudo-instructions through
+/// register allocation, which the functions go through independently of each
+/// other.
+void TargetPassConfig::addMachinePassesThroughRegAlloc() {
+  // Expand pseudo-instructions emitted by ISel.
+  addPass(&ExpandISelPseudosID);
+
+  // Add passes that optimize machine instructions in SSA form.
+  if (getOptLevel() != CodeGenOpt::None) {
+    addMachineSSAOptimization();
+  } else {
+    // If the target requests it, assign local variables to stack slots relative
+    // to one another and simplify frame index references where possible.
+    addPass(&LocalStackSlotAllocationID, false);
+  }
+
+  // Run pre-ra passes.
+  addPreRegAlloc();
+
+  // Run register allocation and passes that are tightly coupled with it,
+  // including phi elimination and scheduling.
+  if (getOptimizeRegAlloc())
+    addOptimizedRegAlloc(createRegAllocPass(true));
+  else
+    addFastRegAlloc(createRegAllocPass(false));
+}
+
+/// Insert a machine instr printer pass after the pass named with
+/// -print-machineinstrs.
+void TargetPassConfig::insertPrintMachineInstrsPass() {
+  if (!StringRef(PrintMachineInstrs.getValue()).equals("") &&
+      !StringRef(PrintMachineInstrs.getValue()).equals("option-unspecified")) {
+    const PassRegistry *PR = PassRegistry::getPassRegistry();
+    const PassInfo *TPI = PR->getPassInfo(PrintMachineInstrs.getValue());
+    const PassInfo *IPI = PR->getPassInfo(StringRef("machineinstr-printer"));
+    assert (TPI && IPI && "Pass ID not registered!");
+    const char *TID = (const char *)(TPI->getTypeInfo());
+    const char *IID = (const char *)(IPI->getTypeInfo());
+    insertPass(TID, IID);
+  }
+}
+
+/// Return true if addMachinePassesThroughRegAlloc() should run on several
+/// threads with -codegen-threads. This is not done when functions depend on
+/// the register allocation of others (IPRA), on partial pipelines, nor with
+/// analyses or timers the threads cannot share.
+bool TargetPassConfig::useParallelMachinePasses() const {
+  return CodeGenThreads != 0 && !TM->Options.EnableIPRA && !StartBefore &&
+         !StartAfter && !StopBefore && !StopAfter &&
+         UseCFLAA == CFLAAType::None && !TimePassesIsEnabled;
+}
+
+void TargetPassConfig::addParallelMachinePasses(PassManagerBase &PM) const {
+  // The analyses the passes use besides the machine ones, as added to the IR
+  // pass pipeline.
+  PM.add(createTargetTransformInfoWrapperPass(TM->getTargetIRAnalysis()));
+  PM.add(new TargetLibraryInfoWrapperPass(TM->getTargetTriple()));
+  PM.add(createTypeBasedAAWrapperPass());
+  PM.add(createScopedNoAliasAAWrapperPass());
+
+  TargetPassConfig *PassConfig =
+      getTM<LLVMTargetMachine>().createPassConfig(PM);
+  PassConfig->setDisableVerify(DisableVerify);
+  PM.add(PassConfig);
+
+  PassConfig->AddingMachinePasses = true;
+  PassConfig->insertPrintMachineInstrsPass();
+  PassConfig->addMachinePassesThroughRegAlloc();
+  PassConfig->AddingMachinePasses = false;
+  PassConfig->setInitialized();
+}
+
 /// Add passes that optimize machine instructions in SSA form.
 void TargetPassConfig::addMachineSSAOptimization() {
   // Pre-ra tail duplication.
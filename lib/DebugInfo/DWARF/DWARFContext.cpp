@@ -46,8 +46,22 @@ static void dumpAccelSection(raw_ostream &OS, StringRef Name,
   Accel.dump(OS);
 }
 
+/// Call \p Dump to dump \p U, then release the DIEs parsed to do so, so that
+/// dumping a large section doesn't keep all of its DIEs in memory. DIEs which
+/// were parsed before may be referenced by the caller and are kept.
+template <typename DumpFn>
+static void dumpUnit(DWARFUnit &U, bool KeepDIEs, DumpFn Dump) {
+  bool WasExtracted = U.hasExtractedDIEs();
+  Dump();
+  if (!WasExtracted && !KeepDIEs)
+    U.clearDIEs(true);
+}
+
 void DWARFContext::dump(raw_ostream &OS, DIDumpType DumpType, bool DumpEH,
                         bool SummarizeTypes) {
+  // In thread-safe mode, other threads may be reading the DIEs.
+  bool KeepDIEs = isThreadSafe();
+
   if (DumpType == DIDT_All || DumpType == DIDT_Abbrev) {
     OS << ".debug_abbrev contents:\n";
     getDebugAbbrev()->dump(OS);
@@ -62,21 +76,21 @@ void DWARFContext::dump(raw_ostream &OS, DIDumpType DumpType, bool DumpEH,
   if (DumpType == DIDT_All || DumpType == DIDT_Info) {
     OS << "\n.debug_info contents:\n";
     for (const auto &CU : compile_units())
-      CU->dump(OS);
+      dumpUnit(*CU, KeepDIEs, [&] { CU->dump(OS); });
   }
 
   if ((DumpType == DIDT_All || DumpType == DIDT_InfoDwo) &&
       getNumDWOCompileUnits()) {
     OS << "\n.debug_info.dwo contents:\n";
     for (const auto &DWOCU : dwo_compile_units())
-      DWOCU->dump(OS);
+      dumpUnit(*DWOCU, KeepDIEs, [&] { DWOCU->dump(OS); });
   }
 
   if ((DumpType == DIDT_All || DumpType == DIDT_Types) && getNumTypeUnits()) {
     OS << "\n.debug_types contents:\n";
     for (const auto &TUS : type_unit_sections())
       for (const auto &TU : TUS)
-        TU->dump(OS, SummarizeTypes);
+        dumpUnit(*TU, KeepDIEs, [&] { TU->dump(OS, SummarizeTypes); });
   }
 
   if ((DumpType == DIDT_All || DumpType == DIDT_TypesDwo) &&
@@ -84,7 +98,8 @@ void DWARFContext::dump(raw_ostream &OS, DIDumpType DumpType, bool DumpEH,
     OS << "\n.debug_types.dwo contents:\n";
     for (const auto &DWOTUS : dwo_type_unit_sections())
       for (const auto &DWOTU : DWOTUS)
-        DWOTU->dump(OS, SummarizeTypes);
+        dumpUnit(*DWOTU, KeepDIEs,
+                 [&] { DWOTU->dump(OS, SummarizeTypes); });
   }
 
   if (DumpType == DIDT_All || DumpType == DIDT_Loc) {
@@ -252,6 +267,32 @@ void DWARFContext::dump(raw_ostream &OS, DIDumpType DumpType, bool DumpEH,
                      getStringSection(), isLittleEndian());
 }
 
+void DWARFContext::setThreadSafe() {
+  if (ThreadSafe)
+    return;
+
+  // Everything the queries may look at and that isn't protected by a lock has
+  // to be built before other threads can access the context.
+  parseCompileUnits();
+  parseTypeUnits();
+  parseDWOCompileUnits();
+  parseDWOTypeUnits();
+  getDebugAranges();
+
+  for (const auto &CU : CUs)
+    CU->prepareForThreadSafeAccess();
+  for (const auto &CU : DWOCUs)
+    CU->prepareForThreadSafeAccess();
+  for (const auto &TUS : TUs)
+    for (const auto &TU : TUS)
+      TU->prepareForThreadSafeAccess();
+  for (const auto &TUS : DWOTUs)
+    for (const auto &TU : TUS)
+      TU->prepareForThreadSafeAccess();
+
+  ThreadSafe = true;
+}
+
 const DWARFUnitIndex &DWARFContext::getCUIndex() {
   if (CUIndex)
     return *CUIndex;
@@ -379,6 +420,10 @@ const DWARFDebugMacro *DWARFContext::getDebugMacro() {
 
 const DWARFLineTable *
 DWARFContext::getLineTableForUnit(DWARFUnit *U) {
+  std::unique_lock<std::mutex> Lock(LineTableLock, std::defer_lock);
+  if (ThreadSafe)
+    Lock.lock();
+
   if (!Line)
     Line.reset(new DWARFDebugLine(&getLineSection().Relocs));
 
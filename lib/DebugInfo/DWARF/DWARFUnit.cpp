@@ -57,7 +57,8 @@ DWARFUnit::DWARFUnit(DWARFContext &DC, const DWARFSection &Section,
         return SOS;
       }()),
       AddrOffsetSection(AOS), isLittleEndian(LE), isDWO(IsDWO),
-      UnitSection(UnitSection), IndexEntry(IndexEntry) {
+      UnitSection(UnitSection), IndexEntry(IndexEntry),
+      AllDIEsExtracted(false) {
   clear();
 }
 
@@ -213,6 +214,28 @@ void DWARFUnit::extractDIEsToVector(
 }
 
 size_t DWARFUnit::extractDIEsIfNeeded(bool CUDieOnly) {
+  if (!Context.isThreadSafe())
+    return extractDIEsIfNeededImpl(CUDieOnly);
+
+  // Other threads may hold DIEs pointing into DieArray, so it can only be
+  // filled once: extract the whole unit even if only the unit DIE is needed.
+  if (AllDIEsExtracted.load(std::memory_order_acquire))
+    return 0;
+  std::lock_guard<std::mutex> Lock(ExtractLock);
+  if (AllDIEsExtracted.load(std::memory_order_relaxed))
+    return 0;
+  size_t NumDIEs = extractDIEsIfNeededImpl(false);
+  AllDIEsExtracted.store(true, std::memory_order_release);
+  return NumDIEs;
+}
+
+void DWARFUnit::prepareForThreadSafeAccess() {
+  if (DieArray.size() == 1)
+    clearDIEs(false);
+  AllDIEsExtracted = !DieArray.empty();
+}
+
+size_t DWARFUnit::extractDIEsIfNeededImpl(bool CUDieOnly) {
   if ((CUDieOnly && !DieArray.empty()) ||
       DieArray.size() > 1)
     return 0; // Already parsed.
@@ -223,9 +246,10 @@ size_t DWARFUnit::extractDIEsIfNeeded(bool CUDieOnly) {
   if (DieArray.empty())
     return 0;
 
-  // If CU DIE was just parsed, copy several attribute values from it.
+  // If CU DIE was just parsed, copy several attribute values from it. Don't
+  // go through getUnitDIE(), which would take ExtractLock again.
   if (!HasCUDie) {
-    DWARFDie UnitDie = getUnitDIE();
+    DWARFDie UnitDie(this, &DieArray[0]);
     auto BaseAddr = toAddress(UnitDie.find({DW_AT_low_pc, DW_AT_entry_pc}));
     if (BaseAddr)
       setBaseAddress(*BaseAddr);
@@ -271,20 +295,29 @@ bool DWARFUnit::parseDWO() {
     sys::path::append(AbsolutePath, *CompilationDir);
   }
   sys::path::append(AbsolutePath, *DWOFileName);
-  DWO = llvm::make_unique<DWOHolder>(AbsolutePath);
-  DWARFUnit *DWOCU = DWO->getUnit();
+  auto NewDWO = llvm::make_unique<DWOHolder>(AbsolutePath);
+  DWARFUnit *DWOCU = NewDWO->getUnit();
   // Verify that compile unit in .dwo file is valid.
-  if (!DWOCU || DWOCU->getDWOId() != getDWOId()) {
-    DWO.reset();
+  if (!DWOCU || DWOCU->getDWOId() != getDWOId())
     return false;
-  }
   // Share .debug_addr and .debug_ranges section with compile unit in .dwo
   DWOCU->setAddrOffsetSection(AddrOffsetSection, AddrOffsetSectionBase);
   auto DWORangesBase = UnitDie.getRangesBaseAttribute();
   DWOCU->setRangesSection(RangeSection, DWORangesBase ? *DWORangesBase : 0);
+  if (Context.isThreadSafe())
+    DWOCU->getContext().setThreadSafe();
+  DWO = std::move(NewDWO);
   return true;
 }
 
+DWARFUnit *DWARFUnit::getDWOUnit() {
+  std::unique_lock<std::mutex> Lock(DWOLock, std::defer_lock);
+  if (Context.isThreadSafe())
+    Lock.lock();
+  parseDWO();
+  return DWO ? DWO->getUnit() : nullptr;
+}
+
 void DWARFUnit::clearDIEs(bool KeepCUDie) {
   if (DieArray.size() > (unsigned)KeepCUDie) {
     // std::vectors never get any smaller when resized to a smaller size,
@@ -355,9 +388,8 @@ DWARFUnit::getInlinedChainForAddress(uint64_t Address,
   // of inlined chain).
   DWARFDie SubprogramDIE;
   // Try to look for subprogram DIEs in the DWO file.
-  parseDWO();
-  if (DWO)
-    SubprogramDIE = DWO->getUnit()->getSubprogramForAddress(Address);
+  if (DWARFUnit *DWOCU = getDWOUnit())
+    SubprogramDIE = DWOCU->getSubprogramForAddress(Address);
   else
     SubprogramDIE = getSubprogramForAddress(Address);
 
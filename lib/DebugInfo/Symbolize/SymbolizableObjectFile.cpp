@@ -79,9 +79,23 @@ SymbolizableObjectFile::create(object::ObjectFile *Obj,
       if (auto EC = res->addCoffExportSymbols(CoffObj))
         return EC;
   }
+  res->sortSymbols();
   return std::move(res);
 }
 
+void SymbolizableObjectFile::sortSymbols() {
+  for (auto *Symbols : {&Functions, &Objects}) {
+    // Keep the first symbol added at each address, as a std::map would.
+    std::stable_sort(Symbols->begin(), Symbols->end());
+    Symbols->erase(std::unique(Symbols->begin(), Symbols->end(),
+                               [](const SymbolDesc &L, const SymbolDesc &R) {
+                                 return L.Addr == R.Addr;
+                               }),
+                   Symbols->end());
+    Symbols->shrink_to_fit();
+  }
+}
+
 SymbolizableObjectFile::SymbolizableObjectFile(ObjectFile *Obj,
                                                std::unique_ptr<DIContext> DICtx)
     : Module(Obj), DebugInfoContext(std::move(DICtx)) {}
@@ -127,8 +141,7 @@ std::error_code SymbolizableObjectFile::addCoffExportSymbols(
     uint32_t NextOffset = I != E ? I->Offset : Export.Offset + 1;
     uint64_t SymbolStart = ImageBase + Export.Offset;
     uint64_t SymbolSize = NextOffset - Export.Offset;
-    SymbolDesc SD = {SymbolStart, SymbolSize};
-    Functions.insert(std::make_pair(SD, Export.Name));
+    Functions.push_back({SymbolStart, SymbolSize, Export.Name});
   }
   return std::error_code();
 }
@@ -169,8 +182,7 @@ std::error_code SymbolizableObjectFile::addSymbol(const SymbolRef &Symbol,
   // FIXME: If a function has alias, there are two entries in symbol table
   // with same address size. Make sure we choose the correct one.
   auto &M = SymbolType == SymbolRef::ST_Function ? Functions : Objects;
-  SymbolDesc SD = { SymbolAddress, SymbolSize };
-  M.insert(std::make_pair(SD, SymbolName));
+  M.push_back({SymbolAddress, SymbolSize, SymbolName});
   return std::error_code();
 }
 
@@ -186,28 +198,64 @@ uint64_t SymbolizableObjectFile::getModulePreferredBase() const {
   return 0;
 }
 
+bool SymbolizableObjectFile::setThreadSafe() {
+  // The symbol tables are immutable once built, so the debug info context is
+  // the only part that needs to support concurrent queries.
+  if (!DebugInfoContext)
+    return true;
+  auto *DWARFCtx = dyn_cast<DWARFContext>(DebugInfoContext.get());
+  if (!DWARFCtx)
+    return false;
+  DWARFCtx->setThreadSafe();
+  return true;
+}
+
 bool SymbolizableObjectFile::getNameFromSymbolTable(SymbolRef::Type Type,
                                                     uint64_t Address,
                                                     std::string &Name,
                                                     uint64_t &Addr,
                                                     uint64_t &Size) const {
-  const auto &SymbolMap = Type == SymbolRef::ST_Function ? Functions : Objects;
-  if (SymbolMap.empty())
+  const auto &Symbols = Type == SymbolRef::ST_Function ? Functions : Objects;
+  auto Next = Symbols.begin();
+  const SymbolDesc *Symbol = findSymbol(Symbols, Next, Address);
+  if (!Symbol)
     return false;
-  SymbolDesc SD = { Address, Address };
-  auto SymbolIterator = SymbolMap.upper_bound(SD);
-  if (SymbolIterator == SymbolMap.begin())
-    return false;
-  --SymbolIterator;
-  if (SymbolIterator->first.Size != 0 &&
-      SymbolIterator->first.Addr + SymbolIterator->first.Size <= Address)
-    return false;
-  Name = SymbolIterator->second.str();
-  Addr = SymbolIterator->first.Addr;
-  Size = SymbolIterator->first.Size;
+  Name = Symbol->Name.str();
+  Addr = Symbol->Addr;
+  Size = Symbol->Size;
   return true;
 }
 
+const SymbolizableObjectFile::SymbolDesc *SymbolizableObjectFile::findSymbol(
+    const std::vector<SymbolDesc> &Symbols,
+    std::vector<SymbolDesc>::const_iterator &Next, uint64_t Address) {
+  Next = std::upper_bound(Next, Symbols.end(), Address,
+                          [](uint64_t Address, const SymbolDesc &Symbol) {
+                            return Address < Symbol.Addr;
+                          });
+  if (Next == Symbols.begin())
+    return nullptr;
+  const SymbolDesc &Symbol = *std::prev(Next);
+  if (Symbol.Size != 0 && Symbol.Addr + Symbol.Size <= Address)
+    return nullptr;
+  return &Symbol;
+}
+
+std::vector<const SymbolizableObjectFile::SymbolDesc *>
+SymbolizableObjectFile::getSymbolsFromSymbolTable(
+    SymbolRef::Type Type, ArrayRef<uint64_t> Addresses) const {
+  assert(std::is_sorted(Addresses.begin(), Addresses.end()) &&
+         "Addresses must be sorted");
+  const auto &Symbols = Type == SymbolRef::ST_Function ? Functions : Objects;
+  std::vector<const SymbolDesc *> Res(Addresses.size(), nullptr);
+  // Both sequences are sorted, so the first symbol after each address is
+  // searched from the one found for the previous address.
+  auto Next = Symbols.begin();
+  for (size_t I = 0, E = Addresses.size(); I != E; ++I)
+    Res[I] = findSymbol(Symbols, Next, Addresses[I]);
+  return Res;
+}
+
 bool SymbolizableObjectFile::shouldOverrideWithSymbolTable(
     FunctionNameKind FNKind, bool UseSymbolTable) const {
   // When DWARF is used with -gline-tables-only / -gmlt, the symbol table gives
@@ -263,6 +311,52 @@ DIInliningInfo SymbolizableObjectFile::symbolizeInlinedCode(
   return InlinedContext;
 }
 
+std::vector<DILineInfo>
+SymbolizableObjectFile::symbolizeCodeBatch(ArrayRef<uint64_t> ModuleOffsets,
+                                           FunctionNameKind FNKind,
+                                           bool UseSymbolTable) const {
+  std::vector<DILineInfo> Res(ModuleOffsets.size());
+  if (DebugInfoContext) {
+    for (size_t I = 0, E = ModuleOffsets.size(); I != E; ++I)
+      Res[I] = DebugInfoContext->getLineInfoForAddress(
+          ModuleOffsets[I], getDILineInfoSpecifier(FNKind));
+  }
+  // Override function names from symbol table if necessary.
+  if (shouldOverrideWithSymbolTable(FNKind, UseSymbolTable)) {
+    auto Symbols =
+        getSymbolsFromSymbolTable(SymbolRef::ST_Function, ModuleOffsets);
+    for (size_t I = 0, E = ModuleOffsets.size(); I != E; ++I)
+      if (Symbols[I])
+        Res[I].FunctionName = Symbols[I]->Name.str();
+  }
+  return Res;
+}
+
+std::vector<DIInliningInfo> SymbolizableObjectFile::symbolizeInlinedCodeBatch(
+    ArrayRef<uint64_t> ModuleOffsets, FunctionNameKind FNKind,
+    bool UseSymbolTable) const {
+  std::vector<DIInliningInfo> Res(ModuleOffsets.size());
+  for (size_t I = 0, E = ModuleOffsets.size(); I != E; ++I) {
+    if (DebugInfoContext)
+      Res[I] = DebugInfoContext->getInliningInfoForAddress(
+          ModuleOffsets[I], getDILineInfoSpecifier(FNKind));
+    // Make sure there is at least one frame in context.
+    if (Res[I].getNumberOfFrames() == 0)
+      Res[I].addFrame(DILineInfo());
+  }
+
+  // Override the function names in lower frames with names from symbol table.
+  if (shouldOverrideWithSymbolTable(FNKind, UseSymbolTable)) {
+    auto Symbols =
+        getSymbolsFromSymbolTable(SymbolRef::ST_Function, ModuleOffsets);
+    for (size_t I = 0, E = ModuleOffsets.size(); I != E; ++I)
+      if (Symbols[I])
+        Res[I].getMutableFrame(Res[I].getNumberOfFrames() - 1)->FunctionName =
+            Symbols[I]->Name.str();
+  }
+  return Res;
+}
+
 DIGlobal SymbolizableObjectFile::symbolizeData(uint64_t ModuleOffset) const {
   DIGlobal Res;
   getNameFromSymbolTable(SymbolRef::ST_Data, ModuleOffset, Res.Name, Res.Start,
@@ -13,15 +13,16 @@
 #ifndef LLVM_LIB_DEBUGINFO_SYMBOLIZE_SYMBOLIZABLEOBJECTFILE_H
 #define LLVM_LIB_DEBUGINFO_SYMBOLIZE_SYMBOLIZABLEOBJECTFILE_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/DebugInfo/DIContext.h"
 #include "llvm/DebugInfo/Symbolize/SymbolizableModule.h"
 #include "llvm/Support/ErrorOr.h"
 #include <cstdint>
-#include <map>
 #include <memory>
 #include <string>
 #include <system_error>
+#include <vector>
 
 namespace llvm {
 
@@ -40,6 +41,13 @@ public:
                                       FunctionNameKind FNKind,
                                       bool UseSymbolTable) const override;
   DIGlobal symbolizeData(uint64_t ModuleOffset) const override;
+  std::vector<DILineInfo>
+  symbolizeCodeBatch(ArrayRef<uint64_t> ModuleOffsets, FunctionNameKind FNKind,
+                     bool UseSymbolTable) const override;
+  std::vector<DIInliningInfo>
+  symbolizeInlinedCodeBatch(ArrayRef<uint64_t> ModuleOffsets,
+                            FunctionNameKind FNKind,
+                            bool UseSymbolTable) const override;
 
   // Return true if this is a 32-bit x86 PE COFF module.
   bool isWin32Module() const override;
@@ -48,13 +56,39 @@ public:
   // it in memory assuming there were no conflicts.
   uint64_t getModulePreferredBase() const override;
 
+  bool setThreadSafe() override;
+
 private:
   bool shouldOverrideWithSymbolTable(FunctionNameKind FNKind,
                                      bool UseSymbolTable) const;
 
+  struct SymbolDesc {
+    uint64_t Addr;
+    // If size is 0, assume that symbol occupies the whole memory range up to
+    // the following symbol.
+    uint64_t Size;
+    StringRef Name;
+
+    friend bool operator<(const SymbolDesc &s1, const SymbolDesc &s2) {
+      return s1.Addr < s2.Addr;
+    }
+  };
+
+  // Find the symbol covering Address among the sorted Symbols, searching from
+  // Next, which is left on the first symbol after Address. Returns null if no
+  // symbol covers Address.
+  static const SymbolDesc *
+  findSymbol(const std::vector<SymbolDesc> &Symbols,
+             std::vector<SymbolDesc>::const_iterator &Next, uint64_t Address);
   bool getNameFromSymbolTable(object::SymbolRef::Type Type, uint64_t Address,
                               std::string &Name, uint64_t &Addr,
                               uint64_t &Size) const;
+  // Find the symbol covering each of Addresses, which are sorted in increasing
+  // order, with a single scan of the symbol table. The result holds null for
+  // the addresses not covered by any symbol.
+  std::vector<const SymbolDesc *>
+  getSymbolsFromSymbolTable(object::SymbolRef::Type Type,
+                            ArrayRef<uint64_t> Addresses) const;
   // For big-endian PowerPC64 ELF, OpdAddress is the address of the .opd
   // (function descriptor) section and OpdExtractor refers to its contents.
   std::error_code addSymbol(const object::SymbolRef &Symbol,
@@ -66,18 +100,14 @@ private:
   object::ObjectFile *Module;
   std::unique_ptr<DIContext> DebugInfoContext;
 
-  struct SymbolDesc {
-    uint64_t Addr;
-    // If size is 0, assume that symbol occupies the whole memory range up to
-    // the following symbol.
-    uint64_t Size;
+  // The function and data symbols, sorted by address once all of them are
+  // added. Symbols are unique by address, the first one added wins.
+  std::vector<SymbolDesc> Functions;
+  std::vector<SymbolDesc> Objects;
 
-    friend bool operator<(const SymbolDesc &s1, const SymbolDesc &s2) {
-      return s1.Addr < s2.Addr;
-    }
-  };
-  std::map<SymbolDesc, StringRef> Functions;
-  std::map<SymbolDesc, StringRef> Objects;
+  // Sort and unique the symbols added by addSymbol() and
+  // addCoffExportSymbols().
+  void sortSymbols();
 
   SymbolizableObjectFile(object::ObjectFile *Obj,
                          std::unique_ptr<DIContext> DICtx);
@@ -32,6 +32,7 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
@@ -51,6 +52,52 @@
 namespace llvm {
 namespace symbolize {
 
+LLVMSymbolizer::LLVMSymbolizer(const Options &Opts) : Opts(Opts) {}
+
+LLVMSymbolizer::~LLVMSymbolizer() { flush(); }
+
+/// Returns \p ModuleOffsets made absolute if the user is giving us relative
+/// addresses. It's what DIContext expects.
+static std::vector<uint64_t>
+getAbsoluteOffsets(const SymbolizableModule &Info,
+                   ArrayRef<uint64_t> ModuleOffsets, bool RelativeAddresses) {
+  std::vector<uint64_t> Res(ModuleOffsets.begin(), ModuleOffsets.end());
+  if (RelativeAddresses) {
+    uint64_t Base = Info.getModulePreferredBase();
+    for (uint64_t &ModuleOffset : Res)
+      ModuleOffset += Base;
+  }
+  return Res;
+}
+
+std::vector<DILineInfo>
+LLVMSymbolizer::symbolizeCodeInModule(const SymbolizableModule &Info,
+                                      ArrayRef<uint64_t> ModuleOffsets) const {
+  std::vector<DILineInfo> LineInfos = Info.symbolizeCodeBatch(
+      getAbsoluteOffsets(Info, ModuleOffsets, Opts.RelativeAddresses),
+      Opts.PrintFunctions, Opts.UseSymbolTable);
+  if (Opts.Demangle)
+    for (DILineInfo &LineInfo : LineInfos)
+      LineInfo.FunctionName = DemangleName(LineInfo.FunctionName, &Info);
+  return LineInfos;
+}
+
+std::vector<DIInliningInfo> LLVMSymbolizer::symbolizeInlinedCodeInModule(
+    const SymbolizableModule &Info, ArrayRef<uint64_t> ModuleOffsets) const {
+  std::vector<DIInliningInfo> InlinedContexts = Info.symbolizeInlinedCodeBatch(
+      getAbsoluteOffsets(Info, ModuleOffsets, Opts.RelativeAddresses),
+      Opts.PrintFunctions, Opts.UseSymbolTable);
+  if (Opts.Demangle) {
+    for (DIInliningInfo &InlinedContext : InlinedContexts) {
+      for (int i = 0, n = InlinedContext.getNumberOfFrames(); i < n; i++) {
+        auto *Frame = InlinedContext.getMutableFrame(i);
+        Frame->FunctionName = DemangleName(Frame->FunctionName, &Info);
+      }
+    }
+  }
+  return InlinedContexts;
+}
+
 Expected<DILineInfo> LLVMSymbolizer::symbolizeCode(const std::string &ModuleName,
                                                   uint64_t ModuleOffset) {
   SymbolizableModule *Info;
@@ -64,15 +111,9 @@ Expected<DILineInfo> LLVMSymbolizer::symbolizeCode(const std::string &ModuleName
   if (!Info)
     return DILineInfo();
 
-  // If the user is giving us relative addresses, add the preferred base of the
-  // object to the offset before we do the query. It's what DIContext expects.
-  if (Opts.RelativeAddresses)
-    ModuleOffset += Info->getModulePreferredBase();
-
-  DILineInfo LineInfo = Info->symbolizeCode(ModuleOffset, Opts.PrintFunctions,
-                                            Opts.UseSymbolTable);
-  if (Opts.Demangle)
-    LineInfo.FunctionName = DemangleName(LineInfo.FunctionName, Info);
+  DILineInfo LineInfo =
+      std::move(symbolizeCodeInModule(*Info, ModuleOffset)[0]);
+  pruneCache();
   return LineInfo;
 }
 
@@ -90,19 +131,9 @@ LLVMSymbolizer::symbolizeInlinedCode(const std::string &ModuleName,
   if (!Info)
     return DIInliningInfo();
 
-  // If the user is giving us relative addresses, add the preferred base of the
-  // object to the offset before we do the query. It's what DIContext expects.
-  if (Opts.RelativeAddresses)
-    ModuleOffset += Info->getModulePreferredBase();
-
-  DIInliningInfo InlinedContext = Info->symbolizeInlinedCode(
-      ModuleOffset, Opts.PrintFunctions, Opts.UseSymbolTable);
-  if (Opts.Demangle) {
-    for (int i = 0, n = InlinedContext.getNumberOfFrames(); i < n; i++) {
-      auto *Frame = InlinedContext.getMutableFrame(i);
-      Frame->FunctionName = DemangleName(Frame->FunctionName, Info);
-    }
-  }
+  DIInliningInfo InlinedContext =
+      std::move(symbolizeInlinedCodeInModule(*Info, ModuleOffset)[0]);
+  pruneCache();
   return InlinedContext;
 }
 
@@ -128,14 +159,172 @@ Expected<DIGlobal> LLVMSymbolizer::symbolizeData(const std::string &ModuleName,
   DIGlobal Global = Info->symbolizeData(ModuleOffset);
   if (Opts.Demangle)
     Global.Name = DemangleName(Global.Name, Info);
+  pruneCache();
   return Global;
 }
 
+template <typename T>
+std::vector<Expected<T>> LLVMSymbolizer::symbolizeBatch(
+    ArrayRef<Request> Requests,
+    std::vector<T> (LLVMSymbolizer::*Symbolize)(const SymbolizableModule &,
+                                                ArrayRef<uint64_t>) const) {
+  // Visit the requests grouped by module and sorted by offset, so that every
+  // module is loaded once and its debug info is walked in address order. The
+  // sort is stable to report a module loading error on the first request
+  // naming the module, like the non-batch methods do.
+  std::vector<size_t> Order(Requests.size());
+  for (size_t I = 0, E = Requests.size(); I != E; ++I)
+    Order[I] = I;
+  std::stable_sort(Order.begin(), Order.end(), [&](size_t LHS, size_t RHS) {
+    const Request &L = Requests[LHS], &R = Requests[RHS];
+    int Cmp = L.ModuleName.compare(R.ModuleName);
+    return Cmp < 0 || (Cmp == 0 && L.ModuleOffset < R.ModuleOffset);
+  });
+
+  std::vector<T> Values(Requests.size());
+  std::map<size_t, Error> Errors;
+
+  for (auto GroupBegin = Order.begin(); GroupBegin != Order.end();) {
+    const std::string &ModuleName = Requests[*GroupBegin].ModuleName;
+    auto GroupEnd = std::find_if(GroupBegin, Order.end(), [&](size_t I) {
+      return Requests[I].ModuleName != ModuleName;
+    });
+
+    SymbolizableModule *Info;
+    if (auto InfoOrErr = getOrCreateModuleInfo(ModuleName)) {
+      Info = InfoOrErr.get();
+    } else {
+      size_t First = *std::min_element(GroupBegin, GroupEnd);
+      Errors.insert(std::make_pair(First, InfoOrErr.takeError()));
+      Info = nullptr;
+    }
+
+    // A null module means an error has already been reported. Leave the
+    // results empty.
+    if (Info) {
+      // Symbolize a sorted run of requests with a single query to the module.
+      auto SymbolizeChunk = [=, &Requests, &Values](
+          std::vector<size_t>::iterator ChunkBegin,
+          std::vector<size_t>::iterator ChunkEnd) {
+        std::vector<uint64_t> ModuleOffsets;
+        ModuleOffsets.reserve(ChunkEnd - ChunkBegin);
+        for (auto It = ChunkBegin; It != ChunkEnd; ++It)
+          ModuleOffsets.push_back(Requests[*It].ModuleOffset);
+        std::vector<T> ChunkValues = (this->*Symbolize)(*Info, ModuleOffsets);
+        for (auto It = ChunkBegin; It != ChunkEnd; ++It)
+          Values[*It] = std::move(ChunkValues[It - ChunkBegin]);
+      };
+
+      size_t NumRequests = GroupEnd - GroupBegin;
+      if (Opts.Threads > 1 && NumRequests > 1 && Info->setThreadSafe()) {
+        if (!Pool)
+          Pool = llvm::make_unique<ThreadPool>(Opts.Threads);
+        ThreadPoolTaskGroup Group(*Pool);
+        // Split the requests in a few chunks per thread, large enough to
+        // amortize the task overhead.
+        size_t ChunkSize =
+            std::max<size_t>(16, NumRequests / (4 * Opts.Threads));
+        for (auto ChunkBegin = GroupBegin; ChunkBegin < GroupEnd;) {
+          auto ChunkEnd = ChunkBegin + std::min<size_t>(
+                                           ChunkSize, GroupEnd - ChunkBegin);
+          Group.async(SymbolizeChunk, ChunkBegin, ChunkEnd);
+          ChunkBegin = ChunkEnd;
+        }
+        Group.wait();
+      } else {
+        SymbolizeChunk(GroupBegin, GroupEnd);
+      }
+    }
+
+    pruneCache();
+    GroupBegin = GroupEnd;
+  }
+
+  std::vector<Expected<T>> Results;
+  Results.reserve(Requests.size());
+  for (size_t I = 0, E = Requests.size(); I != E; ++I) {
+    auto ErrI = Errors.find(I);
+    if (ErrI != Errors.end())
+      Results.push_back(std::move(ErrI->second));
+    else
+      Results.push_back(std::move(Values[I]));
+  }
+  return Results;
+}
+
+std::vector<Expected<DILineInfo>>
+LLVMSymbolizer::symbolizeCodeBatch(ArrayRef<Request> Requests) {
+  return symbolizeBatch(Requests, &LLVMSymbolizer::symbolizeCodeInModule);
+}
+
+std::vector<Expected<DIInliningInfo>>
+LLVMSymbolizer::symbolizeInlinedCodeBatch(ArrayRef<Request> Requests) {
+  return symbolizeBatch(Requests,
+                        &LLVMSymbolizer::symbolizeInlinedCodeInModule);
+}
+
 void LLVMSymbolizer::flush() {
   ObjectForUBPathAndArch.clear();
   BinaryForPath.clear();
+  LRUBinaries.clear();
+  CacheSize = 0;
   ObjectPairForPathArch.clear();
   Modules.clear();
+  ModuleBinaries.clear();
+}
+
+void LLVMSymbolizer::recordAccess(const std::string &Path) {
+  auto I = BinaryForPath.find(Path);
+  if (I == BinaryForPath.end() || !I->second.Bin.getBinary())
+    return;
+  LRUBinaries.splice(LRUBinaries.begin(), LRUBinaries, I->second.LRUPosition);
+}
+
+void LLVMSymbolizer::evictBinary(const std::string &Path) {
+  // Modules and object pairs refer to the object files by pointer, drop every
+  // entry built from this binary before freeing it. Entries recording an
+  // error are kept, they don't own anything.
+  for (auto I = Modules.begin(), E = Modules.end(); I != E;) {
+    auto BI = ModuleBinaries.find(I->first);
+    if (BI != ModuleBinaries.end() && is_contained(BI->second, Path)) {
+      ModuleBinaries.erase(BI);
+      I = Modules.erase(I);
+    } else {
+      ++I;
+    }
+  }
+  for (auto I = ObjectPairForPathArch.begin(), E = ObjectPairForPathArch.end();
+       I != E;) {
+    const ObjectPair &Objects = I->second;
+    if ((Objects.first && Objects.first->getFileName() == Path) ||
+        (Objects.second && Objects.second->getFileName() == Path))
+      I = ObjectPairForPathArch.erase(I);
+    else
+      ++I;
+  }
+  for (auto I = ObjectForUBPathAndArch.begin(),
+            E = ObjectForUBPathAndArch.end();
+       I != E;) {
+    if (I->first.first == Path)
+      I = ObjectForUBPathAndArch.erase(I);
+    else
+      ++I;
+  }
+
+  auto I = BinaryForPath.find(Path);
+  assert(I != BinaryForPath.end() && I->second.Bin.getBinary());
+  CacheSize -= I->second.Size;
+  LRUBinaries.erase(I->second.LRUPosition);
+  BinaryForPath.erase(I);
+}
+
+void LLVMSymbolizer::pruneCache() {
+  if (!Opts.MaxCacheSize)
+    return;
+  while (CacheSize > Opts.MaxCacheSize && LRUBinaries.size() > 1) {
+    std::string Path = LRUBinaries.back();
+    evictBinary(Path);
+  }
 }
 
 namespace {
@@ -292,6 +481,10 @@ LLVMSymbolizer::getOrCreateObjectPair(const std::string &Path,
                                       const std::string &ArchName) {
   const auto &I = ObjectPairForPathArch.find(std::make_pair(Path, ArchName));
   if (I != ObjectPairForPathArch.end()) {
+    if (I->second.second)
+      recordAccess(I->second.second->getFileName());
+    if (I->second.first)
+      recordAccess(I->second.first->getFileName());
     return I->second;
   }
 
@@ -326,13 +519,19 @@ LLVMSymbolizer::getOrCreateObject(const std::string &Path,
   if (I == BinaryForPath.end()) {
     Expected<OwningBinary<Binary>> BinOrErr = createBinary(Path);
     if (!BinOrErr) {
-      BinaryForPath.insert(std::make_pair(Path, OwningBinary<Binary>()));
+      BinaryForPath.insert(std::make_pair(Path, CachedBinary()));
       return BinOrErr.takeError();
     }
     Bin = BinOrErr->getBinary();
-    BinaryForPath.insert(std::make_pair(Path, std::move(BinOrErr.get())));
+    CachedBinary &Cached = BinaryForPath[Path];
+    Cached.Size = Bin->getData().size();
+    Cached.Bin = std::move(BinOrErr.get());
+    LRUBinaries.push_front(Path);
+    Cached.LRUPosition = LRUBinaries.begin();
+    CacheSize += Cached.Size;
   } else {
-    Bin = I->second.getBinary();
+    Bin = I->second.Bin.getBinary();
+    recordAccess(Path);
   }
 
   if (!Bin)
@@ -365,6 +564,10 @@ Expected<SymbolizableModule *>
 LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName) {
   const auto &I = Modules.find(ModuleName);
   if (I != Modules.end()) {
+    auto BI = ModuleBinaries.find(ModuleName);
+    if (BI != ModuleBinaries.end())
+      for (const std::string &Path : BI->second)
+        recordAccess(Path);
     return I->second.get();
   }
   std::string BinaryName = ModuleName;
@@ -386,6 +589,8 @@ LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName) {
     return ObjectsOrErr.takeError();
   }
   ObjectPair Objects = ObjectsOrErr.get();
+  ModuleBinaries[ModuleName] = {Objects.first->getFileName(),
+                                Objects.second->getFileName()};
 
   std::unique_ptr<DIContext> Context;
   // If this is a COFF object containing PDB info, use a PDBContext to
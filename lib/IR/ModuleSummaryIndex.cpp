@@ -52,7 +52,15 @@ void ModuleSummaryIndex::mergeFrom(std::unique_ptr<ModuleSummaryIndex> Other,
   }
 }
 
+void ModuleSummaryIndex::buildGUIDTable() {
+  GUIDTable.clear();
+  GUIDTable.reserve(GlobalValueMap.size());
+  for (auto I = GlobalValueMap.cbegin(), E = GlobalValueMap.cend(); I != E; ++I)
+    GUIDTable.insert({I->first, I});
+}
+
 void ModuleSummaryIndex::removeEmptySummaryEntries() {
+  GUIDTable.clear();
   for (auto MI = begin(), MIE = end(); MI != MIE;) {
     // Only expect this to be called on a per-module index, which has a single
     // entry per value entry list.
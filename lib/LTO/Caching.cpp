@@ -13,10 +13,16 @@
 
 #include "llvm/LTO/Caching.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Support/raw_ostream.h"
+#include <mutex>
 
 using namespace llvm;
 using namespace llvm::lto;
@@ -46,13 +52,259 @@ static void commitEntry(StringRef TempFilename, StringRef EntryPath) {
   }
 }
 
+/// Let the pruning of the cache know that the entry at \p EntryPath was used.
+static void recordAccess(StringRef CacheDirectoryPath, StringRef EntryPath) {
+  uint64_t Size;
+  if (!sys::fs::file_size(EntryPath, Size))
+    CachePruning::recordAccess(CacheDirectoryPath, EntryPath, Size);
+}
+
+/// Write the concatenation of \p Parts to a temporary file of the cache
+/// directory, and rename it to \p Path, so that a concurrent reader never sees
+/// a partial file.
+static void writeEntry(StringRef CacheDirectoryPath, StringRef Path,
+                       ArrayRef<StringRef> Parts) {
+  SmallString<64> Model;
+  sys::path::append(Model, CacheDirectoryPath, "Thin-%%%%%%.tmp");
+  int TempFD;
+  SmallString<64> TempFilename;
+  if (auto EC = sys::fs::createUniqueFile(Model, TempFD, TempFilename))
+    report_fatal_error(Twine("Failed to create a temporary file in ") +
+                       CacheDirectoryPath + ": " + EC.message() + "\n");
+  {
+    raw_fd_ostream OS(TempFD, /* ShouldClose */ true);
+    for (StringRef Part : Parts)
+      OS << Part;
+  }
+  if (auto EC = sys::fs::rename(TempFilename, Path)) {
+    sys::fs::remove(TempFilename);
+    report_fatal_error(Twine("Failed to rename ") + TempFilename + " to " +
+                       Path + ": " + EC.message() + "\n");
+  }
+}
+
+namespace {
+/// The content-addressed store of a cache directory.
+///
+/// Each distinct object file is stored once, as a blob named "blob-<SHA1 of
+/// the object>". Without compression, the entry of a cache key is a hard link
+/// to its blob, so a hit is a plain file of the directory as before. With
+/// compression, the blob is named "blob-<SHA1>.z" and holds the size of the
+/// object as a 64-bit little-endian integer followed by the zlib-compressed
+/// object, and the entry of a key is a file named "<key>.link" holding the
+/// name of its blob.
+///
+/// Blobs are written before the entries linking to them, and every file is
+/// written under a temporary name and renamed in place, so that concurrent
+/// links only ever see complete files. An entry whose blob was pruned is
+/// treated as a miss.
+class ContentStore {
+  std::string CacheDirectoryPath;
+  bool Compress;
+
+  /// The decompressed objects passed to the file callback, removed when the
+  /// cache is destroyed.
+  std::mutex TempFilesMutex;
+  std::vector<std::string> TempFiles;
+
+  static const char BlobPrefix[];
+  static const char CompressedBlobSuffix[];
+
+public:
+  static const char LinkSuffix[];
+
+  ContentStore(StringRef CacheDirectoryPath, bool Compress)
+      : CacheDirectoryPath(CacheDirectoryPath), Compress(Compress) {}
+
+  ~ContentStore() {
+    for (const std::string &TempFile : TempFiles)
+      sys::fs::remove(TempFile);
+  }
+
+  /// Returns the path of the object file stored for the entry at
+  /// \p EntryPath, or an empty string if there is none.
+  std::string load(StringRef EntryPath);
+
+  /// Store the object file at \p TempFilename for the entry at \p EntryPath,
+  /// and return the path of the object to pass to the file callback.
+  std::string commit(StringRef TempFilename, StringRef EntryPath);
+
+private:
+  std::string getBlobName(StringRef Object) const {
+    SHA1 Hasher;
+    Hasher.update(Object);
+    std::string Name = BlobPrefix + toHex(Hasher.result());
+    if (Compress)
+      Name += CompressedBlobSuffix;
+    return Name;
+  }
+
+  void addTempFile(std::string Path) {
+    std::lock_guard<std::mutex> Lock(TempFilesMutex);
+    TempFiles.push_back(std::move(Path));
+  }
+};
+} // end anonymous namespace
+
+const char ContentStore::BlobPrefix[] = "blob-";
+const char ContentStore::CompressedBlobSuffix[] = ".z";
+const char ContentStore::LinkSuffix[] = ".link";
+
+std::string ContentStore::load(StringRef EntryPath) {
+  if (!Compress) {
+    if (!sys::fs::exists(EntryPath))
+      return std::string();
+    // The entry is a link to its blob: keep the blob as recently used as the
+    // entry, or the pruning evicts the blob first, which frees nothing.
+    if (CachePruning::isRecordingAccesses(CacheDirectoryPath)) {
+      if (auto ObjectOrErr = MemoryBuffer::getFile(EntryPath)) {
+        SmallString<64> BlobPath;
+        sys::path::append(BlobPath, CacheDirectoryPath,
+                          getBlobName((*ObjectOrErr)->getBuffer()));
+        recordAccess(CacheDirectoryPath, BlobPath);
+      }
+    }
+    recordAccess(CacheDirectoryPath, EntryPath);
+    return EntryPath;
+  }
+
+  auto LinkOrErr = MemoryBuffer::getFile(EntryPath);
+  if (!LinkOrErr)
+    return std::string();
+  StringRef BlobName = (*LinkOrErr)->getBuffer();
+  if (!BlobName.startswith(BlobPrefix) ||
+      !BlobName.endswith(CompressedBlobSuffix) ||
+      sys::path::filename(BlobName) != BlobName)
+    return std::string();
+  SmallString<64> BlobPath;
+  sys::path::append(BlobPath, CacheDirectoryPath, BlobName);
+  auto BlobOrErr = MemoryBuffer::getFile(BlobPath);
+  if (!BlobOrErr)
+    return std::string();
+
+  StringRef Blob = (*BlobOrErr)->getBuffer();
+  if (Blob.size() < sizeof(uint64_t))
+    return std::string();
+  uint64_t Size = support::endian::read64le(Blob.data());
+  SmallVector<char, 0> Object;
+  if (Error E = zlib::uncompress(Blob.drop_front(sizeof(uint64_t)), Object,
+                                 Size)) {
+    consumeError(std::move(E));
+    return std::string();
+  }
+
+  int TempFD;
+  SmallString<64> TempFilename;
+  if (auto EC =
+          sys::fs::createTemporaryFile("Thin", "tmp.o", TempFD, TempFilename))
+    report_fatal_error(Twine("ThinLTO: Can't get a temporary file: ") +
+                       EC.message() + "\n");
+  {
+    raw_fd_ostream OS(TempFD, /* ShouldClose */ true);
+    OS << StringRef(Object.data(), Object.size());
+  }
+  addTempFile(TempFilename.str());
+  recordAccess(CacheDirectoryPath, BlobPath);
+  recordAccess(CacheDirectoryPath, EntryPath);
+  return TempFilename.str();
+}
+
+std::string ContentStore::commit(StringRef TempFilename, StringRef EntryPath) {
+  auto ObjectOrErr = MemoryBuffer::getFile(TempFilename);
+  if (auto EC = ObjectOrErr.getError())
+    report_fatal_error(Twine("Failed to open temp file '") + TempFilename +
+                       "': " + EC.message() + "\n");
+  StringRef Object = (*ObjectOrErr)->getBuffer();
+  std::string BlobName = getBlobName(Object);
+  SmallString<64> BlobPath;
+  sys::path::append(BlobPath, CacheDirectoryPath, BlobName);
+
+  if (!Compress) {
+    // Another link may have stored the same object already, in which case the
+    // blob can be shared as is.
+    if (sys::fs::exists(BlobPath))
+      sys::fs::remove(TempFilename);
+    else
+      commitEntry(TempFilename, BlobPath);
+    recordAccess(CacheDirectoryPath, BlobPath);
+
+    // An existing entry for this key is either a link to the same blob, or a
+    // copy of it.
+    std::error_code EC = sys::fs::create_hard_link(BlobPath, EntryPath);
+    if (EC && EC != errc::file_exists)
+      // The file system doesn't support hard links, store a copy instead.
+      writeEntry(CacheDirectoryPath, EntryPath, Object);
+    recordAccess(CacheDirectoryPath, EntryPath);
+    return EntryPath;
+  }
+
+  if (!sys::fs::exists(BlobPath)) {
+    SmallVector<char, 0> Compressed;
+    if (Error E = zlib::compress(Object, Compressed))
+      report_fatal_error(Twine("Failed to compress ") + TempFilename + ": " +
+                         toString(std::move(E)) + "\n");
+    char Size[sizeof(uint64_t)];
+    support::endian::write64le(Size, Object.size());
+    writeEntry(CacheDirectoryPath, BlobPath,
+               {StringRef(Size, sizeof(Size)),
+                StringRef(Compressed.data(), Compressed.size())});
+  }
+  recordAccess(CacheDirectoryPath, BlobPath);
+  writeEntry(CacheDirectoryPath, EntryPath, StringRef(BlobName));
+  recordAccess(CacheDirectoryPath, EntryPath);
+
+  // The link gets the object as it was produced.
+  addTempFile(TempFilename);
+  return TempFilename;
+}
+
+namespace {
+/// Prunes the cache directory when the last copy of the cache is destroyed.
+class CachePruner {
+  CachePruning Pruning;
+
+public:
+  CachePruner(CachePruning Pruning) : Pruning(std::move(Pruning)) {}
+  ~CachePruner() { Pruning.prune(); }
+};
+} // end anonymous namespace
+
 NativeObjectCache lto::localCache(StringRef CacheDirectoryPath,
-                                  AddFileFn AddFile) {
+                                  AddFileFn AddFile,
+                                  LocalCacheOptions Options) {
+  std::shared_ptr<CachePruner> Pruner;
+  if (Options.MaxSizeBytes || Options.MaxSizeFiles)
+    Pruner = std::make_shared<CachePruner>(
+        CachePruning(CacheDirectoryPath)
+            .setPruningInterval(Options.PruningInterval)
+            .setMaxSizeBytes(Options.MaxSizeBytes)
+            .setMaxEntries(Options.MaxSizeFiles)
+            .setUseManifest(true));
+
+  std::shared_ptr<ContentStore> Store;
+  if (Options.Compress && !zlib::isAvailable())
+    Options.Compress = false;
+  if (Options.ContentAddressed || Options.Compress)
+    Store = std::make_shared<ContentStore>(CacheDirectoryPath,
+                                           Options.Compress);
+
   return [=](unsigned Task, StringRef Key) -> AddStreamFn {
+    // Every copy of the cache keeps the pruner alive.
+    (void)Pruner;
+
     // First, see if we have a cache hit.
     SmallString<64> EntryPath;
     sys::path::append(EntryPath, CacheDirectoryPath, Key);
-    if (sys::fs::exists(EntryPath)) {
+    if (Options.Compress)
+      EntryPath += ContentStore::LinkSuffix;
+    if (Store) {
+      std::string ObjectPath = Store->load(EntryPath);
+      if (!ObjectPath.empty()) {
+        AddFile(Task, ObjectPath);
+        return AddStreamFn();
+      }
+    } else if (sys::fs::exists(EntryPath)) {
+      recordAccess(CacheDirectoryPath, EntryPath);
       AddFile(Task, EntryPath);
       return AddStreamFn();
     }
@@ -61,21 +313,31 @@ NativeObjectCache lto::localCache(StringRef CacheDirectoryPath,
     // file to the cache and calling AddFile to add it to the link.
     struct CacheStream : NativeObjectStream {
       AddFileFn AddFile;
+      std::shared_ptr<ContentStore> Store;
+      std::string CacheDirectoryPath;
       std::string TempFilename;
       std::string EntryPath;
       unsigned Task;
 
       CacheStream(std::unique_ptr<raw_pwrite_stream> OS, AddFileFn AddFile,
-                  std::string TempFilename, std::string EntryPath,
-                  unsigned Task)
+                  std::shared_ptr<ContentStore> Store,
+                  std::string CacheDirectoryPath, std::string TempFilename,
+                  std::string EntryPath, unsigned Task)
           : NativeObjectStream(std::move(OS)), AddFile(std::move(AddFile)),
+            Store(std::move(Store)),
+            CacheDirectoryPath(std::move(CacheDirectoryPath)),
             TempFilename(std::move(TempFilename)),
             EntryPath(std::move(EntryPath)), Task(Task) {}
 
       ~CacheStream() {
         // Make sure the file is closed before committing it.
         OS.reset();
+        if (Store) {
+          AddFile(Task, Store->commit(TempFilename, EntryPath));
+          return;
+        }
         commitEntry(TempFilename, EntryPath);
+        recordAccess(CacheDirectoryPath, EntryPath);
         AddFile(Task, EntryPath);
       }
     };
@@ -94,7 +356,8 @@ NativeObjectCache lto::localCache(StringRef CacheDirectoryPath,
       // This CacheStream will move the temporary file into the cache when done.
       return llvm::make_unique<CacheStream>(
           llvm::make_unique<raw_fd_ostream>(TempFD, /* ShouldClose */ true),
-          AddFile, TempFilename.str(), EntryPath.str(), Task);
+          AddFile, Store, CacheDirectoryPath, TempFilename.str(),
+          EntryPath.str(), Task);
     };
   };
 }
@@ -16,20 +16,20 @@
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
-#include "llvm/CodeGen/Analysis.h"
-#include "llvm/CodeGen/TargetLoweringObjectFileImpl.h"
 #include "llvm/IR/AutoUpgrade.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/LegacyPassManager.h"
-#include "llvm/IR/Mangler.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/LTO/LTOBackend.h"
 #include "llvm/Linker/IRMover.h"
+#include "llvm/Object/IRObjectFile.h"
 #include "llvm/Object/ModuleSummaryIndexObjectFile.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/LineIterator.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
 #include "llvm/Support/SHA1.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetRegistry.h"
@@ -222,15 +222,7 @@ void llvm::thinLTOInternalizeAndPromoteInIndex(
     thinLTOInternalizeAndPromoteGUID(I.second, I.first, isExported);
 }
 
-struct InputFile::InputModule {
-  BitcodeModule BM;
-  std::unique_ptr<Module> Mod;
-
-  // The range of ModuleSymbolTable entries for this input module.
-  size_t SymBegin, SymEnd;
-};
-
-// Requires a destructor for std::vector<InputModule>.
+// Requires a destructor for std::vector<Symbol>.
 InputFile::~InputFile() = default;
 
 Expected<std::unique_ptr<InputFile>> InputFile::create(MemoryBufferRef Object) {
@@ -241,96 +233,37 @@ Expected<std::unique_ptr<InputFile>> InputFile::create(MemoryBufferRef Object) {
   if (!BCOrErr)
     return errorCodeToError(BCOrErr.getError());
 
-  Expected<std::vector<BitcodeModule>> BMsOrErr =
-      getBitcodeModuleList(*BCOrErr);
-  if (!BMsOrErr)
-    return BMsOrErr.takeError();
+  Expected<irsymtab::FileContents> FCOrErr = irsymtab::readBitcode(*BCOrErr);
+  if (!FCOrErr)
+    return FCOrErr.takeError();
 
-  if (BMsOrErr->empty())
-    return make_error<StringError>("Bitcode file does not contain any modules",
-                                   inconvertibleErrorCode());
+  File->Mods = std::move(FCOrErr->Mods);
+  File->Symtab = std::move(FCOrErr->OwnedSymtab);
+  const irsymtab::Reader &R = FCOrErr->TheReader;
 
-  // Create an InputModule for each module in the InputFile, and add it to the
-  // ModuleSymbolTable.
-  for (auto BM : *BMsOrErr) {
-    Expected<std::unique_ptr<Module>> MOrErr =
-        BM.getLazyModule(File->Ctx, /*ShouldLazyLoadMetadata*/ true,
-                         /*IsImporting*/ false);
-    if (!MOrErr)
-      return MOrErr.takeError();
-
-    size_t SymBegin = File->SymTab.symbols().size();
-    File->SymTab.addModule(MOrErr->get());
-    size_t SymEnd = File->SymTab.symbols().size();
-
-    for (const auto &C : (*MOrErr)->getComdatSymbolTable()) {
-      auto P = File->ComdatMap.insert(
-          std::make_pair(&C.second, File->Comdats.size()));
-      assert(P.second);
-      (void)P;
-      File->Comdats.push_back(C.first());
-    }
+  File->TargetTriple = R.getTargetTriple();
+  File->SourceFileName = R.getSourceFileName();
+  File->COFFLinkerOpts = R.getCOFFLinkerOpts();
+  File->ComdatTable = R.getComdatTable();
 
-    File->Mods.push_back({BM, std::move(*MOrErr), SymBegin, SymEnd});
-  }
+  for (size_t I = 0, E = R.getNumSymbols(); I != E; ++I)
+    File->Symbols.push_back(R.getSymbol(I));
+
+  for (unsigned I = 0; I != R.getNumModules(); ++I)
+    File->ModuleSymIndices.push_back(R.getModuleSymbols(I));
 
   return std::move(File);
 }
 
 Expected<int> InputFile::Symbol::getComdatIndex() const {
-  if (!isGV())
-    return -1;
-  const GlobalObject *GO = getGV()->getBaseObject();
-  if (!GO)
+  if (ComdatIndex == -2)
     return make_error<StringError>("Unable to determine comdat of alias!",
                                    inconvertibleErrorCode());
-  if (const Comdat *C = GO->getComdat()) {
-    auto I = File->ComdatMap.find(C);
-    assert(I != File->ComdatMap.end());
-    return I->second;
-  }
-  return -1;
-}
-
-Expected<std::string> InputFile::getLinkerOpts() {
-  std::string LinkerOpts;
-  raw_string_ostream LOS(LinkerOpts);
-  // Extract linker options from module metadata.
-  for (InputModule &Mod : Mods) {
-    std::unique_ptr<Module> &M = Mod.Mod;
-    if (auto E = M->materializeMetadata())
-      return std::move(E);
-    if (Metadata *Val = M->getModuleFlag("Linker Options")) {
-      MDNode *LinkerOptions = cast<MDNode>(Val);
-      for (const MDOperand &MDOptions : LinkerOptions->operands())
-        for (const MDOperand &MDOption : cast<MDNode>(MDOptions)->operands())
-          LOS << " " << cast<MDString>(MDOption)->getString();
-    }
-  }
-
-  // Synthesize export flags for symbols with dllexport storage.
-  const Triple TT(Mods[0].Mod->getTargetTriple());
-  Mangler M;
-  for (const ModuleSymbolTable::Symbol &Sym : SymTab.symbols())
-    if (auto *GV = Sym.dyn_cast<GlobalValue*>())
-      emitLinkerFlagsForGlobalCOFF(LOS, GV, TT, M);
-  LOS.flush();
-  return LinkerOpts;
+  return ComdatIndex;
 }
 
 StringRef InputFile::getName() const {
-  return Mods[0].BM.getModuleIdentifier();
-}
-
-StringRef InputFile::getSourceFileName() const {
-  return Mods[0].Mod->getSourceFileName();
-}
-
-iterator_range<InputFile::symbol_iterator>
-InputFile::module_symbols(InputModule &IM) {
-  return llvm::make_range(
-      symbol_iterator(SymTab.symbols().data() + IM.SymBegin, SymTab, this),
-      symbol_iterator(SymTab.symbols().data() + IM.SymEnd, SymTab, this));
+  return Mods[0].getModuleIdentifier();
 }
 
 LTO::RegularLTOState::RegularLTOState(unsigned ParallelCodeGenParallelismLevel,
@@ -354,21 +287,18 @@ LTO::LTO(Config Conf, ThinBackend Backend,
 LTO::~LTO() = default;
 
 // Add the given symbol to the GlobalResolutions map, and resolve its partition.
-void LTO::addSymbolToGlobalRes(SmallPtrSet<GlobalValue *, 8> &Used,
-                               const InputFile::Symbol &Sym,
+void LTO::addSymbolToGlobalRes(const InputFile::Symbol &Sym,
                                SymbolResolution Res, unsigned Partition) {
-  GlobalValue *GV = Sym.isGV() ? Sym.getGV() : nullptr;
-
   auto &GlobalRes = GlobalResolutions[Sym.getName()];
-  if (GV) {
-    GlobalRes.UnnamedAddr &= GV->hasGlobalUnnamedAddr();
+  if (Sym.isGV()) {
+    GlobalRes.UnnamedAddr &= Sym.hasGlobalUnnamedAddr();
     if (Res.Prevailing)
-      GlobalRes.IRName = GV->getName();
+      GlobalRes.IRName = Sym.getIRName();
   }
   // Set the partition to external if we know it is used elsewhere, e.g.
   // it is visible to a regular object, is referenced from llvm.compiler_used,
   // or was already recorded as being referenced from a different partition.
-  if (Res.VisibleToRegularObj || (GV && Used.count(GV)) ||
+  if (Res.VisibleToRegularObj || Sym.isUsed() ||
       (GlobalRes.Partition != GlobalResolution::Unknown &&
        GlobalRes.Partition != Partition)) {
     GlobalRes.Partition = GlobalResolution::External;
@@ -412,41 +342,31 @@ Error LTO::add(std::unique_ptr<InputFile> Input,
     writeToResolutionFile(*Conf.ResolutionFile, Input.get(), Res);
 
   const SymbolResolution *ResI = Res.begin();
-  for (InputFile::InputModule &IM : Input->Mods)
-    if (Error Err = addModule(*Input, IM, ResI, Res.end()))
+  for (unsigned I = 0; I != Input->Mods.size(); ++I)
+    if (Error Err = addModule(*Input, I, ResI, Res.end()))
       return Err;
 
   assert(ResI == Res.end());
   return Error::success();
 }
 
-Error LTO::addModule(InputFile &Input, InputFile::InputModule &IM,
+Error LTO::addModule(InputFile &Input, unsigned ModI,
                      const SymbolResolution *&ResI,
                      const SymbolResolution *ResE) {
-  // FIXME: move to backend
-  Module &M = *IM.Mod;
-
-  if (M.getDataLayoutStr().empty())
-    return make_error<StringError>("input module has no datalayout",
-                                    inconvertibleErrorCode());
-
-  if (!Conf.OverrideTriple.empty())
-    M.setTargetTriple(Conf.OverrideTriple);
-  else if (M.getTargetTriple().empty())
-    M.setTargetTriple(Conf.DefaultTriple);
-
-  Expected<bool> HasThinLTOSummary = IM.BM.hasSummary();
+  BitcodeModule BM = Input.Mods[ModI];
+  Expected<bool> HasThinLTOSummary = BM.hasSummary();
   if (!HasThinLTOSummary)
     return HasThinLTOSummary.takeError();
 
   if (*HasThinLTOSummary)
-    return addThinLTO(IM.BM, M, Input.module_symbols(IM), ResI, ResE);
+    return addThinLTO(BM, Input.module_symbols(ModI), ResI, ResE);
   else
-    return addRegularLTO(IM.BM, ResI, ResE);
+    return addRegularLTO(BM, Input.module_symbols(ModI), ResI, ResE);
 }
 
 // Add a regular LTO object to the link.
-Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
+Error LTO::addRegularLTO(BitcodeModule BM, ArrayRef<InputFile::Symbol> Syms,
+                         const SymbolResolution *&ResI,
                          const SymbolResolution *ResE) {
   if (!RegularLTO.CombinedModule) {
     RegularLTO.CombinedModule =
@@ -460,6 +380,15 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
     return MOrErr.takeError();
 
   Module &M = **MOrErr;
+  if (M.getDataLayoutStr().empty())
+    return make_error<StringError>("input module has no datalayout",
+                                   inconvertibleErrorCode());
+
+  if (!Conf.OverrideTriple.empty())
+    M.setTargetTriple(Conf.OverrideTriple);
+  else if (M.getTargetTriple().empty())
+    M.setTargetTriple(Conf.DefaultTriple);
+
   if (Error Err = M.materializeMetadata())
     return Err;
   UpgradeDebugInfo(M);
@@ -467,9 +396,6 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
   ModuleSymbolTable SymTab;
   SymTab.addModule(&M);
 
-  SmallPtrSet<GlobalValue *, 8> Used;
-  collectUsedGlobalVariables(M, Used, /*CompilerUsed*/ false);
-
   std::vector<GlobalValue *> Keep;
 
   for (GlobalVariable &GV : M.globals())
@@ -481,17 +407,43 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
     if (GlobalObject *GO = GA.getBaseObject())
       AliasedGlobals.insert(GO);
 
-  for (const InputFile::Symbol &Sym :
-       make_range(InputFile::symbol_iterator(SymTab.symbols().begin(), SymTab,
-                                             nullptr),
-                  InputFile::symbol_iterator(SymTab.symbols().end(), SymTab,
-                                             nullptr))) {
+  // The symbol table lists the global values of the module in the order of the
+  // ModuleSymbolTable, followed by the module asm symbols. Walk both in
+  // lockstep to find the global value of each symbol.
+  ArrayRef<ModuleSymbolTable::Symbol> Msyms = SymTab.symbols();
+  auto MsymI = Msyms.begin(), MsymE = Msyms.end();
+  auto SkipToNextGV = [&]() {
+    for (; MsymI != MsymE; ++MsymI) {
+      if (!MsymI->is<GlobalValue *>())
+        continue;
+      uint32_t Flags = SymTab.getSymbolFlags(*MsymI);
+      if ((Flags & object::BasicSymbolRef::SF_Global) &&
+          !(Flags & object::BasicSymbolRef::SF_FormatSpecific))
+        return;
+    }
+  };
+  SkipToNextGV();
+  auto MismatchError = [&]() {
+    return make_error<StringError>(
+        "bitcode symbol table does not match module " +
+            BM.getModuleIdentifier(),
+        inconvertibleErrorCode());
+  };
+
+  for (const InputFile::Symbol &Sym : Syms) {
     assert(ResI != ResE);
     SymbolResolution Res = *ResI++;
-    addSymbolToGlobalRes(Used, Sym, Res, 0);
+    addSymbolToGlobalRes(Sym, Res, 0);
 
     if (Sym.isGV()) {
-      GlobalValue *GV = Sym.getGV();
+      if (MsymI == MsymE)
+        return MismatchError();
+      GlobalValue *GV = MsymI->get<GlobalValue *>();
+      if (GV->getName() != Sym.getIRName())
+        return MismatchError();
+      ++MsymI;
+      SkipToNextGV();
+
       if (Res.Prevailing) {
         if (Sym.getFlags() & object::BasicSymbolRef::SF_Undefined)
           continue;
@@ -529,7 +481,7 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
     if (Sym.getFlags() & object::BasicSymbolRef::SF_Common) {
       // FIXME: We should figure out what to do about commons defined by asm.
       // For now they aren't reported correctly by ModuleSymbolTable.
-      auto &CommonRes = RegularLTO.Commons[Sym.getGV()->getName()];
+      auto &CommonRes = RegularLTO.Commons[Sym.getIRName()];
       CommonRes.Size = std::max(CommonRes.Size, Sym.getCommonSize());
       CommonRes.Align = std::max(CommonRes.Align, Sym.getCommonAlignment());
       CommonRes.Prevailing |= Res.Prevailing;
@@ -537,6 +489,8 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
 
     // FIXME: use proposed local attribute for FinalDefinitionInLinkageUnit.
   }
+  if (MsymI != MsymE)
+    return MismatchError();
 
   return RegularLTO.Mover->move(std::move(*MOrErr), Keep,
                                 [](GlobalValue &, IRMover::ValueAdder) {},
@@ -544,28 +498,22 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
 }
 
 // Add a ThinLTO object to the link.
-// FIXME: This function should not need to take as many parameters once we have
-// a bitcode symbol table.
-Error LTO::addThinLTO(BitcodeModule BM, Module &M,
-                      iterator_range<InputFile::symbol_iterator> Syms,
+Error LTO::addThinLTO(BitcodeModule BM, ArrayRef<InputFile::Symbol> Syms,
                       const SymbolResolution *&ResI,
                       const SymbolResolution *ResE) {
-  SmallPtrSet<GlobalValue *, 8> Used;
-  collectUsedGlobalVariables(M, Used, /*CompilerUsed*/ false);
-
-  Expected<std::unique_ptr<ModuleSummaryIndex>> SummaryOrErr = BM.getSummary();
-  if (!SummaryOrErr)
-    return SummaryOrErr.takeError();
-  ThinLTO.CombinedIndex.mergeFrom(std::move(*SummaryOrErr),
-                                  ThinLTO.ModuleMap.size());
-
+  // The summary is read by readThinLTOSummaries, together with the ones of
+  // the other modules.
   for (const InputFile::Symbol &Sym : Syms) {
     assert(ResI != ResE);
     SymbolResolution Res = *ResI++;
-    addSymbolToGlobalRes(Used, Sym, Res, ThinLTO.ModuleMap.size() + 1);
+    addSymbolToGlobalRes(Sym, Res, ThinLTO.ModuleMap.size() + 1);
 
+    // The symbols of the table are not local, so their GUID only depends on
+    // their name.
     if (Res.Prevailing && Sym.isGV())
-      ThinLTO.PrevailingModuleForGUID[Sym.getGV()->getGUID()] =
+      ThinLTO.PrevailingModuleForGUID[GlobalValue::getGUID(
+          GlobalValue::getGlobalIdentifier(Sym.getIRName(),
+                                           GlobalValue::ExternalLinkage, ""))] =
           BM.getModuleIdentifier();
   }
 
@@ -582,7 +530,49 @@ unsigned LTO::getMaxTasks() const {
   return RegularLTO.ParallelCodeGenParallelismLevel + ThinLTO.ModuleMap.size();
 }
 
+Error LTO::readThinLTOSummaries() {
+  // The summaries do not depend on each other, so they are read in parallel.
+  // They are then merged in the order the modules were added, which gives
+  // every module the same ID as merging them one at a time would.
+  size_t NumModules = ThinLTO.ModuleMap.size();
+  std::vector<std::unique_ptr<ModuleSummaryIndex>> Summaries(NumModules);
+  std::map<size_t, Error> Errors;
+  std::mutex ErrorsMu;
+  auto ReadSummary = [&](size_t I) {
+    BitcodeModule BM = (ThinLTO.ModuleMap.begin() + I)->second;
+    Expected<std::unique_ptr<ModuleSummaryIndex>> SummaryOrErr =
+        BM.getSummary();
+    if (!SummaryOrErr) {
+      std::lock_guard<std::mutex> Lock(ErrorsMu);
+      Errors.emplace(I, SummaryOrErr.takeError());
+      return;
+    }
+    Summaries[I] = std::move(*SummaryOrErr);
+  };
+  if (NumModules > 1) {
+    ThreadPool Pool(llvm::heavyweight_hardware_concurrency());
+    for (size_t I = 0; I != NumModules; ++I)
+      Pool.async(ReadSummary, I);
+    Pool.wait();
+  } else if (NumModules == 1)
+    ReadSummary(0);
+
+  Error Err = Error::success();
+  for (auto &E : Errors)
+    Err = joinErrors(std::move(Err), std::move(E.second));
+  if (Err)
+    return Err;
+
+  for (size_t I = 0; I != NumModules; ++I)
+    ThinLTO.CombinedIndex.mergeFrom(std::move(Summaries[I]), I);
+  ThinLTO.CombinedIndex.buildGUIDTable();
+  return Error::success();
+}
+
 Error LTO::run(AddStreamFn AddStream, NativeObjectCache Cache) {
+  if (auto E = readThinLTOSummaries())
+    return E;
+
   // Save the status of having a regularLTO combined module, as
   // this is needed for generating the ThinLTO Task ID, and
   // the CombinedModule will be moved at the end of runRegularLTO.
@@ -882,6 +872,413 @@ ThinBackend lto::createWriteIndexesThinBackend(std::string OldPrefix,
   };
 }
 
+// The out-of-process backend and its workers exchange jobs through small text
+// files: one entry per line, made of a key and its values separated by tabs.
+// Besides the inputs and the output of the job, a job file records the
+// options that computeCacheKey considers, since those are the ones that
+// affect the native object.
+static void writeThinBackendJobOptions(raw_ostream &OS, const Config &Conf) {
+  OS << "cpu\t" << Conf.CPU << '\n';
+  for (auto &A : Conf.MAttrs)
+    OS << "mattr\t" << A << '\n';
+  OS << "reloc-model\t" << (unsigned)Conf.RelocModel << '\n';
+  OS << "code-model\t" << (unsigned)Conf.CodeModel << '\n';
+  OS << "cg-opt-level\t" << (unsigned)Conf.CGOptLevel << '\n';
+  OS << "opt-level\t" << Conf.OptLevel << '\n';
+  OS << "opt-pipeline\t" << Conf.OptPipeline << '\n';
+  OS << "aa-pipeline\t" << Conf.AAPipeline << '\n';
+  OS << "override-triple\t" << Conf.OverrideTriple << '\n';
+  OS << "default-triple\t" << Conf.DefaultTriple << '\n';
+  OS << "sample-profile\t" << Conf.SampleProfile << '\n';
+  OS << "disable-verify\t" << (unsigned)Conf.DisableVerify << '\n';
+  OS << "codegen-only\t" << (unsigned)Conf.CodeGenOnly << '\n';
+  OS << "relax-elf-relocations\t" << Conf.Options.RelaxELFRelocations << '\n';
+  OS << "function-sections\t" << Conf.Options.FunctionSections << '\n';
+  OS << "data-sections\t" << Conf.Options.DataSections << '\n';
+  OS << "debugger-tuning\t" << (unsigned)Conf.Options.DebuggerTuning << '\n';
+}
+
+namespace {
+class OutOfProcessThinBackend : public ThinBackendProc {
+  // Each thread of the pool waits for one worker process at a time.
+  ThreadPool BackendThreadPool;
+  AddStreamFn AddStream;
+  NativeObjectCache Cache;
+  std::string WorkerPath;
+  std::vector<std::string> WorkerArgs;
+
+  // Temporary directory holding the files exchanged with the workers.
+  SmallString<128> JobDir;
+
+  // Bitcode files written for the modules handed to the workers, keyed by
+  // module identifier. A module imported by several jobs is written once.
+  StringMap<std::string> ModuleFiles;
+  std::mutex ModuleFilesMu;
+
+  Optional<Error> Err;
+  std::mutex ErrMu;
+
+public:
+  OutOfProcessThinBackend(
+      Config &Conf, ModuleSummaryIndex &CombinedIndex,
+      unsigned ThinLTOParallelismLevel,
+      const StringMap<GVSummaryMapTy> &ModuleToDefinedGVSummaries,
+      AddStreamFn AddStream, NativeObjectCache Cache, std::string WorkerPath,
+      std::vector<std::string> WorkerArgs)
+      : ThinBackendProc(Conf, CombinedIndex, ModuleToDefinedGVSummaries),
+        BackendThreadPool(ThinLTOParallelismLevel),
+        AddStream(std::move(AddStream)), Cache(std::move(Cache)),
+        WorkerPath(std::move(WorkerPath)), WorkerArgs(std::move(WorkerArgs)) {}
+
+  ~OutOfProcessThinBackend() override {
+    BackendThreadPool.wait();
+    // The jobs clean up after themselves, only the modules are left.
+    for (auto &ModuleFile : ModuleFiles)
+      sys::fs::remove(ModuleFile.second);
+    if (!JobDir.empty())
+      sys::fs::remove(JobDir);
+  }
+
+  Expected<std::string> getModuleFile(BitcodeModule BM) {
+    std::lock_guard<std::mutex> Lock(ModuleFilesMu);
+    std::string &Path = ModuleFiles[BM.getModuleIdentifier()];
+    if (!Path.empty())
+      return Path;
+
+    std::string NewPath =
+        (JobDir + "/module" + Twine(ModuleFiles.size()) + ".bc").str();
+    std::error_code EC;
+    raw_fd_ostream OS(NewPath, EC, sys::fs::F_None);
+    if (EC)
+      return errorCodeToError(EC);
+    // The buffer of a BitcodeModule starts after the bitcode magic.
+    OS << StringRef("BC\xC0\xDE", 4) << BM.getBuffer();
+    Path = NewPath;
+    return Path;
+  }
+
+  Error runThinLTOBackendProcess(
+      AddStreamFn AddStream, unsigned Task, BitcodeModule BM,
+      const FunctionImporter::ImportMapTy &ImportList,
+      MapVector<StringRef, BitcodeModule> &ModuleMap) {
+    StringRef ModulePath = BM.getModuleIdentifier();
+    std::string Prefix = (JobDir + "/task" + Twine(Task)).str();
+    std::string JobPath = Prefix + ".job";
+    std::string IndexPath = Prefix + ".thinlto.bc";
+    std::string OutputPath = Prefix + ".o";
+
+    std::error_code EC;
+    {
+      std::map<std::string, GVSummaryMapTy> ModuleToSummariesForIndex;
+      gatherImportedSummariesForModule(ModulePath, ModuleToDefinedGVSummaries,
+                                       ImportList, ModuleToSummariesForIndex);
+      raw_fd_ostream OS(IndexPath, EC, sys::fs::F_None);
+      if (EC)
+        return errorCodeToError(EC);
+      WriteIndexToFile(CombinedIndex, OS, &ModuleToSummariesForIndex);
+    }
+
+    {
+      raw_fd_ostream OS(JobPath, EC, sys::fs::F_None);
+      if (EC)
+        return errorCodeToError(EC);
+      Expected<std::string> ModuleFile = getModuleFile(BM);
+      if (!ModuleFile)
+        return ModuleFile.takeError();
+      OS << "module\t" << ModulePath << '\t' << *ModuleFile << '\n';
+      for (auto &Entry : ImportList) {
+        auto I = ModuleMap.find(Entry.first());
+        assert(I != ModuleMap.end());
+        Expected<std::string> ImportFile = getModuleFile(I->second);
+        if (!ImportFile)
+          return ImportFile.takeError();
+        OS << "import\t" << Entry.first() << '\t' << *ImportFile << '\n';
+      }
+      OS << "index\t" << IndexPath << '\n';
+      OS << "output\t" << OutputPath << '\n';
+      OS << "task\t" << Task << '\n';
+      writeThinBackendJobOptions(OS, Conf);
+    }
+
+    std::string JobArg = "-thinlto-job=" + JobPath;
+    std::vector<const char *> Args;
+    Args.push_back(WorkerPath.c_str());
+    for (const std::string &Arg : WorkerArgs)
+      Args.push_back(Arg.c_str());
+    Args.push_back(JobArg.c_str());
+    Args.push_back(nullptr);
+
+    std::string ErrMsg;
+    int Result = sys::ExecuteAndWait(WorkerPath, Args.data(), nullptr, nullptr,
+                                     0, 0, &ErrMsg);
+    sys::fs::remove(JobPath);
+    sys::fs::remove(IndexPath);
+    if (Result != 0) {
+      sys::fs::remove(OutputPath);
+      std::string Msg = "ThinLTO backend process for '" + ModulePath.str() +
+                        "' failed";
+      if (!ErrMsg.empty())
+        Msg += ": " + ErrMsg;
+      return make_error<StringError>(Msg, inconvertibleErrorCode());
+    }
+
+    {
+      ErrorOr<std::unique_ptr<MemoryBuffer>> ObjOrErr =
+          MemoryBuffer::getFile(OutputPath);
+      // The in-process backend always produces an object, so a missing one
+      // means the module's code would be silently dropped.
+      if (ObjOrErr.getError() == std::errc::no_such_file_or_directory)
+        return make_error<StringError>("ThinLTO backend process for '" +
+                                           ModulePath +
+                                           "' did not write an object",
+                                       inconvertibleErrorCode());
+      if (!ObjOrErr)
+        return errorCodeToError(ObjOrErr.getError());
+      *AddStream(Task)->OS << (*ObjOrErr)->getBuffer();
+    }
+    sys::fs::remove(OutputPath);
+    return Error::success();
+  }
+
+  Error runThinLTOBackendJob(
+      unsigned Task, BitcodeModule BM,
+      const FunctionImporter::ImportMapTy &ImportList,
+      const FunctionImporter::ExportSetTy &ExportList,
+      const std::map<GlobalValue::GUID, GlobalValue::LinkageTypes> &ResolvedODR,
+      const GVSummaryMapTy &DefinedGlobals,
+      MapVector<StringRef, BitcodeModule> &ModuleMap) {
+    auto ModuleID = BM.getModuleIdentifier();
+
+    if (!Cache || !CombinedIndex.modulePaths().count(ModuleID) ||
+        all_of(CombinedIndex.getModuleHash(ModuleID),
+               [](uint32_t V) { return V == 0; }))
+      // Cache disabled or no entry for this module in the combined index or
+      // no module hash.
+      return runThinLTOBackendProcess(AddStream, Task, BM, ImportList,
+                                      ModuleMap);
+
+    SmallString<40> Key;
+    // The module may be cached, this helps handling it.
+    computeCacheKey(Key, Conf, CombinedIndex, ModuleID, ImportList, ExportList,
+                    ResolvedODR, DefinedGlobals);
+    if (AddStreamFn CacheAddStream = Cache(Task, Key))
+      return runThinLTOBackendProcess(CacheAddStream, Task, BM, ImportList,
+                                      ModuleMap);
+
+    return Error::success();
+  }
+
+  Error start(
+      unsigned Task, BitcodeModule BM,
+      const FunctionImporter::ImportMapTy &ImportList,
+      const FunctionImporter::ExportSetTy &ExportList,
+      const std::map<GlobalValue::GUID, GlobalValue::LinkageTypes> &ResolvedODR,
+      MapVector<StringRef, BitcodeModule> &ModuleMap) override {
+    if (JobDir.empty())
+      if (std::error_code EC =
+              sys::fs::createUniqueDirectory("thinlto-jobs", JobDir))
+        return errorCodeToError(EC);
+
+    StringRef ModulePath = BM.getModuleIdentifier();
+    assert(ModuleToDefinedGVSummaries.count(ModulePath));
+    const GVSummaryMapTy &DefinedGlobals =
+        ModuleToDefinedGVSummaries.find(ModulePath)->second;
+    BackendThreadPool.async(
+        [=](BitcodeModule BM, const FunctionImporter::ImportMapTy &ImportList,
+            const FunctionImporter::ExportSetTy &ExportList,
+            const std::map<GlobalValue::GUID, GlobalValue::LinkageTypes>
+                &ResolvedODR,
+            const GVSummaryMapTy &DefinedGlobals,
+            MapVector<StringRef, BitcodeModule> &ModuleMap) {
+          Error E = runThinLTOBackendJob(Task, BM, ImportList, ExportList,
+                                         ResolvedODR, DefinedGlobals,
+                                         ModuleMap);
+          if (E) {
+            std::unique_lock<std::mutex> L(ErrMu);
+            if (Err)
+              Err = joinErrors(std::move(*Err), std::move(E));
+            else
+              Err = std::move(E);
+          }
+        },
+        BM, std::ref(ImportList), std::ref(ExportList), std::ref(ResolvedODR),
+        std::ref(DefinedGlobals), std::ref(ModuleMap));
+    return Error::success();
+  }
+
+  Error wait() override {
+    BackendThreadPool.wait();
+    if (Err)
+      return std::move(*Err);
+    else
+      return Error::success();
+  }
+};
+} // end anonymous namespace
+
+ThinBackend
+lto::createOutOfProcessThinBackend(unsigned ParallelismLevel,
+                                   std::string WorkerPath,
+                                   std::vector<std::string> WorkerArgs) {
+  return [=](Config &Conf, ModuleSummaryIndex &CombinedIndex,
+             const StringMap<GVSummaryMapTy> &ModuleToDefinedGVSummaries,
+             AddStreamFn AddStream, NativeObjectCache Cache) {
+    return llvm::make_unique<OutOfProcessThinBackend>(
+        Conf, CombinedIndex, ParallelismLevel, ModuleToDefinedGVSummaries,
+        AddStream, Cache, WorkerPath, WorkerArgs);
+  };
+}
+
+Error lto::runThinBackendJob(Config &Conf, StringRef JobPath) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> JobOrErr =
+      MemoryBuffer::getFile(JobPath);
+  if (!JobOrErr)
+    return errorCodeToError(JobOrErr.getError());
+
+  auto Malformed = [&](StringRef Line) {
+    return make_error<StringError>("malformed ThinLTO job file '" + JobPath +
+                                       "': " + Line,
+                                   inconvertibleErrorCode());
+  };
+
+  // Identifiers and paths point into the job file.
+  std::pair<StringRef, StringRef> Module;
+  std::vector<std::pair<StringRef, StringRef>> Imports;
+  StringRef IndexPath, OutputPath;
+  unsigned Task = 0;
+  Conf.MAttrs.clear();
+  for (line_iterator LI(**JobOrErr); !LI.is_at_end(); ++LI) {
+    StringRef Key, Value;
+    std::tie(Key, Value) = LI->split('\t');
+    unsigned N = 0;
+    auto GetUnsigned = [&]() { return !Value.getAsInteger(10, N); };
+
+    if (Key == "module" || Key == "import") {
+      std::pair<StringRef, StringRef> Entry = Value.rsplit('\t');
+      if (Entry.second.empty())
+        return Malformed(*LI);
+      if (Key == "module")
+        Module = Entry;
+      else
+        Imports.push_back(Entry);
+    } else if (Key == "index")
+      IndexPath = Value;
+    else if (Key == "output")
+      OutputPath = Value;
+    else if (Key == "cpu")
+      Conf.CPU = Value;
+    else if (Key == "mattr")
+      Conf.MAttrs.push_back(Value);
+    else if (Key == "opt-pipeline")
+      Conf.OptPipeline = Value;
+    else if (Key == "aa-pipeline")
+      Conf.AAPipeline = Value;
+    else if (Key == "override-triple")
+      Conf.OverrideTriple = Value;
+    else if (Key == "default-triple")
+      Conf.DefaultTriple = Value;
+    else if (Key == "sample-profile")
+      Conf.SampleProfile = Value;
+    else if (!GetUnsigned())
+      return Malformed(*LI);
+    else if (Key == "task")
+      Task = N;
+    else if (Key == "reloc-model")
+      Conf.RelocModel = (Reloc::Model)N;
+    else if (Key == "code-model")
+      Conf.CodeModel = (CodeModel::Model)N;
+    else if (Key == "cg-opt-level")
+      Conf.CGOptLevel = (CodeGenOpt::Level)N;
+    else if (Key == "opt-level")
+      Conf.OptLevel = N;
+    else if (Key == "disable-verify")
+      Conf.DisableVerify = N;
+    else if (Key == "codegen-only")
+      Conf.CodeGenOnly = N;
+    else if (Key == "relax-elf-relocations")
+      Conf.Options.RelaxELFRelocations = N;
+    else if (Key == "function-sections")
+      Conf.Options.FunctionSections = N;
+    else if (Key == "data-sections")
+      Conf.Options.DataSections = N;
+    else if (Key == "debugger-tuning")
+      Conf.Options.DebuggerTuning = (DebuggerKind)N;
+    else
+      return Malformed(*LI);
+  }
+  if (Module.first.empty() || IndexPath.empty() || OutputPath.empty())
+    return Malformed("missing module, index or output");
+
+  Expected<std::unique_ptr<ModuleSummaryIndex>> IndexOrErr =
+      getModuleSummaryIndexForFile(IndexPath);
+  if (!IndexOrErr)
+    return IndexOrErr.takeError();
+  ModuleSummaryIndex &Index = **IndexOrErr;
+
+  // The index refers to modules by their original identifiers, which need not
+  // be the paths of the files written for the job.
+  std::vector<std::unique_ptr<MemoryBuffer>> OwnedBuffers;
+  auto LoadModule = [&](StringRef Identifier,
+                        StringRef Path) -> Expected<BitcodeModule> {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> MBOrErr =
+        MemoryBuffer::getFile(Path);
+    if (!MBOrErr)
+      return errorCodeToError(MBOrErr.getError());
+    OwnedBuffers.push_back(std::move(*MBOrErr));
+    Expected<std::vector<BitcodeModule>> BMsOrErr = getBitcodeModuleList(
+        MemoryBufferRef(OwnedBuffers.back()->getBuffer(), Identifier));
+    if (!BMsOrErr)
+      return BMsOrErr.takeError();
+    if (BMsOrErr->size() != 1)
+      return make_error<StringError>("expected exactly one module in '" +
+                                         Path + "'",
+                                     inconvertibleErrorCode());
+    return BMsOrErr->front();
+  };
+
+  Expected<BitcodeModule> BMOrErr = LoadModule(Module.first, Module.second);
+  if (!BMOrErr)
+    return BMOrErr.takeError();
+  MapVector<StringRef, BitcodeModule> ModuleMap;
+  for (auto &Import : Imports) {
+    Expected<BitcodeModule> ImportOrErr = LoadModule(Import.first,
+                                                     Import.second);
+    if (!ImportOrErr)
+      return ImportOrErr.takeError();
+    ModuleMap.insert({Import.first, *ImportOrErr});
+  }
+
+  // The individual index only holds the summaries of the module itself and of
+  // the values it imports, so everything that is not defined in the module is
+  // to be imported.
+  FunctionImporter::ImportMapTy ImportList;
+  for (auto &GlobalList : Index) {
+    for (auto &Summary : GlobalList.second)
+      if (Summary->modulePath() != Module.first)
+        ImportList[Summary->modulePath()][GlobalList.first] = 1;
+  }
+
+  StringMap<GVSummaryMapTy> ModuleToDefinedGVSummaries;
+  Index.collectDefinedGVSummariesPerModule(ModuleToDefinedGVSummaries);
+
+  LTOLLVMContext BackendContext(Conf);
+  Expected<std::unique_ptr<llvm::Module>> MOrErr =
+      BMOrErr->parseModule(BackendContext);
+  if (!MOrErr)
+    return MOrErr.takeError();
+
+  auto AddStream = [&](size_t Task) -> std::unique_ptr<NativeObjectStream> {
+    std::error_code EC;
+    auto OS = llvm::make_unique<raw_fd_ostream>(OutputPath, EC,
+                                                sys::fs::F_None);
+    if (EC)
+      report_fatal_error("Failed to open " + OutputPath + ": " + EC.message());
+    return llvm::make_unique<NativeObjectStream>(std::move(OS));
+  };
+  return thinBackend(Conf, Task, AddStream, **MOrErr, Index, ImportList,
+                     ModuleToDefinedGVSummaries[Module.first], ModuleMap);
+}
+
 Error LTO::runThinLTO(AddStreamFn AddStream, NativeObjectCache Cache,
                       bool HasRegularLTO) {
   if (ThinLTO.ModuleMap.empty())
@@ -927,8 +1324,19 @@ Error LTO::runThinLTO(AddStreamFn AddStream, NativeObjectCache Cache,
     auto DeadSymbols =
         computeDeadSymbols(ThinLTO.CombinedIndex, GUIDPreservedSymbols);
 
-    ComputeCrossModuleImport(ThinLTO.CombinedIndex, ModuleToDefinedGVSummaries,
-                             ImportLists, ExportLists, &DeadSymbols);
+    if (Conf.ThinLTOImportStatePath.empty()) {
+      ComputeCrossModuleImport(ThinLTO.CombinedIndex,
+                               ModuleToDefinedGVSummaries, ImportLists,
+                               ExportLists, &DeadSymbols);
+    } else {
+      auto ImportState =
+          IncrementalImportState::load(Conf.ThinLTOImportStatePath);
+      ComputeCrossModuleImport(ThinLTO.CombinedIndex,
+                               ModuleToDefinedGVSummaries, ImportLists,
+                               ExportLists, &DeadSymbols, &ImportState);
+      if (Error E = ImportState.save(Conf.ThinLTOImportStatePath))
+        return E;
+    }
 
     std::set<GlobalValue::GUID> ExportedGUIDs;
     for (auto &Res : GlobalResolutions) {
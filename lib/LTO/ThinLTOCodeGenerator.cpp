@@ -358,7 +358,10 @@ public:
   ErrorOr<std::unique_ptr<MemoryBuffer>> tryLoadingBuffer() {
     if (EntryPath.empty())
       return std::error_code();
-    return MemoryBuffer::getFile(EntryPath);
+    auto BufferOrErr = MemoryBuffer::getFile(EntryPath);
+    if (BufferOrErr)
+      recordAccess((*BufferOrErr)->getBufferSize());
+    return BufferOrErr;
   }
 
   // Cache the Produced object file
@@ -389,6 +392,14 @@ public:
                            " to save cached entry\n");
       OS << OutputBuffer.getBuffer();
     }
+    recordAccess(OutputBuffer.getBufferSize());
+  }
+
+private:
+  // Let the pruning know that this entry was used.
+  void recordAccess(uint64_t Size) {
+    CachePruning::recordAccess(sys::path::parent_path(EntryPath), EntryPath,
+                               Size);
   }
 };
 
@@ -563,25 +574,42 @@ std::unique_ptr<TargetMachine> TargetMachineBuilder::create() const {
  * "thin-link".
  */
 std::unique_ptr<ModuleSummaryIndex> ThinLTOCodeGenerator::linkCombinedIndex() {
+  // Read the summaries in parallel, then merge them in order so that the
+  // module IDs do not depend on the scheduling.
+  std::vector<std::unique_ptr<ModuleSummaryIndex>> Summaries(Modules.size());
+  std::vector<std::string> Errors(Modules.size());
+  {
+    ThreadPool Pool(ThreadCount);
+    for (size_t I = 0, E = Modules.size(); I != E; ++I)
+      Pool.async([&](size_t I) {
+        Expected<std::unique_ptr<object::ModuleSummaryIndexObjectFile>>
+            ObjOrErr =
+                object::ModuleSummaryIndexObjectFile::create(Modules[I]);
+        if (!ObjOrErr) {
+          Errors[I] = toString(ObjOrErr.takeError());
+          return;
+        }
+        Summaries[I] = (*ObjOrErr)->takeIndex();
+      }, I);
+  }
+
   std::unique_ptr<ModuleSummaryIndex> CombinedIndex;
   uint64_t NextModuleId = 0;
-  for (auto &ModuleBuffer : Modules) {
-    Expected<std::unique_ptr<object::ModuleSummaryIndexObjectFile>> ObjOrErr =
-        object::ModuleSummaryIndexObjectFile::create(ModuleBuffer);
-    if (!ObjOrErr) {
+  for (size_t I = 0, E = Modules.size(); I != E; ++I) {
+    if (!Summaries[I]) {
       // FIXME diagnose
-      logAllUnhandledErrors(
-          ObjOrErr.takeError(), errs(),
-          "error: can't create ModuleSummaryIndexObjectFile for buffer: ");
+      errs() << "error: can't create ModuleSummaryIndexObjectFile for buffer: "
+             << Errors[I] << "\n";
       return nullptr;
     }
-    auto Index = (*ObjOrErr)->takeIndex();
     if (CombinedIndex) {
-      CombinedIndex->mergeFrom(std::move(Index), ++NextModuleId);
+      CombinedIndex->mergeFrom(std::move(Summaries[I]), ++NextModuleId);
     } else {
-      CombinedIndex = std::move(Index);
+      CombinedIndex = std::move(Summaries[I]);
     }
   }
+  if (CombinedIndex)
+    CombinedIndex->buildGUIDTable();
   return CombinedIndex;
 }
 
@@ -882,8 +910,17 @@ void ThinLTOCodeGenerator::run() {
   // combined index.
   StringMap<FunctionImporter::ImportMapTy> ImportLists(ModuleCount);
   StringMap<FunctionImporter::ExportSetTy> ExportLists(ModuleCount);
-  ComputeCrossModuleImport(*Index, ModuleToDefinedGVSummaries, ImportLists,
-                           ExportLists, &DeadSymbols);
+  if (ImportStatePath.empty()) {
+    ComputeCrossModuleImport(*Index, ModuleToDefinedGVSummaries, ImportLists,
+                             ExportLists, &DeadSymbols);
+  } else {
+    auto ImportState = IncrementalImportState::load(ImportStatePath);
+    ComputeCrossModuleImport(*Index, ModuleToDefinedGVSummaries, ImportLists,
+                             ExportLists, &DeadSymbols, &ImportState);
+    if (Error E = ImportState.save(ImportStatePath))
+      report_fatal_error(Twine("Failed to save the import state to ") +
+                         ImportStatePath + ": " + toString(std::move(E)));
+  }
 
   // We use a std::map here to be able to have a defined ordering when
   // producing a hash for the cache entry.
@@ -1024,6 +1061,9 @@ void ThinLTOCodeGenerator::run() {
       .setPruningInterval(std::chrono::seconds(CacheOptions.PruningInterval))
       .setEntryExpiration(std::chrono::seconds(CacheOptions.Expiration))
       .setMaxSize(CacheOptions.MaxPercentageOfAvailableSpace)
+      .setMaxSizeBytes(CacheOptions.MaxSizeBytes)
+      .setMaxEntries(CacheOptions.MaxSizeFiles)
+      .setUseManifest(CacheOptions.MaxSizeBytes || CacheOptions.MaxSizeFiles)
       .prune();
 
   // If statistics were requested, print them out now.
@@ -920,6 +920,12 @@ Expected<Constant *> IRLinker::linkGlobalValueProto(GlobalValue *SGV,
     if (DoneLinkingBodies)
       return nullptr;
 
+    // The metadata of global variables and declarations is copied with their
+    // prototype, make sure it is loaded.
+    if (isa<GlobalVariable>(SGV) || SGV->isDeclaration())
+      if (Error Err = SGV->materialize())
+        return std::move(Err);
+
     NewGV = copyGlobalValueProto(SGV, ShouldLink);
     if (ShouldLink || !ForAlias)
       forceRenaming(NewGV, SGV->getName());
@@ -72,6 +72,7 @@ MCContext::~MCContext() {
 //===----------------------------------------------------------------------===//
 
 void MCContext::reset() {
+  assert(!ThreadSafe && "Cannot reset the context from parallel codegen");
   // Call the destructors so the fragments are freed
   COFFAllocator.DestroyAll();
   ELFAllocator.DestroyAll();
@@ -111,6 +112,7 @@ void MCContext::reset() {
 //===----------------------------------------------------------------------===//
 
 MCSymbol *MCContext::getOrCreateSymbol(const Twine &Name) {
+  auto Lock = lockSymbols();
   SmallString<128> NameSV;
   StringRef NameRef = Name.toStringRef(NameSV);
 
@@ -191,12 +193,14 @@ MCSymbol *MCContext::createSymbol(StringRef Name, bool AlwaysAddSuffix,
 
 MCSymbol *MCContext::createTempSymbol(const Twine &Name, bool AlwaysAddSuffix,
                                       bool CanBeUnnamed) {
+  auto Lock = lockSymbols();
   SmallString<128> NameSV;
   raw_svector_ostream(NameSV) << MAI->getPrivateGlobalPrefix() << Name;
   return createSymbol(NameSV, AlwaysAddSuffix, CanBeUnnamed);
 }
 
 MCSymbol *MCContext::createLinkerPrivateTempSymbol() {
+  auto Lock = lockSymbols();
   SmallString<128> NameSV;
   raw_svector_ostream(NameSV) << MAI->getLinkerPrivateGlobalPrefix() << "tmp";
   return createSymbol(NameSV, true, false);
@@ -207,6 +211,7 @@ MCSymbol *MCContext::createTempSymbol(bool CanBeUnnamed) {
 }
 
 unsigned MCContext::NextInstance(unsigned LocalLabelVal) {
+  auto Lock = lockSymbols();
   MCLabel *&Label = Instances[LocalLabelVal];
   if (!Label)
     Label = new (*this) MCLabel(0);
@@ -214,6 +219,7 @@ unsigned MCContext::NextInstance(unsigned LocalLabelVal) {
 }
 
 unsigned MCContext::GetInstance(unsigned LocalLabelVal) {
+  auto Lock = lockSymbols();
   MCLabel *&Label = Instances[LocalLabelVal];
   if (!Label)
     Label = new (*this) MCLabel(0);
@@ -222,6 +228,7 @@ unsigned MCContext::GetInstance(unsigned LocalLabelVal) {
 
 MCSymbol *MCContext::getOrCreateDirectionalLocalSymbol(unsigned LocalLabelVal,
                                                        unsigned Instance) {
+  auto Lock = lockSymbols();
   MCSymbol *&Sym = LocalSymbols[std::make_pair(LocalLabelVal, Instance)];
   if (!Sym)
     Sym = createTempSymbol(false);
@@ -229,12 +236,14 @@ MCSymbol *MCContext::getOrCreateDirectionalLocalSymbol(unsigned LocalLabelVal,
 }
 
 MCSymbol *MCContext::createDirectionalLocalSymbol(unsigned LocalLabelVal) {
+  auto Lock = lockSymbols();
   unsigned Instance = NextInstance(LocalLabelVal);
   return getOrCreateDirectionalLocalSymbol(LocalLabelVal, Instance);
 }
 
 MCSymbol *MCContext::getDirectionalLocalSymbol(unsigned LocalLabelVal,
                                                bool Before) {
+  auto Lock = lockSymbols();
   unsigned Instance = GetInstance(LocalLabelVal);
   if (!Before)
     ++Instance;
@@ -242,6 +251,7 @@ MCSymbol *MCContext::getDirectionalLocalSymbol(unsigned LocalLabelVal,
 }
 
 MCSymbol *MCContext::lookupSymbol(const Twine &Name) const {
+  auto Lock = lockSymbols();
   SmallString<128> NameSV;
   StringRef NameRef = Name.toStringRef(NameSV);
   return Symbols.lookup(NameRef);
@@ -262,6 +272,7 @@ MCSectionMachO *MCContext::getMachOSection(StringRef Segment, StringRef Section,
                                            unsigned TypeAndAttributes,
                                            unsigned Reserved2, SectionKind Kind,
                                            const char *BeginSymName) {
+  assert(!ThreadSafe && "Cannot create sections from parallel codegen");
 
   // We unique sections by their segment/section pair.  The returned section
   // may not have the same flags as the requested section, if so this should be
@@ -288,6 +299,7 @@ MCSectionMachO *MCContext::getMachOSection(StringRef Segment, StringRef Section,
 }
 
 void MCContext::renameELFSection(MCSectionELF *Section, StringRef Name) {
+  assert(!ThreadSafe && "Cannot create sections from parallel codegen");
   StringRef GroupName;
   if (const MCSymbol *Group = Section->getGroup())
     GroupName = Group->getName();
@@ -309,6 +321,7 @@ MCSectionELF *MCContext::createELFSectionImpl(StringRef Section, unsigned Type,
                                               const MCSymbolELF *Group,
                                               unsigned UniqueID,
                                               const MCSectionELF *Associated) {
+  assert(!ThreadSafe && "Cannot create sections from parallel codegen");
 
   MCSymbolELF *R;
   MCSymbol *&Sym = Symbols[Section];
@@ -373,6 +386,7 @@ MCSectionELF *MCContext::getELFSection(const Twine &Section, unsigned Type,
                                        const MCSymbolELF *GroupSym,
                                        unsigned UniqueID,
                                        const MCSectionELF *Associated) {
+  assert(!ThreadSafe && "Cannot create sections from parallel codegen");
   StringRef Group = "";
   if (GroupSym)
     Group = GroupSym->getName();
@@ -411,6 +425,7 @@ MCSectionCOFF *MCContext::getCOFFSection(StringRef Section,
                                          StringRef COMDATSymName, int Selection,
                                          unsigned UniqueID,
                                          const char *BeginSymName) {
+  assert(!ThreadSafe && "Cannot create sections from parallel codegen");
   MCSymbol *COMDATSymbol = nullptr;
   if (!COMDATSymName.empty()) {
     COMDATSymbol = getOrCreateSymbol(COMDATSymName);
@@ -475,6 +490,7 @@ MCSectionCOFF *MCContext::getAssociativeCOFFSection(MCSectionCOFF *Sec,
 }
 
 MCSubtargetInfo &MCContext::getSubtargetCopy(const MCSubtargetInfo &STI) {
+  assert(!ThreadSafe && "Cannot copy subtargets from parallel codegen");
   return *new (MCSubtargetAllocator.Allocate()) MCSubtargetInfo(STI);
 }
 
@@ -488,6 +504,7 @@ MCSubtargetInfo &MCContext::getSubtargetCopy(const MCSubtargetInfo &STI) {
 /// allocated file number is returned.  The file numbers may be in any order.
 unsigned MCContext::getDwarfFile(StringRef Directory, StringRef FileName,
                                  unsigned FileNumber, unsigned CUID) {
+  assert(!ThreadSafe && "Cannot add DWARF files from parallel codegen");
   MCDwarfLineTable &Table = MCDwarfLineTablesCUMap[CUID];
   return Table.getFile(Directory, FileName, FileNumber);
 }
@@ -0,0 +1,697 @@
+//===- FlatSummaryIndex.cpp - Memory-mappable combined summary index ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The flat summary index is laid out as follows, all integers little-endian:
+//
+//   Header
+//   u64 ModuleIds[NumModules]
+//   u32 ModuleNameOffsets[NumModules]  (into the string table)
+//   u32 ModuleNameSizes[NumModules]
+//   u32 ModuleHashes[NumModules * 5]
+//   u64 GUIDs[NumGUIDs]                (sorted)
+//   u32 GUIDSummaryStarts[NumGUIDs + 1]
+//   u64 SummaryOriginalNames[NumSummaries]
+//   u32 SummaryFlags[NumSummaries]     (linkage, flags and kind, see below)
+//   u32 SummaryModules[NumSummaries]
+//   u32 SummaryInstCounts[NumSummaries]
+//   u32 SummaryAliasees[NumSummaries]  (summary position or ~0U)
+//   u32 SummaryCallStarts[NumSummaries + 1]
+//   u32 SummaryRefStarts[NumSummaries + 1]
+//   u64 CallGUIDs[NumCalls]
+//   u8  CallHotness[NumCalls]
+//   u64 RefGUIDs[NumRefs]
+//   u32 SummaryTypeInfoStarts[NumSummaries + 1]
+//   u64 TypeInfo[NumTypeInfo]
+//   char StringTable[StringTableSize]
+//
+// Every column starts on an 8-byte boundary. The summaries of the I-th GUID
+// are the ones in [GUIDSummaryStarts[I], GUIDSummaryStarts[I + 1]), and the
+// calls, references and type information of a summary are found the same way.
+//
+// The type information of a function summary is empty if it has no type tests
+// or virtual calls. Otherwise it holds five lists, each one made of its length
+// followed by its elements: the type test GUIDs, the llvm.assume(llvm.type.test)
+// and llvm.type.checked.load virtual calls as (GUID, offset) pairs, and the
+// constant virtual calls of both kinds as (GUID, offset, number of arguments,
+// arguments...) entries.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Object/FlatSummaryIndex.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Object/Error.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace object;
+
+static const char FlatSummaryIndexMagic[8] = {'L', 'L', 'V', 'M',
+                                              'F', 'S', 'I', 'X'};
+
+// Layout of the SummaryFlags column.
+enum : uint32_t {
+  LinkageMask = 0xf,
+  NotEligibleToImportBit = 1 << 4,
+  LiveRootBit = 1 << 5,
+  KindShift = 8,
+};
+
+static const uint32_t NoAliasee = ~0U;
+
+namespace {
+/// Byte offsets of the columns, which only depend on the counts in the header.
+struct ColumnLayout {
+  uint64_t ModuleIds, ModuleNameOffsets, ModuleNameSizes, ModuleHashes;
+  uint64_t GUIDs, GUIDSummaryStarts;
+  uint64_t SummaryOriginalNames, SummaryFlags, SummaryModules,
+      SummaryInstCounts, SummaryAliasees, SummaryCallStarts, SummaryRefStarts;
+  uint64_t CallGUIDs, CallHotness, RefGUIDs;
+  uint64_t SummaryTypeInfoStarts, TypeInfo;
+  uint64_t StringTable;
+  uint64_t Size;
+
+  explicit ColumnLayout(const FlatSummaryIndex::Header &H) {
+    uint64_t Offset = sizeof(FlatSummaryIndex::Header);
+    auto Column = [&](uint64_t &Start, uint64_t NumElts, uint64_t EltSize) {
+      Start = Offset;
+      Offset = alignTo(Offset + NumElts * EltSize, 8);
+    };
+    uint64_t NumModules = H.NumModules, NumGUIDs = H.NumGUIDs,
+             NumSummaries = H.NumSummaries;
+    Column(ModuleIds, NumModules, 8);
+    Column(ModuleNameOffsets, NumModules, 4);
+    Column(ModuleNameSizes, NumModules, 4);
+    Column(ModuleHashes, NumModules * 5, 4);
+    Column(GUIDs, NumGUIDs, 8);
+    Column(GUIDSummaryStarts, NumGUIDs + 1, 4);
+    Column(SummaryOriginalNames, NumSummaries, 8);
+    Column(SummaryFlags, NumSummaries, 4);
+    Column(SummaryModules, NumSummaries, 4);
+    Column(SummaryInstCounts, NumSummaries, 4);
+    Column(SummaryAliasees, NumSummaries, 4);
+    Column(SummaryCallStarts, NumSummaries + 1, 4);
+    Column(SummaryRefStarts, NumSummaries + 1, 4);
+    Column(CallGUIDs, H.NumCalls, 8);
+    Column(CallHotness, H.NumCalls, 1);
+    Column(RefGUIDs, H.NumRefs, 8);
+    Column(SummaryTypeInfoStarts, NumSummaries + 1, 4);
+    Column(TypeInfo, H.NumTypeInfo, 8);
+    Column(StringTable, H.StringTableSize, 1);
+    Size = Offset;
+  }
+};
+} // end anonymous namespace
+
+static GlobalValue::GUID getGUID(const ValueInfo &VI) {
+  return VI.isGUID() ? VI.getGUID() : VI.getValue()->getGUID();
+}
+
+// Append the type information of \p FS to \p TypeInfo, in the layout
+// documented at the top of this file.
+static void writeTypeInfo(const FunctionSummary &FS,
+                          std::vector<uint64_t> &TypeInfo) {
+  if (FS.type_tests().empty() && FS.type_test_assume_vcalls().empty() &&
+      FS.type_checked_load_vcalls().empty() &&
+      FS.type_test_assume_const_vcalls().empty() &&
+      FS.type_checked_load_const_vcalls().empty())
+    return;
+
+  TypeInfo.push_back(FS.type_tests().size());
+  TypeInfo.insert(TypeInfo.end(), FS.type_tests().begin(),
+                  FS.type_tests().end());
+  for (ArrayRef<FunctionSummary::VFuncId> VCalls :
+       {FS.type_test_assume_vcalls(), FS.type_checked_load_vcalls()}) {
+    TypeInfo.push_back(VCalls.size());
+    for (const FunctionSummary::VFuncId &VF : VCalls) {
+      TypeInfo.push_back(VF.GUID);
+      TypeInfo.push_back(VF.Offset);
+    }
+  }
+  for (ArrayRef<FunctionSummary::ConstVCall> VCalls :
+       {FS.type_test_assume_const_vcalls(),
+        FS.type_checked_load_const_vcalls()}) {
+    TypeInfo.push_back(VCalls.size());
+    for (const FunctionSummary::ConstVCall &VC : VCalls) {
+      TypeInfo.push_back(VC.VFunc.GUID);
+      TypeInfo.push_back(VC.VFunc.Offset);
+      TypeInfo.push_back(VC.Args.size());
+      TypeInfo.insert(TypeInfo.end(), VC.Args.begin(), VC.Args.end());
+    }
+  }
+}
+
+void object::writeFlatSummaryIndex(const ModuleSummaryIndex &Index,
+                                   raw_ostream &OS) {
+  // Number the modules in path order, which does not depend on the order they
+  // were added to the index.
+  std::vector<StringRef> ModulePaths;
+  for (auto &M : Index.modulePaths())
+    ModulePaths.push_back(M.first());
+  std::sort(ModulePaths.begin(), ModulePaths.end());
+  StringMap<uint32_t> ModuleNumbers;
+  std::string StringTable;
+  std::vector<uint64_t> ModuleIds;
+  std::vector<uint32_t> ModuleNameOffsets, ModuleNameSizes, ModuleHashes;
+  for (StringRef Path : ModulePaths) {
+    ModuleNumbers[Path] = ModuleIds.size();
+    ModuleIds.push_back(Index.getModuleId(Path));
+    ModuleNameOffsets.push_back(StringTable.size());
+    ModuleNameSizes.push_back(Path.size());
+    StringTable += Path;
+    const ModuleHash &Hash = Index.getModuleHash(Path);
+    ModuleHashes.insert(ModuleHashes.end(), Hash.begin(), Hash.end());
+  }
+
+  // Number the summaries in GUID order, and the summaries of a GUID in module
+  // order, first, so that aliases can refer to their aliasee by position.
+  std::vector<uint64_t> GUIDs;
+  std::vector<uint32_t> GUIDSummaryStarts;
+  std::vector<const GlobalValueSummary *> Summaries;
+  DenseMap<const GlobalValueSummary *, uint32_t> SummaryNumbers;
+  auto getModuleNumber = [&](const GlobalValueSummary *S) {
+    auto I = ModuleNumbers.find(S->modulePath());
+    assert(I != ModuleNumbers.end() && "Summary of an unregistered module");
+    return I->second;
+  };
+  for (auto &Entry : Index) {
+    if (Entry.second.empty())
+      continue;
+    GUIDs.push_back(Entry.first);
+    GUIDSummaryStarts.push_back(Summaries.size());
+    size_t First = Summaries.size();
+    for (auto &S : Entry.second)
+      Summaries.push_back(S.get());
+    std::stable_sort(Summaries.begin() + First, Summaries.end(),
+                     [&](const GlobalValueSummary *L,
+                         const GlobalValueSummary *R) {
+                       return getModuleNumber(L) < getModuleNumber(R);
+                     });
+    for (size_t I = First, E = Summaries.size(); I != E; ++I)
+      SummaryNumbers[Summaries[I]] = I;
+  }
+  GUIDSummaryStarts.push_back(Summaries.size());
+
+  std::vector<uint64_t> SummaryOriginalNames, CallGUIDs, RefGUIDs, TypeInfo;
+  std::vector<uint32_t> SummaryFlags, SummaryModules, SummaryInstCounts,
+      SummaryAliasees, SummaryCallStarts, SummaryRefStarts,
+      SummaryTypeInfoStarts;
+  std::vector<uint8_t> CallHotness;
+  for (const GlobalValueSummary *S : Summaries) {
+    auto Flags = const_cast<GlobalValueSummary *>(S)->flags();
+    SummaryOriginalNames.push_back(
+        const_cast<GlobalValueSummary *>(S)->getOriginalName());
+    SummaryFlags.push_back(Flags.Linkage |
+                           (Flags.NotEligibleToImport
+                                ? uint32_t(NotEligibleToImportBit)
+                                : 0) |
+                           (Flags.LiveRoot ? uint32_t(LiveRootBit) : 0) |
+                           (S->getSummaryKind() << KindShift));
+    SummaryModules.push_back(getModuleNumber(S));
+    SummaryCallStarts.push_back(CallGUIDs.size());
+    SummaryRefStarts.push_back(RefGUIDs.size());
+    SummaryTypeInfoStarts.push_back(TypeInfo.size());
+    for (const ValueInfo &Ref : S->refs())
+      RefGUIDs.push_back(getGUID(Ref));
+
+    uint32_t InstCount = 0, Aliasee = NoAliasee;
+    if (auto *FS = dyn_cast<FunctionSummary>(S)) {
+      InstCount = FS->instCount();
+      for (auto &Edge : FS->calls()) {
+        CallGUIDs.push_back(getGUID(Edge.first));
+        CallHotness.push_back(static_cast<uint8_t>(Edge.second.Hotness));
+      }
+      writeTypeInfo(*FS, TypeInfo);
+    } else if (auto *AS = dyn_cast<AliasSummary>(S)) {
+      auto I = SummaryNumbers.find(&AS->getAliasee());
+      if (I != SummaryNumbers.end())
+        Aliasee = I->second;
+    }
+    SummaryInstCounts.push_back(InstCount);
+    SummaryAliasees.push_back(Aliasee);
+  }
+  SummaryCallStarts.push_back(CallGUIDs.size());
+  SummaryRefStarts.push_back(RefGUIDs.size());
+  SummaryTypeInfoStarts.push_back(TypeInfo.size());
+
+  if (Summaries.size() > UINT32_MAX || CallGUIDs.size() > UINT32_MAX ||
+      RefGUIDs.size() > UINT32_MAX || TypeInfo.size() > UINT32_MAX ||
+      StringTable.size() > UINT32_MAX)
+    report_fatal_error("Summary index too large for the flat format");
+
+  FlatSummaryIndex::Header H;
+  std::copy(std::begin(FlatSummaryIndexMagic), std::end(FlatSummaryIndexMagic),
+            H.Magic);
+  H.Version = FlatSummaryIndex::CurrentVersion;
+  H.NumModules = ModuleIds.size();
+  H.NumGUIDs = GUIDs.size();
+  H.NumSummaries = Summaries.size();
+  H.NumCalls = CallGUIDs.size();
+  H.NumRefs = RefGUIDs.size();
+  H.StringTableSize = StringTable.size();
+  H.NumTypeInfo = TypeInfo.size();
+  OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+
+  support::endian::Writer<support::little> W(OS);
+  uint64_t Offset = sizeof(H);
+  auto Pad = [&](uint64_t Size) {
+    Offset += Size;
+    for (uint64_t I = 0, E = OffsetToAlignment(Offset, 8); I != E; ++I)
+      OS << '\0';
+    Offset = alignTo(Offset, 8);
+  };
+  auto Column = [&](StringRef Bytes) {
+    OS << Bytes;
+    Pad(Bytes.size());
+  };
+  auto Column64 = [&](ArrayRef<uint64_t> Vals) {
+    W.write(Vals);
+    Pad(Vals.size() * 8);
+  };
+  auto Column32 = [&](ArrayRef<uint32_t> Vals) {
+    W.write(Vals);
+    Pad(Vals.size() * 4);
+  };
+  Column64(ModuleIds);
+  Column32(ModuleNameOffsets);
+  Column32(ModuleNameSizes);
+  Column32(ModuleHashes);
+  Column64(GUIDs);
+  Column32(GUIDSummaryStarts);
+  Column64(SummaryOriginalNames);
+  Column32(SummaryFlags);
+  Column32(SummaryModules);
+  Column32(SummaryInstCounts);
+  Column32(SummaryAliasees);
+  Column32(SummaryCallStarts);
+  Column32(SummaryRefStarts);
+  Column64(CallGUIDs);
+  Column(StringRef(reinterpret_cast<const char *>(CallHotness.data()),
+                   CallHotness.size()));
+  Column64(RefGUIDs);
+  Column32(SummaryTypeInfoStarts);
+  Column64(TypeInfo);
+  Column(StringTable);
+  assert(Offset == ColumnLayout(H).Size && "Layout mismatch");
+}
+
+bool FlatSummaryIndex::isFlatSummaryIndex(StringRef Buffer) {
+  return Buffer.startswith(
+      StringRef(FlatSummaryIndexMagic, sizeof(FlatSummaryIndexMagic)));
+}
+
+static Error malformedError(const Twine &Msg) {
+  return make_error<StringError>("Malformed flat summary index: " + Msg,
+                                 object_error::parse_failed);
+}
+
+Expected<std::unique_ptr<FlatSummaryIndex>>
+FlatSummaryIndex::create(MemoryBufferRef Buffer) {
+  StringRef Data = Buffer.getBuffer();
+  if (!isFlatSummaryIndex(Data))
+    return make_error<StringError>("Not a flat summary index",
+                                   object_error::invalid_file_type);
+  if (Data.size() < sizeof(Header))
+    return malformedError("truncated header");
+  const Header &H = *reinterpret_cast<const Header *>(Data.data());
+  if (H.Version != CurrentVersion)
+    return malformedError("unsupported version " + Twine(H.Version));
+  ColumnLayout L(H);
+  if (Data.size() < L.Size)
+    return malformedError("truncated columns");
+
+  std::unique_ptr<FlatSummaryIndex> Index(new FlatSummaryIndex());
+  auto Base = reinterpret_cast<const uint8_t *>(Data.data());
+  auto Col64 = [&](uint64_t Offset) {
+    return reinterpret_cast<const ulittle64_t *>(Base + Offset);
+  };
+  auto Col32 = [&](uint64_t Offset) {
+    return reinterpret_cast<const ulittle32_t *>(Base + Offset);
+  };
+  Index->NumModules = H.NumModules;
+  Index->NumGUIDs = H.NumGUIDs;
+  Index->NumSummaries = H.NumSummaries;
+  Index->ModuleIds = Col64(L.ModuleIds);
+  Index->ModuleNameOffsets = Col32(L.ModuleNameOffsets);
+  Index->ModuleNameSizes = Col32(L.ModuleNameSizes);
+  Index->ModuleHashes = Col32(L.ModuleHashes);
+  Index->GUIDs = Col64(L.GUIDs);
+  Index->GUIDSummaryStarts = Col32(L.GUIDSummaryStarts);
+  Index->SummaryOriginalNames = Col64(L.SummaryOriginalNames);
+  Index->SummaryFlags = Col32(L.SummaryFlags);
+  Index->SummaryModules = Col32(L.SummaryModules);
+  Index->SummaryInstCounts = Col32(L.SummaryInstCounts);
+  Index->SummaryAliasees = Col32(L.SummaryAliasees);
+  Index->SummaryCallStarts = Col32(L.SummaryCallStarts);
+  Index->SummaryRefStarts = Col32(L.SummaryRefStarts);
+  Index->CallGUIDs = Col64(L.CallGUIDs);
+  Index->CallHotness = Base + L.CallHotness;
+  Index->RefGUIDs = Col64(L.RefGUIDs);
+  Index->SummaryTypeInfoStarts = Col32(L.SummaryTypeInfoStarts);
+  Index->TypeInfo = Col64(L.TypeInfo);
+  Index->StringTable = StringRef(Data.data() + L.StringTable,
+                                 H.StringTableSize);
+
+  // Check the entries that locate other entries, so that no query reads out of
+  // the buffer: the ranges have to be ordered and within their columns, the
+  // modules and aliasees within their tables. This only reads the small
+  // columns, not the edges.
+  auto CheckStarts = [](const ulittle32_t *Starts, uint32_t NumRanges,
+                        uint32_t NumElts) {
+    if (Starts[0] != 0 || Starts[NumRanges] != NumElts)
+      return false;
+    for (uint32_t I = 0; I != NumRanges; ++I)
+      if (Starts[I] > Starts[I + 1])
+        return false;
+    return true;
+  };
+  if (!CheckStarts(Index->GUIDSummaryStarts, H.NumGUIDs, H.NumSummaries) ||
+      !CheckStarts(Index->SummaryCallStarts, H.NumSummaries, H.NumCalls) ||
+      !CheckStarts(Index->SummaryRefStarts, H.NumSummaries, H.NumRefs) ||
+      !CheckStarts(Index->SummaryTypeInfoStarts, H.NumSummaries,
+                   H.NumTypeInfo))
+    return malformedError("inconsistent column sizes");
+  for (uint32_t I = 0; I != H.NumSummaries; ++I) {
+    if (Index->SummaryModules[I] >= H.NumModules)
+      return malformedError("module out of range");
+    Summary S(Index.get(), I);
+    if (S.getKind() != GlobalValueSummary::AliasKind)
+      continue;
+    uint32_t Aliasee = Index->SummaryAliasees[I];
+    if (Aliasee == NoAliasee)
+      continue;
+    if (Aliasee >= H.NumSummaries)
+      return malformedError("aliasee out of range");
+    // Aliases refer to the summary of their base object, so an alias of an
+    // alias can only come from a corrupt file, and could form a cycle.
+    if (Summary(Index.get(), Aliasee).getKind() ==
+        GlobalValueSummary::AliasKind)
+      return malformedError("aliasee is an alias");
+  }
+  return std::move(Index);
+}
+
+Expected<std::unique_ptr<FlatSummaryIndex>>
+FlatSummaryIndex::createFromFile(const Twine &Path) {
+  auto BufferOrErr = MemoryBuffer::getFile(Path, /*FileSize=*/-1,
+                                           /*RequiresNullTerminator=*/false);
+  if (!BufferOrErr)
+    return errorCodeToError(BufferOrErr.getError());
+  auto IndexOrErr = create((*BufferOrErr)->getMemBufferRef());
+  if (!IndexOrErr)
+    return IndexOrErr.takeError();
+  (*IndexOrErr)->OwnedBuffer = std::move(*BufferOrErr);
+  return IndexOrErr;
+}
+
+StringRef FlatSummaryIndex::getModulePath(uint32_t Module) const {
+  assert(Module < NumModules && "Module out of range");
+  return StringTable.substr(ModuleNameOffsets[Module],
+                            ModuleNameSizes[Module]);
+}
+
+uint64_t FlatSummaryIndex::getModuleId(uint32_t Module) const {
+  assert(Module < NumModules && "Module out of range");
+  return ModuleIds[Module];
+}
+
+ModuleHash FlatSummaryIndex::getModuleHash(uint32_t Module) const {
+  assert(Module < NumModules && "Module out of range");
+  ModuleHash Hash;
+  std::copy(ModuleHashes + Module * 5, ModuleHashes + (Module + 1) * 5,
+            Hash.begin());
+  return Hash;
+}
+
+iterator_range<FlatSummaryIndex::summary_iterator>
+FlatSummaryIndex::lookup(GlobalValue::GUID GUID) const {
+  const ulittle64_t *I = std::lower_bound(
+      GUIDs, GUIDs + NumGUIDs, GUID,
+      [](const ulittle64_t &L, GlobalValue::GUID R) { return L < R; });
+  if (I == GUIDs + NumGUIDs || *I != GUID)
+    return make_range(summary_iterator(this, 0), summary_iterator(this, 0));
+  size_t Pos = I - GUIDs;
+  return make_range(summary_iterator(this, GUIDSummaryStarts[Pos]),
+                    summary_iterator(this, GUIDSummaryStarts[Pos + 1]));
+}
+
+Optional<FlatSummaryIndex::Summary>
+FlatSummaryIndex::findSummaryInModule(GlobalValue::GUID GUID,
+                                      StringRef ModulePath) const {
+  for (Summary S : lookup(GUID))
+    if (S.getModulePath() == ModulePath)
+      return S;
+  return None;
+}
+
+GlobalValue::GUID FlatSummaryIndex::getGUIDForSummary(uint32_t Idx) const {
+  const ulittle32_t *I = std::upper_bound(
+      GUIDSummaryStarts, GUIDSummaryStarts + NumGUIDs, Idx,
+      [](uint32_t L, const ulittle32_t &R) { return L < R; });
+  return GUIDs[I - GUIDSummaryStarts - 1];
+}
+
+Expected<GlobalValueSummary *>
+FlatSummaryIndex::materializeSummary(uint32_t Idx,
+                                     ModuleSummaryIndex &Index) const {
+  Summary S(this, Idx);
+  // create() checked the entries locating other entries, not the kinds.
+  switch (S.getKind()) {
+  case GlobalValueSummary::FunctionKind:
+  case GlobalValueSummary::GlobalVarKind:
+  case GlobalValueSummary::AliasKind:
+    break;
+  default:
+    return malformedError("unknown summary kind " +
+                          Twine(unsigned(S.getKind())));
+  }
+
+  GlobalValue::GUID GUID = getGUIDForSummary(Idx);
+  if (GlobalValueSummary *Existing =
+          Index.findSummaryInModule(GUID, S.getModulePath()))
+    return Existing;
+
+  uint32_t Module = S.getModule();
+  StringRef ModulePath =
+      Index
+          .addModulePath(getModulePath(Module), getModuleId(Module),
+                         getModuleHash(Module))
+          ->first();
+  std::vector<ValueInfo> Refs;
+  for (uint64_t Ref : S.refs())
+    Refs.push_back(Ref);
+
+  std::unique_ptr<GlobalValueSummary> GVS;
+  switch (S.getKind()) {
+  case GlobalValueSummary::FunctionKind: {
+    std::vector<FunctionSummary::EdgeTy> Calls;
+    for (uint32_t I = 0, E = S.getNumCalls(); I != E; ++I) {
+      CallEdge Call = S.getCall(I);
+      Calls.push_back({Call.Callee, CalleeInfo(Call.Hotness)});
+    }
+
+    // Decode the type information, checking that every list stays within
+    // the range of the summary.
+    ArrayRef<ulittle64_t> Info = makeArrayRef(
+        TypeInfo + SummaryTypeInfoStarts[Idx],
+        TypeInfo + SummaryTypeInfoStarts[Idx + 1]);
+    bool Truncated = false;
+    auto Read = [&]() -> uint64_t {
+      if (Info.empty()) {
+        Truncated = true;
+        return 0;
+      }
+      uint64_t V = Info.front();
+      Info = Info.drop_front();
+      return V;
+    };
+    // Read a list length, bounded by what is left so that a corrupt length
+    // does not make us allocate or loop for nothing.
+    auto ReadSize = [&]() -> uint64_t {
+      uint64_t N = Read();
+      if (N > Info.size()) {
+        Truncated = true;
+        return 0;
+      }
+      return N;
+    };
+    std::vector<GlobalValue::GUID> TypeTests;
+    std::vector<FunctionSummary::VFuncId> VCalls[2];
+    std::vector<FunctionSummary::ConstVCall> ConstVCalls[2];
+    if (!Info.empty()) {
+      for (uint64_t I = 0, E = ReadSize(); I != E; ++I)
+        TypeTests.push_back(Read());
+      for (auto &List : VCalls)
+        for (uint64_t I = 0, E = ReadSize(); I != E && !Truncated; ++I) {
+          uint64_t GUID = Read();
+          List.push_back({GUID, Read()});
+        }
+      for (auto &List : ConstVCalls)
+        for (uint64_t I = 0, E = ReadSize(); I != E && !Truncated; ++I) {
+          FunctionSummary::ConstVCall VC;
+          VC.VFunc.GUID = Read();
+          VC.VFunc.Offset = Read();
+          for (uint64_t J = 0, NumArgs = ReadSize(); J != NumArgs; ++J)
+            VC.Args.push_back(Read());
+          List.push_back(std::move(VC));
+        }
+      if (Truncated || !Info.empty())
+        return malformedError("inconsistent type information");
+    }
+
+    GVS = llvm::make_unique<FunctionSummary>(
+        S.getFlags(), S.getInstCount(), std::move(Refs), std::move(Calls),
+        std::move(TypeTests), std::move(VCalls[0]), std::move(VCalls[1]),
+        std::move(ConstVCalls[0]), std::move(ConstVCalls[1]));
+    break;
+  }
+  case GlobalValueSummary::GlobalVarKind:
+    GVS = llvm::make_unique<GlobalVarSummary>(S.getFlags(), std::move(Refs));
+    break;
+  case GlobalValueSummary::AliasKind: {
+    auto AS = llvm::make_unique<AliasSummary>(S.getFlags(), std::move(Refs));
+    if (SummaryAliasees[Idx] != NoAliasee) {
+      // create() made sure the aliasee is not an alias, so this recursion
+      // stops there.
+      Expected<GlobalValueSummary *> Aliasee =
+          materializeSummary(SummaryAliasees[Idx], Index);
+      if (!Aliasee)
+        return Aliasee.takeError();
+      AS->setAliasee(*Aliasee);
+    }
+    GVS = std::move(AS);
+    break;
+  }
+  }
+  GVS->setModulePath(ModulePath);
+  GVS->setOriginalName(S.getOriginalName());
+  GlobalValueSummary *Result = GVS.get();
+  Index.addGlobalValueSummary(GUID, std::move(GVS));
+  return Result;
+}
+
+Error FlatSummaryIndex::materialize(GlobalValue::GUID GUID,
+                                    ModuleSummaryIndex &Index) const {
+  for (Summary S : lookup(GUID)) {
+    Expected<GlobalValueSummary *> GVS =
+        materializeSummary(S.getIndex(), Index);
+    if (!GVS)
+      return GVS.takeError();
+  }
+  return Error::success();
+}
+
+Error FlatSummaryIndex::materializeForModule(StringRef ModulePath,
+                                             ModuleSummaryIndex &Index) const {
+  uint32_t Module = 0;
+  while (Module != NumModules && getModulePath(Module) != ModulePath)
+    ++Module;
+  if (Module == NumModules)
+    return Error::success();
+
+  // Start from the values defined in the module, and follow the call edges.
+  DenseSet<GlobalValue::GUID> Visited;
+  std::vector<GlobalValue::GUID> Worklist;
+  for (uint32_t I = 0; I != NumSummaries; ++I)
+    if (SummaryModules[I] == Module) {
+      GlobalValue::GUID GUID = getGUIDForSummary(I);
+      if (Visited.insert(GUID).second)
+        Worklist.push_back(GUID);
+    }
+  while (!Worklist.empty()) {
+    GlobalValue::GUID GUID = Worklist.back();
+    Worklist.pop_back();
+    if (Error E = materialize(GUID, Index))
+      return E;
+    for (Summary S : lookup(GUID)) {
+      // The importer looks through aliases at their aliasee.
+      if (S.getKind() == GlobalValueSummary::AliasKind &&
+          SummaryAliasees[S.getIndex()] != NoAliasee)
+        S = S.getAliasee();
+      if (S.getKind() != GlobalValueSummary::FunctionKind)
+        continue;
+      for (uint32_t I = 0, E = S.getNumCalls(); I != E; ++I) {
+        GlobalValue::GUID Callee = S.getCall(I).Callee;
+        if (Visited.insert(Callee).second)
+          Worklist.push_back(Callee);
+      }
+    }
+  }
+  return Error::success();
+}
+
+GlobalValueSummary::SummaryKind
+FlatSummaryIndex::Summary::getKind() const {
+  return static_cast<GlobalValueSummary::SummaryKind>(
+      Index->SummaryFlags[Idx] >> KindShift);
+}
+
+GlobalValueSummary::GVFlags FlatSummaryIndex::Summary::getFlags() const {
+  return GlobalValueSummary::GVFlags(getLinkage(), notEligibleToImport(),
+                                     liveRoot());
+}
+
+GlobalValue::LinkageTypes FlatSummaryIndex::Summary::getLinkage() const {
+  return static_cast<GlobalValue::LinkageTypes>(Index->SummaryFlags[Idx] &
+                                                LinkageMask);
+}
+
+bool FlatSummaryIndex::Summary::notEligibleToImport() const {
+  return Index->SummaryFlags[Idx] & NotEligibleToImportBit;
+}
+
+bool FlatSummaryIndex::Summary::liveRoot() const {
+  return Index->SummaryFlags[Idx] & LiveRootBit;
+}
+
+GlobalValue::GUID FlatSummaryIndex::Summary::getOriginalName() const {
+  return Index->SummaryOriginalNames[Idx];
+}
+
+uint32_t FlatSummaryIndex::Summary::getModule() const {
+  return Index->SummaryModules[Idx];
+}
+
+StringRef FlatSummaryIndex::Summary::getModulePath() const {
+  return Index->getModulePath(getModule());
+}
+
+uint32_t FlatSummaryIndex::Summary::getInstCount() const {
+  return Index->SummaryInstCounts[Idx];
+}
+
+ArrayRef<FlatSummaryIndex::ulittle64_t>
+FlatSummaryIndex::Summary::refs() const {
+  uint32_t Begin = Index->SummaryRefStarts[Idx];
+  uint32_t End = Index->SummaryRefStarts[Idx + 1];
+  return makeArrayRef(Index->RefGUIDs + Begin, End - Begin);
+}
+
+uint32_t FlatSummaryIndex::Summary::getNumCalls() const {
+  return Index->SummaryCallStarts[Idx + 1] - Index->SummaryCallStarts[Idx];
+}
+
+FlatSummaryIndex::CallEdge
+FlatSummaryIndex::Summary::getCall(uint32_t I) const {
+  assert(I < getNumCalls() && "Call out of range");
+  uint32_t Pos = Index->SummaryCallStarts[Idx] + I;
+  return {Index->CallGUIDs[Pos],
+          static_cast<CalleeInfo::HotnessType>(Index->CallHotness[Pos])};
+}
+
+FlatSummaryIndex::Summary FlatSummaryIndex::Summary::getAliasee() const {
+  assert(getKind() == GlobalValueSummary::AliasKind && "Not an alias");
+  assert(Index->SummaryAliasees[Idx] != NoAliasee && "Missing aliasee");
+  return Summary(Index, Index->SummaryAliasees[Idx]);
+}
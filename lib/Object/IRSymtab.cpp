@@ -0,0 +1,405 @@
+//===- IRSymtab.cpp - Symbol table of bitcode files -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Object/IRSymtab.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Mangler.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Object/ModuleSymbolTable.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace irsymtab;
+
+namespace {
+
+/// Accumulates the contents of a table, and lays them out in build().
+struct Builder {
+  SmallVector<char, 0> &Symtab;
+  Builder(SmallVector<char, 0> &Symtab) : Symtab(Symtab) {}
+
+  std::vector<storage::Module> Mods;
+  std::vector<storage::Comdat> Comdats;
+  std::vector<storage::Symbol> Syms;
+  storage::Header Hdr;
+
+  /// The strings, and the offset of each of them in StrtabData. Mangled names
+  /// and IR names are often the same, so they are only stored once.
+  std::string StrtabData;
+  StringMap<unsigned> StrtabOffsets;
+
+  std::string COFFLinkerOpts;
+  raw_string_ostream COFFLinkerOptsOS{COFFLinkerOpts};
+
+  Mangler Mang;
+
+  void setStr(storage::Str &S, StringRef Value) {
+    auto P = StrtabOffsets.insert(std::make_pair(Value, StrtabData.size()));
+    if (P.second)
+      StrtabData += Value;
+    S.Offset = P.first->second;
+    S.Size = Value.size();
+  }
+
+  Error addModule(Module *M);
+  void addSymbol(const ModuleSymbolTable &Msymtab,
+                 const DenseMap<const Comdat *, unsigned> &ComdatMap,
+                 const SmallPtrSet<GlobalValue *, 8> &Used,
+                 ModuleSymbolTable::Symbol Sym);
+
+  Error build(ArrayRef<Module *> Mods);
+};
+
+} // end anonymous namespace
+
+Error Builder::addModule(Module *M) {
+  if (Error Err = M->materializeMetadata())
+    return Err;
+
+  SmallPtrSet<GlobalValue *, 8> Used;
+  collectUsedGlobalVariables(*M, Used, /*CompilerUsed*/ false);
+
+  DenseMap<const Comdat *, unsigned> ComdatMap;
+  for (const auto &C : M->getComdatSymbolTable()) {
+    ComdatMap.insert(std::make_pair(&C.second, Comdats.size()));
+    storage::Comdat Comdat;
+    setStr(Comdat.Name, C.first());
+    Comdats.push_back(Comdat);
+  }
+
+  ModuleSymbolTable Msymtab;
+  Msymtab.addModule(M);
+
+  storage::Module Mod;
+  Mod.Begin = Syms.size();
+  for (ModuleSymbolTable::Symbol Msym : Msymtab.symbols())
+    addSymbol(Msymtab, ComdatMap, Used, Msym);
+  Mod.End = Syms.size();
+  Mods.push_back(Mod);
+
+  if (Metadata *Val = M->getModuleFlag("Linker Options")) {
+    MDNode *LinkerOptions = cast<MDNode>(Val);
+    for (const MDOperand &MDOptions : LinkerOptions->operands())
+      for (const MDOperand &MDOption : cast<MDNode>(MDOptions)->operands())
+        COFFLinkerOptsOS << " " << cast<MDString>(MDOption)->getString();
+  }
+
+  // Synthesize export flags for symbols with dllexport storage.
+  const Triple TT(M->getTargetTriple());
+  for (ModuleSymbolTable::Symbol Msym : Msymtab.symbols())
+    if (auto *GV = Msym.dyn_cast<GlobalValue *>())
+      emitLinkerFlagsForGlobalCOFF(COFFLinkerOptsOS, GV, TT, Mang);
+
+  return Error::success();
+}
+
+void Builder::addSymbol(const ModuleSymbolTable &Msymtab,
+                        const DenseMap<const Comdat *, unsigned> &ComdatMap,
+                        const SmallPtrSet<GlobalValue *, 8> &Used,
+                        ModuleSymbolTable::Symbol Msym) {
+  uint32_t Flags = Msymtab.getSymbolFlags(Msym);
+  if (!(Flags & object::BasicSymbolRef::SF_Global) ||
+      (Flags & object::BasicSymbolRef::SF_FormatSpecific))
+    return;
+
+  storage::Symbol Sym;
+  SmallString<64> Name;
+  {
+    raw_svector_ostream OS(Name);
+    Msymtab.printSymbolName(OS, Msym);
+  }
+  setStr(Sym.Name, Name);
+  setStr(Sym.IRName, "");
+  setStr(Sym.COFFWeakExternFallbackName, "");
+  Sym.ComdatIndex = -1;
+  Sym.Flags = Flags;
+  Sym.Attributes = 0;
+  Sym.CommonSize = 0;
+  Sym.CommonAlign = 0;
+
+  auto *GV = Msym.dyn_cast<GlobalValue *>();
+  if (!GV) {
+    // FIXME: Expose a thread-local flag for module asm symbols.
+    Syms.push_back(Sym);
+    return;
+  }
+
+  setStr(Sym.IRName, GV->getName());
+
+  uint32_t Attributes = GV->getVisibility()
+                        << storage::Symbol::FB_visibility;
+  Attributes |= 1 << storage::Symbol::FB_has_gv;
+  if (Used.count(GV))
+    Attributes |= 1 << storage::Symbol::FB_used;
+  if (GV->isThreadLocal())
+    Attributes |= 1 << storage::Symbol::FB_tls;
+  if (GV->hasGlobalUnnamedAddr())
+    Attributes |= 1 << storage::Symbol::FB_unnamed_addr;
+  if (GV->canBeOmittedFromSymbolTable())
+    Attributes |= 1 << storage::Symbol::FB_may_omit;
+  Sym.Attributes = Attributes;
+
+  if (Flags & object::BasicSymbolRef::SF_Common) {
+    Sym.CommonSize = GV->getParent()->getDataLayout().getTypeAllocSize(
+        GV->getValueType());
+    Sym.CommonAlign = GV->getAlignment();
+  }
+
+  // Aliases point to an arbitrary ConstantExpr, which might not let us find
+  // the object they alias, and its comdat. That is an error for the linker if
+  // it asks for the comdat of the symbol.
+  if (const GlobalObject *GO = GV->getBaseObject()) {
+    if (const Comdat *C = GO->getComdat())
+      Sym.ComdatIndex = ComdatMap.lookup(C);
+  } else {
+    Sym.ComdatIndex = -2;
+  }
+
+  if ((Flags & object::BasicSymbolRef::SF_Weak) &&
+      (Flags & object::BasicSymbolRef::SF_Indirect)) {
+    if (auto *Fallback = dyn_cast<GlobalValue>(
+            cast<GlobalAlias>(GV)->getAliasee()->stripPointerCasts())) {
+      std::string FallbackName;
+      raw_string_ostream OS(FallbackName);
+      Msymtab.printSymbolName(OS, Fallback);
+      setStr(Sym.COFFWeakExternFallbackName, OS.str());
+    }
+  }
+
+  Syms.push_back(Sym);
+}
+
+template <typename T>
+static void writeRange(SmallVector<char, 0> &Symtab, storage::Range<T> &R,
+                       const std::vector<T> &Objs) {
+  R.Offset = Symtab.size();
+  R.Size = Objs.size();
+  Symtab.append(reinterpret_cast<const char *>(Objs.data()),
+                reinterpret_cast<const char *>(Objs.data() + Objs.size()));
+}
+
+/// The producer recorded in the tables this version writes. The
+/// LLVM_OVERRIDE_PRODUCER environment variable replaces it, which lets tests
+/// write a table that looks stale.
+static std::string getExpectedProducerName() {
+  if (Optional<std::string> Override =
+          sys::Process::GetEnv("LLVM_OVERRIDE_PRODUCER"))
+    return *Override;
+  return LLVM_VERSION_STRING;
+}
+
+Error Builder::build(ArrayRef<Module *> IRMods) {
+  assert(!IRMods.empty());
+  setStr(Hdr.Producer, getExpectedProducerName());
+  setStr(Hdr.TargetTriple, IRMods[0]->getTargetTriple());
+  setStr(Hdr.SourceFileName, IRMods[0]->getSourceFileName());
+
+  for (Module *M : IRMods)
+    if (Error Err = addModule(M))
+      return Err;
+
+  COFFLinkerOptsOS.flush();
+  setStr(Hdr.COFFLinkerOpts, COFFLinkerOpts);
+
+  // The strings go last, so their offsets are only known once the other
+  // parts are laid out.
+  Hdr.Version = storage::Header::kCurrentVersion;
+  Symtab.resize(sizeof(storage::Header));
+  writeRange(Symtab, Hdr.Modules, Mods);
+  writeRange(Symtab, Hdr.Comdats, Comdats);
+  writeRange(Symtab, Hdr.Symbols, Syms);
+
+  uint32_t StrtabOffset = Symtab.size();
+  auto Relocate = [&](storage::Str &S) { S.Offset = S.Offset + StrtabOffset; };
+  Relocate(Hdr.Producer);
+  Relocate(Hdr.TargetTriple);
+  Relocate(Hdr.SourceFileName);
+  Relocate(Hdr.COFFLinkerOpts);
+  auto *StoredComdats =
+      reinterpret_cast<storage::Comdat *>(Symtab.data() + Hdr.Comdats.Offset);
+  for (unsigned I = 0; I != Comdats.size(); ++I)
+    Relocate(StoredComdats[I].Name);
+  auto *StoredSyms =
+      reinterpret_cast<storage::Symbol *>(Symtab.data() + Hdr.Symbols.Offset);
+  for (unsigned I = 0; I != Syms.size(); ++I) {
+    Relocate(StoredSyms[I].Name);
+    Relocate(StoredSyms[I].IRName);
+    Relocate(StoredSyms[I].COFFWeakExternFallbackName);
+  }
+  *reinterpret_cast<storage::Header *>(Symtab.data()) = Hdr;
+
+  Symtab.append(StrtabData.begin(), StrtabData.end());
+  return Error::success();
+}
+
+Error irsymtab::build(ArrayRef<Module *> Mods, SmallVector<char, 0> &Symtab) {
+  return Builder(Symtab).build(Mods);
+}
+
+static Error malformedError(const Twine &Msg) {
+  return make_error<StringError>("Malformed bitcode symbol table: " + Msg,
+                                 object::object_error::parse_failed);
+}
+
+static bool isValid(StringRef Symtab, const storage::Str &S) {
+  return uint64_t(S.Offset) + S.Size <= Symtab.size();
+}
+
+template <typename T>
+static bool isValid(StringRef Symtab, const storage::Range<T> &R) {
+  return uint64_t(R.Offset) + uint64_t(R.Size) * sizeof(T) <= Symtab.size();
+}
+
+Expected<Reader> Reader::create(StringRef Symtab) {
+  if (Symtab.size() < sizeof(storage::Header))
+    return malformedError("truncated header");
+
+  Reader R;
+  R.Symtab = Symtab;
+  R.Header = reinterpret_cast<const storage::Header *>(Symtab.data());
+  const storage::Header &Hdr = *R.Header;
+  if (Hdr.Version != storage::Header::kCurrentVersion)
+    return make_error<StringError>("Unsupported bitcode symbol table version",
+                                   object::object_error::invalid_file_type);
+
+  if (!isValid(Symtab, Hdr.Modules) || !isValid(Symtab, Hdr.Comdats) ||
+      !isValid(Symtab, Hdr.Symbols) || !isValid(Symtab, Hdr.Producer) ||
+      !isValid(Symtab, Hdr.TargetTriple) ||
+      !isValid(Symtab, Hdr.SourceFileName) ||
+      !isValid(Symtab, Hdr.COFFLinkerOpts))
+    return malformedError("out of bounds header field");
+
+  // LTO walks the symbols of a module in lockstep with its global values, so
+  // every symbol must belong to exactly one module.
+  uint32_t NumSyms = Hdr.Symbols.Size;
+  uint32_t NextBegin = 0;
+  for (const storage::Module &M : Hdr.Modules.get(Symtab)) {
+    if (M.Begin != NextBegin || M.Begin > M.End || M.End > NumSyms)
+      return malformedError("invalid module symbol range");
+    NextBegin = M.End;
+  }
+  if (NextBegin != NumSyms)
+    return malformedError("symbols outside of any module");
+
+  for (const storage::Comdat &C : Hdr.Comdats.get(Symtab))
+    if (!isValid(Symtab, C.Name))
+      return malformedError("out of bounds comdat name");
+
+  int NumComdats = Hdr.Comdats.Size;
+  for (const storage::Symbol &S : Hdr.Symbols.get(Symtab)) {
+    int ComdatIndex = S.ComdatIndex;
+    if (!isValid(Symtab, S.Name) || !isValid(Symtab, S.IRName) ||
+        !isValid(Symtab, S.COFFWeakExternFallbackName) || ComdatIndex < -2 ||
+        ComdatIndex >= NumComdats)
+      return malformedError("invalid symbol");
+  }
+
+  return R;
+}
+
+unsigned Reader::getNumModules() const { return Header->Modules.Size; }
+
+std::pair<size_t, size_t> Reader::getModuleSymbols(unsigned I) const {
+  const storage::Module &M = Header->Modules.get(Symtab)[I];
+  return {M.Begin, M.End};
+}
+
+size_t Reader::getNumSymbols() const { return Header->Symbols.Size; }
+
+Symbol Reader::getSymbol(size_t I) const {
+  const storage::Symbol &S = Header->Symbols.get(Symtab)[I];
+  Symbol Sym;
+  Sym.Name = S.Name.get(Symtab);
+  Sym.IRName = S.IRName.get(Symtab);
+  Sym.COFFWeakExternFallbackName = S.COFFWeakExternFallbackName.get(Symtab);
+  Sym.ComdatIndex = int32_t(uint32_t(S.ComdatIndex));
+  Sym.Flags = S.Flags;
+  Sym.Attributes = S.Attributes;
+  Sym.CommonSize = S.CommonSize;
+  Sym.CommonAlign = S.CommonAlign;
+  return Sym;
+}
+
+std::vector<StringRef> Reader::getComdatTable() const {
+  std::vector<StringRef> ComdatTable;
+  for (const storage::Comdat &C : Header->Comdats.get(Symtab))
+    ComdatTable.push_back(C.Name.get(Symtab));
+  return ComdatTable;
+}
+
+StringRef Reader::getProducer() const {
+  return Header->Producer.get(Symtab);
+}
+
+StringRef Reader::getTargetTriple() const {
+  return Header->TargetTriple.get(Symtab);
+}
+
+StringRef Reader::getSourceFileName() const {
+  return Header->SourceFileName.get(Symtab);
+}
+
+StringRef Reader::getCOFFLinkerOpts() const {
+  return Header->COFFLinkerOpts.get(Symtab);
+}
+
+Expected<FileContents> irsymtab::readBitcode(MemoryBufferRef BC) {
+  Expected<BitcodeFileContents> BFCOrErr = getBitcodeFileContents(BC);
+  if (!BFCOrErr)
+    return BFCOrErr.takeError();
+
+  FileContents FC;
+  FC.Mods = std::move(BFCOrErr->Mods);
+  if (FC.Mods.empty())
+    return make_error<StringError>("Bitcode file does not contain any modules",
+                                   inconvertibleErrorCode());
+
+  // A table written by another version, or that does not cover every module
+  // of the file (say, after concatenating the modules of several files), is
+  // built again below.
+  if (!BFCOrErr->Symtab.empty()) {
+    Expected<Reader> ROrErr = Reader::create(BFCOrErr->Symtab);
+    if (ROrErr && ROrErr->getNumModules() == FC.Mods.size() &&
+        ROrErr->getProducer() == getExpectedProducerName()) {
+      FC.TheReader = *ROrErr;
+      return std::move(FC);
+    }
+    consumeError(ROrErr.takeError());
+  }
+
+  LLVMContext Ctx;
+  std::vector<std::unique_ptr<Module>> OwnedMods;
+  std::vector<Module *> Mods;
+  for (BitcodeModule &BM : FC.Mods) {
+    Expected<std::unique_ptr<Module>> MOrErr =
+        BM.getLazyModule(Ctx, /*ShouldLazyLoadMetadata*/ true,
+                         /*IsImporting*/ false);
+    if (!MOrErr)
+      return MOrErr.takeError();
+    Mods.push_back(MOrErr->get());
+    OwnedMods.push_back(std::move(*MOrErr));
+  }
+
+  if (Error Err = build(Mods, FC.OwnedSymtab))
+    return std::move(Err);
+
+  Expected<Reader> ROrErr = Reader::create(
+      StringRef(FC.OwnedSymtab.data(), FC.OwnedSymtab.size()));
+  if (!ROrErr)
+    return ROrErr.takeError();
+  FC.TheReader = *ROrErr;
+  return std::move(FC);
+}
@@ -21,6 +21,8 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
@@ -256,28 +258,265 @@ Expected<std::unique_ptr<CoverageMapping>> CoverageMapping::load(
   return std::move(Coverage);
 }
 
+namespace {
+/// \brief The identifier and version of the coverage mapping cache format.
+const char CacheMagic[8] = {'L', 'L', 'V', 'M', 'C', 'O', 'V', 'C'};
+const uint32_t CacheVersion = 1;
+
+/// \brief Reads the little-endian fields written by
+/// CoverageMapping::writeCache(), and records whether the buffer was too
+/// short.
+class CacheReader {
+  StringRef Data;
+  bool Failed = false;
+
+public:
+  CacheReader(StringRef Data) : Data(Data) {}
+
+  bool failed() const { return Failed; }
+  bool atEnd() const { return Data.empty(); }
+
+  template <typename T> T read() {
+    if (Failed || Data.size() < sizeof(T)) {
+      Failed = true;
+      return T();
+    }
+    T Value = support::endian::read<T, support::little, support::unaligned>(
+        Data.data());
+    Data = Data.drop_front(sizeof(T));
+    return Value;
+  }
+
+  StringRef readString() {
+    uint32_t Size = read<uint32_t>();
+    if (Failed || Data.size() < Size) {
+      Failed = true;
+      return StringRef();
+    }
+    StringRef Str = Data.take_front(Size);
+    Data = Data.drop_front(Size);
+    return Str;
+  }
+};
+} // end anonymous namespace
+
+void CoverageMapping::writeCache(raw_ostream &OS) const {
+  support::endian::Writer<support::little> W(OS);
+  auto WriteString = [&](StringRef Str) {
+    W.write<uint32_t>(Str.size());
+    OS << Str;
+  };
+
+  // Functions mostly share a few files, store each filename once.
+  std::vector<StringRef> Filenames;
+  StringMap<uint32_t> FilenameIndices;
+  for (const auto &Function : Functions)
+    for (const auto &Filename : Function.Filenames)
+      if (FilenameIndices.insert(std::make_pair(Filename, Filenames.size()))
+              .second)
+        Filenames.push_back(Filename);
+
+  OS.write(CacheMagic, sizeof(CacheMagic));
+  W.write<uint32_t>(CacheVersion);
+  W.write<uint32_t>(MismatchedFunctionCount);
+  W.write<uint32_t>(Filenames.size());
+  for (StringRef Filename : Filenames)
+    WriteString(Filename);
+  W.write<uint64_t>(Functions.size());
+  for (const auto &Function : Functions) {
+    WriteString(Function.Name);
+    W.write<uint64_t>(Function.ExecutionCount);
+    W.write<uint32_t>(Function.Filenames.size());
+    for (const auto &Filename : Function.Filenames)
+      W.write<uint32_t>(FilenameIndices[Filename]);
+    W.write<uint32_t>(Function.CountedRegions.size());
+    for (const auto &Region : Function.CountedRegions) {
+      W.write<uint32_t>(Region.Count.getKind());
+      W.write<uint32_t>(Region.Count.getCounterID());
+      W.write<uint32_t>(Region.FileID);
+      W.write<uint32_t>(Region.ExpandedFileID);
+      W.write<uint32_t>(Region.LineStart);
+      W.write<uint32_t>(Region.ColumnStart);
+      W.write<uint32_t>(Region.LineEnd);
+      W.write<uint32_t>(Region.ColumnEnd);
+      W.write<uint32_t>(Region.Kind);
+      W.write<uint64_t>(Region.ExecutionCount);
+    }
+  }
+}
+
+Expected<std::unique_ptr<CoverageMapping>>
+CoverageMapping::readCache(MemoryBufferRef Buffer) {
+  auto Malformed = [] {
+    return make_error<CoverageMapError>(coveragemap_error::malformed);
+  };
+  StringRef Data = Buffer.getBuffer();
+  if (!Data.startswith(StringRef(CacheMagic, sizeof(CacheMagic))))
+    return make_error<CoverageMapError>(coveragemap_error::no_data_found);
+  CacheReader R(Data.drop_front(sizeof(CacheMagic)));
+  if (R.read<uint32_t>() != CacheVersion)
+    return make_error<CoverageMapError>(
+        coveragemap_error::unsupported_version);
+
+  auto Coverage = std::unique_ptr<CoverageMapping>(new CoverageMapping());
+  Coverage->MismatchedFunctionCount = R.read<uint32_t>();
+  std::vector<StringRef> Filenames(R.read<uint32_t>());
+  for (StringRef &Filename : Filenames)
+    Filename = R.readString();
+  if (R.failed())
+    return Malformed();
+
+  uint64_t NumFunctions = R.read<uint64_t>();
+  // Every function takes at least 16 bytes, don't trust a larger count.
+  if (R.failed() || NumFunctions > Data.size() / 16)
+    return Malformed();
+  Coverage->Functions.reserve(NumFunctions);
+  SmallVector<StringRef, 4> FunctionFilenames;
+  for (uint64_t I = 0; I != NumFunctions; ++I) {
+    StringRef Name = R.readString();
+    uint64_t ExecutionCount = R.read<uint64_t>();
+    FunctionFilenames.resize(R.read<uint32_t>());
+    for (StringRef &Filename : FunctionFilenames) {
+      uint32_t Index = R.read<uint32_t>();
+      if (R.failed() || Index >= Filenames.size())
+        return Malformed();
+      Filename = Filenames[Index];
+    }
+    if (R.failed())
+      return Malformed();
+
+    FunctionRecord Function(Name, FunctionFilenames);
+    Function.ExecutionCount = ExecutionCount;
+    uint32_t NumRegions = R.read<uint32_t>();
+    for (uint32_t J = 0; J != NumRegions && !R.failed(); ++J) {
+      uint32_t CountKind = R.read<uint32_t>();
+      uint32_t CountID = R.read<uint32_t>();
+      uint32_t FileID = R.read<uint32_t>();
+      uint32_t ExpandedFileID = R.read<uint32_t>();
+      uint32_t LineStart = R.read<uint32_t>();
+      uint32_t ColumnStart = R.read<uint32_t>();
+      uint32_t LineEnd = R.read<uint32_t>();
+      uint32_t ColumnEnd = R.read<uint32_t>();
+      uint32_t Kind = R.read<uint32_t>();
+      uint64_t RegionCount = R.read<uint64_t>();
+      if (CountKind > Counter::Expression ||
+          Kind > CounterMappingRegion::SkippedRegion ||
+          FileID >= FunctionFilenames.size())
+        return Malformed();
+      Counter Count;
+      if (CountKind == Counter::CounterValueReference)
+        Count = Counter::getCounter(CountID);
+      else if (CountKind == Counter::Expression)
+        Count = Counter::getExpression(CountID);
+      CounterMappingRegion Region(
+          Count, FileID, ExpandedFileID, LineStart, ColumnStart, LineEnd,
+          ColumnEnd, static_cast<CounterMappingRegion::RegionKind>(Kind));
+      Function.CountedRegions.emplace_back(Region, RegionCount);
+    }
+    if (R.failed() || Function.CountedRegions.empty())
+      return Malformed();
+
+    Coverage->FunctionNames.insert(Function.Name);
+    Coverage->Functions.push_back(std::move(Function));
+  }
+  if (!R.atEnd())
+    return Malformed();
+  return std::move(Coverage);
+}
+
+/// \brief Returns the path of the cache file for the given input buffers.
+static std::string getCachePath(StringRef CacheDirectory, StringRef Arch,
+                                ArrayRef<std::unique_ptr<MemoryBuffer>> Objects,
+                                const MemoryBuffer &Profile) {
+  MD5 Hasher;
+  auto AddString = [&](StringRef Str) {
+    uint64_t Size = Str.size();
+    Hasher.update(ArrayRef<uint8_t>(reinterpret_cast<uint8_t *>(&Size),
+                                    sizeof(Size)));
+    Hasher.update(Str);
+  };
+  Hasher.update(ArrayRef<uint8_t>(
+      reinterpret_cast<const uint8_t *>(&CacheVersion), sizeof(CacheVersion)));
+  AddString(Arch);
+  for (const auto &Object : Objects)
+    AddString(Object->getBuffer());
+  AddString(Profile.getBuffer());
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+
+  SmallString<32> Hash;
+  MD5::stringifyResult(Result, Hash);
+  SmallString<128> Path = CacheDirectory;
+  sys::path::append(Path, "llvmcov-" + Hash + ".cache");
+  return Path.str();
+}
+
+/// \brief Atomically write \p Coverage to \p Path. Failures are ignored, the
+/// cache is only an optimization.
+static void saveToCache(const CoverageMapping &Coverage, StringRef Path) {
+  SmallString<128> TempPath;
+  int FD;
+  if (sys::fs::createUniqueFile(Path + ".tmp%%%%%%", FD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    Coverage.writeCache(OS);
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  if (sys::fs::rename(TempPath, Path))
+    sys::fs::remove(TempPath);
+}
+
 Expected<std::unique_ptr<CoverageMapping>>
 CoverageMapping::load(ArrayRef<StringRef> ObjectFilenames,
-                      StringRef ProfileFilename, StringRef Arch) {
-  auto ProfileReaderOrErr = IndexedInstrProfReader::create(ProfileFilename);
-  if (Error E = ProfileReaderOrErr.takeError())
-    return std::move(E);
-  auto ProfileReader = std::move(ProfileReaderOrErr.get());
+                      StringRef ProfileFilename, StringRef Arch,
+                      StringRef CacheDirectory) {
+  auto ProfileBufOrErr = MemoryBuffer::getFileOrSTDIN(ProfileFilename);
+  if (std::error_code EC = ProfileBufOrErr.getError())
+    return errorCodeToError(EC);
 
-  SmallVector<std::unique_ptr<CoverageMappingReader>, 4> Readers;
   SmallVector<std::unique_ptr<MemoryBuffer>, 4> Buffers;
   for (StringRef ObjectFilename : ObjectFilenames) {
     auto CovMappingBufOrErr = MemoryBuffer::getFileOrSTDIN(ObjectFilename);
     if (std::error_code EC = CovMappingBufOrErr.getError())
       return errorCodeToError(EC);
-    auto CoverageReaderOrErr =
-        BinaryCoverageReader::create(CovMappingBufOrErr.get(), Arch);
+    Buffers.push_back(std::move(CovMappingBufOrErr.get()));
+  }
+
+  std::string CachePath;
+  if (!CacheDirectory.empty()) {
+    CachePath = getCachePath(CacheDirectory, Arch, Buffers, **ProfileBufOrErr);
+    // A missing or unreadable cache file is rebuilt from the inputs.
+    if (auto CacheBufOrErr = MemoryBuffer::getFile(CachePath)) {
+      auto CoverageOrErr = readCache((*CacheBufOrErr)->getMemBufferRef());
+      if (CoverageOrErr)
+        return std::move(CoverageOrErr.get());
+      consumeError(CoverageOrErr.takeError());
+    }
+  }
+
+  auto ProfileReaderOrErr =
+      IndexedInstrProfReader::create(std::move(ProfileBufOrErr.get()));
+  if (Error E = ProfileReaderOrErr.takeError())
+    return std::move(E);
+  auto ProfileReader = std::move(ProfileReaderOrErr.get());
+
+  SmallVector<std::unique_ptr<CoverageMappingReader>, 4> Readers;
+  for (auto &Buffer : Buffers) {
+    auto CoverageReaderOrErr = BinaryCoverageReader::create(Buffer, Arch);
     if (Error E = CoverageReaderOrErr.takeError())
       return std::move(E);
     Readers.push_back(std::move(CoverageReaderOrErr.get()));
-    Buffers.push_back(std::move(CovMappingBufOrErr.get()));
   }
-  return load(Readers, *ProfileReader);
+  auto CoverageOrErr = load(Readers, *ProfileReader);
+  if (CoverageOrErr && !CachePath.empty())
+    saveToCache(**CoverageOrErr, CachePath);
+  return CoverageOrErr;
 }
 
 namespace {
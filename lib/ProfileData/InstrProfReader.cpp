@@ -14,6 +14,11 @@
 
 #include "llvm/ProfileData/InstrProfReader.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Mutex.h"
 #include <cassert>
 
 using namespace llvm;
@@ -78,6 +83,70 @@ IndexedInstrProfReader::create(const Twine &Path) {
   return IndexedInstrProfReader::create(std::move(BufferOrError.get()));
 }
 
+namespace {
+/// The readers handed out by IndexedInstrProfReader::getShared. The cache
+/// keeps them alive after their last user is done with them, so that the
+/// next module annotated with the same profile doesn't parse it again. An
+/// entry is only reused while the file on disk still has the size and
+/// modification time it had when the reader was created, and the least
+/// recently used entry is evicted once more than MaxReaders are cached.
+struct SharedReaderCache {
+  static const unsigned MaxReaders = 4;
+
+  struct Entry {
+    std::shared_ptr<IndexedInstrProfReader> Reader;
+    sys::TimePoint<> ModTime;
+    uint64_t Size = 0;
+    uint64_t LastUse = 0;
+  };
+  sys::Mutex Lock;
+  StringMap<Entry> Readers;
+  uint64_t UseCount = 0;
+};
+} // end anonymous namespace
+
+static ManagedStatic<SharedReaderCache> SharedReaders;
+
+Expected<std::shared_ptr<IndexedInstrProfReader>>
+IndexedInstrProfReader::getShared(const Twine &Path) {
+  SmallString<128> Key;
+  Path.toVector(Key);
+  sys::fs::file_status Status;
+  if (std::error_code EC = sys::fs::status(Key, Status))
+    return errorCodeToError(EC);
+
+  sys::ScopedLock Guard(SharedReaders->Lock);
+  SharedReaderCache::Entry &Cached = SharedReaders->Readers[Key];
+  Cached.LastUse = ++SharedReaders->UseCount;
+  if (Cached.Reader && Cached.ModTime == Status.getLastModificationTime() &&
+      Cached.Size == Status.getSize())
+    return Cached.Reader;
+
+  auto ReaderOrErr = create(Key);
+  if (Error E = ReaderOrErr.takeError()) {
+    SharedReaders->Readers.erase(Key);
+    return std::move(E);
+  }
+  Cached.Reader = std::move(ReaderOrErr.get());
+  Cached.ModTime = Status.getLastModificationTime();
+  Cached.Size = Status.getSize();
+  std::shared_ptr<IndexedInstrProfReader> Reader = Cached.Reader;
+
+  // Evict the least recently used reader. Its current users keep it alive.
+  if (SharedReaders->Readers.size() > SharedReaderCache::MaxReaders) {
+    auto LRU = SharedReaders->Readers.begin();
+    for (auto I = LRU, E = SharedReaders->Readers.end(); I != E; ++I)
+      if (I->second.LastUse < LRU->second.LastUse)
+        LRU = I;
+    SharedReaders->Readers.erase(LRU);
+  }
+  return std::move(Reader);
+}
+
+void IndexedInstrProfReader::releaseSharedReaders() {
+  sys::ScopedLock Guard(SharedReaders->Lock);
+  SharedReaders->Readers.clear();
+}
 
 Expected<std::unique_ptr<IndexedInstrProfReader>>
 IndexedInstrProfReader::create(std::unique_ptr<MemoryBuffer> Buffer) {
@@ -540,6 +609,70 @@ Error InstrProfReaderIndex<HashTableImpl>::getRecords(
   return Error::success();
 }
 
+bool InstrProfLookupTrait::ReadDataViews(
+    const unsigned char *D, offset_type N,
+    SmallVectorImpl<InstrProfRecordView> &Views) const {
+  // This mirrors ReadData, but only records where each piece of the payload
+  // lives instead of decoding it.
+  if (N % sizeof(uint64_t))
+    return false;
+
+  using namespace support;
+  const unsigned char *End = D + N;
+  while (D < End) {
+    InstrProfRecordView View;
+    if (D + sizeof(uint64_t) >= End)
+      return false;
+    View.Hash = endian::readNext<uint64_t, little, unaligned>(D);
+
+    uint64_t CountsSize = N / sizeof(uint64_t) - 1;
+    if (GET_VERSION(FormatVersion) != IndexedInstrProf::ProfVersion::Version1) {
+      if (D + sizeof(uint64_t) > End)
+        return false;
+      CountsSize = endian::readNext<uint64_t, little, unaligned>(D);
+    }
+    if (D + CountsSize * sizeof(uint64_t) > End)
+      return false;
+    View.Counts = makeArrayRef(
+        reinterpret_cast<const support::ulittle64_t *>(D), CountsSize);
+    D += CountsSize * sizeof(uint64_t);
+
+    if (GET_VERSION(FormatVersion) > IndexedInstrProf::ProfVersion::Version2) {
+      // The serialized ValueProfData starts with its total size. Validating
+      // the rest is left to whoever deserializes it.
+      if (D + sizeof(ValueProfData) > End)
+        return false;
+      uint32_t TotalSize =
+          endian::read<uint32_t, unaligned>(D, ValueProfDataEndianness);
+      if (TotalSize < sizeof(ValueProfData) || D + TotalSize > End)
+        return false;
+      View.ValueData = makeArrayRef(D, TotalSize);
+      D += TotalSize;
+    }
+    Views.push_back(View);
+  }
+  return true;
+}
+
+template <typename HashTableImpl>
+Error InstrProfReaderIndex<HashTableImpl>::getRecordViews(
+    StringRef FuncName, SmallVectorImpl<InstrProfRecordView> &Views) {
+  auto Iter = HashTable->find(FuncName);
+  if (Iter == HashTable->end())
+    return make_error<InstrProfError>(instrprof_error::unknown_function);
+
+  if (!HashTable->getInfoObj().ReadDataViews(Iter.getDataPtr(),
+                                             Iter.getDataLen(), Views) ||
+      Views.empty())
+    return make_error<InstrProfError>(instrprof_error::malformed);
+
+  // Name the records with the key in the buffer rather than with FuncName,
+  // which the caller may free before it is done with the records.
+  for (InstrProfRecordView &View : Views)
+    View.Name = Iter.getInternalKey();
+  return Error::success();
+}
+
 template <typename HashTableImpl>
 Error InstrProfReaderIndex<HashTableImpl>::getRecords(
     ArrayRef<InstrProfRecord> &Data) {
@@ -680,17 +813,39 @@ InstrProfSymtab &IndexedInstrProfReader::getSymtab() {
 Expected<InstrProfRecord>
 IndexedInstrProfReader::getInstrProfRecord(StringRef FuncName,
                                            uint64_t FuncHash) {
-  ArrayRef<InstrProfRecord> Data;
-  Error Err = Index->getRecords(FuncName, Data);
-  if (Err)
-    return std::move(Err);
-  // Found it. Look for counters with the right hash.
-  for (unsigned I = 0, E = Data.size(); I < E; ++I) {
-    // Check for a match and fill the vector if there is one.
-    if (Data[I].Hash == FuncHash) {
-      return std::move(Data[I]);
-    }
+  // Decode only the matching record, straight from its view. Going through
+  // the view rather than Index->getRecords also keeps this lookup free of
+  // shared state, which getShared relies on.
+  Expected<InstrProfRecordView> View =
+      getInstrProfRecordView(FuncName, FuncHash);
+  if (Error E = View.takeError())
+    return std::move(E);
+
+  InstrProfRecord Record(View->Name, View->Hash,
+                         std::vector<uint64_t>(View->Counts.begin(),
+                                               View->Counts.end()));
+  if (!View->ValueData.empty()) {
+    Expected<std::unique_ptr<ValueProfData>> VDataPtrOrErr =
+        ValueProfData::getValueProfData(View->ValueData.begin(),
+                                        View->ValueData.end(),
+                                        Index->getValueProfDataEndianness());
+    if (Error E = VDataPtrOrErr.takeError())
+      return std::move(E);
+    VDataPtrOrErr.get()->deserializeTo(Record, nullptr);
   }
+  return std::move(Record);
+}
+
+Expected<InstrProfRecordView>
+IndexedInstrProfReader::getInstrProfRecordView(StringRef FuncName,
+                                               uint64_t FuncHash) {
+  SmallVector<InstrProfRecordView, 1> Views;
+  if (Error E = Index->getRecordViews(FuncName, Views))
+    return std::move(E);
+  // Found it. Look for counters with the right hash.
+  for (const InstrProfRecordView &View : Views)
+    if (View.Hash == FuncHash)
+      return View;
   return error(instrprof_error::hash_mismatch);
 }
 
@@ -706,8 +861,6 @@ Error IndexedInstrProfReader::getFunctionCounts(StringRef FuncName,
 }
 
 Error IndexedInstrProfReader::readNextRecord(InstrProfRecord &Record) {
-  static unsigned RecordIndex = 0;
-
   ArrayRef<InstrProfRecord> Data;
 
   Error E = Index->getRecords(Data);
@@ -17,6 +17,7 @@
 #include "llvm/IR/ProfileSummary.h"
 #include "llvm/ProfileData/ProfileCommon.h"
 #include "llvm/Support/EndianStream.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/OnDiskHashTable.h"
 #include "llvm/Support/raw_ostream.h"
@@ -203,7 +204,8 @@ Error InstrProfWriter::mergeRecordsFromWriter(InstrProfWriter &&IPW) {
   return Error::success();
 }
 
-bool InstrProfWriter::shouldEncodeData(const ProfilingData &PD) {
+static bool shouldEncodeData(const InstrProfWriter::ProfilingData &PD,
+                             bool Sparse) {
   if (!Sparse)
     return true;
   for (const auto &Func : PD) {
@@ -214,6 +216,10 @@ bool InstrProfWriter::shouldEncodeData(const ProfilingData &PD) {
   return false;
 }
 
+bool InstrProfWriter::shouldEncodeData(const ProfilingData &PD) {
+  return ::shouldEncodeData(PD, Sparse);
+}
+
 static void setSummary(IndexedInstrProf::Summary *TheSummary,
                        ProfileSummary &PS) {
   using namespace IndexedInstrProf;
@@ -230,22 +236,17 @@ static void setSummary(IndexedInstrProf::Summary *TheSummary,
     TheSummary->setEntry(I, Res[I]);
 }
 
-void InstrProfWriter::writeImpl(ProfOStream &OS) {
-  OnDiskChainedHashTableGenerator<InstrProfRecordWriterTrait> Generator;
-
+// Write the header of an indexed profile and reserve the space of the hash
+// table offset and of the summary, which are patched by \c patchHeader once
+// the hash table is written.
+static void writeHeader(ProfOStream &OS, bool IsIRLevel,
+                        uint64_t &HashTableStartFieldOffset,
+                        uint64_t &SummaryOffset) {
   using namespace IndexedInstrProf;
-  InstrProfSummaryBuilder ISB(ProfileSummaryBuilder::DefaultCutoffs);
-  InfoObj->SummaryBuilder = &ISB;
-
-  // Populate the hash table generator.
-  for (const auto &I : FunctionData)
-    if (shouldEncodeData(I.getValue()))
-      Generator.insert(I.getKey(), &I.getValue());
-  // Write the header.
   IndexedInstrProf::Header Header;
   Header.Magic = IndexedInstrProf::Magic;
   Header.Version = IndexedInstrProf::ProfVersion::CurrentVersion;
-  if (ProfileKind == PF_IRLevel)
+  if (IsIRLevel)
     Header.Version |= VARIANT_MASK_IR_PROF;
   Header.Unused = 0;
   Header.HashType = static_cast<uint64_t>(IndexedInstrProf::HashType);
@@ -259,7 +260,7 @@ void InstrProfWriter::writeImpl(ProfOStream &OS) {
     OS.write(reinterpret_cast<uint64_t *>(&Header)[I]);
 
   // Save the location of Header.HashOffset field in \c OS.
-  uint64_t HashTableStartFieldOffset = OS.tell();
+  HashTableStartFieldOffset = OS.tell();
   // Reserve the space for HashOffset field.
   OS.write(0);
 
@@ -267,12 +268,17 @@ void InstrProfWriter::writeImpl(ProfOStream &OS) {
   uint32_t NumEntries = ProfileSummaryBuilder::DefaultCutoffs.size();
   uint32_t SummarySize = Summary::getSize(Summary::NumKinds, NumEntries);
   // Remember the summary offset.
-  uint64_t SummaryOffset = OS.tell();
+  SummaryOffset = OS.tell();
   for (unsigned I = 0; I < SummarySize / sizeof(uint64_t); I++)
     OS.write(0);
+}
 
-  // Write the hash table.
-  uint64_t HashTableStart = Generator.Emit(OS.OS, *InfoObj);
+static void patchHeader(ProfOStream &OS, uint64_t HashTableStartFieldOffset,
+                        uint64_t HashTableStart, uint64_t SummaryOffset,
+                        InstrProfSummaryBuilder &ISB) {
+  using namespace IndexedInstrProf;
+  uint32_t NumEntries = ProfileSummaryBuilder::DefaultCutoffs.size();
+  uint32_t SummarySize = Summary::getSize(Summary::NumKinds, NumEntries);
 
   // Allocate space for data to be serialized out.
   std::unique_ptr<IndexedInstrProf::Summary> TheSummary =
@@ -281,7 +287,6 @@ void InstrProfWriter::writeImpl(ProfOStream &OS) {
   // structure to be serialized out (to disk or buffer).
   std::unique_ptr<ProfileSummary> PS = ISB.getSummary();
   setSummary(TheSummary.get(), *PS);
-  InfoObj->SummaryBuilder = nullptr;
 
   // Now do the final patch:
   PatchItem PatchItems[] = {
@@ -293,12 +298,54 @@ void InstrProfWriter::writeImpl(ProfOStream &OS) {
   OS.patch(PatchItems, sizeof(PatchItems) / sizeof(*PatchItems));
 }
 
+void InstrProfWriter::writeImpl(ProfOStream &OS) {
+  OnDiskChainedHashTableGenerator<InstrProfRecordWriterTrait> Generator;
+
+  InstrProfSummaryBuilder ISB(ProfileSummaryBuilder::DefaultCutoffs);
+  InfoObj->SummaryBuilder = &ISB;
+
+  // Populate the hash table generator.
+  for (const auto &I : FunctionData)
+    if (shouldEncodeData(I.getValue()))
+      Generator.insert(I.getKey(), &I.getValue());
+
+  uint64_t HashTableStartFieldOffset, SummaryOffset;
+  writeHeader(OS, ProfileKind == PF_IRLevel, HashTableStartFieldOffset,
+              SummaryOffset);
+
+  // Write the hash table.
+  uint64_t HashTableStart = Generator.Emit(OS.OS, *InfoObj);
+
+  patchHeader(OS, HashTableStartFieldOffset, HashTableStart, SummaryOffset,
+              ISB);
+  InfoObj->SummaryBuilder = nullptr;
+}
+
 void InstrProfWriter::write(raw_fd_ostream &OS) {
   // Write the hash table.
   ProfOStream POS(OS);
   writeImpl(POS);
 }
 
+void InstrProfWriter::writeInStreamOrder(raw_fd_ostream &OS) {
+  std::vector<StringMapEntry<ProfilingData> *> Functions;
+  for (auto &I : FunctionData)
+    Functions.push_back(&I);
+  std::sort(Functions.begin(), Functions.end(),
+            [](const StringMapEntry<ProfilingData> *LHS,
+               const StringMapEntry<ProfilingData> *RHS) {
+              return InstrProfStreamWriter::precedes(LHS->getKey(),
+                                                     RHS->getKey());
+            });
+
+  InstrProfStreamWriter SW(OS, ProfileKind == PF_IRLevel, Sparse,
+                           Functions.size());
+  SW.setValueProfDataEndianness(InfoObj->ValueProfDataEndianness);
+  for (const StringMapEntry<ProfilingData> *I : Functions)
+    SW.addFunction(I->getKey(), I->getValue());
+  SW.finish();
+}
+
 std::unique_ptr<MemoryBuffer> InstrProfWriter::writeBuffer() {
   std::string Data;
   llvm::raw_string_ostream OS(Data);
@@ -309,6 +356,95 @@ std::unique_ptr<MemoryBuffer> InstrProfWriter::writeBuffer() {
   return MemoryBuffer::getMemBufferCopy(Data);
 }
 
+InstrProfStreamWriter::InstrProfStreamWriter(raw_fd_ostream &OS,
+                                             bool IsIRLevel, bool Sparse,
+                                             uint64_t MaxNumFunctions)
+    : OS(new ProfOStream(OS)), Sparse(Sparse),
+      InfoObj(new InstrProfRecordWriterTrait()),
+      ISB(new InstrProfSummaryBuilder(ProfileSummaryBuilder::DefaultCutoffs)) {
+  InfoObj->SummaryBuilder = ISB.get();
+  // Use the sizing of OnDiskChainedHashTableGenerator.
+  uint64_t NumBuckets =
+      MaxNumFunctions <= 2 ? 1 : NextPowerOf2(MaxNumFunctions * 4 / 3);
+  BucketOffsets.resize(NumBuckets);
+  writeHeader(*this->OS, IsIRLevel, HashTableStartFieldOffset, SummaryOffset);
+}
+
+InstrProfStreamWriter::~InstrProfStreamWriter() {
+  delete InfoObj;
+  delete OS;
+}
+
+void InstrProfStreamWriter::setValueProfDataEndianness(
+    support::endianness Endianness) {
+  InfoObj->ValueProfDataEndianness = Endianness;
+}
+
+// The bucket of a function is given by the low bits of its hash, so ordering
+// the functions by their bit-reversed hash puts the functions of a bucket
+// next to each other for any power of 2 number of buckets.
+bool InstrProfStreamWriter::precedes(StringRef LHS, StringRef RHS) {
+  uint64_t LHSKey = reverseBits(IndexedInstrProf::ComputeHash(LHS));
+  uint64_t RHSKey = reverseBits(IndexedInstrProf::ComputeHash(RHS));
+  return std::tie(LHSKey, LHS) < std::tie(RHSKey, RHS);
+}
+
+void InstrProfStreamWriter::flushBucket() {
+  if (!CurBucketLength)
+    return;
+  using namespace llvm::support;
+  assert(!BucketOffsets[CurBucket] && "Functions added out of order");
+  BucketOffsets[CurBucket] = OS->tell();
+  endian::Writer<little>(OS->OS).write<uint16_t>(CurBucketLength);
+  OS->OS << CurBucketData;
+  CurBucketLength = 0;
+  CurBucketData.clear();
+}
+
+void InstrProfStreamWriter::addFunction(
+    StringRef Name, const InstrProfWriter::ProfilingData &PD) {
+  if (!shouldEncodeData(PD, Sparse))
+    return;
+
+  uint64_t Hash = InstrProfRecordWriterTrait::ComputeHash(Name);
+  uint64_t Bucket = Hash & (BucketOffsets.size() - 1);
+  if (Bucket != CurBucket)
+    flushBucket();
+  CurBucket = Bucket;
+  assert(CurBucketLength < UINT16_MAX && "Too many functions in a bucket");
+  ++CurBucketLength;
+  ++NumEntries;
+
+  // Lay out the item as OnDiskChainedHashTableGenerator::Emit does.
+  using namespace llvm::support;
+  raw_string_ostream Out(CurBucketData);
+  endian::Writer<little>(Out).write<uint64_t>(Hash);
+  auto Len = InfoObj->EmitKeyDataLength(Out, Name, &PD);
+  InfoObj->EmitKey(Out, Name, Len.first);
+  InfoObj->EmitData(Out, Name, &PD, Len.second);
+}
+
+void InstrProfStreamWriter::finish() {
+  flushBucket();
+
+  using namespace llvm::support;
+  endian::Writer<little> LE(OS->OS);
+  // Pad with zeros so that the hash table starts at an aligned address.
+  uint64_t HashTableStart = OS->tell();
+  uint64_t N = OffsetToAlignment(HashTableStart, alignof(uint64_t));
+  HashTableStart += N;
+  while (N--)
+    LE.write<uint8_t>(0);
+
+  LE.write<uint64_t>(BucketOffsets.size());
+  LE.write<uint64_t>(NumEntries);
+  for (uint64_t Offset : BucketOffsets)
+    LE.write<uint64_t>(Offset);
+
+  patchHeader(*OS, HashTableStartFieldOffset, HashTableStart, SummaryOffset,
+              *ISB);
+}
+
 static const char *ValueProfKindStr[] = {
 #define VALUE_PROF_KIND(Enumerator, Value) #Enumerator,
 #include "llvm/ProfileData/InstrProfData.inc"
@@ -9,23 +9,129 @@
 //
 // This file implements the pruning of a directory based on least recently used.
 //
+// With a manifest, the entries of the cache are listed in llvmcache.manifest,
+// one "<last use> <size> <device>:<file> <name>" line each, times being
+// seconds since the epoch and "<device>:<file>" identifying the file the entry
+// is a link to, "-" if unknown. The clients of the cache append lines of the
+// same format to llvmcache.journal when they add or use an entry. Pruning
+// moves the journal aside, folds it into the manifest, evicts entries and
+// writes the manifest back, holding a lock so that only one process prunes at
+// a time.
+//
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/CachePruning.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Chrono.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LockFileManager.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 
 #define DEBUG_TYPE "cache-pruning"
 
-#include <set>
+#include <algorithm>
+#include <map>
 #include <system_error>
+#include <vector>
 
 using namespace llvm;
 
+static const char ManifestFileName[] = "llvmcache.manifest";
+static const char JournalFileName[] = "llvmcache.journal";
+static const char OldJournalFileName[] = "llvmcache.journal.old";
+static const char ManifestHeader[] = "llvmcache-manifest 2";
+
+/// The manifest is rebuilt from a walk of the directory when it is older than
+/// this.
+static const std::chrono::hours FullScanInterval(24);
+
+namespace {
+/// A file of the cache directory, as known to the pruning.
+struct CacheEntry {
+  std::string Name;
+  uint64_t Size;
+  /// The file the entry is a link to. Entries that are hard links to the same
+  /// file only take its size once.
+  Optional<sys::fs::UniqueID> ID;
+  /// Last use, in seconds since the epoch.
+  std::time_t LastUse;
+  /// Order in which the entry was last seen used, to break the ties between
+  /// entries used during the same second.
+  uint64_t Sequence;
+};
+
+/// The entries of a cache directory, by file name.
+class CacheEntries {
+  StringMap<CacheEntry> Entries;
+  uint64_t NextSequence = 0;
+
+public:
+  void add(StringRef Name, uint64_t Size, Optional<sys::fs::UniqueID> ID,
+           std::time_t LastUse) {
+    CacheEntry &Entry = Entries[Name];
+    if (Entry.Name.empty())
+      Entry.Name = Name;
+    else if (LastUse < Entry.LastUse)
+      LastUse = Entry.LastUse;
+    Entry.Size = Size;
+    Entry.ID = ID;
+    Entry.LastUse = LastUse;
+    Entry.Sequence = NextSequence++;
+  }
+
+  /// Add the entries listed in \p Buffer, in the manifest and journal format,
+  /// skipping malformed lines, e.g. a line being appended.
+  void addRecords(StringRef Buffer) {
+    SmallVector<StringRef, 0> Lines;
+    Buffer.split(Lines, '\n', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+    for (StringRef Line : Lines) {
+      StringRef LastUse, Size, ID, Name;
+      std::tie(LastUse, Line) = Line.split(' ');
+      std::tie(Size, Line) = Line.split(' ');
+      std::tie(ID, Name) = Line.split(' ');
+      long long LastUseValue;
+      unsigned long long SizeValue;
+      if (Name.empty() || LastUse.getAsInteger(10, LastUseValue) ||
+          Size.getAsInteger(10, SizeValue))
+        continue;
+      Optional<sys::fs::UniqueID> IDValue;
+      if (ID != "-") {
+        StringRef Device, File;
+        std::tie(Device, File) = ID.split(':');
+        uint64_t DeviceValue, FileValue;
+        if (Device.getAsInteger(10, DeviceValue) ||
+            File.getAsInteger(10, FileValue))
+          continue;
+        IDValue = sys::fs::UniqueID(DeviceValue, FileValue);
+      }
+      add(Name, SizeValue, IDValue, LastUseValue);
+    }
+  }
+
+  /// Returns the entries, least recently used first.
+  std::vector<CacheEntry> takeSortedEntries() {
+    std::vector<CacheEntry> Sorted;
+    Sorted.reserve(Entries.size());
+    for (auto &Entry : Entries)
+      Sorted.push_back(std::move(Entry.second));
+    Entries.clear();
+    std::sort(Sorted.begin(), Sorted.end(),
+              [](const CacheEntry &LHS, const CacheEntry &RHS) {
+                return std::tie(LHS.LastUse, LHS.Sequence) <
+                       std::tie(RHS.LastUse, RHS.Sequence);
+              });
+    return Sorted;
+  }
+};
+} // end anonymous namespace
+
 /// Write a new timestamp file with the given path. This is used for the pruning
 /// interval option.
 static void writeTimestampFile(StringRef TimestampFile) {
@@ -33,6 +139,136 @@ static void writeTimestampFile(StringRef TimestampFile) {
   raw_fd_ostream Out(TimestampFile.str(), EC, sys::fs::F_None);
 }
 
+/// Returns true for the files the pruning itself keeps in the cache directory.
+static bool isBookkeepingFile(StringRef FileName) {
+  return FileName.startswith("llvmcache.");
+}
+
+/// Write the "<device>:<file>" field of a record, "-" for an unknown file.
+static void writeID(raw_ostream &OS, const Optional<sys::fs::UniqueID> &ID) {
+  if (ID)
+    OS << ID->getDevice() << ':' << ID->getFile();
+  else
+    OS << '-';
+}
+
+/// Append \p Record to the file at \p Path with a single write, so that records
+/// appended concurrently are not interleaved.
+static void appendRecord(StringRef Path, StringRef Record) {
+  int FD;
+  if (sys::fs::openFileForWrite(Path, FD, sys::fs::F_Append | sys::fs::F_Text))
+    return;
+  raw_fd_ostream OS(FD, /*shouldClose=*/true, /*unbuffered=*/true);
+  OS << Record;
+}
+
+bool CachePruning::isRecordingAccesses(StringRef Path) {
+  SmallString<128> JournalPath(Path);
+  sys::path::append(JournalPath, JournalFileName);
+  // The journal only exists when the cache is pruned with a manifest.
+  return sys::fs::exists(JournalPath);
+}
+
+void CachePruning::recordAccess(StringRef Path, StringRef EntryName,
+                                uint64_t Size) {
+  if (!isRecordingAccesses(Path))
+    return;
+  SmallString<128> JournalPath(Path);
+  sys::path::append(JournalPath, JournalFileName);
+  StringRef FileName = sys::path::filename(EntryName);
+  SmallString<128> EntryPath(Path);
+  sys::path::append(EntryPath, FileName);
+  Optional<sys::fs::UniqueID> ID;
+  sys::fs::file_status Status;
+  if (!sys::fs::status(EntryPath, Status))
+    ID = Status.getUniqueID();
+  std::string Record;
+  raw_string_ostream OS(Record);
+  OS << sys::toTimeT(std::chrono::system_clock::now()) << ' ' << Size << ' ';
+  writeID(OS, ID);
+  OS << ' ' << FileName << '\n';
+  appendRecord(JournalPath, OS.str());
+}
+
+/// Read the manifest of the cache at \p Path into \p Entries, and fold in the
+/// journal, which is replaced with an empty one. \p ScanTime is set to the
+/// time of the walk of the directory the manifest derives from. Returns false
+/// if the directory has to be walked instead, i.e. there is no manifest or it
+/// is too old.
+static bool readManifest(StringRef Path, CacheEntries &Entries,
+                         std::time_t &ScanTime) {
+  using namespace std::chrono;
+
+  SmallString<128> ManifestPath(Path), JournalPath(Path), OldJournalPath(Path);
+  sys::path::append(ManifestPath, ManifestFileName);
+  sys::path::append(JournalPath, JournalFileName);
+  sys::path::append(OldJournalPath, OldJournalFileName);
+
+  bool UpToDate = false;
+  auto ManifestOrErr = MemoryBuffer::getFile(ManifestPath);
+  if (ManifestOrErr) {
+    StringRef Header, Records;
+    std::tie(Header, Records) = (*ManifestOrErr)->getBuffer().split('\n');
+    long long HeaderScanTime;
+    if (Header.consume_front(ManifestHeader) && Header.consume_front(" ") &&
+        !Header.getAsInteger(10, HeaderScanTime) &&
+        system_clock::now() - sys::toTimePoint(HeaderScanTime) <
+            FullScanInterval) {
+      Entries.addRecords(Records);
+      ScanTime = HeaderScanTime;
+      UpToDate = true;
+    }
+  }
+
+  // A journal left over by a pruning that didn't complete comes first. Then
+  // move the journal aside, and put an empty one in its place right away:
+  // clients only record accesses when there is a journal.
+  auto OldJournalOrErr = MemoryBuffer::getFile(OldJournalPath);
+  if (OldJournalOrErr)
+    Entries.addRecords((*OldJournalOrErr)->getBuffer());
+  if (!sys::fs::rename(JournalPath, OldJournalPath)) {
+    OldJournalOrErr = MemoryBuffer::getFile(OldJournalPath);
+    if (OldJournalOrErr)
+      Entries.addRecords((*OldJournalOrErr)->getBuffer());
+  }
+  appendRecord(JournalPath, "");
+  return UpToDate;
+}
+
+/// Write \p Entries as the manifest of the cache at \p Path, and drop the
+/// journal records they include.
+static void writeManifest(StringRef Path, ArrayRef<CacheEntry> Entries,
+                          std::time_t ScanTime) {
+  SmallString<128> ManifestPath(Path), OldJournalPath(Path);
+  sys::path::append(ManifestPath, ManifestFileName);
+  sys::path::append(OldJournalPath, OldJournalFileName);
+
+  int FD;
+  SmallString<128> TempPath;
+  if (sys::fs::createUniqueFile(ManifestPath + ".tmp%%%%%%", FD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << ManifestHeader << ' ' << ScanTime << '\n';
+    for (const CacheEntry &Entry : Entries) {
+      OS << Entry.LastUse << ' ' << Entry.Size << ' ';
+      writeID(OS, Entry.ID);
+      OS << ' ' << Entry.Name << '\n';
+    }
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  if (sys::fs::rename(TempPath, ManifestPath)) {
+    sys::fs::remove(TempPath);
+    return;
+  }
+  sys::fs::remove(OldJournalPath);
+}
+
 /// Prune the cache of files that haven't been accessed in a long time.
 bool CachePruning::prune() {
   using namespace std::chrono;
@@ -47,7 +283,8 @@ bool CachePruning::prune() {
   if (!isPathDir)
     return false;
 
-  if (Expiration == seconds(0) && PercentageOfAvailableSpace == 0) {
+  if (Expiration == seconds(0) && PercentageOfAvailableSpace == 0 &&
+      MaxSizeBytes == 0 && MaxEntries == 0) {
     DEBUG(dbgs() << "No pruning settings set, exit early\n");
     // Nothing will be pruned, early exit
     return false;
@@ -67,7 +304,7 @@ bool CachePruning::prune() {
       return false;
     }
   } else {
-    if (Interval == seconds(0)) {
+    if (Interval != seconds(0)) {
       // Check whether the time stamp is older than our pruning interval.
       // If not, do nothing.
       const auto TimeStampModTime = FileStatus.getLastModificationTime();
@@ -85,77 +322,120 @@ bool CachePruning::prune() {
     writeTimestampFile(TimestampFile);
   }
 
-  bool ShouldComputeSize = (PercentageOfAvailableSpace > 0);
-
-  // Keep track of space
-  std::set<std::pair<uint64_t, std::string>> FileSizes;
-  uint64_t TotalSize = 0;
-  // Helper to add a path to the set of files to consider for size-based
-  // pruning, sorted by size.
-  auto AddToFileListForSizePruning =
-      [&](StringRef Path) {
-        if (!ShouldComputeSize)
-          return;
-        TotalSize += FileStatus.getSize();
-        FileSizes.insert(
-            std::make_pair(FileStatus.getSize(), std::string(Path)));
-      };
-
-  // Walk the entire directory cache, looking for unused files.
-  std::error_code EC;
-  SmallString<128> CachePathNative;
-  sys::path::native(Path, CachePathNative);
-  // Walk all of the files within this directory.
-  for (sys::fs::directory_iterator File(CachePathNative, EC), FileEnd;
-       File != FileEnd && !EC; File.increment(EC)) {
-    // Do not touch the timestamp.
-    if (File->path() == TimestampFile)
-      continue;
-
-    // Look at this file. If we can't stat it, there's nothing interesting
-    // there.
-    if (sys::fs::status(File->path(), FileStatus)) {
-      DEBUG(dbgs() << "Ignore " << File->path() << " (can't stat)\n");
-      continue;
+  // Make sure only one process updates the manifest at a time. The others
+  // don't wait: the cache is being pruned already.
+  Optional<LockFileManager> Lock;
+  if (UseManifest) {
+    SmallString<128> ManifestPath(Path);
+    sys::path::append(ManifestPath, ManifestFileName);
+    Lock.emplace(ManifestPath);
+    if (*Lock != LockFileManager::LFS_Owned) {
+      DEBUG(dbgs() << "Cache is being pruned by another process\n");
+      return false;
     }
+  }
 
-    // If the file hasn't been used recently enough, delete it
-    const auto FileAccessTime = FileStatus.getLastAccessedTime();
-    auto FileAge = CurrentTime - FileAccessTime;
-    if (FileAge > Expiration) {
-      DEBUG(dbgs() << "Remove " << File->path() << " ("
-                   << duration_cast<seconds>(FileAge).count() << "s old)\n");
-      sys::fs::remove(File->path());
-      continue;
+  CacheEntries Entries;
+  std::time_t ScanTime = sys::toTimeT(CurrentTime);
+  if (UseManifest && readManifest(Path, Entries, ScanTime)) {
+    DEBUG(dbgs() << "Using the cache manifest\n");
+  } else {
+    if (!UseManifest) {
+      // Stop the clients from journaling if the manifest was used before.
+      for (const char *FileName :
+           {ManifestFileName, JournalFileName, OldJournalFileName}) {
+        SmallString<128> FilePath(Path);
+        sys::path::append(FilePath, FileName);
+        sys::fs::remove(FilePath);
+      }
     }
 
-    // Leave it here for now, but add it to the list of size-based pruning.
-    AddToFileListForSizePruning(File->path());
+    // Walk the entire directory cache, looking for unused files.
+    std::error_code EC;
+    SmallString<128> CachePathNative;
+    sys::path::native(Path, CachePathNative);
+    // Walk all of the files within this directory.
+    for (sys::fs::directory_iterator File(CachePathNative, EC), FileEnd;
+         File != FileEnd && !EC; File.increment(EC)) {
+      // Do not touch the timestamp, the manifest and the journal.
+      StringRef FileName = sys::path::filename(File->path());
+      if (isBookkeepingFile(FileName))
+        continue;
+
+      // Look at this file. If we can't stat it, there's nothing interesting
+      // there.
+      if (sys::fs::status(File->path(), FileStatus)) {
+        DEBUG(dbgs() << "Ignore " << File->path() << " (can't stat)\n");
+        continue;
+      }
+      Entries.add(FileName, FileStatus.getSize(), FileStatus.getUniqueID(),
+                  sys::toTimeT(FileStatus.getLastAccessedTime()));
+    }
   }
 
-  // Prune for size now if needed
-  if (ShouldComputeSize) {
+  // Several entries can be hard links to the same file. Its size is counted
+  // once, and only freed when its last link is removed.
+  std::vector<CacheEntry> SortedEntries = Entries.takeSortedEntries();
+  std::map<sys::fs::UniqueID, unsigned> NumLinks;
+  uint64_t TotalSize = 0;
+  for (const CacheEntry &Entry : SortedEntries)
+    if (!Entry.ID || NumLinks[*Entry.ID]++ == 0)
+      TotalSize += Entry.Size;
+  auto freedSize = [&](const CacheEntry &Entry) -> uint64_t {
+    return !Entry.ID || NumLinks[*Entry.ID] == 1 ? Entry.Size : 0;
+  };
+
+  // The size the cache must fit in, given the available disk space.
+  uint64_t SizeLimit = MaxSizeBytes;
+  if (PercentageOfAvailableSpace > 0) {
     auto ErrOrSpaceInfo = sys::fs::disk_space(Path);
     if (!ErrOrSpaceInfo) {
       report_fatal_error("Can't get available size");
     }
     sys::fs::space_info SpaceInfo = ErrOrSpaceInfo.get();
     auto AvailableSpace = TotalSize + SpaceInfo.free;
-    auto FileAndSize = FileSizes.rbegin();
+    uint64_t Limit = AvailableSpace * PercentageOfAvailableSpace / 100;
     DEBUG(dbgs() << "Occupancy: " << ((100 * TotalSize) / AvailableSpace)
                  << "% target is: " << PercentageOfAvailableSpace << "\n");
-    // Remove the oldest accessed files first, till we get below the threshold
-    while (((100 * TotalSize) / AvailableSpace) > PercentageOfAvailableSpace &&
-           FileAndSize != FileSizes.rend()) {
-      // Remove the file.
-      sys::fs::remove(FileAndSize->second);
-      // Update size
-      TotalSize -= FileAndSize->first;
-      DEBUG(dbgs() << " - Remove " << FileAndSize->second << " (size "
-                   << FileAndSize->first << "), new occupancy is " << TotalSize
-                   << "%\n");
-      ++FileAndSize;
+    if (!SizeLimit || Limit < SizeLimit)
+      SizeLimit = Limit;
+  }
+
+  // Remove the least recently used files first, until the cache fits in the
+  // limits. Files that expired go in any case.
+  auto RemoveEntry = [&](const CacheEntry &Entry) {
+    SmallString<128> EntryPath(Path);
+    sys::path::append(EntryPath, Entry.Name);
+    sys::fs::remove(EntryPath);
+    TotalSize -= freedSize(Entry);
+    if (Entry.ID)
+      --NumLinks[*Entry.ID];
+  };
+  size_t NumEntries = SortedEntries.size();
+  auto Kept = SortedEntries.begin();
+  for (; Kept != SortedEntries.end(); ++Kept) {
+    auto FileAge = CurrentTime - sys::toTimePoint(Kept->LastUse);
+    if (Expiration != seconds(0) && FileAge > Expiration) {
+      DEBUG(dbgs() << "Remove " << Kept->Name << " ("
+                   << duration_cast<seconds>(FileAge).count() << "s old)\n");
+    } else if (SizeLimit && TotalSize > SizeLimit) {
+      DEBUG(dbgs() << " - Remove " << Kept->Name << " (size " << Kept->Size
+                   << "), new size is " << TotalSize - freedSize(*Kept)
+                   << "\n");
+    } else if (MaxEntries && NumEntries > MaxEntries) {
+      DEBUG(dbgs() << " - Remove " << Kept->Name << ", "
+                   << NumEntries - 1 << " entries left\n");
+    } else {
+      break;
     }
+    RemoveEntry(*Kept);
+    --NumEntries;
   }
+
+  if (UseManifest)
+    writeManifest(Path,
+                  makeArrayRef(SortedEntries)
+                      .drop_front(Kept - SortedEntries.begin()),
+                  ScanTime);
   return true;
 }
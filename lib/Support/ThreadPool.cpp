@@ -7,94 +7,186 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements a crude C++11 based thread pool.
+// This file implements a work-stealing C++11 based thread pool.
 //
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/ThreadPool.h"
 
 #include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Compiler.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 
 #if LLVM_ENABLE_THREADS
 
+/// The pool the current thread is a worker of, if any, and its index in that
+/// pool.
+static LLVM_THREAD_LOCAL const ThreadPool *CurrentPool = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentWorker = 0;
+
 // Default to std::thread::hardware_concurrency
 ThreadPool::ThreadPool() : ThreadPool(std::thread::hardware_concurrency()) {}
 
 ThreadPool::ThreadPool(unsigned ThreadCount)
-    : ActiveThreads(0), EnableFlag(true) {
-  // Create ThreadCount threads that will loop forever, wait on QueueCondition
-  // for tasks to be queued or the Pool to be destroyed.
+    : ThreadCount(ThreadCount), Queues(new WorkerQueue[ThreadCount ? ThreadCount
+                                                                   : 1]),
+      NextQueue(0), QueuedTasks(0), OutstandingTasks(0), EnableFlag(true) {
+  // Create ThreadCount threads that will loop until the pool is destroyed,
+  // running their own tasks, stealing from others, or waiting on
+  // QueueCondition for tasks to be queued.
   Threads.reserve(ThreadCount);
-  for (unsigned ThreadID = 0; ThreadID < ThreadCount; ++ThreadID) {
-    Threads.emplace_back([&] {
-      while (true) {
-        PackagedTaskTy Task;
-        {
-          std::unique_lock<std::mutex> LockGuard(QueueLock);
-          // Wait for tasks to be pushed in the queue
-          QueueCondition.wait(LockGuard,
-                              [&] { return !EnableFlag || !Tasks.empty(); });
-          // Exit condition
-          if (!EnableFlag && Tasks.empty())
-            return;
-          // Yeah, we have a task, grab it and release the lock on the queue
-
-          // We first need to signal that we are active before popping the queue
-          // in order for wait() to properly detect that even if the queue is
-          // empty, there is still a task in flight.
-          {
-            ++ActiveThreads;
-            std::unique_lock<std::mutex> LockGuard(CompletionLock);
-          }
-          Task = std::move(Tasks.front());
-          Tasks.pop();
-        }
-        // Run the task we just grabbed
+  for (unsigned ThreadID = 0; ThreadID < ThreadCount; ++ThreadID)
+    Threads.emplace_back([this, ThreadID] { workerLoop(ThreadID); });
+}
+
+bool ThreadPool::isWorkerThread() const { return CurrentPool == this; }
+
+void ThreadPool::workerLoop(unsigned ThreadID) {
+  CurrentPool = this;
+  CurrentWorker = ThreadID;
+  while (true) {
+    QueuedTask Task;
+    if (popTask(ThreadID, Task)) {
+      runTask(Task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> LockGuard(QueueLock);
+    // Wait for tasks to be pushed in one of the queues
+    QueueCondition.wait(LockGuard,
+                        [&] { return !EnableFlag || QueuedTasks != 0; });
+    // Exit condition
+    if (!EnableFlag && QueuedTasks == 0)
+      return;
+  }
+}
+
+bool ThreadPool::popTask(unsigned Self, QueuedTask &Result) {
+  if (QueuedTasks == 0)
+    return false;
+
+  // Consume from the front of our own queue first: this is where nested tasks
+  // are pushed, so recently spawned (and cache-warm) work runs first.
+  if (Self < ThreadCount) {
+    WorkerQueue &Queue = Queues[Self];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    if (!Queue.Tasks.empty()) {
+      Result = std::move(Queue.Tasks.front());
+      Queue.Tasks.pop_front();
+      --QueuedTasks;
+      return true;
+    }
+  }
+
+  // Then steal from the back of the other queues, starting with our neighbour
+  // so that thieves spread over the victims.
+  for (unsigned I = 1; I <= ThreadCount; ++I) {
+    unsigned Victim = (Self + I) % ThreadCount;
+    if (Victim == Self)
+      continue;
+    WorkerQueue &Queue = Queues[Victim];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    if (!Queue.Tasks.empty()) {
+      Result = std::move(Queue.Tasks.back());
+      Queue.Tasks.pop_back();
+      --QueuedTasks;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::runTask(QueuedTask &Task) {
+  // Run the task we just grabbed
 #ifndef _MSC_VER
-        Task();
+  Task.Task();
 #else
-        Task(/* unused */ false);
+  Task.Task(/* unused */ false);
 #endif
 
-        {
-          // Adjust `ActiveThreads`, in case someone waits on ThreadPool::wait()
-          std::unique_lock<std::mutex> LockGuard(CompletionLock);
-          --ActiveThreads;
-        }
+  bool GroupFinished = Task.Group && --Task.Group->Pending == 0;
+  bool PoolFinished = --OutstandingTasks == 0;
 
-        // Notify task completion, in case someone waits on ThreadPool::wait()
-        CompletionCondition.notify_all();
-      }
-    });
+  // Workers helping on a group wait sleep on QueueCondition, wake them up when
+  // the group they may be waiting on is finished.
+  if (GroupFinished) {
+    { std::unique_lock<std::mutex> LockGuard(QueueLock); }
+    QueueCondition.notify_all();
+  }
+
+  // Notify task completion, in case someone waits on ThreadPool::wait()
+  if (GroupFinished || PoolFinished) {
+    { std::unique_lock<std::mutex> LockGuard(CompletionLock); }
+    CompletionCondition.notify_all();
   }
 }
 
 void ThreadPool::wait() {
-  // Wait for all threads to complete and the queue to be empty
+  assert(!isWorkerThread() &&
+         "ThreadPool::wait() called from a task, use a ThreadPoolTaskGroup");
+  // Wait for all the submitted tasks to complete, including the ones still
+  // waiting in the queues.
   std::unique_lock<std::mutex> LockGuard(CompletionLock);
-  // The order of the checks for ActiveThreads and Tasks.empty() matters because
-  // any active threads might be modifying the Tasks queue, and this would be a
-  // race.
-  CompletionCondition.wait(LockGuard,
-                           [&] { return !ActiveThreads && Tasks.empty(); });
+  CompletionCondition.wait(LockGuard, [&] { return OutstandingTasks == 0; });
+}
+
+void ThreadPool::wait(ThreadPoolTaskGroup &Group) {
+  assert(&Group.getPool() == this && "Group belongs to another pool");
+  if (!isWorkerThread()) {
+    std::unique_lock<std::mutex> LockGuard(CompletionLock);
+    CompletionCondition.wait(LockGuard, [&] { return Group.isFinished(); });
+    return;
+  }
+
+  // We are running on one of our own workers: rather than blocking this
+  // thread (which may be the only one able to make progress on the group),
+  // keep executing queued tasks until the group is done.
+  while (!Group.isFinished()) {
+    QueuedTask Task;
+    if (popTask(CurrentWorker, Task)) {
+      runTask(Task);
+      continue;
+    }
+    // Nothing to help with: the remaining tasks of the group are running on
+    // other workers. Sleep until either the group finishes or new work shows
+    // up.
+    std::unique_lock<std::mutex> LockGuard(QueueLock);
+    QueueCondition.wait(LockGuard, [&] {
+      return Group.isFinished() || QueuedTasks != 0;
+    });
+  }
 }
 
-std::shared_future<ThreadPool::VoidTy> ThreadPool::asyncImpl(TaskTy Task) {
+std::shared_future<ThreadPool::VoidTy>
+ThreadPool::asyncImpl(TaskTy Task, ThreadPoolTaskGroup *Group) {
   /// Wrap the Task in a packaged_task to return a future object.
   PackagedTaskTy PackagedTask(std::move(Task));
   auto Future = PackagedTask.get_future();
-  {
-    // Lock the queue and push the new task
-    std::unique_lock<std::mutex> LockGuard(QueueLock);
 
-    // Don't allow enqueueing after disabling the pool
-    assert(EnableFlag && "Queuing a thread during ThreadPool destruction");
+  assert(EnableFlag && "Queuing a thread during ThreadPool destruction");
+  if (Group)
+    ++Group->Pending;
+  ++OutstandingTasks;
 
-    Tasks.push(std::move(PackagedTask));
+  // Tasks spawned by one of our workers go to the front of its own queue,
+  // external submissions are spread round-robin at the back of the queues.
+  if (isWorkerThread()) {
+    WorkerQueue &Queue = Queues[CurrentWorker];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    Queue.Tasks.push_front({std::move(PackagedTask), Group});
+    ++QueuedTasks;
+  } else {
+    WorkerQueue &Queue = Queues[NextQueue++ % (ThreadCount ? ThreadCount : 1)];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    Queue.Tasks.push_back({std::move(PackagedTask), Group});
+    ++QueuedTasks;
   }
+
+  // Taking the lock guarantees that a worker which just found the queues empty
+  // is either already sleeping or will observe the new task.
+  { std::unique_lock<std::mutex> LockGuard(QueueLock); }
   QueueCondition.notify_one();
   return Future.share();
 }
@@ -116,27 +208,54 @@ ThreadPool::ThreadPool() : ThreadPool(0) {}
 
 // No threads are launched, issue a warning if ThreadCount is not 0
 ThreadPool::ThreadPool(unsigned ThreadCount)
-    : ActiveThreads(0) {
+    : ThreadCount(0), Queues(new WorkerQueue[1]), NextQueue(0),
+      QueuedTasks(0), OutstandingTasks(0) {
   if (ThreadCount) {
     errs() << "Warning: request a ThreadPool with " << ThreadCount
            << " threads, but LLVM_ENABLE_THREADS has been turned off\n";
   }
 }
 
-void ThreadPool::wait() {
-  // Sequential implementation running the tasks
-  while (!Tasks.empty()) {
-    auto Task = std::move(Tasks.front());
-    Tasks.pop();
+bool ThreadPool::isWorkerThread() const { return false; }
+
+bool ThreadPool::popTask(unsigned Self, QueuedTask &Result) {
+  auto &Tasks = Queues[0].Tasks;
+  if (Tasks.empty())
+    return false;
+  Result = std::move(Tasks.front());
+  Tasks.pop_front();
+  --QueuedTasks;
+  return true;
+}
+
+void ThreadPool::runTask(QueuedTask &Task) {
 #ifndef _MSC_VER
-        Task();
+  Task.Task();
 #else
-        Task(/* unused */ false);
+  Task.Task(/* unused */ false);
 #endif
-  }
+  if (Task.Group)
+    --Task.Group->Pending;
+  --OutstandingTasks;
+}
+
+void ThreadPool::wait() {
+  // Sequential implementation running the tasks
+  QueuedTask Task;
+  while (popTask(0, Task))
+    runTask(Task);
+}
+
+void ThreadPool::wait(ThreadPoolTaskGroup &Group) {
+  // Tasks are run in submission order, which may include tasks of other
+  // groups queued before the ones of this group.
+  QueuedTask Task;
+  while (!Group.isFinished() && popTask(0, Task))
+    runTask(Task);
 }
 
-std::shared_future<ThreadPool::VoidTy> ThreadPool::asyncImpl(TaskTy Task) {
+std::shared_future<ThreadPool::VoidTy>
+ThreadPool::asyncImpl(TaskTy Task, ThreadPoolTaskGroup *Group) {
 #ifndef _MSC_VER
   // Get a Future with launch::deferred execution using std::async
   auto Future = std::async(std::launch::deferred, std::move(Task)).share();
@@ -147,7 +266,11 @@ std::shared_future<ThreadPool::VoidTy> ThreadPool::asyncImpl(TaskTy Task) {
   auto Future = std::async(std::launch::deferred, std::move(Task), false).share();
   PackagedTaskTy PackagedTask([Future](bool) -> bool { Future.get(); return false; });
 #endif
-  Tasks.push(std::move(PackagedTask));
+  if (Group)
+    ++Group->Pending;
+  ++OutstandingTasks;
+  ++QueuedTasks;
+  Queues[0].Tasks.push_back({std::move(PackagedTask), Group});
   return Future;
 }
 
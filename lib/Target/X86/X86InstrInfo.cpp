@@ -8374,7 +8374,9 @@ MachineInstr *X86InstrInfo::foldMemoryOperandImpl(
         return nullptr;
     }
 
-    // Create a constant-pool entry.
+    // Create a constant-pool entry. The constant is created in the
+    // LLVMContext shared with the other threads of parallel codegen.
+    auto ContextLock = MF.getMMI().lockContext();
     MachineConstantPool &MCP = *MF.getConstantPool();
     Type *Ty;
     unsigned Opc = LoadMI.getOpcode();
@@ -8395,6 +8397,8 @@ MachineInstr *X86InstrInfo::foldMemoryOperandImpl(
     const Constant *C = IsAllOnes ? Constant::getAllOnesValue(Ty) :
                                     Constant::getNullValue(Ty);
     unsigned CPI = MCP.getConstantPoolIndex(C, Alignment);
+    if (ContextLock)
+      ContextLock.unlock();
 
     // Create operands to load from the constant pool entry.
     MOs.push_back(MachineOperand::CreateReg(PICBase, false));
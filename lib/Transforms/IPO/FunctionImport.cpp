@@ -28,7 +28,13 @@
 #include "llvm/Object/ModuleSummaryIndexObjectFile.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Transforms/IPO/Internalize.h"
 #include "llvm/Transforms/Utils/FunctionImportUtils.h"
 
@@ -40,6 +46,8 @@ STATISTIC(NumImportedFunctions, "Number of functions imported");
 STATISTIC(NumImportedModules, "Number of modules imported from");
 STATISTIC(NumDeadSymbols, "Number of dead stripped symbols in index");
 STATISTIC(NumLiveSymbols, "Number of live symbols in index");
+STATISTIC(NumReusedImportLists,
+          "Number of import lists reused from an earlier link");
 
 /// Limit on instruction count of imported functions.
 static cl::opt<unsigned> ImportInstrLimit(
@@ -69,6 +77,11 @@ static cl::opt<float> ImportColdMultiplier(
     "import-cold-multiplier", cl::init(0), cl::Hidden, cl::value_desc("N"),
     cl::desc("Multiply the `import-instr-limit` threshold for cold callsites"));
 
+static cl::opt<unsigned> ImportThreads(
+    "import-threads", cl::init(0), cl::Hidden, cl::value_desc("N"),
+    cl::desc("Number of threads computing the import lists of the modules "
+             "during the thin link (default: the number of cores)"));
+
 static cl::opt<bool> PrintImports("print-imports", cl::init(false), cl::Hidden,
                                   cl::desc("Print imported functions"));
 
@@ -192,7 +205,8 @@ static void computeImportForFunction(
     const unsigned Threshold, const GVSummaryMapTy &DefinedGVSummaries,
     SmallVectorImpl<EdgeInfo> &Worklist,
     FunctionImporter::ImportMapTy &ImportList,
-    StringMap<FunctionImporter::ExportSetTy> *ExportLists = nullptr) {
+    StringMap<FunctionImporter::ExportSetTy> *ExportLists = nullptr,
+    DenseSet<GlobalValue::GUID> *Dependencies = nullptr) {
   for (auto &Edge : Summary.calls()) {
     auto GUID = Edge.first.getGUID();
     DEBUG(dbgs() << " edge -> " << GUID << " Threshold:" << Threshold << "\n");
@@ -202,6 +216,9 @@ static void computeImportForFunction(
       continue;
     }
 
+    if (Dependencies)
+      Dependencies->insert(GUID);
+
     auto GetBonusMultiplier = [](CalleeInfo::HotnessType Hotness) -> float {
       if (Hotness == CalleeInfo::HotnessType::Hot)
         return ImportHotMultiplier;
@@ -293,7 +310,8 @@ static void ComputeImportForModule(
     const GVSummaryMapTy &DefinedGVSummaries, const ModuleSummaryIndex &Index,
     FunctionImporter::ImportMapTy &ImportList,
     StringMap<FunctionImporter::ExportSetTy> *ExportLists = nullptr,
-    const DenseSet<GlobalValue::GUID> *DeadSymbols = nullptr) {
+    const DenseSet<GlobalValue::GUID> *DeadSymbols = nullptr,
+    DenseSet<GlobalValue::GUID> *Dependencies = nullptr) {
   // Worklist contains the list of function imported in this module, for which
   // we will analyse the callees and may import further down the callgraph.
   SmallVector<EdgeInfo, 128> Worklist;
@@ -315,7 +333,7 @@ static void ComputeImportForModule(
     DEBUG(dbgs() << "Initalize import for " << GVSummary.first << "\n");
     computeImportForFunction(*FuncSummary, Index, ImportInstrLimit,
                              DefinedGVSummaries, Worklist, ImportList,
-                             ExportLists);
+                             ExportLists, Dependencies);
   }
 
   // Process the newly imported functions and add callees to the worklist.
@@ -333,8 +351,104 @@ static void ComputeImportForModule(
       continue;
 
     computeImportForFunction(*Summary, Index, Threshold, DefinedGVSummaries,
-                             Worklist, ImportList, ExportLists);
+                             Worklist, ImportList, ExportLists, Dependencies);
+  }
+}
+
+/// Mark the functions in \p ImportList, and the symbols they reference, as
+/// exported from their source module, the way computeImportForFunction() does
+/// when it computes the import list.
+static void
+addExportsForImportList(const ModuleSummaryIndex &Index,
+                        const FunctionImporter::ImportMapTy &ImportList,
+                        StringMap<FunctionImporter::ExportSetTy> &ExportLists) {
+  for (auto &ILI : ImportList) {
+    auto &ExportList = ExportLists[ILI.first()];
+    for (auto &GI : ILI.second) {
+      ExportList.insert(GI.first);
+      auto *Summary = Index.findSummaryInModule(GI.first, ILI.first());
+      if (!Summary)
+        continue;
+      if (auto *AS = dyn_cast<AliasSummary>(Summary))
+        Summary = &AS->getAliasee();
+      auto *FuncSummary = cast<FunctionSummary>(Summary);
+      for (auto &Edge : FuncSummary->calls())
+        ExportList.insert(Edge.first.getGUID());
+      for (auto &Ref : FuncSummary->refs())
+        ExportList.insert(Ref.getGUID());
+    }
+  }
+}
+
+/// The importing options, recorded in an IncrementalImportState.
+static std::string getImportOptions() {
+  std::string Options;
+  raw_string_ostream OS(Options);
+  OS << ImportInstrLimit << ' ' << FloatToBits(ImportInstrFactor) << ' '
+     << FloatToBits(ImportHotInstrFactor) << ' '
+     << FloatToBits(ImportHotMultiplier) << ' '
+     << FloatToBits(ImportColdMultiplier);
+  return OS.str();
+}
+
+/// Return, for each module of \p Modules, whether the import list recorded in
+/// \p State can be reused.
+static std::vector<bool> findReusableImportLists(
+    const IncrementalImportState &State, const ModuleSummaryIndex &Index,
+    ArrayRef<const StringMapEntry<GVSummaryMapTy> *> Modules,
+    const DenseSet<GlobalValue::GUID> *DeadSymbols) {
+  std::vector<bool> Reusable(Modules.size(), false);
+  if (State.Options != getImportOptions())
+    return Reusable;
+
+  auto getCurrentHash = [&](StringRef ModulePath) -> const ModuleHash * {
+    auto It = Index.modulePaths().find(ModulePath);
+    if (It == Index.modulePaths().end() ||
+        It->second.second == ModuleHash{{0}})
+      return nullptr;
+    return &It->second.second;
+  };
+
+  // Collect the globals defined by the modules that changed since the state
+  // was recorded, before and after the change: the import lists that looked
+  // up any of them have to be computed again.
+  DenseSet<GlobalValue::GUID> ChangedGUIDs;
+  for (auto &Entry : State.Modules) {
+    const ModuleHash *Hash = getCurrentHash(Entry.first());
+    if (!Hash || *Hash != Entry.second.Hash)
+      ChangedGUIDs.insert(Entry.second.DefinedGUIDs.begin(),
+                          Entry.second.DefinedGUIDs.end());
   }
+  std::vector<const IncrementalImportState::ModuleState *> Recorded(
+      Modules.size(), nullptr);
+  for (size_t I = 0, E = Modules.size(); I != E; ++I) {
+    StringRef ModulePath = Modules[I]->first();
+    auto It = State.Modules.find(ModulePath);
+    const ModuleHash *Hash = getCurrentHash(ModulePath);
+    if (It != State.Modules.end() && Hash && *Hash == It->second.Hash) {
+      Recorded[I] = &It->second;
+      continue;
+    }
+    for (auto &GVSummary : Modules[I]->second)
+      ChangedGUIDs.insert(GVSummary.first);
+  }
+
+  for (size_t I = 0, E = Modules.size(); I != E; ++I) {
+    if (!Recorded[I])
+      continue;
+    // The dead globals of the module don't seed the import list.
+    auto DeadStatusChanged = [&](GlobalValue::GUID GUID) {
+      bool WasDead = std::binary_search(State.DeadSymbols.begin(),
+                                        State.DeadSymbols.end(), GUID);
+      return WasDead != (DeadSymbols && DeadSymbols->count(GUID));
+    };
+    auto IsChanged = [&](GlobalValue::GUID GUID) {
+      return ChangedGUIDs.count(GUID) != 0;
+    };
+    Reusable[I] = none_of(Recorded[I]->DefinedGUIDs, DeadStatusChanged) &&
+                  none_of(Recorded[I]->Dependencies, IsChanged);
+  }
+  return Reusable;
 }
 
 } // anonymous namespace
@@ -345,14 +459,103 @@ void llvm::ComputeCrossModuleImport(
     const StringMap<GVSummaryMapTy> &ModuleToDefinedGVSummaries,
     StringMap<FunctionImporter::ImportMapTy> &ImportLists,
     StringMap<FunctionImporter::ExportSetTy> &ExportLists,
-    const DenseSet<GlobalValue::GUID> *DeadSymbols) {
+    const DenseSet<GlobalValue::GUID> *DeadSymbols,
+    IncrementalImportState *State) {
   // For each module that has function defined, compute the import/export lists.
-  for (auto &DefinedGVSummaries : ModuleToDefinedGVSummaries) {
-    auto &ImportList = ImportLists[DefinedGVSummaries.first()];
-    DEBUG(dbgs() << "Computing import for Module '"
-                 << DefinedGVSummaries.first() << "'\n");
-    ComputeImportForModule(DefinedGVSummaries.second, Index, ImportList,
-                           &ExportLists, DeadSymbols);
+  // The modules only share the index, which is not modified, so they are
+  // processed in parallel. Each shard of modules records the symbols it
+  // exports from other modules in a map of its own; the maps are merged once
+  // all the shards are done. The result does not depend on the scheduling.
+  std::vector<std::pair<const StringMapEntry<GVSummaryMapTy> *,
+                        FunctionImporter::ImportMapTy *>>
+      Modules;
+  Modules.reserve(ModuleToDefinedGVSummaries.size());
+  for (auto &DefinedGVSummaries : ModuleToDefinedGVSummaries)
+    Modules.push_back({&DefinedGVSummaries,
+                       &ImportLists[DefinedGVSummaries.first()]});
+
+  // With an incremental state, find the import lists still valid, and record
+  // what the others are computed from.
+  std::vector<bool> Reusable(Modules.size(), false);
+  std::vector<DenseSet<GlobalValue::GUID>> Dependencies;
+  if (State) {
+    std::vector<const StringMapEntry<GVSummaryMapTy> *> ModuleEntries;
+    for (auto &Module : Modules)
+      ModuleEntries.push_back(Module.first);
+    Reusable =
+        findReusableImportLists(*State, Index, ModuleEntries, DeadSymbols);
+    Dependencies.resize(Modules.size());
+  }
+
+  unsigned Threads =
+      ImportThreads ? ImportThreads : llvm::heavyweight_hardware_concurrency();
+  size_t NumShards = std::min<size_t>(Modules.size(), 4 * Threads);
+  std::vector<StringMap<FunctionImporter::ExportSetTy>> ShardExportLists(
+      NumShards);
+  auto ComputeShard = [&](size_t Shard) {
+    size_t Begin = Modules.size() * Shard / NumShards;
+    size_t End = Modules.size() * (Shard + 1) / NumShards;
+    for (size_t I = Begin; I != End; ++I) {
+      StringRef ModulePath = Modules[I].first->first();
+      if (Reusable[I]) {
+        DEBUG(dbgs() << "Reusing import for Module '" << ModulePath << "'\n");
+        *Modules[I].second = State->Modules.find(ModulePath)->second.ImportList;
+        addExportsForImportList(Index, *Modules[I].second,
+                                ShardExportLists[Shard]);
+        continue;
+      }
+      DEBUG(dbgs() << "Computing import for Module '" << ModulePath << "'\n");
+      ComputeImportForModule(Modules[I].first->second, Index,
+                             *Modules[I].second, &ShardExportLists[Shard],
+                             DeadSymbols,
+                             State ? &Dependencies[I] : nullptr);
+    }
+  };
+  if (Threads <= 1 || NumShards <= 1) {
+    for (size_t Shard = 0; Shard != NumShards; ++Shard)
+      ComputeShard(Shard);
+  } else {
+    ThreadPool Pool(Threads);
+    for (size_t Shard = 0; Shard != NumShards; ++Shard)
+      Pool.async(ComputeShard, Shard);
+    Pool.wait();
+  }
+  for (auto &ShardExports : ShardExportLists)
+    for (auto &Exports : ShardExports) {
+      auto &ExportList = ExportLists[Exports.first()];
+      ExportList.insert(Exports.second.begin(), Exports.second.end());
+    }
+
+  if (State) {
+    // Replace the state with the one of this link.
+    StringMap<IncrementalImportState::ModuleState> ModuleStates;
+    State->NumReused = 0;
+    for (size_t I = 0, E = Modules.size(); I != E; ++I) {
+      StringRef ModulePath = Modules[I].first->first();
+      auto &ModuleState = ModuleStates[ModulePath];
+      ModuleState.Hash = Index.getModuleHash(ModulePath);
+      for (auto &GVSummary : Modules[I].first->second)
+        ModuleState.DefinedGUIDs.push_back(GVSummary.first);
+      if (Reusable[I]) {
+        ModuleState.Dependencies = std::move(
+            State->Modules.find(ModulePath)->second.Dependencies);
+        ++State->NumReused;
+      } else {
+        ModuleState.Dependencies.assign(Dependencies[I].begin(),
+                                        Dependencies[I].end());
+        std::sort(ModuleState.Dependencies.begin(),
+                  ModuleState.Dependencies.end());
+      }
+      ModuleState.ImportList = *Modules[I].second;
+    }
+    NumReusedImportLists += State->NumReused;
+    State->Modules = std::move(ModuleStates);
+    State->Options = getImportOptions();
+    State->DeadSymbols.clear();
+    if (DeadSymbols) {
+      State->DeadSymbols.assign(DeadSymbols->begin(), DeadSymbols->end());
+      std::sort(State->DeadSymbols.begin(), State->DeadSymbols.end());
+    }
   }
 
   // When computing imports we added all GUIDs referenced by anything
@@ -389,6 +592,145 @@ void llvm::ComputeCrossModuleImport(
 #endif
 }
 
+static const char ImportStateMagic[8] = {'L', 'L', 'V', 'M',
+                                         'I', 'M', 'P', 'S'};
+static const uint32_t ImportStateVersion = 1;
+
+namespace {
+/// Reads the fields of a saved IncrementalImportState, remembering whether it
+/// ran past the end of the data.
+class ImportStateReader {
+  StringRef Data;
+  bool Truncated = false;
+
+public:
+  ImportStateReader(StringRef Data) : Data(Data) {}
+
+  bool truncated() const { return Truncated; }
+
+  StringRef readBytes(uint64_t Size) {
+    if (Truncated || Size > Data.size()) {
+      Truncated = true;
+      return StringRef();
+    }
+    StringRef Bytes = Data.take_front(Size);
+    Data = Data.drop_front(Size);
+    return Bytes;
+  }
+  template <typename T> T read() {
+    StringRef Bytes = readBytes(sizeof(T));
+    if (Truncated)
+      return 0;
+    return support::endian::read<T, support::little, support::unaligned>(
+        Bytes.data());
+  }
+  StringRef readString() { return readBytes(read<uint32_t>()); }
+  void readGUIDs(std::vector<GlobalValue::GUID> &GUIDs) {
+    uint64_t Size = read<uint64_t>();
+    // Don't trust the size before having checked there is data for it.
+    if (Size > Data.size() / sizeof(uint64_t)) {
+      Truncated = true;
+      return;
+    }
+    GUIDs.reserve(Size);
+    for (uint64_t I = 0; I != Size; ++I)
+      GUIDs.push_back(read<uint64_t>());
+  }
+};
+} // anonymous namespace
+
+IncrementalImportState IncrementalImportState::load(StringRef Path) {
+  IncrementalImportState State;
+  auto BufferOrErr = MemoryBuffer::getFile(Path, /*FileSize=*/-1,
+                                           /*RequiresNullTerminator=*/false);
+  if (!BufferOrErr)
+    return State;
+  ImportStateReader R((*BufferOrErr)->getBuffer());
+  if (R.readBytes(sizeof(ImportStateMagic)) !=
+          StringRef(ImportStateMagic, sizeof(ImportStateMagic)) ||
+      R.read<uint32_t>() != ImportStateVersion)
+    return State;
+
+  State.Options = R.readString();
+  R.readGUIDs(State.DeadSymbols);
+  for (uint32_t NumModules = R.read<uint32_t>(); NumModules && !R.truncated();
+       --NumModules) {
+    auto &ModuleState = State.Modules[R.readString()];
+    for (uint32_t &Word : ModuleState.Hash)
+      Word = R.read<uint32_t>();
+    R.readGUIDs(ModuleState.DefinedGUIDs);
+    R.readGUIDs(ModuleState.Dependencies);
+    for (uint32_t NumSources = R.read<uint32_t>();
+         NumSources && !R.truncated(); --NumSources) {
+      auto &FunctionsToImport = ModuleState.ImportList[R.readString()];
+      for (uint32_t NumFunctions = R.read<uint32_t>();
+           NumFunctions && !R.truncated(); --NumFunctions) {
+        GlobalValue::GUID GUID = R.read<uint64_t>();
+        FunctionsToImport[GUID] = R.read<uint32_t>();
+      }
+    }
+  }
+  if (R.truncated())
+    return IncrementalImportState();
+  return State;
+}
+
+Error IncrementalImportState::save(StringRef Path) const {
+  // Write to a temporary file renamed over the state, so that concurrent links
+  // sharing the path read either the old state or the new one.
+  int FD;
+  SmallString<128> TempPath;
+  if (std::error_code EC =
+          sys::fs::createUniqueFile(Path + ".tmp%%%%%%", FD, TempPath))
+    return errorCodeToError(EC);
+  std::error_code EC;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    support::endian::Writer<support::little> W(OS);
+    auto WriteString = [&](StringRef Str) {
+      W.write<uint32_t>(Str.size());
+      OS << Str;
+    };
+    auto WriteGUIDs = [&](ArrayRef<GlobalValue::GUID> GUIDs) {
+      W.write<uint64_t>(GUIDs.size());
+      W.write(GUIDs);
+    };
+    OS.write(ImportStateMagic, sizeof(ImportStateMagic));
+    W.write<uint32_t>(ImportStateVersion);
+    WriteString(Options);
+    WriteGUIDs(DeadSymbols);
+    W.write<uint32_t>(Modules.size());
+    for (auto &Entry : Modules) {
+      WriteString(Entry.first());
+      for (uint32_t Word : Entry.second.Hash)
+        W.write<uint32_t>(Word);
+      WriteGUIDs(Entry.second.DefinedGUIDs);
+      WriteGUIDs(Entry.second.Dependencies);
+      W.write<uint32_t>(Entry.second.ImportList.size());
+      for (auto &Source : Entry.second.ImportList) {
+        WriteString(Source.first());
+        W.write<uint32_t>(Source.second.size());
+        for (auto &Function : Source.second) {
+          W.write<uint64_t>(Function.first);
+          W.write<uint32_t>(Function.second);
+        }
+      }
+    }
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      EC = std::make_error_code(std::errc::io_error);
+    }
+  }
+  if (!EC)
+    EC = sys::fs::rename(TempPath, Path);
+  if (EC) {
+    sys::fs::remove(TempPath);
+    return errorCodeToError(EC);
+  }
+  return Error::success();
+}
+
 /// Compute all the imports for the given module in the Index.
 void llvm::ComputeCrossModuleImportForModule(
     StringRef ModulePath, const ModuleSummaryIndex &Index,
@@ -280,6 +280,7 @@ void splitAndWriteThinLTOBitcode(raw_ostream &OS, Module &M) {
                 /*GenerateHash=*/true);
 
   W.writeModule(MergedM.get());
+  W.writeSymtab();
 
   OS << Buffer;
 }
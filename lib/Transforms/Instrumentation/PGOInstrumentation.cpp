@@ -1194,7 +1194,9 @@ static bool annotateAllFunctions(
   DEBUG(dbgs() << "Read in profile counters: ");
   auto &Ctx = M.getContext();
   // Read the counter array from file.
-  auto ReaderOrErr = IndexedInstrProfReader::create(ProfileFileName);
+  // The reader is shared with any other module being annotated with the same
+  // profile, e.g. by parallel ThinLTO backends.
+  auto ReaderOrErr = IndexedInstrProfReader::getShared(ProfileFileName);
   if (Error E = ReaderOrErr.takeError()) {
     handleAllErrors(std::move(E), [&](const ErrorInfoBase &EI) {
       Ctx.diagnose(
@@ -1203,7 +1205,7 @@ static bool annotateAllFunctions(
     return false;
   }
 
-  std::unique_ptr<IndexedInstrProfReader> PGOReader =
+  std::shared_ptr<IndexedInstrProfReader> PGOReader =
       std::move(ReaderOrErr.get());
   if (!PGOReader) {
     Ctx.diagnose(DiagnosticInfoPGOProfile(ProfileFileName.data(),
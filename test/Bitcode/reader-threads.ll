@@ -0,0 +1,58 @@
+; Check that decoding the function blocks on worker threads gives back the same
+; module, with nested constants, metadata, value symbol table and use-list
+; blocks, and functions forward referenced by block addresses.
+; RUN: llvm-as -preserve-bc-uselistorder < %s > %t.bc
+; RUN: llvm-dis %t.bc -o %t.ll
+; RUN: llvm-dis -bitcode-reader-threads=2 %t.bc -o %t2.ll
+; RUN: diff %t.ll %t2.ll
+; RUN: FileCheck %s < %t2.ll
+
+@g = global i32 0
+
+; CHECK: define i32 @f(i32 %a)
+define i32 @f(i32 %a) !dbg !4 {
+entry:
+; CHECK: %add = add i32 %a, 42
+  %add = add i32 %a, 42
+  store i8* blockaddress(@h, %target), i8** null
+  %cmp = icmp eq i32 %add, 0, !prof !8
+  br i1 %cmp, label %then, label %else, !dbg !7
+
+then:
+  ret i32 %add
+
+else:
+; CHECK: %v = load i32, i32* @g
+  %v = load i32, i32* @g
+  %mul = mul i32 %v, %add
+  %mul2 = mul i32 %v, %mul
+  ret i32 %mul2
+}
+
+; CHECK: define void @h()
+define void @h() {
+entry:
+  br label %target
+
+target:
+; CHECK: store i32 ptrtoint (i32* @g to i32), i32* @g
+  store i32 ptrtoint (i32* @g to i32), i32* @g
+  ret void
+}
+
+; CHECK: define i32 @k(i32 %x)
+define i32 @k(i32 %x) {
+  %r = call i32 @f(i32 %x)
+  ret i32 %r
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, emissionKind: FullDebug)
+!1 = !DIFile(filename: "t.c", directory: "/")
+!2 = !DISubroutineType(types: !{})
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = distinct !DISubprogram(name: "f", scope: !1, file: !1, line: 1, type: !2, unit: !0)
+!7 = !DILocation(line: 2, scope: !4)
+!8 = !{!"branch_weights", i32 1, i32 2}
@@ -0,0 +1,64 @@
+; Check that encoding the function blocks on several threads gives the same
+; bitcode as encoding them in place, with function-local constants, metadata
+; and use-lists, block addresses and a module-level VST with function offsets.
+; RUN: llvm-as -preserve-bc-uselistorder < %s > %t.bc
+; RUN: llvm-as -preserve-bc-uselistorder -bitcode-writer-threads=2 < %s > %t2.bc
+; RUN: cmp %t.bc %t2.bc
+; RUN: opt -module-summary %s -o %t3.bc
+; RUN: opt -module-summary -bitcode-writer-threads=3 %s -o %t4.bc
+; RUN: cmp %t3.bc %t4.bc
+; RUN: llvm-dis %t2.bc -o - | FileCheck %s
+
+@g = global i32 0
+
+; CHECK: define i32 @f(i32 %a)
+define i32 @f(i32 %a) !dbg !4 {
+entry:
+  %add = add i32 %a, 42
+  store i8* blockaddress(@h, %target), i8** null
+  %cmp = icmp eq i32 %add, 0, !prof !8
+  br i1 %cmp, label %then, label %else, !dbg !7
+
+then:
+  call void @llvm.dbg.value(metadata i32 %add, i64 0, metadata !9, metadata !DIExpression()), !dbg !7
+  ret i32 %add
+
+else:
+  %v = load i32, i32* @g
+  %mul = mul i32 %v, %add
+  %mul2 = mul i32 %v, %mul
+  ret i32 %mul2
+}
+
+; CHECK: define void @h()
+define void @h() {
+entry:
+  br label %target
+
+target:
+  store i32 ptrtoint (i32* @g to i32), i32* @g
+  store i32 7, i32* @g
+  ret void
+}
+
+; CHECK: define i32 @k(i32 %x)
+define i32 @k(i32 %x) {
+  %r = call i32 @f(i32 %x)
+  %s = call i32 @f(i32 %r)
+  ret i32 %s
+}
+
+declare void @llvm.dbg.value(metadata, i64, metadata, metadata)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, emissionKind: FullDebug)
+!1 = !DIFile(filename: "t.c", directory: "/")
+!2 = !DISubroutineType(types: !{})
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = distinct !DISubprogram(name: "f", scope: !1, file: !1, line: 1, type: !2, unit: !0)
+!7 = !DILocation(line: 2, scope: !4)
+!8 = !{!"branch_weights", i32 1, i32 2}
+!9 = !DILocalVariable(name: "add", scope: !4, file: !1, line: 2, type: !10)
+!10 = !DIBasicType(name: "int", size: 32, encoding: DW_ATE_signed)
@@ -1,5 +1,8 @@
 ; RUN: llc -mtriple=i686-pc-windows-msvc -stack-symbol-ordering=0 < %s | FileCheck --check-prefix=X86 %s
 ; RUN: llc -mtriple=x86_64-pc-windows-msvc -stack-symbol-ordering=0 < %s | FileCheck --check-prefix=X64 %s
+; The EH registration node must stay a frame index when the entry block is
+; selected in several DAGs.
+; RUN: llc -mtriple=i686-pc-windows-msvc -stack-symbol-ordering=0 -isel-max-block-size=1 < %s | FileCheck --check-prefix=X86 %s
 
 declare i32 @__CxxFrameHandler3(...)
 declare void @Dtor(i64* %o)
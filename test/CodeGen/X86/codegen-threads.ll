@@ -0,0 +1,163 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu > %t.serial
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -codegen-threads=4 \
+; RUN:   -verify-machineinstrs > %t.parallel
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -codegen-threads=3 \
+; RUN:   > %t.parallel2
+; RUN: diff %t.parallel %t.parallel2
+; RUN: sed -e 's/Ltmp[0-9]*/Ltmp/g' %t.serial > %t.serial.labels
+; RUN: sed -e 's/Ltmp[0-9]*/Ltmp/g' %t.parallel > %t.parallel.labels
+; RUN: diff %t.serial.labels %t.parallel.labels
+; RUN: FileCheck %s < %t.parallel
+
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -O0 > %t.serial.O0
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -O0 -codegen-threads=2 \
+; RUN:   > %t.parallel.O0
+; RUN: sed -e 's/Ltmp[0-9]*/Ltmp/g' %t.serial.O0 > %t.serial.O0.labels
+; RUN: sed -e 's/Ltmp[0-9]*/Ltmp/g' %t.parallel.O0 > %t.parallel.O0.labels
+; RUN: diff %t.serial.O0.labels %t.parallel.O0.labels
+
+; RUN: llc < %s -mtriple=i686-apple-macosx > %t.serial.darwin
+; RUN: llc < %s -mtriple=i686-apple-macosx -codegen-threads=3 \
+; RUN:   > %t.parallel.darwin
+; RUN: sed -e 's/Ltmp[0-9]*/Ltmp/g' %t.serial.darwin > %t.serial.darwin.labels
+; RUN: sed -e 's/Ltmp[0-9]*/Ltmp/g' %t.parallel.darwin \
+; RUN:   > %t.parallel.darwin.labels
+; RUN: diff %t.serial.darwin.labels %t.parallel.darwin.labels
+
+; Check that the machine function passes through register allocation give the
+; same code when they run on several functions at once, and that the functions
+; are still emitted in order. The temporary labels created by the selection,
+; here for the invokes, are numbered before the ones of the AsmPrinter instead
+; of being interleaved with them, e.g. the type info labels of the Darwin LSDA.
+; So they are only compared by name with the serial output, but the numbering
+; does not depend on the number of threads.
+
+; CHECK-LABEL: ssp_array:
+; CHECK: __stack_chk_fail
+; CHECK-LABEL: colored:
+; CHECK-LABEL: spills:
+; CHECK-LABEL: fp_constants:
+; CHECK-LABEL: caller:
+; CHECK: callq ssp_array
+; CHECK: callq spills
+; CHECK-LABEL: throws:
+; CHECK: callq may_throw
+; CHECK: callq __cxa_begin_catch
+; CHECK: GCC_except_table
+; CHECK: Call site
+
+declare void @use(i8*)
+declare void @use_i32(i32*)
+declare void @clobber()
+declare void @llvm.lifetime.start(i64, i8* nocapture)
+declare void @llvm.lifetime.end(i64, i8* nocapture)
+
+define i32 @ssp_array(i32 %n) sspstrong {
+entry:
+  %buf = alloca [16 x i8], align 16
+  %big = alloca [64 x i8], align 16
+  %x = alloca i32, align 4
+  store i32 %n, i32* %x
+  %b = getelementptr inbounds [16 x i8], [16 x i8]* %buf, i64 0, i64 0
+  %g = getelementptr inbounds [64 x i8], [64 x i8]* %big, i64 0, i64 0
+  call void @use(i8* %b)
+  call void @use(i8* %g)
+  call void @use_i32(i32* %x)
+  %v = load i32, i32* %x
+  ret i32 %v
+}
+
+define void @colored(i1 %c) ssp {
+entry:
+  %a = alloca [32 x i8], align 16
+  %b = alloca [32 x i8], align 16
+  %pa = getelementptr inbounds [32 x i8], [32 x i8]* %a, i64 0, i64 0
+  %pb = getelementptr inbounds [32 x i8], [32 x i8]* %b, i64 0, i64 0
+  call void @llvm.lifetime.start(i64 32, i8* %pa)
+  call void @use(i8* %pa)
+  call void @llvm.lifetime.end(i64 32, i8* %pa)
+  call void @llvm.lifetime.start(i64 32, i8* %pb)
+  call void @use(i8* %pb)
+  call void @llvm.lifetime.end(i64 32, i8* %pb)
+  ret void
+}
+
+define i64 @spills(i64 %a, i64 %b, i64 %c, i64 %d, i64 %e, i64 %f) {
+entry:
+  %ab = mul i64 %a, %b
+  %cd = mul i64 %c, %d
+  %ef = mul i64 %e, %f
+  %ac = add i64 %a, %c
+  %bd = add i64 %b, %d
+  %ce = sub i64 %c, %e
+  %df = sub i64 %d, %f
+  call void @clobber()
+  %s0 = add i64 %ab, %cd
+  %s1 = add i64 %ef, %ac
+  %s2 = add i64 %bd, %ce
+  %s3 = add i64 %df, %s0
+  %s4 = mul i64 %s1, %s2
+  %s5 = add i64 %s3, %s4
+  ret i64 %s5
+}
+
+define <4 x float> @fp_constants(<4 x float> %x, double %y, double* %p) {
+entry:
+  %add = fadd <4 x float> %x, <float 1.0, float 2.0, float 3.0, float 4.0>
+  %mul = fmul double %y, 3.5
+  store double %mul, double* %p
+  call void @clobber()
+  %sel = fcmp olt <4 x float> %add, zeroinitializer
+  %r = select <4 x i1> %sel, <4 x float> zeroinitializer, <4 x float> %add
+  ret <4 x float> %r
+}
+
+define i64 @caller(i32 %n) {
+entry:
+  %r = call i32 @ssp_array(i32 %n)
+  %w = sext i32 %r to i64
+  %s = call i64 @spills(i64 %w, i64 1, i64 2, i64 3, i64 4, i64 5)
+  ret i64 %s
+}
+
+@_ZTIi = external constant i8*
+
+declare void @may_throw(i32)
+declare i32 @__gxx_personality_v0(...)
+declare i8* @__cxa_begin_catch(i8*)
+declare void @__cxa_end_catch()
+
+define i32 @throws(i32 %n) personality i32 (...)* @__gxx_personality_v0 {
+entry:
+  invoke void @may_throw(i32 %n)
+          to label %next unwind label %lpad
+
+next:
+  invoke void @may_throw(i32 0)
+          to label %done unwind label %lpad
+
+done:
+  ret i32 0
+
+lpad:
+  %lp = landingpad { i8*, i32 }
+          catch i8* bitcast (i8** @_ZTIi to i8*)
+  %exn = extractvalue { i8*, i32 } %lp, 0
+  %c = call i8* @__cxa_begin_catch(i8* %exn)
+  call void @__cxa_end_catch()
+  ret i32 1
+}
+
+define i32 @rethrows(i32 %n) personality i32 (...)* @__gxx_personality_v0 {
+entry:
+  %r = invoke i32 @throws(i32 %n)
+          to label %done unwind label %lpad
+
+done:
+  ret i32 %r
+
+lpad:
+  %lp = landingpad { i8*, i32 }
+          cleanup
+  resume { i8*, i32 } %lp
+}
@@ -0,0 +1,25 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -combiner-topological-sweep \
+; RUN:   | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -o /dev/null \
+; RUN:   -combiner-print-costs 2>&1 | FileCheck %s --check-prefix=COSTS
+
+; Check that seeding the worklist in topological order still reaches the usual
+; fixed point, and that the combiner reports what each opcode cost.
+
+; CHECK-LABEL: fold_chain:
+; CHECK: leal (%rdi,%rsi), %eax
+; CHECK-NEXT: shll $2, %eax
+; CHECK-NEXT: retq
+
+; COSTS-LABEL: DAG combine costs at level 0 in 'fold_chain':
+; COSTS-NEXT: Visits Combined Wall time (us) Opcode
+; COSTS-DAG: {{^ +[0-9]+ +[1-9][0-9]* +[0-9.]+ +}}mul{{$}}
+; COSTS-DAG: {{^ +[0-9]+ +[0-9]+ +[0-9.]+ +}}add{{$}}
+; COSTS: DAG combine costs at level {{[1-3]}} in 'fold_chain':
+
+define i32 @fold_chain(i32 %a, i32 %b) {
+  %x = add i32 %a, %b
+  %y = mul i32 %x, 2
+  %z = shl i32 %y, 1
+  ret i32 %z
+}
@@ -0,0 +1,68 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -isel-max-block-size=2 \
+; RUN:   -verify-machineinstrs | FileCheck %s --check-prefix=CHECK --check-prefix=TWO
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -isel-max-block-size=1 \
+; RUN:   -verify-machineinstrs | FileCheck %s --check-prefix=CHECK --check-prefix=ONE
+
+; Check that a block selected in several DAGs carries the values used across
+; the cuts in registers, keeps the memory operations in order, and still emits
+; the compare with the branch and the tail call with the return.
+
+declare i32 @callee(i32)
+
+; With cuts after each store, the loads still fold into the add. With a cut
+; after every instruction with side effects, the addresses of the stores are
+; computed in the previous DAG.
+; CHECK-LABEL: straight_line:
+; CHECK: movl 4(%rdi), %[[S:e[a-z]+]]
+; CHECK-NEXT: addl (%rdi), %[[S]]
+; TWO-NEXT: movl %[[S]], 8(%rdi)
+; ONE-NEXT: leaq 8(%rdi), %[[P2:r[a-z]+]]
+; ONE-NEXT: movl %[[S]], (%[[P2]])
+; CHECK-NEXT: movl 12(%rdi), %[[M:e[a-z]+]]
+; CHECK-NEXT: imull %[[S]], %[[M]]
+; TWO-NEXT: movl %[[M]], 16(%rdi)
+; ONE-NEXT: addq $16, %rdi
+; ONE-NEXT: movl %[[M]], (%rdi)
+; CHECK-NEXT: cmpl %esi, %[[M]]
+; CHECK-NEXT: jge
+define i32 @straight_line(i32* %p, i32 %n) {
+entry:
+  %a = load i32, i32* %p
+  %p1 = getelementptr i32, i32* %p, i64 1
+  %b = load i32, i32* %p1
+  %s = add i32 %a, %b
+  %p2 = getelementptr i32, i32* %p, i64 2
+  store i32 %s, i32* %p2
+  %p3 = getelementptr i32, i32* %p, i64 3
+  %c = load i32, i32* %p3
+  %m = mul i32 %s, %c
+  %p4 = getelementptr i32, i32* %p, i64 4
+  store i32 %m, i32* %p4
+  %cmp = icmp slt i32 %m, %n
+  br i1 %cmp, label %lt, label %ge
+
+lt:
+  ret i32 %s
+
+ge:
+  ret i32 %m
+}
+
+; CHECK-LABEL: tail_call:
+; CHECK: movl %esi, (%rdi)
+; CHECK-NEXT: incl %esi
+; TWO-NEXT: movl %esi, 4(%rdi)
+; ONE-NEXT: addq $4, %rdi
+; ONE-NEXT: movl %esi, (%rdi)
+; CHECK-NEXT: leal (,%rsi,4), %edi
+; CHECK-NEXT: jmp callee # TAILCALL
+define i32 @tail_call(i32* %p, i32 %x) {
+entry:
+  store i32 %x, i32* %p
+  %y = add i32 %x, 1
+  %p1 = getelementptr i32, i32* %p, i64 1
+  store i32 %y, i32* %p1
+  %z = shl i32 %y, 2
+  %r = tail call i32 @callee(i32 %z)
+  ret i32 %r
+}
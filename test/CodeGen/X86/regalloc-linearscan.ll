@@ -0,0 +1,93 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -regalloc=linearscan \
+; RUN:   -verify-machineinstrs -verify-regalloc | FileCheck %s
+
+; Check that the linear scan allocator keeps values in registers when there are
+; enough, uses callee saved registers across calls, and spills the values that
+; are used the least when it runs out.
+
+declare void @clobber()
+
+; CHECK-LABEL: no_pressure:
+; CHECK-NOT: Spill
+; CHECK-NOT: (%rsp)
+; CHECK: retq
+define i64 @no_pressure(i64 %a, i64 %b) {
+entry:
+  %s = add i64 %a, %b
+  %m = mul i64 %s, %a
+  ret i64 %m
+}
+
+; CHECK-LABEL: across_call:
+; CHECK-NOT: Spill
+; CHECK: movq %rdi, %rbx
+; CHECK: callq clobber
+; CHECK: imulq %rbx,
+define i64 @across_call(i64 %a, i64 %b) {
+entry:
+  %s = add i64 %a, %b
+  call void @clobber()
+  %m = mul i64 %s, %a
+  ret i64 %m
+}
+
+; The accumulator and the induction variable stay in registers in the loop,
+; the values used once per iteration are reloaded from the stack.
+; CHECK-LABEL: pressure:
+; CHECK: 8-byte Spill
+; CHECK: xorl %ebp, %ebp
+; CHECK: xorl %ebx, %ebx
+; CHECK: %loop
+; CHECK: addq {{[0-9]*}}(%rsp), %rbx {{.*}} Folded Reload
+; CHECK: callq clobber
+; CHECK: xorq %r13, %rbx
+; CHECK: incq %rbp
+; CHECK: jb
+define i64 @pressure(i64* %p, i64 %n) {
+entry:
+  %v0 = load volatile i64, i64* %p
+  %v1 = load volatile i64, i64* %p
+  %v2 = load volatile i64, i64* %p
+  %v3 = load volatile i64, i64* %p
+  %v4 = load volatile i64, i64* %p
+  %v5 = load volatile i64, i64* %p
+  %v6 = load volatile i64, i64* %p
+  %v7 = load volatile i64, i64* %p
+  %v8 = load volatile i64, i64* %p
+  %v9 = load volatile i64, i64* %p
+  %v10 = load volatile i64, i64* %p
+  %v11 = load volatile i64, i64* %p
+  %v12 = load volatile i64, i64* %p
+  %v13 = load volatile i64, i64* %p
+  %v14 = load volatile i64, i64* %p
+  %v15 = load volatile i64, i64* %p
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i64 [ 0, %entry ], [ %a15, %loop ]
+  %a0 = add i64 %acc, %v0
+  %a1 = xor i64 %a0, %v1
+  %a2 = add i64 %a1, %v2
+  %a3 = xor i64 %a2, %v3
+  %a4 = add i64 %a3, %v4
+  %a5 = xor i64 %a4, %v5
+  %a6 = add i64 %a5, %v6
+  %a7 = xor i64 %a6, %v7
+  call void @clobber()
+  %a8 = add i64 %a7, %v8
+  %a9 = xor i64 %a8, %v9
+  %a10 = add i64 %a9, %v10
+  %a11 = xor i64 %a10, %v11
+  %a12 = add i64 %a11, %v12
+  %a13 = xor i64 %a12, %v13
+  %a14 = add i64 %a13, %v14
+  %a15 = xor i64 %a14, %v15
+  %i.next = add i64 %i, 1
+  %c = icmp ult i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %r = add i64 %a15, %v0
+  ret i64 %r
+}
@@ -0,0 +1,74 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:   -regalloc-work-budget=20 -pass-remarks-missed=regalloc 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=LOCAL
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:   -regalloc-work-budget=1 -pass-remarks-missed=regalloc 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=SPILL
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:   -pass-remarks-missed=regalloc 2>&1 | FileCheck %s --check-prefix=NONE
+
+; Sixteen values live across a call in a loop keep the greedy allocator busy
+; evicting and splitting. Check that it steps down to cheaper strategies once
+; it did more work on the function than -regalloc-work-budget allows.
+
+; LOCAL: remark: <unknown>:0:0: exceeded the work budget of 20 units, splitting only locally from now on
+; LOCAL-NOT: exceeded twice
+; LOCAL-LABEL: pressure:
+
+; SPILL: remark: <unknown>:0:0: exceeded the work budget of 1 units, splitting only locally from now on
+; SPILL: remark: <unknown>:0:0: exceeded twice the work budget of 1 units, spilling from now on
+; SPILL-LABEL: pressure:
+
+; NONE-NOT: work budget
+; NONE-LABEL: pressure:
+
+declare void @clobber()
+
+define i64 @pressure(i64* %p, i64 %n) {
+entry:
+  %v0 = load volatile i64, i64* %p
+  %v1 = load volatile i64, i64* %p
+  %v2 = load volatile i64, i64* %p
+  %v3 = load volatile i64, i64* %p
+  %v4 = load volatile i64, i64* %p
+  %v5 = load volatile i64, i64* %p
+  %v6 = load volatile i64, i64* %p
+  %v7 = load volatile i64, i64* %p
+  %v8 = load volatile i64, i64* %p
+  %v9 = load volatile i64, i64* %p
+  %v10 = load volatile i64, i64* %p
+  %v11 = load volatile i64, i64* %p
+  %v12 = load volatile i64, i64* %p
+  %v13 = load volatile i64, i64* %p
+  %v14 = load volatile i64, i64* %p
+  %v15 = load volatile i64, i64* %p
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i64 [ 0, %entry ], [ %a15, %loop ]
+  %a0 = add i64 %acc, %v0
+  %a1 = xor i64 %a0, %v1
+  %a2 = add i64 %a1, %v2
+  %a3 = xor i64 %a2, %v3
+  %a4 = add i64 %a3, %v4
+  %a5 = xor i64 %a4, %v5
+  %a6 = add i64 %a5, %v6
+  %a7 = xor i64 %a6, %v7
+  call void @clobber()
+  %a8 = add i64 %a7, %v8
+  %a9 = xor i64 %a8, %v9
+  %a10 = add i64 %a9, %v10
+  %a11 = xor i64 %a10, %v11
+  %a12 = add i64 %a11, %v12
+  %a13 = xor i64 %a12, %v13
+  %a14 = add i64 %a13, %v14
+  %a15 = xor i64 %a14, %v15
+  %i.next = add i64 %i, 1
+  %c = icmp ult i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %r = add i64 %a15, %v0
+  ret i64 %r
+}
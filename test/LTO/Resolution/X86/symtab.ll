@@ -0,0 +1,72 @@
+; The writer stores the symbol table of the module after it.
+; RUN: llvm-as < %s > %t.bc
+; RUN: llvm-bcanalyzer -dump %t.bc | FileCheck --check-prefix=BCA %s
+; BCA: <SYMTAB_BLOCK
+; BCA-NEXT: <BLOB
+
+; The symbols of the table are the ones the linker resolves.
+; RUN: llvm-lto2 %t.bc -o %t.o -save-temps \
+; RUN:  -r %t.bc,f,px \
+; RUN:  -r %t.bc,undef, \
+; RUN:  -r %t.bc,c,px \
+; RUN:  -r %t.bc,v,px \
+; RUN:  -r %t.bc,used,px \
+; RUN:  -r %t.bc,a,px
+; RUN: FileCheck --check-prefix=RES %s < %t.o.resolution.txt
+; RES: -r={{.*}},f,p
+; RES-NEXT: -r={{.*}},undef,
+; RES-NEXT: -r={{.*}},c,p
+; RES-NEXT: -r={{.*}},v,p
+; RES-NEXT: -r={{.*}},used,p
+; RES-NEXT: -r={{.*}},a,p
+; RUN: llvm-dis < %t.o.0.0.preopt.bc | FileCheck --check-prefix=IR %s
+; IR: @v = common global i64 0, align 8
+
+; A file without a table gets one built from its modules: concatenating the
+; modules of files leaves out their tables.
+; RUN: llvm-cat -b -o %t2.bc %t.bc
+; RUN: llvm-bcanalyzer -dump %t2.bc | FileCheck --check-prefix=NOSYMTAB %s
+; NOSYMTAB-NOT: <SYMTAB_BLOCK
+; RUN: llvm-lto2 %t2.bc -o %t2.o -save-temps \
+; RUN:  -r %t2.bc,f,px \
+; RUN:  -r %t2.bc,undef, \
+; RUN:  -r %t2.bc,c,px \
+; RUN:  -r %t2.bc,v,px \
+; RUN:  -r %t2.bc,used,px \
+; RUN:  -r %t2.bc,a,px
+; RUN: FileCheck --check-prefix=RES %s < %t2.o.resolution.txt
+
+; A table written by another producer is built again as well.
+; RUN: env LLVM_OVERRIDE_PRODUCER=other llvm-as < %s > %t3.bc
+; RUN: llvm-lto2 %t3.bc -o %t3.o -save-temps \
+; RUN:  -r %t3.bc,f,px \
+; RUN:  -r %t3.bc,undef, \
+; RUN:  -r %t3.bc,c,px \
+; RUN:  -r %t3.bc,v,px \
+; RUN:  -r %t3.bc,used,px \
+; RUN:  -r %t3.bc,a,px
+; RUN: FileCheck --check-prefix=RES %s < %t3.o.resolution.txt
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+$c = comdat any
+
+@c = global i32 1, comdat
+@v = common global i64 0, align 8
+@used = global i32 2
+@llvm.used = appending global [1 x i8*] [i8* bitcast (i32* @used to i8*)], section "llvm.metadata"
+
+@a = alias i32, i32* @c
+
+define void @f() {
+  call void @undef()
+  call void @local()
+  ret void
+}
+
+declare void @undef()
+
+define internal void @local() {
+  ret void
+}
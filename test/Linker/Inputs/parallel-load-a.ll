@@ -0,0 +1,5 @@
+@a = global i32 1
+
+define linkonce_odr i32 @pick() {
+  ret i32 1
+}
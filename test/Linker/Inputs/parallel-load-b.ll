@@ -0,0 +1,5 @@
+@b = global i32 2
+
+define linkonce_odr i32 @pick() {
+  ret i32 2
+}
@@ -0,0 +1,8 @@
+@c = global i32 3
+
+define i32 @use() {
+  %r = call i32 @pick()
+  ret i32 %r
+}
+
+declare i32 @pick()
@@ -0,0 +1,50 @@
+; Reading the inputs ahead on several threads must give the same result as
+; loading them in order, whatever the in-flight limit looks like.
+; RUN: llvm-link %s %S/Inputs/parallel-load-a.ll %S/Inputs/parallel-load-b.ll \
+; RUN:   %S/Inputs/parallel-load-c.ll -S -o %t.serial.ll
+; RUN: FileCheck %s < %t.serial.ll
+; RUN: llvm-link -j 2 %s %S/Inputs/parallel-load-a.ll \
+; RUN:   %S/Inputs/parallel-load-b.ll %S/Inputs/parallel-load-c.ll -S \
+; RUN:   | FileCheck %s
+; RUN: llvm-link -j 4 -max-in-flight-modules=1 %s \
+; RUN:   %S/Inputs/parallel-load-a.ll %S/Inputs/parallel-load-b.ll \
+; RUN:   %S/Inputs/parallel-load-c.ll -S | FileCheck %s
+
+; Bitcode inputs are parsed on the workers as well, and the inputs are verified
+; there without the type map.
+; RUN: llvm-as %S/Inputs/parallel-load-a.ll -o %t.a.bc
+; RUN: llvm-as %S/Inputs/parallel-load-c.ll -o %t.c.bc
+; RUN: llvm-link -j 2 %s %t.a.bc %S/Inputs/parallel-load-b.ll %t.c.bc -S \
+; RUN:   | FileCheck %s
+; RUN: llvm-link -j 2 -disable-debug-info-type-map %s %t.a.bc \
+; RUN:   %S/Inputs/parallel-load-b.ll %t.c.bc -S | FileCheck %s
+; RUN: llvm-link -j 3 %s %t.a.bc %S/Inputs/parallel-load-b.ll %t.c.bc -S \
+; RUN:   -o %t.parallel.ll
+; RUN: diff %t.serial.ll %t.parallel.ll
+
+; Inputs that fail to load are reported once and stop the link.
+; RUN: not llvm-link -j 2 %s %S/Inputs/parallel-load-a.ll %t.missing.ll \
+; RUN:   -o %t.bc 2>&1 | FileCheck --check-prefix=MISSING %s
+; MISSING: error loading file '{{.*}}missing.ll'
+; MISSING-NOT: error loading file
+
+; CHECK: @main.g = global i32 0
+; CHECK-NEXT: @a = global i32 1
+; CHECK-NEXT: @b = global i32 2
+; CHECK-NEXT: @c = global i32 3
+
+; CHECK: define i32 @main()
+; CHECK: define linkonce_odr i32 @pick() {
+; CHECK-NEXT: ret i32 1
+; CHECK: define i32 @use()
+
+@main.g = global i32 0
+
+define i32 @main() {
+  %p = call i32 @pick()
+  %r = call i32 @use()
+  ret i32 %r
+}
+
+declare i32 @pick()
+declare i32 @use()
@@ -0,0 +1,37 @@
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+@globalvar = global i32 1, align 4
+@staticvar = internal global i32 1, align 4
+
+@analias = alias void (), void ()* @aliasee
+
+define void @aliasee() {
+entry:
+  ret void
+}
+
+define i32 @foo() {
+entry:
+  %call = call i32 @bar()
+  ret i32 %call
+}
+
+define i32 @bar() {
+entry:
+  %call = call i32 @staticfunc()
+  %0 = load i32, i32* @globalvar, align 4
+  %add = add nsw i32 %call, %0
+  ret i32 %add
+}
+
+define internal i32 @staticfunc() {
+entry:
+  %0 = load i32, i32* @staticvar, align 4
+  ret i32 %0
+}
+
+define i32 @unused() {
+entry:
+  ret i32 0
+}
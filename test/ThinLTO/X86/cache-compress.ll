@@ -0,0 +1,40 @@
+; REQUIRES: zlib
+; RUN: opt -module-hash -module-summary %s -o %t.bc
+; RUN: opt -module-hash -module-summary %p/Inputs/cache.ll -o %t2.bc
+
+; The objects are stored as compressed blobs, named by the entry of each key.
+; RUN: rm -Rf %t.cache && mkdir %t.cache
+; RUN: llvm-lto2 -o %t.o %t2.bc %t.bc -cache-dir %t.cache -cache-compress \
+; RUN:  -r=%t2.bc,_main,plx \
+; RUN:  -r=%t2.bc,_globalfunc,lx \
+; RUN:  -r=%t.bc,_globalfunc,plx
+; RUN: ls %t.cache | count 4
+; RUN: ls %t.cache | grep 'blob-.*\.z$' | count 2
+; RUN: ls %t.cache | grep '\.link$' | count 2
+
+; Hits decompress the objects.
+; RUN: llvm-lto2 -o %t2.o %t2.bc %t.bc -cache-dir %t.cache -cache-compress \
+; RUN:  -r=%t2.bc,_main,plx \
+; RUN:  -r=%t2.bc,_globalfunc,lx \
+; RUN:  -r=%t.bc,_globalfunc,plx
+; RUN: ls %t.cache | count 4
+; RUN: cmp %t.o.0 %t2.o.0
+; RUN: cmp %t.o.1 %t2.o.1
+
+; An entry whose blob was pruned is a miss.
+; RUN: rm %t.cache/blob-*
+; RUN: llvm-lto2 -o %t3.o %t2.bc %t.bc -cache-dir %t.cache -cache-compress \
+; RUN:  -r=%t2.bc,_main,plx \
+; RUN:  -r=%t2.bc,_globalfunc,lx \
+; RUN:  -r=%t.bc,_globalfunc,plx
+; RUN: ls %t.cache | count 4
+; RUN: cmp %t.o.0 %t3.o.0
+; RUN: cmp %t.o.1 %t3.o.1
+
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+define void @globalfunc() #0 {
+entry:
+  ret void
+}
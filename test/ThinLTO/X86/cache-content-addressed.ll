@@ -0,0 +1,53 @@
+; RUN: opt -module-hash -module-summary %s -o %t.bc
+; RUN: opt -module-hash -module-summary %p/Inputs/cache.ll -o %t2.bc
+
+; Each object is stored once as a blob, and linked from the entry of its key.
+; RUN: rm -Rf %t.cache && mkdir %t.cache
+; RUN: llvm-lto2 -o %t.o %t2.bc %t.bc -cache-dir %t.cache \
+; RUN:  -cache-content-addressed \
+; RUN:  -r=%t2.bc,_main,plx \
+; RUN:  -r=%t2.bc,_globalfunc,lx \
+; RUN:  -r=%t.bc,_globalfunc,plx
+; RUN: ls %t.cache | count 4
+; RUN: ls %t.cache | grep blob- | count 2
+
+; The alias analysis pipeline is part of the cache key, but is not used without
+; a custom optimization pipeline: the new keys link to the existing blobs.
+; RUN: llvm-lto2 -o %t3.o %t2.bc %t.bc -cache-dir %t.cache \
+; RUN:  -cache-content-addressed -aa-pipeline=basic-aa \
+; RUN:  -r=%t2.bc,_main,plx \
+; RUN:  -r=%t2.bc,_globalfunc,lx \
+; RUN:  -r=%t.bc,_globalfunc,plx
+; RUN: ls %t.cache | count 6
+; RUN: ls %t.cache | grep blob- | count 2
+; RUN: cmp %t.o.0 %t3.o.0
+; RUN: cmp %t.o.1 %t3.o.1
+
+; Hits give back the same objects.
+; RUN: llvm-lto2 -o %t4.o %t2.bc %t.bc -cache-dir %t.cache \
+; RUN:  -cache-content-addressed \
+; RUN:  -r=%t2.bc,_main,plx \
+; RUN:  -r=%t2.bc,_globalfunc,lx \
+; RUN:  -r=%t.bc,_globalfunc,plx
+; RUN: ls %t.cache | count 6
+; RUN: cmp %t.o.0 %t4.o.0
+; RUN: cmp %t.o.1 %t4.o.1
+
+; When the cache is pruned with a manifest, a hit records the use of the blob
+; along with the use of the entry linking to it.
+; RUN: touch %t.cache/llvmcache.journal
+; RUN: llvm-lto2 -o %t5.o %t2.bc %t.bc -cache-dir %t.cache \
+; RUN:  -cache-content-addressed \
+; RUN:  -r=%t2.bc,_main,plx \
+; RUN:  -r=%t2.bc,_globalfunc,lx \
+; RUN:  -r=%t.bc,_globalfunc,plx
+; RUN: grep " blob-" %t.cache/llvmcache.journal | count 2
+; RUN: grep -v " blob-" %t.cache/llvmcache.journal | count 2
+
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+define void @globalfunc() #0 {
+entry:
+  ret void
+}
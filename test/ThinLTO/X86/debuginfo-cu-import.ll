@@ -1,6 +1,8 @@
 ; Test to ensure only the necessary DICompileUnit fields are imported
 ; for ThinLTO
 
+; REQUIRES: asserts
+
 ; RUN: opt -module-summary %s -o %t1.bc
 ; RUN: opt -module-summary %p/Inputs/debuginfo-cu-import.ll -o %t2.bc
 ; RUN: llvm-lto -thinlto-action=thinlink -o %t.index.bc %t1.bc %t2.bc
@@ -15,6 +17,25 @@
 ; CHECK: DICompileUnit{{.*}} imports: ![[IMP:[0-9]+]]
 ; CHECK: ![[IMP]] = !{!{{[0-9]+}}}
 
+; The lists are trimmed the same way when the metadata is loaded lazily, the
+; global variables are not imported and their attachments are never parsed.
+; RUN: opt -module-summary %p/Inputs/debuginfo-cu-import.ll -o %t3.bc \
+; RUN:     -bitcode-mdindex-threshold=0
+; RUN: llvm-lto -thinlto-action=thinlink -o %t.index2.bc %t1.bc %t3.bc
+; RUN: llvm-lto -thinlto-action=import %t3.bc -thinlto-index=%t.index2.bc \
+; RUN:     -o - | llvm-dis -o - | FileCheck %s
+
+; The dropped lists and the attachments of the globals are never loaded: 69
+; records instead of 87 when the metadata is loaded eagerly, or 83 when it is
+; loaded lazily but the lists are loaded in full.
+; RUN: llvm-lto -thinlto-action=import %t3.bc -thinlto-index=%t.index2.bc \
+; RUN:     -o /dev/null -stats 2>&1 | FileCheck %s --check-prefix=LAZY
+; LAZY: 69 bitcode-reader  - Number of Metadata records loaded
+; RUN: llvm-lto -thinlto-action=import %t3.bc -thinlto-index=%t.index2.bc \
+; RUN:     -o /dev/null -disable-ondemand-mds-loading -stats 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=NOTLAZY
+; NOTLAZY: 87 bitcode-reader  - Number of Metadata records loaded
+
 ; ModuleID = 'debuginfo-cu-import.c'
 source_filename = "debuginfo-cu-import.c"
 target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
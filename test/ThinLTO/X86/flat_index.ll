@@ -0,0 +1,60 @@
+; Check that the backend actions accept a flat index in place of the bitcode
+; one, and produce the same output from it.
+; RUN: opt -module-summary %s -o %t1.bc
+; RUN: opt -module-summary %p/Inputs/flat_index.ll -o %t2.bc
+; RUN: llvm-lto -thinlto-action=thinlink -o %t.index.bc %t1.bc %t2.bc
+; RUN: llvm-lto -thinlto-action=thinlink -thinlto-flat-index \
+; RUN:   -o %t.index.flat %t1.bc %t2.bc
+
+; The import lists only depend on the part of the flat index reachable from
+; each module.
+; RUN: llvm-lto -thinlto-action=emitimports -thinlto-index=%t.index.bc \
+; RUN:   %t1.bc -o %t1.imports.bc
+; RUN: llvm-lto -thinlto-action=emitimports -thinlto-index=%t.index.flat \
+; RUN:   %t1.bc -o %t1.imports.flat
+; RUN: cat %t1.imports.flat | FileCheck %s --check-prefix=IMPORTS
+; RUN: diff %t1.imports.bc %t1.imports.flat
+; IMPORTS: {{.*}}2.bc
+
+; The per-module index holds the same summaries.
+; RUN: llvm-lto -thinlto-action=distributedindexes \
+; RUN:   -thinlto-index=%t.index.bc %t1.bc -o %t1.thinlto.bc
+; RUN: llvm-lto -thinlto-action=distributedindexes \
+; RUN:   -thinlto-index=%t.index.flat %t1.bc -o %t1.thinlto.flat
+; RUN: llvm-lto -thinlto-index-stats %t1.thinlto.bc | FileCheck %s \
+; RUN:   --check-prefix=STATS
+; RUN: llvm-lto -thinlto-index-stats %t1.thinlto.flat | FileCheck %s \
+; RUN:   --check-prefix=STATS
+; STATS: contains 4 nodes (4 functions, 0 alias, 0 globals) and 5 edges (2 refs and 3 calls)
+
+; Promotion, importing and internalization decode the whole flat index.
+; RUN: llvm-lto -thinlto-action=import -thinlto-index=%t.index.bc %t1.bc \
+; RUN:   -o - | llvm-dis -o %t1.import.bc.ll
+; RUN: llvm-lto -thinlto-action=import -thinlto-index=%t.index.flat %t1.bc \
+; RUN:   -o - | llvm-dis -o %t1.import.flat.ll
+; RUN: diff %t1.import.bc.ll %t1.import.flat.ll
+; RUN: FileCheck %s --check-prefix=IMPORT < %t1.import.flat.ll
+; IMPORT-DAG: define available_externally i32 @foo()
+; IMPORT-DAG: define available_externally i32 @bar()
+; IMPORT-DAG: define available_externally hidden i32 @staticfunc.llvm.0()
+; IMPORT-DAG: declare void @analias()
+; IMPORT-NOT: @unused
+
+; RUN: llvm-lto -thinlto-action=promote -thinlto-index=%t.index.flat %t2.bc \
+; RUN:   -o - | llvm-dis -o - | FileCheck %s --check-prefix=PROMOTE
+; PROMOTE-DAG: @staticvar.llvm.0 = hidden global
+; PROMOTE-DAG: define hidden i32 @staticfunc.llvm.0()
+
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+define i32 @main() {
+entry:
+  %call = call i32 @foo()
+  call void @analias()
+  ret i32 %call
+}
+
+declare i32 @foo()
+
+declare void @analias()
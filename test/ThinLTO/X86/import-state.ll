@@ -0,0 +1,77 @@
+; Check that -thinlto-import-state reuses the import lists of an earlier link,
+; except for the modules that changed and the modules importing from them.
+; REQUIRES: asserts
+
+; RUN: opt -module-hash -module-summary %s -o %t1.bc
+; RUN: opt -module-hash -module-summary %p/Inputs/import-state.ll -o %t2.bc
+; RUN: opt -module-hash -module-summary %p/Inputs/import-state-other.ll -o %t3.bc
+; RUN: rm -f %t.state
+
+; RUN: llvm-lto2 %t1.bc %t2.bc %t3.bc -o %t.o -thinlto-threads=1 \
+; RUN:     -thinlto-import-state=%t.state -debug-only=function-import \
+; RUN:     -r=%t1.bc,main,plx -r=%t1.bc,foo, \
+; RUN:     -r=%t2.bc,foo,pl -r=%t3.bc,other,plx 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=FIRST --implicit-check-not="Reusing import"
+; FIRST-DAG: Computing import for Module '{{.*}}1.bc'
+; FIRST-DAG: Computing import for Module '{{.*}}2.bc'
+; FIRST-DAG: Computing import for Module '{{.*}}3.bc'
+
+; RUN: llvm-lto2 %t1.bc %t2.bc %t3.bc -o %t.o -thinlto-threads=1 \
+; RUN:     -thinlto-import-state=%t.state -debug-only=function-import \
+; RUN:     -r=%t1.bc,main,plx -r=%t1.bc,foo, \
+; RUN:     -r=%t2.bc,foo,pl -r=%t3.bc,other,plx 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=SAME --implicit-check-not="Computing import"
+; SAME-DAG: Reusing import for Module '{{.*}}1.bc'
+; SAME-DAG: Reusing import for Module '{{.*}}2.bc'
+; SAME-DAG: Reusing import for Module '{{.*}}3.bc'
+
+; Change the module defining foo: the module importing it is computed again.
+; RUN: opt -module-hash -module-summary %p/Inputs/import-state-changed.ll \
+; RUN:     -o %t2.bc
+; RUN: llvm-lto2 %t1.bc %t2.bc %t3.bc -o %t.inc.o -thinlto-threads=1 \
+; RUN:     -thinlto-import-state=%t.state -debug-only=function-import \
+; RUN:     -save-temps \
+; RUN:     -r=%t1.bc,main,plx -r=%t1.bc,foo, \
+; RUN:     -r=%t2.bc,foo,pl -r=%t3.bc,other,plx 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=CHANGED
+; CHANGED-DAG: Computing import for Module '{{.*}}1.bc'
+; CHANGED-DAG: Computing import for Module '{{.*}}2.bc'
+; CHANGED-DAG: Reusing import for Module '{{.*}}3.bc'
+
+; The result is the one of a link without state.
+; RUN: llvm-lto2 %t1.bc %t2.bc %t3.bc -o %t.full.o -thinlto-threads=1 \
+; RUN:     -save-temps \
+; RUN:     -r=%t1.bc,main,plx -r=%t1.bc,foo, \
+; RUN:     -r=%t2.bc,foo,pl -r=%t3.bc,other,plx
+; RUN: cmp %t.inc.o.0.3.import.bc %t.full.o.0.3.import.bc
+; RUN: llvm-dis %t.inc.o.0.3.import.bc -o - | FileCheck %s --check-prefix=IMPORT
+; IMPORT: define available_externally i32 @foo()
+; IMPORT-NEXT: ret i32 2
+
+; The legacy code generator reuses the import lists the same way.
+; RUN: opt -module-hash -module-summary %p/Inputs/import-state.ll -o %t2.bc
+; RUN: rm -f %t.legacy.state
+; RUN: llvm-lto -thinlto-action=run -exported-symbol=main \
+; RUN:     -thinlto-import-state=%t.legacy.state -debug-only=function-import \
+; RUN:     %t1.bc %t2.bc %t3.bc 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=FIRST --implicit-check-not="Reusing import"
+; RUN: llvm-lto -thinlto-action=run -exported-symbol=main \
+; RUN:     -thinlto-import-state=%t.legacy.state -debug-only=function-import \
+; RUN:     %t1.bc %t2.bc %t3.bc 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=SAME --implicit-check-not="Computing import"
+; RUN: opt -module-hash -module-summary %p/Inputs/import-state-changed.ll \
+; RUN:     -o %t2.bc
+; RUN: llvm-lto -thinlto-action=run -exported-symbol=main \
+; RUN:     -thinlto-import-state=%t.legacy.state -debug-only=function-import \
+; RUN:     %t1.bc %t2.bc %t3.bc 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=CHANGED
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @foo()
+
+define i32 @main() {
+  %r = call i32 @foo()
+  ret i32 %r
+}
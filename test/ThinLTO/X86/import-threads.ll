@@ -0,0 +1,26 @@
+; The import lists computed by the thin link do not depend on the number of
+; threads computing them.
+; RUN: opt -module-summary %s -o %t1.bc
+; RUN: opt -module-summary %p/Inputs/funcimport2.ll -o %t2.bc
+
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.st.o -save-temps -import-threads=1 \
+; RUN:     -r=%t1.bc,_foo,plx \
+; RUN:     -r=%t2.bc,_main,plx \
+; RUN:     -r=%t2.bc,_foo,l
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.mt.o -save-temps -import-threads=4 \
+; RUN:     -r=%t1.bc,_foo,plx \
+; RUN:     -r=%t2.bc,_main,plx \
+; RUN:     -r=%t2.bc,_foo,l
+; RUN: llvm-dis < %t.st.o.1.3.import.bc -o %t.st.ll
+; RUN: llvm-dis < %t.mt.o.1.3.import.bc -o %t.mt.ll
+; RUN: diff %t.st.ll %t.mt.ll
+; RUN: FileCheck %s < %t.mt.ll
+; CHECK: define available_externally void @foo()
+
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+define void @foo() #0 {
+entry:
+  ret void
+}
@@ -0,0 +1,47 @@
+; RUN: opt -module-hash -module-summary %s -o %t1.bc
+; RUN: opt -module-hash -module-summary %p/Inputs/funcimport2.ll -o %t2.bc
+
+; Running the backend jobs in worker processes gives the same objects as
+; running them in-process.
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.inproc.o \
+; RUN:     -r=%t1.bc,_foo,plx \
+; RUN:     -r=%t2.bc,_main,plx \
+; RUN:     -r=%t2.bc,_foo,l
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.oop.o -thinlto-out-of-process \
+; RUN:     -thinlto-threads=2 \
+; RUN:     -r=%t1.bc,_foo,plx \
+; RUN:     -r=%t2.bc,_main,plx \
+; RUN:     -r=%t2.bc,_foo,l
+; RUN: cmp %t.inproc.o.0 %t.oop.o.0
+; RUN: cmp %t.inproc.o.1 %t.oop.o.1
+; RUN: llvm-nm %t.oop.o.1 | FileCheck %s
+; CHECK: T _main
+
+; Objects produced by the workers are cached under the same keys as with the
+; in-process backend: the second link below only hits the cache, so no backend
+; runs and no temporaries are saved.
+; RUN: rm -rf %t.cache && mkdir %t.cache
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.oop.o -thinlto-out-of-process \
+; RUN:     -cache-dir %t.cache \
+; RUN:     -r=%t1.bc,_foo,plx \
+; RUN:     -r=%t2.bc,_main,plx \
+; RUN:     -r=%t2.bc,_foo,l
+; RUN: rm -f %t.hit.o.0.3.import.bc
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.hit.o -save-temps -cache-dir %t.cache \
+; RUN:     -r=%t1.bc,_foo,plx \
+; RUN:     -r=%t2.bc,_main,plx \
+; RUN:     -r=%t2.bc,_foo,l
+; RUN: not ls %t.hit.o.0.3.import.bc
+; RUN: cmp %t.inproc.o.1 %t.hit.o.1
+
+; RUN: not llvm-lto2 -thinlto-job=%t.missing.job 2>&1 \
+; RUN:     | FileCheck --check-prefix=NOJOB %s
+; NOJOB: llvm-lto2: {{.*}}missing.job:
+
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+define void @foo() #0 {
+entry:
+  ret void
+}
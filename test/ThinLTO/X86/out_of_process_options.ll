@@ -0,0 +1,29 @@
+; The workers of the out-of-process backend get the code generation options of
+; the parent, including the ones that are not recorded in the job file, so they
+; produce the same objects as the in-process backend.
+; RUN: opt -module-hash -module-summary %s -o %t.bc
+; RUN: llvm-lto2 %t.bc -o %t.inproc.o -enable-unsafe-fp-math \
+; RUN:     -r=%t.bc,_addzero,plx
+; RUN: llvm-lto2 %t.bc -o %t.oop.o -enable-unsafe-fp-math \
+; RUN:     -thinlto-out-of-process -r %t.bc,_addzero,plx
+; RUN: cmp %t.inproc.o.0 %t.oop.o.0
+; RUN: llvm-objdump -d %t.oop.o.0 | FileCheck %s
+
+; Without the option, the addition is kept.
+; RUN: llvm-lto2 %t.bc -o %t.strict.o -thinlto-out-of-process \
+; RUN:     -r=%t.bc,_addzero,plx
+; RUN: llvm-objdump -d %t.strict.o.0 | FileCheck --check-prefix=STRICT %s
+
+; CHECK-LABEL: _addzero:
+; CHECK-NOT: addsd
+; CHECK: retq
+; STRICT-LABEL: _addzero:
+; STRICT: addsd
+
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+define double @addzero(double %x) {
+  %r = fadd double %x, 0.0
+  ret double %r
+}
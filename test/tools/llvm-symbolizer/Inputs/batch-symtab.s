@@ -0,0 +1,16 @@
+# sized covers 8 of its 16 bytes, nosize extends to last, the last symbol.
+  .text
+  .globl sized
+  .type sized,@function
+sized:
+  .fill 16, 1, 0x90
+  .size sized, 8
+  .globl nosize
+  .type nosize,@function
+nosize:
+  .fill 16, 1, 0x90
+  .globl last
+  .type last,@function
+last:
+  .fill 4, 1, 0x90
+  .size last, 4
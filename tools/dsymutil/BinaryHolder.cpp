@@ -44,7 +44,7 @@ void BinaryHolder::changeBackingMemoryBuffer(
 ErrorOr<std::vector<MemoryBufferRef>> BinaryHolder::GetMemoryBuffersForFile(
     StringRef Filename, sys::TimePoint<std::chrono::seconds> Timestamp) {
   if (Verbose)
-    outs() << "trying to open '" << Filename << "'\n";
+    verboseOS() << "trying to open '" << Filename << "'\n";
 
   // Try that first as it doesn't involve any filesystem access.
   if (auto ErrOrArchiveMembers = GetArchiveMemberBuffers(Filename, Timestamp))
@@ -68,7 +68,7 @@ ErrorOr<std::vector<MemoryBufferRef>> BinaryHolder::GetMemoryBuffersForFile(
 
   changeBackingMemoryBuffer(std::move(*ErrOrFile));
   if (Verbose)
-    outs() << "\tloaded file.\n";
+    verboseOS() << "\tloaded file.\n";
 
   auto ErrOrFat = object::MachOUniversalBinary::create(
       CurrentMemoryBuffer->getMemBufferRef());
@@ -110,11 +110,11 @@ ErrorOr<std::vector<MemoryBufferRef>> BinaryHolder::GetArchiveMemberBuffers(
           if (Timestamp != sys::TimePoint<>() &&
               Timestamp != ModTimeOrErr.get()) {
             if (Verbose)
-              outs() << "\tmember had timestamp mismatch.\n";
+              verboseOS() << "\tmember had timestamp mismatch.\n";
             continue;
           }
           if (Verbose)
-            outs() << "\tfound member in current archive.\n";
+            verboseOS() << "\tfound member in current archive.\n";
           auto ErrOrMem = Child.getMemoryBufferRef();
           if (!ErrOrMem)
             return errorToErrorCode(ErrOrMem.takeError());
@@ -141,7 +141,7 @@ BinaryHolder::MapArchiveAndGetMemberBuffers(
     return Err;
 
   if (Verbose)
-    outs() << "\topened new archive '" << ArchiveFilename << "'\n";
+    verboseOS() << "\topened new archive '" << ArchiveFilename << "'\n";
 
   changeBackingMemoryBuffer(std::move(*ErrOrBuff));
   std::vector<MemoryBufferRef> ArchiveBuffers;
@@ -22,6 +22,7 @@
 #include "llvm/Support/Chrono.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/raw_ostream.h"
 
 namespace llvm {
 namespace dsymutil {
@@ -44,6 +45,10 @@ class BinaryHolder {
   std::unique_ptr<object::MachOUniversalBinary> CurrentFatBinary;
   std::string CurrentFatBinaryName;
   bool Verbose;
+  /// The stream the verbose output goes to, outs() if null.
+  raw_ostream *VerboseOS;
+
+  raw_ostream &verboseOS() { return VerboseOS ? *VerboseOS : outs(); }
 
   /// Get the MemoryBufferRefs for the file specification in \p
   /// Filename from the current archive. Multiple buffers are returned
@@ -83,7 +88,8 @@ class BinaryHolder {
   ErrorOr<const object::ObjectFile &> getObjfileForArch(const Triple &T);
 
 public:
-  BinaryHolder(bool Verbose) : Verbose(Verbose) {}
+  BinaryHolder(bool Verbose, raw_ostream *VerboseOS = nullptr)
+      : Verbose(Verbose), VerboseOS(VerboseOS) {}
 
   /// Get the ObjectFiles designated by the \p Filename. This
   /// might be an archive member specification of the form
@@ -36,6 +36,7 @@
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include <memory>
@@ -1424,6 +1425,40 @@ private:
                                                  const DebugMap &Map);
   /// @}
 
+  /// The state of a debug map object that doesn't depend on the other
+  /// objects of the link. It can be computed ahead of time and concurrently
+  /// for several objects, while the object-order-dependent phases (ODR
+  /// analysis, DIE selection, cloning and emission) stay sequential.
+  struct LinkContext {
+    DebugMapObject &DMO;
+    /// The verbose output of the loading phase. It is printed when the
+    /// object is linked, after its header.
+    std::string LoadLog;
+    raw_string_ostream LoadLogOS;
+    /// Each context owns its binary so that objects can be loaded from
+    /// different threads.
+    BinaryHolder BinHolder;
+    /// The error encountered while loading the object file, if any. It is
+    /// reported when the object is linked to keep diagnostics in debug map
+    /// order.
+    std::error_code LoadError;
+    const object::ObjectFile *ObjectFile;
+    std::unique_ptr<DWARFContextInMemory> DwarfContext;
+
+    LinkContext(DebugMapObject &DMO, bool Verbose)
+        : DMO(DMO), LoadLogOS(LoadLog), BinHolder(Verbose, &LoadLogOS),
+          ObjectFile(nullptr) {}
+  };
+
+  /// \brief Load the object described by \p Context and parse its debug
+  /// information: the DIEs and line tables of every compile unit. This can
+  /// run on any thread as it doesn't access any linker state.
+  void loadDebugObject(LinkContext &Context, const DebugMap &Map);
+
+  /// \brief Link the debug information of an object loaded by
+  /// loadDebugObject(). This must be called in debug map order.
+  void linkDebugObject(LinkContext &Context, DebugMap &ModuleMap);
+
   std::string OutputFilename;
   LinkOptions Options;
   BinaryHolder BinHolder;
@@ -3395,6 +3430,92 @@ void DwarfLinker::DIECloner::cloneAllCompileUnits(
   }
 }
 
+void DwarfLinker::loadDebugObject(LinkContext &Context, const DebugMap &Map) {
+  auto ErrOrObjs = Context.BinHolder.GetObjectFiles(
+      Context.DMO.getObjectFilename(), Context.DMO.getTimestamp());
+  if ((Context.LoadError = ErrOrObjs.getError()))
+    return;
+  auto ErrOrObj = Context.BinHolder.Get(Map.getTriple());
+  if ((Context.LoadError = ErrOrObj.getError()))
+    return;
+  Context.ObjectFile = &*ErrOrObj;
+
+  // Setup access to the debug info and parse everything the linking phases
+  // will need. The parsed data is cached in the DWARFContext.
+  Context.DwarfContext =
+      llvm::make_unique<DWARFContextInMemory>(*Context.ObjectFile);
+  for (const auto &CU : Context.DwarfContext->compile_units()) {
+    CU->getNumDIEs();
+    Context.DwarfContext->getLineTableForUnit(CU.get());
+  }
+}
+
+void DwarfLinker::linkDebugObject(LinkContext &Context, DebugMap &ModuleMap) {
+  DebugMapObject &Obj = Context.DMO;
+  CurrentDebugObject = &Obj;
+
+  if (Options.Verbose)
+    outs() << "DEBUG MAP OBJECT: " << Obj.getObjectFilename() << "\n"
+           << Context.LoadLogOS.str();
+  if (Context.LoadError) {
+    reportWarning(Twine(Obj.getObjectFilename()) + ": " +
+                  Context.LoadError.message());
+    return;
+  }
+
+  // Look for relocations that correspond to debug map entries.
+  RelocationManager RelocMgr(*this);
+  if (!RelocMgr.findValidRelocsInDebugInfo(*Context.ObjectFile, Obj)) {
+    if (Options.Verbose)
+      outs() << "No valid relocations found. Skipping.\n";
+    return;
+  }
+
+  DWARFContextInMemory &DwarfContext = *Context.DwarfContext;
+  startDebugObject(DwarfContext, Obj);
+
+  // In a first phase, just read in the debug info and load all clang modules.
+  for (const auto &CU : DwarfContext.compile_units()) {
+    auto CUDie = CU->getUnitDIE(false);
+    if (Options.Verbose) {
+      outs() << "Input compilation unit:";
+      CUDie.dump(outs(), 0);
+    }
+
+    if (!registerModuleReference(CUDie, *CU, ModuleMap))
+      Units.push_back(llvm::make_unique<CompileUnit>(*CU, UnitID++,
+                                                     !Options.NoODR, ""));
+  }
+
+  // Now build the DIE parent links that we will use during the next phase.
+  for (auto &CurrentUnit : Units)
+    analyzeContextInfo(CurrentUnit->getOrigUnit().getUnitDIE(), 0, *CurrentUnit,
+                       &ODRContexts.getRoot(), StringPool, ODRContexts);
+
+  // Then mark all the DIEs that need to be present in the linked
+  // output and collect some information about them. Note that this
+  // loop can not be merged with the previous one becaue cross-cu
+  // references require the ParentIdx to be setup for every CU in
+  // the object file before calling this.
+  for (auto &CurrentUnit : Units)
+    lookForDIEsToKeep(RelocMgr, CurrentUnit->getOrigUnit().getUnitDIE(), Obj,
+                      *CurrentUnit, 0);
+
+  // The calls to applyValidRelocs inside cloneDIE will walk the
+  // reloc array again (in the same way findValidRelocsInDebugInfo()
+  // did). We need to reset the NextValidReloc index to the beginning.
+  RelocMgr.resetValidRelocs();
+  if (RelocMgr.hasValidRelocs())
+    DIECloner(*this, RelocMgr, DIEAlloc, Units, Options)
+        .cloneAllCompileUnits(DwarfContext);
+  if (!Options.NoOutput && !Units.empty())
+    patchFrameInfoForObject(Obj, DwarfContext,
+                            Units[0]->getOrigUnit().getAddressByteSize());
+
+  // Clean-up before starting working on the next object.
+  endDebugObject();
+}
+
 bool DwarfLinker::link(const DebugMap &Map) {
 
   if (!createStreamer(Map.getTriple(), OutputFilename))
@@ -3406,67 +3527,46 @@ bool DwarfLinker::link(const DebugMap &Map) {
   UnitID = 0;
   DebugMap ModuleMap(Map.getTriple(), Map.getBinaryPath());
 
-  for (const auto &Obj : Map.objects()) {
-    CurrentDebugObject = Obj.get();
-
-    if (Options.Verbose)
-      outs() << "DEBUG MAP OBJECT: " << Obj->getObjectFilename() << "\n";
-    auto ErrOrObj = loadObject(BinHolder, *Obj, Map);
-    if (!ErrOrObj)
-      continue;
-
-    // Look for relocations that correspond to debug map entries.
-    RelocationManager RelocMgr(*this);
-    if (!RelocMgr.findValidRelocsInDebugInfo(*ErrOrObj, *Obj)) {
-      if (Options.Verbose)
-        outs() << "No valid relocations found. Skipping.\n";
-      continue;
+  // Loading and parsing the objects is independent of the link order, so
+  // it is done by a pool of threads running ahead of the linking loop below.
+  // Linking itself (which depends on the ODR state and output offsets built
+  // by the previous objects) happens in debug map order, which keeps the
+  // output identical to a single-threaded link. The verbose output of the
+  // loading phase is buffered and printed in that order as well.
+  unsigned NumThreads = Options.Threads;
+  if (!NumThreads)
+    NumThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<std::unique_ptr<LinkContext>> Contexts;
+  for (const auto &Obj : Map.objects())
+    Contexts.push_back(llvm::make_unique<LinkContext>(*Obj, Options.Verbose));
+  unsigned NumObjects = Contexts.size();
+
+  if (NumThreads == 1) {
+    for (auto &Context : Contexts) {
+      loadDebugObject(*Context, Map);
+      linkDebugObject(*Context, ModuleMap);
+      Context.reset();
     }
-
-    // Setup access to the debug info.
-    DWARFContextInMemory DwarfContext(*ErrOrObj);
-    startDebugObject(DwarfContext, *Obj);
-
-    // In a first phase, just read in the debug info and load all clang modules.
-    for (const auto &CU : DwarfContext.compile_units()) {
-      auto CUDie = CU->getUnitDIE(false);
-      if (Options.Verbose) {
-        outs() << "Input compilation unit:";
-        CUDie.dump(outs(), 0);
-      }
-
-      if (!registerModuleReference(CUDie, *CU, ModuleMap))
-        Units.push_back(llvm::make_unique<CompileUnit>(*CU, UnitID++,
-                                                       !Options.NoODR, ""));
+  } else {
+    // Bound the number of objects loaded ahead of the linking loop to keep
+    // the memory usage under control.
+    unsigned Window = 2 * NumThreads;
+    ThreadPool Pool(NumThreads);
+    std::vector<std::shared_future<ThreadPool::VoidTy>> Loaded(NumObjects);
+    auto ScheduleLoad = [&](unsigned I) {
+      LinkContext &Context = *Contexts[I];
+      Loaded[I] = Pool.async([&] { loadDebugObject(Context, Map); });
+    };
+    for (unsigned I = 0; I < std::min(Window, NumObjects); ++I)
+      ScheduleLoad(I);
+    for (unsigned I = 0; I < NumObjects; ++I) {
+      Loaded[I].wait();
+      if (I + Window < NumObjects)
+        ScheduleLoad(I + Window);
+      linkDebugObject(*Contexts[I], ModuleMap);
+      Contexts[I].reset();
     }
-
-    // Now build the DIE parent links that we will use during the next phase.
-    for (auto &CurrentUnit : Units)
-      analyzeContextInfo(CurrentUnit->getOrigUnit().getUnitDIE(), 0, *CurrentUnit,
-                         &ODRContexts.getRoot(), StringPool, ODRContexts);
-
-    // Then mark all the DIEs that need to be present in the linked
-    // output and collect some information about them. Note that this
-    // loop can not be merged with the previous one becaue cross-cu
-    // references require the ParentIdx to be setup for every CU in
-    // the object file before calling this.
-    for (auto &CurrentUnit : Units)
-      lookForDIEsToKeep(RelocMgr, CurrentUnit->getOrigUnit().getUnitDIE(), *Obj,
-                        *CurrentUnit, 0);
-
-    // The calls to applyValidRelocs inside cloneDIE will walk the
-    // reloc array again (in the same way findValidRelocsInDebugInfo()
-    // did). We need to reset the NextValidReloc index to the beginning.
-    RelocMgr.resetValidRelocs();
-    if (RelocMgr.hasValidRelocs())
-      DIECloner(*this, RelocMgr, DIEAlloc, Units, Options)
-          .cloneAllCompileUnits(DwarfContext);
-    if (!Options.NoOutput && !Units.empty())
-      patchFrameInfoForObject(*Obj, DwarfContext,
-                              Units[0]->getOrigUnit().getAddressByteSize());
-
-    // Clean-up before starting working on the next object.
-    endDebugObject();
   }
 
   // Emit everything that's global.
@@ -49,6 +49,7 @@ int main(int argc, char **argv) {
                       BitcodeMod.getBuffer().end());
     }
   } else {
+    std::vector<std::unique_ptr<Module>> OwnedMods;
     for (std::string InputFilename : InputFilenames) {
       SMDiagnostic Err;
       std::unique_ptr<Module> M = parseIRFile(InputFilename, Err, Context);
@@ -57,7 +58,9 @@ int main(int argc, char **argv) {
         return 1;
       }
       Writer.writeModule(M.get());
+      OwnedMods.push_back(std::move(M));
     }
+    Writer.writeSymtab();
   }
 
   std::error_code EC;
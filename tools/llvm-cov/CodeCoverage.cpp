@@ -134,6 +134,9 @@ private:
   /// The architecture the coverage mapping data targets.
   std::string CoverageArch;
 
+  /// The directory in which decoded coverage mappings are cached, if any.
+  std::string CoverageCacheDir;
+
   /// A cache for demangled symbols.
   DemangleCache DC;
 
@@ -328,7 +331,8 @@ std::unique_ptr<CoverageMapping> CodeCoverageTool::load() {
       warning("profile data may be out of date - object is newer",
               ObjectFilename);
   auto CoverageOrErr =
-      CoverageMapping::load(ObjectFilenames, PGOFilename, CoverageArch);
+      CoverageMapping::load(ObjectFilenames, PGOFilename, CoverageArch,
+                            CoverageCacheDir);
   if (Error E = CoverageOrErr.takeError()) {
     error("Failed to load coverage: " + toString(std::move(E)),
           join(ObjectFilenames.begin(), ObjectFilenames.end(), ", "));
@@ -502,6 +506,12 @@ int CodeCoverageTool::run(Command Cmd, int argc, const char **argv) {
   cl::opt<bool> DebugDump("dump", cl::Optional,
                           cl::desc("Show internal debug dump"));
 
+  cl::opt<std::string, true> CacheDir(
+      "cache-dir", cl::Optional, cl::location(this->CoverageCacheDir),
+      cl::desc("Directory in which to cache the decoded coverage mapping, so "
+               "that later runs on the same binaries and profile can skip "
+               "decoding them"));
+
   cl::opt<CoverageViewOptions::OutputFormat> Format(
       "format", cl::desc("Output format for line-based coverage reports"),
       cl::values(clEnumValN(CoverageViewOptions::OutputFormat::Text, "text",
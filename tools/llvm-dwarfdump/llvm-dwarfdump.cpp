@@ -15,6 +15,7 @@
 #include "llvm/ADT/Triple.h"
 #include "llvm/DebugInfo/DIContext.h"
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/DebugInfo/DWARF/DWARFUnit.h"
 #include "llvm/Object/MachOUniversal.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Object/RelocVisitor.h"
@@ -26,11 +27,14 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cstring>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <vector>
 
 using namespace llvm;
 using namespace object;
@@ -78,6 +82,20 @@ static cl::opt<bool>
     SummarizeTypes("summarize-types",
                    cl::desc("Abbreviate the description of type unit entries"));
 
+static cl::opt<bool>
+    Statistics("statistics",
+               cl::desc("Print the size, DIE count and name of each unit of "
+                        ".debug_info and .debug_types instead of dumping the "
+                        "debug sections"));
+
+static cl::opt<unsigned>
+    NumThreads("num-threads",
+               cl::desc("Number of threads used to parse the units for "
+                        "-statistics, 0 for all the cores"),
+               cl::init(0));
+static cl::alias NumThreadsA("j", cl::desc("Alias for -num-threads"),
+                             cl::aliasopt(NumThreads));
+
 static void error(StringRef Filename, std::error_code EC) {
   if (!EC)
     return;
@@ -85,13 +103,88 @@ static void error(StringRef Filename, std::error_code EC) {
   exit(1);
 }
 
+namespace {
+struct UnitStatistics {
+  uint32_t Offset;
+  uint32_t Size;
+  unsigned NumDIEs;
+  std::string Name;
+};
+} // end anonymous namespace
+
+static UnitStatistics computeStatistics(DWARFUnit &U) {
+  UnitStatistics Stats;
+  Stats.Offset = U.getOffset();
+  Stats.Size = U.getNextUnitOffset() - U.getOffset();
+  // Only keep the DIEs of the units which are being parsed, so that the
+  // memory use is bounded by the number of threads.
+  bool WasExtracted = U.hasExtractedDIEs();
+  Stats.NumDIEs = U.getNumDIEs();
+  Stats.Name = dwarf::toString(U.getUnitDIE().find(dwarf::DW_AT_name), "");
+  if (!WasExtracted)
+    U.clearDIEs(true);
+  return Stats;
+}
+
+/// Print the statistics of the units of one section. The units are parsed
+/// concurrently, each one by a single thread, and their statistics are
+/// printed in section order as soon as they are available.
+static void printStatistics(ThreadPool &Pool, StringRef SectionName,
+                            ArrayRef<DWARFUnit *> Units) {
+  if (Units.empty())
+    return;
+  std::vector<UnitStatistics> Stats(Units.size());
+  std::vector<std::shared_future<void>> Futures;
+  Futures.reserve(Units.size());
+  for (size_t I = 0, E = Units.size(); I != E; ++I)
+    Futures.push_back(
+        Pool.async([&, I] { Stats[I] = computeStatistics(*Units[I]); }));
+
+  outs() << SectionName << " statistics:\n";
+  uint64_t TotalSize = 0, TotalDIEs = 0;
+  for (size_t I = 0, E = Units.size(); I != E; ++I) {
+    Futures[I].wait();
+    const UnitStatistics &S = Stats[I];
+    outs() << format("0x%08x", S.Offset) << ": size = "
+           << format("0x%08x", S.Size) << " dies = " << S.NumDIEs
+           << " name = \"" << S.Name << "\"\n";
+    TotalSize += S.Size;
+    TotalDIEs += S.NumDIEs;
+  }
+  outs() << "total: units = " << Units.size() << " size = "
+         << format("0x%08" PRIx64, TotalSize) << " dies = " << TotalDIEs
+         << "\n\n";
+}
+
+static void printStatistics(DWARFContext &DICtx) {
+  unsigned Threads = NumThreads;
+  if (Threads == 0)
+    Threads = std::thread::hardware_concurrency();
+  ThreadPool Pool(Threads);
+
+  std::vector<DWARFUnit *> Units;
+  for (const auto &CU : DICtx.compile_units())
+    Units.push_back(CU.get());
+  printStatistics(Pool, ".debug_info", Units);
+
+  Units.clear();
+  for (const auto &TUS : DICtx.type_unit_sections())
+    for (const auto &TU : TUS)
+      Units.push_back(TU.get());
+  printStatistics(Pool, ".debug_types", Units);
+}
+
 static void DumpObjectFile(ObjectFile &Obj, Twine Filename) {
-  std::unique_ptr<DIContext> DICtx(new DWARFContextInMemory(Obj));
+  DWARFContextInMemory DICtx(Obj);
 
   outs() << Filename.str() << ":\tfile format " << Obj.getFileFormatName()
          << "\n\n";
+  if (Statistics) {
+    printStatistics(DICtx);
+    return;
+  }
   // Dump the complete DWARF structure.
-  DICtx->dump(outs(), DumpType, false, SummarizeTypes);
+  DICtx.dump(outs(), DumpType, false, SummarizeTypes);
 }
 
 static void DumpInput(StringRef Filename) {
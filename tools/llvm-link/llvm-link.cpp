@@ -13,6 +13,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/AutoUpgrade.h"
 #include "llvm/IR/DiagnosticInfo.h"
@@ -32,6 +33,8 @@
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Transforms/IPO/FunctionImport.h"
 #include "llvm/Transforms/Utils/FunctionImportUtils.h"
@@ -92,6 +95,20 @@ static cl::opt<bool>
 static cl::opt<bool>
 Verbose("v", cl::desc("Print information about actions taken"));
 
+static cl::opt<unsigned> NumThreads(
+    "num-threads",
+    cl::desc("Number of threads used to parse the regular input files "
+             "ahead of linking them (default: 1, 0: the number of cores)"),
+    cl::init(1));
+static cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
+                             cl::aliasopt(NumThreads));
+
+static cl::opt<unsigned> MaxInFlightModules(
+    "max-in-flight-modules",
+    cl::desc("Maximum number of input modules parsed ahead that may wait in "
+             "memory to be linked (default: twice the number of threads)"),
+    cl::init(0));
+
 static cl::opt<bool>
 DumpAsm("d", cl::desc("Print assembly as linked"), cl::Hidden);
 
@@ -112,22 +129,28 @@ static cl::opt<bool> PreserveAssemblyUseListOrder(
 static ExitOnError ExitOnErr;
 
 // Read the specified bitcode file in and return it. This routine searches the
-// link path for the specified file to try to find it...
+// link path for the specified file to try to find it... If the contents of
+// the file were read already, they are passed in \p Buffer.
 //
-static std::unique_ptr<Module> loadFile(const char *argv0,
-                                        const std::string &FN,
-                                        LLVMContext &Context,
-                                        bool MaterializeMetadata = true) {
+static std::unique_ptr<Module>
+loadFile(const char *argv0, const std::string &FN, LLVMContext &Context,
+         bool MaterializeMetadata = true, raw_ostream &OS = errs(),
+         std::unique_ptr<MemoryBuffer> Buffer = nullptr) {
   SMDiagnostic Err;
-  if (Verbose) errs() << "Loading '" << FN << "'\n";
+  if (Verbose) OS << "Loading '" << FN << "'\n";
   std::unique_ptr<Module> Result;
-  if (DisableLazyLoad)
+  if (Buffer && DisableLazyLoad)
+    Result = parseIR(Buffer->getMemBufferRef(), Err, Context);
+  else if (Buffer)
+    Result = getLazyIRModule(std::move(Buffer), Err, Context,
+                             !MaterializeMetadata);
+  else if (DisableLazyLoad)
     Result = parseIRFile(FN, Err, Context);
   else
     Result = getLazyIRFileModule(FN, Err, Context, !MaterializeMetadata);
 
   if (!Result) {
-    Err.print(argv0, errs());
+    Err.print(argv0, OS);
     return nullptr;
   }
 
@@ -181,25 +204,28 @@ Module &ModuleLazyLoaderCache::operator()(const char *argv0,
 }
 } // anonymous namespace
 
+// Print a diagnostic to the raw_ostream pointed to by \p C, or to errs() if
+// \p C is null.
 static void diagnosticHandler(const DiagnosticInfo &DI, void *C) {
+  raw_ostream &OS = C ? *static_cast<raw_ostream *>(C) : errs();
   unsigned Severity = DI.getSeverity();
   switch (Severity) {
   case DS_Error:
-    errs() << "ERROR: ";
+    OS << "ERROR: ";
     break;
   case DS_Warning:
     if (SuppressWarnings)
       return;
-    errs() << "WARNING: ";
+    OS << "WARNING: ";
     break;
   case DS_Remark:
   case DS_Note:
     llvm_unreachable("Only expecting warnings and errors");
   }
 
-  DiagnosticPrinterRawOStream DP(errs());
+  DiagnosticPrinterRawOStream DP(OS);
   DI.print(DP);
-  errs() << '\n';
+  OS << '\n';
 }
 
 /// Import any functions requested via the -import option.
@@ -267,9 +293,101 @@ static bool importFunctions(const char *argv0, Module &DestModule) {
   return true;
 }
 
+namespace {
+/// A regular input file parsed ahead of the link by a worker thread.
+struct PreloadedInput {
+  /// The fully materialized module as bitcode, or null if the file could not
+  /// be loaded or is broken.
+  std::unique_ptr<MemoryBuffer> Buffer;
+  /// Diagnostics, replayed in command-line order.
+  std::string Diagnostics;
+};
+} // anonymous namespace
+
+/// Parse \p File for linkFilesInParallel. The module is parsed, upgraded and
+/// verified in a private context, since modules cannot be moved between
+/// contexts, and handed back as bitcode. Loading that bitcode lazily is all
+/// that is left to the main thread, whatever the format of the input.
+static void preloadFile(const char *argv0, const std::string &File,
+                        PreloadedInput &Input) {
+  raw_string_ostream OS(Input.Diagnostics);
+  LLVMContext Context;
+  Context.setDiagnosticHandler(diagnosticHandler, &OS, true);
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseIRFile(File, Err, Context);
+  if (!M) {
+    Err.print(argv0, OS);
+    OS << argv0 << ": error loading file '" << File << "'\n";
+    return;
+  }
+  UpgradeDebugInfo(*M);
+
+  // See linkFiles for why this is only done without the type map.
+  if (DisableDITypeMap && verifyModule(*M, &OS)) {
+    OS << argv0 << ": " << File << ": error: input module is broken!\n";
+    return;
+  }
+
+  SmallVector<char, 0> Bitcode;
+  raw_svector_ostream BOS(Bitcode);
+  WriteBitcodeToFile(M.get(), BOS, PreserveBitcodeUseListOrder);
+  Input.Buffer = MemoryBuffer::getMemBufferCopy(
+      StringRef(Bitcode.data(), Bitcode.size()), File);
+}
+
+/// Link \p Files into \p L, parsing them ahead on worker threads. The files
+/// are linked into the destination on this thread in command-line order, so
+/// the result does not depend on the scheduling of the workers.
+static bool linkFilesInParallel(const char *argv0, LLVMContext &Context,
+                                Linker &L, ArrayRef<std::string> Files) {
+  unsigned Threads = NumThreads ? NumThreads
+                                : llvm::heavyweight_hardware_concurrency();
+  // Bound the number of files that are parsed, but not linked yet.
+  size_t MaxInFlight = MaxInFlightModules ? MaxInFlightModules : 2 * Threads;
+
+  std::vector<PreloadedInput> Inputs(Files.size());
+  // Declared after Inputs: the pool has to finish before they go away.
+  ThreadPool Pool(Threads);
+  std::vector<std::shared_future<ThreadPool::VoidTy>> Loaded;
+  for (size_t I = 0; I != Files.size(); ++I) {
+    while (Loaded.size() != Files.size() && Loaded.size() < I + MaxInFlight) {
+      size_t Next = Loaded.size();
+      Loaded.push_back(Pool.async(preloadFile, argv0, std::cref(Files[Next]),
+                                  std::ref(Inputs[Next])));
+    }
+    Loaded[I].wait();
+
+    PreloadedInput &Input = Inputs[I];
+    errs() << Input.Diagnostics;
+    if (!Input.Buffer)
+      return false;
+    std::unique_ptr<Module> M =
+        loadFile(argv0, Files[I], Context, true, errs(),
+                 std::move(Input.Buffer));
+    if (!M.get()) {
+      errs() << argv0 << ": error loading file '" << Files[I] << "'\n";
+      return false;
+    }
+
+    if (Verbose)
+      errs() << "Linking in '" << Files[I] << "'\n";
+
+    if (L.linkInModule(std::move(M)))
+      return false;
+  }
+  return true;
+}
+
 static bool linkFiles(const char *argv0, LLVMContext &Context, Linker &L,
                       const cl::list<std::string> &Files,
                       unsigned Flags) {
+  // The files are only read ahead for a plain link, the linker flags and the
+  // summary index promotion are handled by the loop below.
+  if (NumThreads != 1 && Files.size() > 1 && Flags == Linker::Flags::None &&
+      SummaryIndex.empty())
+    return linkFilesInParallel(argv0, Context, L,
+                               makeArrayRef(&Files[0], Files.size()));
+
   // Filter out flags that don't apply to the first file we load.
   unsigned ApplicableFlags = Flags & Linker::Flags::OverrideFromSrc;
   for (const auto &File : Files) {
@@ -23,6 +23,7 @@
 #include "llvm/LTO/legacy/LTOCodeGenerator.h"
 #include "llvm/LTO/legacy/LTOModule.h"
 #include "llvm/LTO/legacy/ThinLTOCodeGenerator.h"
+#include "llvm/Object/FlatSummaryIndex.h"
 #include "llvm/Object/ModuleSummaryIndexObjectFile.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
@@ -108,7 +109,13 @@ cl::opt<ThinLTOModes> ThinLTOMode(
 static cl::opt<std::string>
     ThinLTOIndex("thinlto-index",
                  cl::desc("Provide the index produced by a ThinLink, required "
-                          "to perform the promotion and/or importing."));
+                          "to perform the promotion and/or importing. Both "
+                          "the bitcode and the flat formats are accepted."));
+
+static cl::opt<bool> ThinLTOFlatIndex(
+    "thinlto-flat-index", cl::init(false),
+    cl::desc("Write the index produced by a ThinLink in the flat, "
+             "memory-mappable format instead of bitcode."));
 
 static cl::opt<std::string> ThinLTOPrefixReplace(
     "thinlto-prefix-replace",
@@ -125,6 +132,19 @@ static cl::opt<std::string> ThinLTOModuleId(
 static cl::opt<std::string>
     ThinLTOCacheDir("thinlto-cache-dir", cl::desc("Enable ThinLTO caching."));
 
+static cl::opt<unsigned long long> ThinLTOCacheMaxSizeBytes(
+    "thinlto-cache-max-size-bytes",
+    cl::desc("Set the maximum size of the ThinLTO cache, in bytes."));
+
+static cl::opt<unsigned long long> ThinLTOCacheMaxSizeFiles(
+    "thinlto-cache-max-size-files",
+    cl::desc("Set the maximum number of files in the ThinLTO cache."));
+
+static cl::opt<std::string> ThinLTOImportState(
+    "thinlto-import-state",
+    cl::desc("Reuse the import lists recorded in this file by an earlier "
+             "-thinlto-action=run, and record this run's import lists."));
+
 static cl::opt<std::string> ThinLTOSaveTempsPrefix(
     "thinlto-save-temps",
     cl::desc("Save ThinLTO temp files using filenames created by adding "
@@ -391,14 +411,47 @@ loadAllFilesForIndex(const ModuleSummaryIndex &Index) {
   return InputBuffers;
 }
 
+/// Map the index given with -thinlto-index if it is a flat index, return null
+/// if it is a bitcode one.
+static std::unique_ptr<object::FlatSummaryIndex> loadFlatIndex() {
+  if (ThinLTOIndex.empty())
+    report_fatal_error("Missing -thinlto-index for ThinLTO promotion stage");
+  ExitOnError ExitOnErr("llvm-lto: error loading file '" + ThinLTOIndex +
+                        "': ");
+  auto BufferOrErr = MemoryBuffer::getFile(ThinLTOIndex, /*FileSize=*/-1,
+                                           /*RequiresNullTerminator=*/false);
+  error(BufferOrErr, "error loading file '" + ThinLTOIndex + "'");
+  if (!object::FlatSummaryIndex::isFlatSummaryIndex(
+          (*BufferOrErr)->getBuffer()))
+    return nullptr;
+  return ExitOnErr(object::FlatSummaryIndex::createFromFile(ThinLTOIndex));
+}
+
 std::unique_ptr<ModuleSummaryIndex> loadCombinedIndex() {
   if (ThinLTOIndex.empty())
     report_fatal_error("Missing -thinlto-index for ThinLTO promotion stage");
   ExitOnError ExitOnErr("llvm-lto: error loading file '" + ThinLTOIndex +
                         "': ");
+  if (auto Flat = loadFlatIndex()) {
+    auto Index = llvm::make_unique<ModuleSummaryIndex>();
+    for (GlobalValue::GUID GUID : Flat->guids())
+      ExitOnErr(Flat->materialize(GUID, *Index));
+    return Index;
+  }
   return ExitOnErr(llvm::getModuleSummaryIndexForFile(ThinLTOIndex));
 }
 
+/// Decode from \p Flat the summaries that computing the imports of
+/// \p ModulePath needs, instead of the whole index.
+static std::unique_ptr<ModuleSummaryIndex>
+loadIndexForModule(const object::FlatSummaryIndex &Flat, StringRef ModulePath) {
+  ExitOnError ExitOnErr("llvm-lto: error loading file '" + ThinLTOIndex +
+                        "': ");
+  auto Index = llvm::make_unique<ModuleSummaryIndex>();
+  ExitOnErr(Flat.materializeForModule(ModulePath, *Index));
+  return Index;
+}
+
 static std::unique_ptr<Module> loadModule(StringRef Filename,
                                           LLVMContext &Ctx) {
   SMDiagnostic Err;
@@ -433,6 +486,8 @@ public:
     ThinGenerator.setCodePICModel(getRelocModel());
     ThinGenerator.setTargetOptions(Options);
     ThinGenerator.setCacheDir(ThinLTOCacheDir);
+    ThinGenerator.setCacheMaxSizeBytes(ThinLTOCacheMaxSizeBytes);
+    ThinGenerator.setCacheMaxSizeFiles(ThinLTOCacheMaxSizeFiles);
 
     // Add all the exported symbols to the table of symbols to preserve.
     for (unsigned i = 0; i < ExportedSymbols.size(); ++i)
@@ -487,7 +542,10 @@ private:
     std::error_code EC;
     raw_fd_ostream OS(OutputFilename, EC, sys::fs::OpenFlags::F_None);
     error(EC, "error opening the file '" + OutputFilename + "'");
-    WriteIndexToFile(*CombinedIndex, OS);
+    if (ThinLTOFlatIndex)
+      object::writeFlatSummaryIndex(*CombinedIndex, OS);
+    else
+      WriteIndexToFile(*CombinedIndex, OS);
     return;
   }
 
@@ -505,8 +563,14 @@ private:
     std::string OldPrefix, NewPrefix;
     getThinLTOOldAndNewPrefix(OldPrefix, NewPrefix);
 
-    auto Index = loadCombinedIndex();
+    // A flat index is only decoded for the values each module may import.
+    auto Flat = loadFlatIndex();
+    auto CombinedIndex = Flat ? nullptr : loadCombinedIndex();
     for (auto &Filename : InputFilenames) {
+      auto ModuleIndex = Flat ? loadIndexForModule(*Flat, Filename) : nullptr;
+      ModuleSummaryIndex *Index =
+          Flat ? ModuleIndex.get() : CombinedIndex.get();
+
       // Build a map of module to the GUIDs and summary objects that should
       // be written to its index.
       std::map<std::string, GVSummaryMapTy> ModuleToSummariesForIndex;
@@ -537,8 +601,13 @@ private:
     std::string OldPrefix, NewPrefix;
     getThinLTOOldAndNewPrefix(OldPrefix, NewPrefix);
 
-    auto Index = loadCombinedIndex();
+    auto Flat = loadFlatIndex();
+    auto CombinedIndex = Flat ? nullptr : loadCombinedIndex();
     for (auto &Filename : InputFilenames) {
+      auto ModuleIndex = Flat ? loadIndexForModule(*Flat, Filename) : nullptr;
+      ModuleSummaryIndex *Index =
+          Flat ? ModuleIndex.get() : CombinedIndex.get();
+
       std::string OutputName = OutputFilename;
       if (OutputName.empty()) {
         OutputName = Filename + ".imports";
@@ -713,6 +782,9 @@ private:
     if (!ThinLTOSaveTempsPrefix.empty())
       ThinGenerator.setSaveTempsDir(ThinLTOSaveTempsPrefix);
 
+    if (!ThinLTOImportState.empty())
+      ThinGenerator.setImportStatePath(ThinLTOImportState);
+
     if (!ThinLTOGeneratedObjectsDir.empty()) {
       ThinGenerator.setGeneratedObjectsDirectory(ThinLTOGeneratedObjectsDir);
       ThinGenerator.run();
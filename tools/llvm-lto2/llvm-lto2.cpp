@@ -21,6 +21,7 @@
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/LTO/LTO.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/Threading.h"
 
@@ -38,16 +39,38 @@ static cl::opt<char> CGOptLevel(
     cl::desc("Codegen optimization level (0, 1, 2 or 3, default = '2')"),
     cl::init('2'));
 
-static cl::list<std::string> InputFilenames(cl::Positional, cl::OneOrMore,
+// The inputs and the output are required, except with -thinlto-job.
+static cl::list<std::string> InputFilenames(cl::Positional, cl::ZeroOrMore,
                                             cl::desc("<input bitcode files>"));
 
-static cl::opt<std::string> OutputFilename("o", cl::Required,
-                                           cl::desc("Output filename"),
+static cl::opt<std::string> OutputFilename("o", cl::desc("Output filename"),
                                            cl::value_desc("filename"));
 
 static cl::opt<std::string> CacheDir("cache-dir", cl::desc("Cache Directory"),
                                      cl::value_desc("directory"));
 
+static cl::opt<bool> CacheContentAddressed(
+    "cache-content-addressed",
+    cl::desc("Deduplicate the objects of the cache by content"));
+
+static cl::opt<bool>
+    CacheCompress("cache-compress",
+                  cl::desc("Compress the objects of the cache (implies "
+                           "-cache-content-addressed)"));
+
+static cl::opt<unsigned> CachePruningInterval(
+    "cache-pruning-interval", cl::init(1200),
+    cl::desc("Minimum interval between two prunings of the cache, in "
+             "seconds"));
+
+static cl::opt<unsigned long long> CacheMaxSizeBytes(
+    "cache-max-size-bytes",
+    cl::desc("Set the maximum size of the cache, in bytes"));
+
+static cl::opt<unsigned long long>
+    CacheMaxSizeFiles("cache-max-size-files",
+                      cl::desc("Set the maximum number of files in the cache"));
+
 static cl::opt<std::string> OptPipeline("opt-pipeline",
                                         cl::desc("Optimizer Pipeline"),
                                         cl::value_desc("pipeline"));
@@ -67,6 +90,23 @@ static cl::opt<bool>
 static cl::opt<int> Threads("thinlto-threads",
                             cl::init(llvm::heavyweight_hardware_concurrency()));
 
+static cl::opt<bool> ThinLTOOutOfProcess(
+    "thinlto-out-of-process", cl::init(false),
+    cl::desc("Run every ThinLTO backend job in a separate llvm-lto2 process "
+             "(at most -thinlto-threads at a time)"));
+
+static cl::opt<std::string>
+    ThinLTOJob("thinlto-job",
+               cl::desc("Run the ThinLTO backend job described by the given "
+                        "job file (used by -thinlto-out-of-process)"),
+               cl::value_desc("filename"), cl::Hidden);
+
+static cl::opt<std::string> ThinLTOImportState(
+    "thinlto-import-state",
+    cl::desc("Reuse the ThinLTO import lists recorded in this file by an "
+             "earlier link, when still valid, and record the new ones"),
+    cl::value_desc("filename"));
+
 static cl::list<std::string> SymbolResolutions(
     "r",
     cl::desc("Specify a symbol resolution: filename,symbolname,resolution\n"
@@ -126,6 +166,30 @@ template <typename T> static T check(ErrorOr<T> E, std::string Msg) {
   return T();
 }
 
+// The workers of -thinlto-out-of-process get the command line of this
+// process, so that they see the same code generation options and cl::opts.
+// The inputs and the symbol resolutions are left out: the job file gives the
+// workers the modules they need.
+static std::vector<std::string> getWorkerArgs(int argc, char **argv) {
+  std::vector<bool> Skip(argc);
+  for (unsigned I = 0, E = InputFilenames.size(); I != E; ++I)
+    Skip[InputFilenames.getPosition(I)] = true;
+  for (unsigned I = 0, E = SymbolResolutions.size(); I != E; ++I) {
+    // The position is the one of the value, which follows the option name
+    // unless they are written as a single argument.
+    unsigned Pos = SymbolResolutions.getPosition(I);
+    Skip[Pos] = true;
+    if (!StringRef(argv[Pos]).startswith("-"))
+      Skip[Pos - 1] = true;
+  }
+
+  std::vector<std::string> Args;
+  for (int I = 1; I != argc; ++I)
+    if (!Skip[I])
+      Args.push_back(argv[I]);
+  return Args;
+}
+
 int main(int argc, char **argv) {
   InitializeAllTargets();
   InitializeAllTargetMCs();
@@ -134,6 +198,13 @@ int main(int argc, char **argv) {
 
   cl::ParseCommandLineOptions(argc, argv, "Resolution-based LTO test harness");
 
+  if (ThinLTOJob.empty() &&
+      (InputFilenames.empty() || OutputFilename.empty())) {
+    errs() << argv[0] << ": input files and an output filename (-o) are "
+           << "required\n";
+    return 1;
+  }
+
   // FIXME: Workaround PR30396 which means that a symbol can appear
   // more than once if it is defined in module-level assembly and
   // has a GV declaration. We allow (file, symbol) pairs to have multiple
@@ -214,11 +285,24 @@ int main(int argc, char **argv) {
 
   Conf.OverrideTriple = OverrideTriple;
   Conf.DefaultTriple = DefaultTriple;
+  Conf.ThinLTOImportStatePath = ThinLTOImportState;
+
+  if (!ThinLTOJob.empty()) {
+    check(runThinBackendJob(Conf, ThinLTOJob), ThinLTOJob);
+    return 0;
+  }
 
   ThinBackend Backend;
   if (ThinLTODistributedIndexes)
     Backend = createWriteIndexesThinBackend("", "", true, "");
-  else
+  else if (ThinLTOOutOfProcess) {
+    // The workers are llvm-lto2 processes running with -thinlto-job.
+    void (*CheckFn)(Error, std::string) = check;
+    void *MainAddr = (void *)(intptr_t)CheckFn;
+    Backend = createOutOfProcessThinBackend(
+        Threads, sys::fs::getMainExecutable(argv[0], MainAddr),
+        getWorkerArgs(argc, argv));
+  } else
     Backend = createInProcessThinBackend(Threads);
   LTO Lto(std::move(Conf), std::move(Backend));
 
@@ -280,8 +364,15 @@ int main(int argc, char **argv) {
   };
 
   NativeObjectCache Cache;
-  if (!CacheDir.empty())
-    Cache = localCache(CacheDir, AddFile);
+  if (!CacheDir.empty()) {
+    LocalCacheOptions CacheOptions;
+    CacheOptions.ContentAddressed = CacheContentAddressed;
+    CacheOptions.Compress = CacheCompress;
+    CacheOptions.PruningInterval = std::chrono::seconds(CachePruningInterval);
+    CacheOptions.MaxSizeBytes = CacheMaxSizeBytes;
+    CacheOptions.MaxSizeFiles = CacheMaxSizeFiles;
+    Cache = localCache(CacheDir, AddFile, CacheOptions);
+  }
 
   check(Lto.run(AddStream, Cache), "LTO::run failed");
 }
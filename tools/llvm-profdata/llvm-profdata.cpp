@@ -32,6 +32,7 @@
 #include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <queue>
 
 using namespace llvm;
 
@@ -119,18 +120,60 @@ struct WriterContext {
   std::mutex Lock;
   InstrProfWriter Writer;
   Error Err;
-  StringRef ErrWhence;
+  std::string ErrWhence;
   std::mutex &ErrLock;
   SmallSet<instrprof_error, 4> &WriterErrorCodes;
+  /// Number of functions above which the records are spilled to a temporary
+  /// file, 0 to keep everything in memory.
+  unsigned SpillThreshold;
+  /// Temporary indexed profiles holding the spilled records, with the
+  /// functions in the order of InstrProfStreamWriter::precedes.
+  std::vector<std::string> SpillFiles;
+  /// Number of functions written to the spill files.
+  uint64_t NumSpilledFunctions = 0;
 
   WriterContext(bool IsSparse, std::mutex &ErrLock,
-                SmallSet<instrprof_error, 4> &WriterErrorCodes)
+                SmallSet<instrprof_error, 4> &WriterErrorCodes,
+                unsigned SpillThreshold)
       : Lock(), Writer(IsSparse), Err(Error::success()), ErrWhence(""),
-        ErrLock(ErrLock), WriterErrorCodes(WriterErrorCodes) {}
+        ErrLock(ErrLock), WriterErrorCodes(WriterErrorCodes),
+        SpillThreshold(SpillThreshold) {}
 };
 
+/// Write the records of \p WC to a temporary indexed profile, and drop them
+/// from memory.
+static void spillWriterContext(WriterContext *WC, bool IsSparse) {
+  int FD;
+  SmallString<128> Path;
+  if (std::error_code EC =
+          sys::fs::createTemporaryFile("llvm-profdata-spill", "profdata", FD,
+                                       Path)) {
+    WC->Err = errorCodeToError(EC);
+    WC->ErrWhence = "";
+    return;
+  }
+  raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  // Zero counts still matter to detect mismatches with the other spills,
+  // only the final output is sparse.
+  WC->Writer.setOutputSparse(false);
+  WC->Writer.writeInStreamOrder(OS);
+  WC->Writer.setOutputSparse(IsSparse);
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    WC->Err = make_error<StringError>("cannot write spill file",
+                                      std::error_code());
+    WC->ErrWhence = Path.str();
+    return;
+  }
+  WC->SpillFiles.push_back(Path.str());
+  WC->NumSpilledFunctions += WC->Writer.getNumFunctions();
+  WC->Writer.clearRecords();
+}
+
 /// Load an input into a writer context.
-static void loadInput(const WeightedFile &Input, WriterContext *WC) {
+static void loadInput(const WeightedFile &Input, WriterContext *WC,
+                      bool IsSparse) {
   std::unique_lock<std::mutex> CtxGuard{WC->Lock};
 
   // If there's a pending hard error, don't do more work.
@@ -168,8 +211,187 @@ static void loadInput(const WeightedFile &Input, WriterContext *WC) {
                              FuncName, firstTime);
     }
   }
-  if (Reader->hasError())
+  if (Reader->hasError()) {
     WC->Err = Reader->getError();
+    return;
+  }
+
+  if (WC->SpillThreshold &&
+      WC->Writer.getNumFunctions() > WC->SpillThreshold)
+    spillWriterContext(WC, IsSparse);
+}
+
+/// Merge the records of one function into \p PD.
+static void addSpilledRecord(InstrProfWriter::ProfilingData &PD,
+                             InstrProfRecord &&I,
+                             SmallSet<instrprof_error, 4> &WriterErrorCodes) {
+  auto Where = PD.insert(std::make_pair(I.Hash, InstrProfRecord()));
+  InstrProfRecord &Dest = Where.first->second;
+  if (Where.second) {
+    Dest = std::move(I);
+    return;
+  }
+  Dest.merge(I, 1);
+  Dest.sortValueData();
+  if (Error E = Dest.takeError()) {
+    instrprof_error IPE = InstrProfError::take(std::move(E));
+    bool firstTime = WriterErrorCodes.insert(IPE).second;
+    handleMergeWriterError(make_error<InstrProfError>(IPE), "", Dest.Name,
+                           firstTime);
+  }
+}
+
+/// Merge the spill files \p Paths into an indexed profile written to \p OS.
+/// The spill files hold their functions in the order of
+/// InstrProfStreamWriter::precedes, so a k-way merge streams the merged
+/// functions to the output in that order, and only the records of one
+/// function are held in memory at a time.
+static Error mergeSpillFiles(ArrayRef<std::string> Paths,
+                             uint64_t MaxNumFunctions, raw_fd_ostream &OS,
+                             bool OutputSparse,
+                             SmallSet<instrprof_error, 4> &WriterErrorCodes,
+                             std::string &ErrWhence) {
+  struct SpillCursor {
+    std::unique_ptr<InstrProfReader> Reader;
+    InstrProfIterator It;
+  };
+  std::vector<SpillCursor> Cursors;
+  for (const std::string &Path : Paths) {
+    ErrWhence = Path;
+    auto ReaderOrErr = InstrProfReader::create(Path);
+    if (Error E = ReaderOrErr.takeError())
+      return E;
+    SpillCursor C;
+    C.Reader = std::move(ReaderOrErr.get());
+    if (!Cursors.empty() &&
+        C.Reader->isIRLevelProfile() != Cursors[0].Reader->isIRLevelProfile())
+      return make_error<StringError>(
+          "Merge IR generated profile with Clang generated profile.",
+          std::error_code());
+    C.It = C.Reader->begin();
+    Cursors.push_back(std::move(C));
+  }
+  ErrWhence = "";
+
+  // Order the cursors by the function they are on, the first one on top.
+  auto Follows = [&](unsigned LHS, unsigned RHS) {
+    return InstrProfStreamWriter::precedes(Cursors[RHS].It->Name,
+                                           Cursors[LHS].It->Name);
+  };
+  std::priority_queue<unsigned, std::vector<unsigned>, decltype(Follows)>
+      Heap(Follows);
+  // Queue a cursor unless it reached the end of its file.
+  auto Push = [&](unsigned I) -> Error {
+    if (Cursors[I].It != InstrProfIterator()) {
+      Heap.push(I);
+      return Error::success();
+    }
+    if (Cursors[I].Reader->hasError()) {
+      ErrWhence = Paths[I];
+      return Cursors[I].Reader->getError();
+    }
+    return Error::success();
+  };
+  for (unsigned I = 0; I < Cursors.size(); ++I)
+    if (Error E = Push(I))
+      return E;
+
+  InstrProfStreamWriter Writer(
+      OS, !Cursors.empty() && Cursors[0].Reader->isIRLevelProfile(),
+      OutputSparse, MaxNumFunctions);
+  while (!Heap.empty()) {
+    // The names point into the buffers of the readers, which outlive the
+    // merge.
+    StringRef Name = Cursors[Heap.top()].It->Name;
+    InstrProfWriter::ProfilingData PD;
+    while (!Heap.empty() && Cursors[Heap.top()].It->Name == Name) {
+      unsigned I = Heap.top();
+      Heap.pop();
+      SpillCursor &C = Cursors[I];
+      for (; C.It != InstrProfIterator() && C.It->Name == Name; ++C.It)
+        addSpilledRecord(PD, std::move(*C.It), WriterErrorCodes);
+      if (Error E = Push(I))
+        return E;
+    }
+    Writer.addFunction(Name, PD);
+  }
+  Writer.finish();
+  return Error::success();
+}
+
+/// Merge the records of all the writer contexts through spill files, once
+/// some of them are spilled, and write the result to \p Output.
+static void mergeSpilledContexts(
+    ArrayRef<std::unique_ptr<WriterContext>> Contexts,
+    raw_fd_ostream &Output, ProfileFormat OutputFormat, bool OutputSparse,
+    SmallSet<instrprof_error, 4> &WriterErrorCodes) {
+  std::vector<std::string> Paths;
+  auto RemoveSpillFiles = [&]() {
+    for (const std::unique_ptr<WriterContext> &WC : Contexts)
+      for (const std::string &Path : WC->SpillFiles)
+        sys::fs::remove(Path);
+  };
+
+  // Spill what is left in memory so that all the records are merged by the
+  // same k-way merge.
+  uint64_t MaxNumFunctions = 0;
+  for (const std::unique_ptr<WriterContext> &WC : Contexts) {
+    if (!WC->Err && WC->Writer.getNumFunctions())
+      spillWriterContext(WC.get(), OutputSparse);
+    if (WC->Err) {
+      RemoveSpillFiles();
+      exitWithError(std::move(WC->Err), WC->ErrWhence);
+    }
+    Paths.insert(Paths.end(), WC->SpillFiles.begin(), WC->SpillFiles.end());
+    MaxNumFunctions += WC->NumSpilledFunctions;
+  }
+
+  // The text format is written from a temporary indexed profile, which is
+  // read back one function at a time.
+  std::string ErrWhence;
+  if (OutputFormat == PF_Text) {
+    int FD;
+    SmallString<128> IndexedPath;
+    if (std::error_code EC = sys::fs::createTemporaryFile(
+            "llvm-profdata-merged", "profdata", FD, IndexedPath)) {
+      RemoveSpillFiles();
+      exitWithErrorCode(EC);
+    }
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    Error E = mergeSpillFiles(Paths, MaxNumFunctions, OS, OutputSparse,
+                              WriterErrorCodes, ErrWhence);
+    OS.close();
+    RemoveSpillFiles();
+    if (!E && OS.has_error()) {
+      OS.clear_error();
+      E = make_error<StringError>("cannot write temporary file",
+                                  std::error_code());
+      ErrWhence = IndexedPath.str();
+    }
+    if (!E) {
+      auto ReaderOrErr = InstrProfReader::create(IndexedPath);
+      if (!(E = ReaderOrErr.takeError())) {
+        auto Reader = std::move(ReaderOrErr.get());
+        if (Reader->isIRLevelProfile())
+          Output << "# IR level Instrumentation Flag\n:ir\n";
+        InstrProfSymtab &Symtab = Reader->getSymtab();
+        for (const auto &I : *Reader)
+          InstrProfWriter::writeRecordInText(I, Symtab, Output);
+        if (Reader->hasError())
+          E = Reader->getError();
+      }
+    }
+    sys::fs::remove(IndexedPath);
+    if (E)
+      exitWithError(std::move(E), ErrWhence);
+    return;
+  }
+
+  Error E = mergeSpillFiles(Paths, MaxNumFunctions, Output, OutputSparse,
+                            WriterErrorCodes, ErrWhence);
+  RemoveSpillFiles();
+  if (E)
+    exitWithError(std::move(E), ErrWhence);
 }
 
 /// Merge the \p Src writer context into \p Dst.
@@ -181,7 +403,7 @@ static void mergeWriterContexts(WriterContext *Dst, WriterContext *Src) {
 static void mergeInstrProfile(const WeightedFileVector &Inputs,
                               StringRef OutputFilename,
                               ProfileFormat OutputFormat, bool OutputSparse,
-                              unsigned NumThreads) {
+                              unsigned NumThreads, unsigned SpillThreshold) {
   if (OutputFilename.compare("-") == 0)
     exitWithError("Cannot write indexed profdata format to stdout.");
 
@@ -205,18 +427,25 @@ static void mergeInstrProfile(const WeightedFileVector &Inputs,
   SmallVector<std::unique_ptr<WriterContext>, 4> Contexts;
   for (unsigned I = 0; I < NumThreads; ++I)
     Contexts.emplace_back(llvm::make_unique<WriterContext>(
-        OutputSparse, ErrorLock, WriterErrorCodes));
+        OutputSparse, ErrorLock, WriterErrorCodes, SpillThreshold));
+
+  // Once some records are spilled, all of them are merged from spill files.
+  auto HasSpilled = [&]() {
+    return any_of(Contexts, [](const std::unique_ptr<WriterContext> &WC) {
+      return !WC->SpillFiles.empty();
+    });
+  };
 
   if (NumThreads == 1) {
     for (const auto &Input : Inputs)
-      loadInput(Input, Contexts[0].get());
+      loadInput(Input, Contexts[0].get(), OutputSparse);
   } else {
     ThreadPool Pool(NumThreads);
 
     // Load the inputs in parallel (N/NumThreads serial steps).
     unsigned Ctx = 0;
     for (const auto &Input : Inputs) {
-      Pool.async(loadInput, Input, Contexts[Ctx].get());
+      Pool.async(loadInput, Input, Contexts[Ctx].get(), OutputSparse);
       Ctx = (Ctx + 1) % NumThreads;
     }
     Pool.wait();
@@ -225,7 +454,7 @@ static void mergeInstrProfile(const WeightedFileVector &Inputs,
     unsigned Mid = Contexts.size() / 2;
     unsigned End = Contexts.size();
     assert(Mid > 0 && "Expected more than one context");
-    do {
+    while (Mid > 0 && !HasSpilled()) {
       for (unsigned I = 0; I < Mid; ++I)
         Pool.async(mergeWriterContexts, Contexts[I].get(),
                    Contexts[I + Mid].get());
@@ -237,7 +466,13 @@ static void mergeInstrProfile(const WeightedFileVector &Inputs,
       }
       End = Mid;
       Mid /= 2;
-    } while (Mid > 0);
+    }
+  }
+
+  if (HasSpilled()) {
+    mergeSpilledContexts(Contexts, Output, OutputFormat, OutputSparse,
+                         WriterErrorCodes);
+    return;
   }
 
   // Handle deferred hard errors encountered during merging.
@@ -413,6 +648,12 @@ static int merge_main(int argc, const char *argv[]) {
       cl::desc("Number of merge threads to use (default: autodetect)"));
   cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
                         cl::aliasopt(NumThreads));
+  cl::opt<unsigned> SpillThreshold(
+      "spill-threshold", cl::init(0),
+      cl::desc("Number of functions each merge thread may hold in memory "
+               "before spilling them to a temporary file, which are then "
+               "merged into the output one function at a time (only "
+               "meaningful for -instr, default: no spilling)"));
 
   cl::ParseCommandLineOptions(argc, argv, "LLVM profile data merger\n");
 
@@ -439,7 +680,7 @@ static int merge_main(int argc, const char *argv[]) {
 
   if (ProfileKind == instr)
     mergeInstrProfile(WeightedInputs, OutputFilename, OutputFormat,
-                      OutputSparse, NumThreads);
+                      OutputSparse, NumThreads, SpillThreshold);
   else
     mergeSampleProfile(WeightedInputs, OutputFilename, OutputFormat);
 
@@ -30,6 +30,8 @@
 #include <cstdio>
 #include <cstring>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace llvm;
 using namespace symbolize;
@@ -88,6 +90,21 @@ static cl::opt<int> ClPrintSourceContextLines(
 static cl::opt<bool> ClVerbose("verbose", cl::init(false),
                                cl::desc("Print verbose line info"));
 
+static cl::opt<unsigned> ClBatchSize(
+    "batch-size", cl::init(0),
+    cl::desc("Read N input lines before symbolizing them together, 0 to "
+             "answer each line as soon as it is read"));
+
+static cl::opt<unsigned>
+    ClThreads("threads", cl::init(1),
+              cl::desc("Number of threads used to symbolize a batch, 0 for "
+                       "all the cores"));
+
+static cl::opt<unsigned long long> ClCacheSize(
+    "cache-size", cl::init(0),
+    cl::desc("Evict the least recently used binaries when the total size of "
+             "the loaded binaries exceeds N bytes, 0 for no limit"));
+
 template<typename T>
 static bool error(Expected<T> &ResOrErr) {
   if (ResOrErr)
@@ -140,6 +157,67 @@ static bool parseCommand(StringRef InputString, bool &IsData,
   return !StringRef(pos, offset_length).getAsInteger(0, ModuleOffset);
 }
 
+static void printAddress(uint64_t ModuleOffset) {
+  if (ClPrintAddress) {
+    outs() << "0x";
+    outs().write_hex(ModuleOffset);
+    StringRef Delimiter = (ClPrettyPrint == true) ? ": " : "\n";
+    outs() << Delimiter;
+  }
+}
+
+template <typename T>
+static void printResult(DIPrinter &Printer, Expected<T> &ResOrErr) {
+  Printer << (error(ResOrErr) ? T() : ResOrErr.get());
+  outs() << "\n";
+  outs().flush();
+}
+
+namespace {
+/// An input line read in batch mode.
+struct BatchLine {
+  std::string Input;
+  bool Parsed;
+  bool IsData;
+  LLVMSymbolizer::Request Req;
+};
+} // end anonymous namespace
+
+/// Symbolize the code addresses of \p Lines together, and print the results
+/// in the input order.
+static void symbolizeBatch(LLVMSymbolizer &Symbolizer, DIPrinter &Printer,
+                           ArrayRef<BatchLine> Lines) {
+  std::vector<LLVMSymbolizer::Request> CodeRequests;
+  for (const BatchLine &Line : Lines)
+    if (Line.Parsed && !Line.IsData)
+      CodeRequests.push_back(Line.Req);
+
+  std::vector<Expected<DILineInfo>> LineInfos;
+  std::vector<Expected<DIInliningInfo>> InliningInfos;
+  if (ClPrintInlining)
+    InliningInfos = Symbolizer.symbolizeInlinedCodeBatch(CodeRequests);
+  else
+    LineInfos = Symbolizer.symbolizeCodeBatch(CodeRequests);
+
+  size_t NextCodeResult = 0;
+  for (const BatchLine &Line : Lines) {
+    if (!Line.Parsed) {
+      outs() << Line.Input;
+      continue;
+    }
+    printAddress(Line.Req.ModuleOffset);
+    if (Line.IsData) {
+      auto ResOrErr = Symbolizer.symbolizeData(Line.Req.ModuleName,
+                                               Line.Req.ModuleOffset);
+      printResult(Printer, ResOrErr);
+    } else if (ClPrintInlining) {
+      printResult(Printer, InliningInfos[NextCodeResult++]);
+    } else {
+      printResult(Printer, LineInfos[NextCodeResult++]);
+    }
+  }
+}
+
 int main(int argc, char **argv) {
   // Print stack trace if we signal out.
   sys::PrintStackTraceOnErrorSignal(argv[0]);
@@ -151,6 +229,8 @@ int main(int argc, char **argv) {
   cl::ParseCommandLineOptions(argc, argv, "llvm-symbolizer\n");
   LLVMSymbolizer::Options Opts(ClPrintFunctions, ClUseSymbolTable, ClDemangle,
                                ClUseRelativeAddress, ClDefaultArch);
+  Opts.Threads = ClThreads ? ClThreads : std::thread::hardware_concurrency();
+  Opts.MaxCacheSize = ClCacheSize;
 
   for (const auto &hint : ClDsymHint) {
     if (sys::path::extension(hint) == ".dSYM") {
@@ -168,6 +248,7 @@ int main(int argc, char **argv) {
   const int kMaxInputStringLength = 1024;
   char InputString[kMaxInputStringLength];
 
+  std::vector<BatchLine> Batch;
   while (true) {
     if (!fgets(InputString, sizeof(InputString), stdin))
       break;
@@ -175,32 +256,38 @@ int main(int argc, char **argv) {
     bool IsData = false;
     std::string ModuleName;
     uint64_t ModuleOffset = 0;
-    if (!parseCommand(StringRef(InputString), IsData, ModuleName,
-                      ModuleOffset)) {
-      outs() << InputString;
+    bool Parsed = parseCommand(StringRef(InputString), IsData, ModuleName,
+                               ModuleOffset);
+
+    if (ClBatchSize) {
+      Batch.push_back(
+          {InputString, Parsed, IsData, {ModuleName, ModuleOffset}});
+      if (Batch.size() == ClBatchSize) {
+        symbolizeBatch(Symbolizer, Printer, Batch);
+        Batch.clear();
+      }
       continue;
     }
 
-    if (ClPrintAddress) {
-      outs() << "0x";
-      outs().write_hex(ModuleOffset);
-      StringRef Delimiter = (ClPrettyPrint == true) ? ": " : "\n";
-      outs() << Delimiter;
+    if (!Parsed) {
+      outs() << InputString;
+      continue;
     }
+
+    printAddress(ModuleOffset);
     if (IsData) {
       auto ResOrErr = Symbolizer.symbolizeData(ModuleName, ModuleOffset);
-      Printer << (error(ResOrErr) ? DIGlobal() : ResOrErr.get());
+      printResult(Printer, ResOrErr);
     } else if (ClPrintInlining) {
       auto ResOrErr = Symbolizer.symbolizeInlinedCode(ModuleName, ModuleOffset);
-      Printer << (error(ResOrErr) ? DIInliningInfo()
-                                             : ResOrErr.get());
+      printResult(Printer, ResOrErr);
     } else {
       auto ResOrErr = Symbolizer.symbolizeCode(ModuleName, ModuleOffset);
-      Printer << (error(ResOrErr) ? DILineInfo() : ResOrErr.get());
+      printResult(Printer, ResOrErr);
     }
-    outs() << "\n";
-    outs().flush();
   }
+  if (!Batch.empty())
+    symbolizeBatch(Symbolizer, Printer, Batch);
 
   return 0;
 }
@@ -24,6 +24,7 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
 #include "gtest/gtest.h"
 #include <climits>
 #include <cstdint>
@@ -1543,4 +1544,74 @@ TEST(DWARFDebugInfo, TestFindAttrs) {
   EXPECT_EQ(DieMangled, toString(NameOpt, ""));
 }
 
+TEST(DWARFDebugInfo, TestThreadSafeContext) {
+  // Test that a thread-safe context can be queried concurrently, including
+  // for compile units whose DIEs are parsed lazily by the queries.
+  uint16_t Version = 4;
+
+  const uint8_t AddrSize = sizeof(void *);
+  initLLVMIfNeeded();
+  Triple Triple = getHostTripleForAddrSize(AddrSize);
+  auto ExpectedDG = dwarfgen::Generator::create(Triple, Version);
+  if (HandleExpectedError(ExpectedDG))
+    return;
+  dwarfgen::Generator *DG = ExpectedDG.get().get();
+
+  const unsigned NumCUs = 4;
+  const unsigned NumFunctions = 16;
+  const uint64_t FunctionSize = 0x100;
+  std::vector<std::string> Names;
+  for (unsigned I = 0; I < NumCUs * NumFunctions; ++I)
+    Names.push_back("func" + std::to_string(I));
+  for (unsigned I = 0; I < NumCUs; ++I) {
+    dwarfgen::CompileUnit &CU = DG->addCompileUnit();
+    dwarfgen::DIE CUDie = CU.getUnitDIE();
+    CUDie.addAttribute(DW_AT_name, DW_FORM_strp, "/tmp/main.c");
+    CUDie.addAttribute(DW_AT_language, DW_FORM_data2, DW_LANG_C);
+    for (unsigned J = 0; J < NumFunctions; ++J) {
+      unsigned Index = I * NumFunctions + J;
+      dwarfgen::DIE Subprogram = CUDie.addChild(DW_TAG_subprogram);
+      Subprogram.addAttribute(DW_AT_name, DW_FORM_strp, Names[Index].c_str());
+      Subprogram.addAttribute(DW_AT_low_pc, DW_FORM_addr,
+                              FunctionSize * (Index + 1));
+      Subprogram.addAttribute(DW_AT_high_pc, DW_FORM_data4, FunctionSize);
+    }
+  }
+
+  MemoryBufferRef FileBuffer(DG->generate(), "dwarf");
+  auto Obj = object::ObjectFile::createObjectFile(FileBuffer);
+  EXPECT_TRUE((bool)Obj);
+  DWARFContextInMemory DwarfContext(*Obj.get());
+  EXPECT_FALSE(DwarfContext.isThreadSafe());
+  DwarfContext.setThreadSafe();
+  EXPECT_TRUE(DwarfContext.isThreadSafe());
+  EXPECT_EQ(NumCUs, DwarfContext.getNumCompileUnits());
+
+  DILineInfoSpecifier Spec(
+      DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath,
+      DILineInfoSpecifier::FunctionNameKind::ShortName);
+  std::atomic<unsigned> Mismatches(0);
+  {
+    ThreadPool Pool(4);
+    for (unsigned T = 0; T < 8; ++T) {
+      Pool.async([&, T] {
+        // Walk the functions in a different order in each task.
+        for (unsigned I = 0; I < Names.size(); ++I) {
+          unsigned Index = (I * (2 * T + 1) + T) % Names.size();
+          uint64_t Address = FunctionSize * (Index + 1) + FunctionSize / 2;
+          DILineInfo LineInfo = DwarfContext.getLineInfoForAddress(Address,
+                                                                   Spec);
+          DIInliningInfo InliningInfo =
+              DwarfContext.getInliningInfoForAddress(Address, Spec);
+          if (LineInfo.FunctionName != Names[Index] ||
+              InliningInfo.getNumberOfFrames() != 1 ||
+              InliningInfo.getFrame(0).FunctionName != Names[Index])
+            ++Mismatches;
+        }
+      });
+    }
+  }
+  EXPECT_EQ(0u, Mismatches);
+}
+
 } // end anonymous namespace
@@ -0,0 +1,347 @@
+//===- FlatSummaryIndexTest.cpp - Tests for FlatSummaryIndex.cpp ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Object/FlatSummaryIndex.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace llvm::object;
+
+namespace {
+
+const GlobalValue::GUID FooGUID = 100, BarGUID = 42, VarGUID = 7,
+                        AliasGUID = 300, MissingGUID = 55;
+
+std::unique_ptr<GlobalValueSummary>
+makeFunction(StringRef ModulePath, GlobalValue::GUID GUID, unsigned InstCount,
+             std::vector<FunctionSummary::EdgeTy> Calls,
+             std::vector<ValueInfo> Refs,
+             GlobalValue::LinkageTypes Linkage =
+                 GlobalValue::ExternalLinkage) {
+  auto FS = llvm::make_unique<FunctionSummary>(
+      GlobalValueSummary::GVFlags(Linkage, false, false), InstCount,
+      std::move(Refs), std::move(Calls), std::vector<GlobalValue::GUID>(),
+      std::vector<FunctionSummary::VFuncId>(),
+      std::vector<FunctionSummary::VFuncId>(),
+      std::vector<FunctionSummary::ConstVCall>(),
+      std::vector<FunctionSummary::ConstVCall>());
+  FS->setModulePath(ModulePath);
+  FS->setOriginalName(GUID);
+  return std::move(FS);
+}
+
+/// Builds a combined index over two modules: foo is defined in both (weak in
+/// b.o), bar and the variable var in a.o, and alias in b.o aliases b.o's foo.
+/// The modules and the two definitions of foo are added in the opposite order
+/// if \p Reverse.
+void buildIndex(ModuleSummaryIndex &Index, bool Reverse = false) {
+  StringRef A, B;
+  if (Reverse) {
+    A = Index.addModulePath("a.o", 1, {{6, 7, 8, 9, 10}})->first();
+    B = Index.addModulePath("b.o", 0, {{1, 2, 3, 4, 5}})->first();
+  } else {
+    B = Index.addModulePath("b.o", 0, {{1, 2, 3, 4, 5}})->first();
+    A = Index.addModulePath("a.o", 1, {{6, 7, 8, 9, 10}})->first();
+  }
+
+  auto BFoo =
+      makeFunction(B, FooGUID, 3, {}, {}, GlobalValue::WeakODRLinkage);
+  GlobalValueSummary *BFooPtr = BFoo.get();
+  auto AFoo = makeFunction(
+      A, FooGUID, 10,
+      {{ValueInfo(BarGUID), CalleeInfo(CalleeInfo::HotnessType::Hot)},
+       {ValueInfo(MissingGUID), CalleeInfo(CalleeInfo::HotnessType::Cold)}},
+      {ValueInfo(VarGUID)});
+  if (Reverse)
+    std::swap(AFoo, BFoo);
+  Index.addGlobalValueSummary(FooGUID, std::move(BFoo));
+  Index.addGlobalValueSummary(FooGUID, std::move(AFoo));
+  Index.addGlobalValueSummary(BarGUID, makeFunction(A, BarGUID, 1, {}, {}));
+
+  auto Var = llvm::make_unique<GlobalVarSummary>(
+      GlobalValueSummary::GVFlags(GlobalValue::InternalLinkage, true, false),
+      std::vector<ValueInfo>{ValueInfo(BarGUID)});
+  Var->setModulePath(A);
+  Var->setOriginalName(VarGUID);
+  Index.addGlobalValueSummary(VarGUID, std::move(Var));
+
+  auto Alias = llvm::make_unique<AliasSummary>(
+      GlobalValueSummary::GVFlags(GlobalValue::ExternalLinkage, false, true),
+      std::vector<ValueInfo>());
+  Alias->setModulePath(B);
+  Alias->setOriginalName(AliasGUID);
+  Alias->setAliasee(BFooPtr);
+  Index.addGlobalValueSummary(AliasGUID, std::move(Alias));
+}
+
+std::string writeIndex(const ModuleSummaryIndex &Index) {
+  std::string Buffer;
+  raw_string_ostream OS(Buffer);
+  writeFlatSummaryIndex(Index, OS);
+  return OS.str();
+}
+
+TEST(FlatSummaryIndexTest, Lookup) {
+  ModuleSummaryIndex Index;
+  buildIndex(Index);
+  std::string Buffer = writeIndex(Index);
+  ASSERT_TRUE(FlatSummaryIndex::isFlatSummaryIndex(Buffer));
+  auto FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(Buffer, "index"));
+  ASSERT_TRUE(!!FlatOrErr);
+  const FlatSummaryIndex &Flat = **FlatOrErr;
+
+  ASSERT_EQ(2u, Flat.getNumModules());
+  EXPECT_EQ("a.o", Flat.getModulePath(0));
+  EXPECT_EQ(1u, Flat.getModuleId(0));
+  EXPECT_EQ(6u, Flat.getModuleHash(0)[0]);
+  EXPECT_EQ("b.o", Flat.getModulePath(1));
+  EXPECT_EQ(5u, Flat.getModuleHash(1)[4]);
+
+  ASSERT_EQ(4u, Flat.getNumGUIDs());
+  EXPECT_EQ(5u, Flat.getNumSummaries());
+  EXPECT_EQ(VarGUID, Flat.guids()[0]);
+  EXPECT_EQ(AliasGUID, Flat.guids()[3]);
+
+  EXPECT_TRUE(Flat.lookup(MissingGUID).begin() ==
+              Flat.lookup(MissingGUID).end());
+  EXPECT_FALSE(Flat.findSummaryInModule(BarGUID, "b.o").hasValue());
+
+  // The summaries of a GUID are sorted by module path.
+  auto Foos = Flat.lookup(FooGUID);
+  ASSERT_EQ(2, std::distance(Foos.begin(), Foos.end()));
+  FlatSummaryIndex::Summary AFoo = *Foos.begin();
+  EXPECT_EQ("a.o", AFoo.getModulePath());
+  EXPECT_EQ(GlobalValueSummary::FunctionKind, AFoo.getKind());
+  EXPECT_EQ(GlobalValue::ExternalLinkage, AFoo.getLinkage());
+  EXPECT_EQ(10u, AFoo.getInstCount());
+  EXPECT_EQ(FooGUID, AFoo.getOriginalName());
+  ASSERT_EQ(2u, AFoo.getNumCalls());
+  EXPECT_EQ(BarGUID, AFoo.getCall(0).Callee);
+  EXPECT_EQ(CalleeInfo::HotnessType::Hot, AFoo.getCall(0).Hotness);
+  EXPECT_EQ(MissingGUID, AFoo.getCall(1).Callee);
+  EXPECT_EQ(CalleeInfo::HotnessType::Cold, AFoo.getCall(1).Hotness);
+  ASSERT_EQ(1u, AFoo.refs().size());
+  EXPECT_EQ(VarGUID, AFoo.refs()[0]);
+
+  auto BFoo = Flat.findSummaryInModule(FooGUID, "b.o");
+  ASSERT_TRUE(BFoo.hasValue());
+  EXPECT_EQ(GlobalValue::WeakODRLinkage, BFoo->getLinkage());
+  EXPECT_EQ(0u, BFoo->getNumCalls());
+
+  auto Var = Flat.findSummaryInModule(VarGUID, "a.o");
+  ASSERT_TRUE(Var.hasValue());
+  EXPECT_EQ(GlobalValueSummary::GlobalVarKind, Var->getKind());
+  EXPECT_EQ(GlobalValue::InternalLinkage, Var->getLinkage());
+  EXPECT_TRUE(Var->notEligibleToImport());
+  EXPECT_FALSE(Var->liveRoot());
+
+  auto Alias = Flat.findSummaryInModule(AliasGUID, "b.o");
+  ASSERT_TRUE(Alias.hasValue());
+  EXPECT_EQ(GlobalValueSummary::AliasKind, Alias->getKind());
+  EXPECT_TRUE(Alias->liveRoot());
+  EXPECT_EQ(BFoo->getIndex(), Alias->getAliasee().getIndex());
+}
+
+TEST(FlatSummaryIndexTest, OutputIsIndependentOfInsertionOrder) {
+  ModuleSummaryIndex Index;
+  buildIndex(Index);
+  ModuleSummaryIndex Reversed;
+  buildIndex(Reversed, /*Reverse=*/true);
+  EXPECT_EQ(writeIndex(Index), writeIndex(Reversed));
+}
+
+TEST(FlatSummaryIndexTest, Materialize) {
+  ModuleSummaryIndex Index;
+  buildIndex(Index);
+  std::string Buffer = writeIndex(Index);
+  auto FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(Buffer, "index"));
+  ASSERT_TRUE(!!FlatOrErr);
+
+  ModuleSummaryIndex Partial;
+  ASSERT_FALSE(bool((*FlatOrErr)->materialize(AliasGUID, Partial)));
+  ASSERT_FALSE(bool((*FlatOrErr)->materialize(MissingGUID, Partial)));
+  // The alias and its aliasee, and only the module defining them.
+  EXPECT_EQ(2u, Partial.size());
+  ASSERT_EQ(1u, Partial.modulePaths().size());
+  EXPECT_EQ(0u, Partial.getModuleId("b.o"));
+  EXPECT_EQ(3u, Partial.getModuleHash("b.o")[2]);
+
+  auto *Alias = dyn_cast_or_null<AliasSummary>(
+      Partial.findSummaryInModule(AliasGUID, "b.o"));
+  ASSERT_TRUE(Alias);
+  auto *BFoo = Partial.findSummaryInModule(FooGUID, "b.o");
+  EXPECT_EQ(BFoo, &Alias->getAliasee());
+  EXPECT_EQ(FooGUID, BFoo->getOriginalName());
+
+  // Materializing foo adds the definition of a.o, and keeps b.o's.
+  ASSERT_FALSE(bool((*FlatOrErr)->materialize(FooGUID, Partial)));
+  EXPECT_EQ(BFoo, Partial.findSummaryInModule(FooGUID, "b.o"));
+  auto *AFoo = dyn_cast_or_null<FunctionSummary>(
+      Partial.findSummaryInModule(FooGUID, "a.o"));
+  ASSERT_TRUE(AFoo);
+  EXPECT_EQ(10u, AFoo->instCount());
+  ASSERT_EQ(2u, AFoo->calls().size());
+  EXPECT_EQ(BarGUID, AFoo->calls()[0].first.getGUID());
+  EXPECT_EQ(CalleeInfo::HotnessType::Hot, AFoo->calls()[0].second.Hotness);
+  ASSERT_EQ(1u, AFoo->refs().size());
+  EXPECT_EQ(VarGUID, AFoo->refs()[0].getGUID());
+  EXPECT_EQ(1u, Partial.getModuleId("a.o"));
+}
+
+TEST(FlatSummaryIndexTest, MaterializeTypeInfo) {
+  ModuleSummaryIndex Index;
+  StringRef A = Index.addModulePath("a.o", 0, {{1, 2, 3, 4, 5}})->first();
+  FunctionSummary::ConstVCall AssumeConst = {{4, 16}, {1, 2}};
+  FunctionSummary::ConstVCall CheckedLoadConst = {{5, 0}, {}};
+  auto FS = llvm::make_unique<FunctionSummary>(
+      GlobalValueSummary::GVFlags(GlobalValue::ExternalLinkage, false, false),
+      1, std::vector<ValueInfo>(), std::vector<FunctionSummary::EdgeTy>(),
+      std::vector<GlobalValue::GUID>{1, 2},
+      std::vector<FunctionSummary::VFuncId>{{3, 8}},
+      std::vector<FunctionSummary::VFuncId>(),
+      std::vector<FunctionSummary::ConstVCall>{AssumeConst},
+      std::vector<FunctionSummary::ConstVCall>{CheckedLoadConst});
+  FS->setModulePath(A);
+  Index.addGlobalValueSummary(FooGUID, std::move(FS));
+  Index.addGlobalValueSummary(BarGUID, makeFunction(A, BarGUID, 1, {}, {}));
+
+  std::string Buffer = writeIndex(Index);
+  auto FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(Buffer, "index"));
+  ASSERT_TRUE(!!FlatOrErr);
+  ModuleSummaryIndex Partial;
+  ASSERT_FALSE(bool((*FlatOrErr)->materialize(FooGUID, Partial)));
+  ASSERT_FALSE(bool((*FlatOrErr)->materialize(BarGUID, Partial)));
+
+  auto *Foo = dyn_cast_or_null<FunctionSummary>(
+      Partial.findSummaryInModule(FooGUID, "a.o"));
+  ASSERT_TRUE(Foo);
+  EXPECT_EQ(std::vector<GlobalValue::GUID>({1, 2}),
+            std::vector<GlobalValue::GUID>(Foo->type_tests().begin(),
+                                           Foo->type_tests().end()));
+  ASSERT_EQ(1u, Foo->type_test_assume_vcalls().size());
+  EXPECT_EQ(3u, Foo->type_test_assume_vcalls()[0].GUID);
+  EXPECT_EQ(8u, Foo->type_test_assume_vcalls()[0].Offset);
+  EXPECT_TRUE(Foo->type_checked_load_vcalls().empty());
+  ASSERT_EQ(1u, Foo->type_test_assume_const_vcalls().size());
+  EXPECT_EQ(4u, Foo->type_test_assume_const_vcalls()[0].VFunc.GUID);
+  EXPECT_EQ(16u, Foo->type_test_assume_const_vcalls()[0].VFunc.Offset);
+  EXPECT_EQ(std::vector<uint64_t>({1, 2}),
+            Foo->type_test_assume_const_vcalls()[0].Args);
+  ASSERT_EQ(1u, Foo->type_checked_load_const_vcalls().size());
+  EXPECT_EQ(5u, Foo->type_checked_load_const_vcalls()[0].VFunc.GUID);
+  EXPECT_TRUE(Foo->type_checked_load_const_vcalls()[0].Args.empty());
+
+  auto *Bar = dyn_cast_or_null<FunctionSummary>(
+      Partial.findSummaryInModule(BarGUID, "a.o"));
+  ASSERT_TRUE(Bar);
+  EXPECT_TRUE(Bar->type_tests().empty());
+  EXPECT_TRUE(Bar->type_test_assume_const_vcalls().empty());
+}
+
+TEST(FlatSummaryIndexTest, MaterializeForModule) {
+  ModuleSummaryIndex Index;
+  buildIndex(Index);
+  std::string Buffer = writeIndex(Index);
+  auto FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(Buffer, "index"));
+  ASSERT_TRUE(!!FlatOrErr);
+
+  // b.o defines foo and alias, foo is also defined in a.o and calls bar.
+  ModuleSummaryIndex B;
+  ASSERT_FALSE(bool((*FlatOrErr)->materializeForModule("b.o", B)));
+  EXPECT_EQ(3u, B.size());
+  EXPECT_TRUE(B.findSummaryInModule(AliasGUID, "b.o"));
+  EXPECT_TRUE(B.findSummaryInModule(FooGUID, "a.o"));
+  EXPECT_TRUE(B.findSummaryInModule(BarGUID, "a.o"));
+  EXPECT_FALSE(B.findSummaryInModule(VarGUID, "a.o"));
+
+  // Nothing reaches alias from a.o.
+  ModuleSummaryIndex A;
+  ASSERT_FALSE(bool((*FlatOrErr)->materializeForModule("a.o", A)));
+  EXPECT_EQ(3u, A.size());
+  EXPECT_TRUE(A.findSummaryInModule(VarGUID, "a.o"));
+  EXPECT_FALSE(A.findSummaryInModule(AliasGUID, "b.o"));
+
+  ModuleSummaryIndex Unknown;
+  ASSERT_FALSE(bool((*FlatOrErr)->materializeForModule("c.o", Unknown)));
+  EXPECT_EQ(0u, Unknown.size());
+}
+
+TEST(FlatSummaryIndexTest, Malformed) {
+  ModuleSummaryIndex Index;
+  buildIndex(Index);
+  std::string Buffer = writeIndex(Index);
+
+  std::string Truncated = Buffer.substr(0, Buffer.size() - 8);
+  auto FlatOrErr =
+      FlatSummaryIndex::create(MemoryBufferRef(Truncated, "index"));
+  ASSERT_FALSE(!!FlatOrErr);
+  EXPECT_EQ("Malformed flat summary index: truncated columns",
+            toString(FlatOrErr.takeError()));
+
+  std::string NotAnIndex = "BC\xC0\xDE";
+  FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(NotAnIndex, "index"));
+  ASSERT_FALSE(!!FlatOrErr);
+  EXPECT_EQ("Not a flat summary index", toString(FlatOrErr.takeError()));
+
+  const auto &H =
+      *reinterpret_cast<const FlatSummaryIndex::Header *>(Buffer.data());
+  auto Column = [](uint64_t Size) { return alignTo(Size, 8); };
+  uint64_t SummaryFlags = sizeof(H) + Column(H.NumModules * 8) +
+                          2 * Column(H.NumModules * 4) +
+                          Column(H.NumModules * 20) + Column(H.NumGUIDs * 8) +
+                          Column((H.NumGUIDs + 1) * 4) +
+                          Column(H.NumSummaries * 8);
+  uint64_t SummaryModules = SummaryFlags + Column(H.NumSummaries * 4);
+  uint64_t SummaryAliasees = SummaryModules + 2 * Column(H.NumSummaries * 4);
+  uint64_t SummaryCallStarts = SummaryAliasees + Column(H.NumSummaries * 4);
+  auto Set32 = [](std::string &S, uint64_t Offset, uint32_t Value) {
+    support::endian::write32le(&S[Offset], Value);
+  };
+
+  // The kinds are only checked when the summaries are materialized. Give
+  // every summary an unknown kind.
+  std::string BadKind = Buffer;
+  for (uint32_t I = 0; I != H.NumSummaries; ++I)
+    BadKind[SummaryFlags + 4 * I + 1] = 0x7f;
+  FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(BadKind, "index"));
+  ASSERT_TRUE(!!FlatOrErr);
+  ModuleSummaryIndex Partial;
+  EXPECT_EQ("Malformed flat summary index: unknown summary kind 127",
+            toString((*FlatOrErr)->materialize(FooGUID, Partial)));
+
+  // The entries locating other entries are all checked up front.
+  std::string BadStarts = Buffer;
+  Set32(BadStarts, SummaryCallStarts + 4, H.NumCalls + 1);
+  FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(BadStarts, "index"));
+  ASSERT_FALSE(!!FlatOrErr);
+  EXPECT_EQ("Malformed flat summary index: inconsistent column sizes",
+            toString(FlatOrErr.takeError()));
+
+  std::string BadModule = Buffer;
+  Set32(BadModule, SummaryModules, H.NumModules);
+  FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(BadModule, "index"));
+  ASSERT_FALSE(!!FlatOrErr);
+  EXPECT_EQ("Malformed flat summary index: module out of range",
+            toString(FlatOrErr.takeError()));
+
+  // Make alias its own aliasee.
+  FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(Buffer, "index"));
+  ASSERT_TRUE(!!FlatOrErr);
+  uint32_t Alias =
+      (*FlatOrErr)->findSummaryInModule(AliasGUID, "b.o")->getIndex();
+  std::string AliasCycle = Buffer;
+  Set32(AliasCycle, SummaryAliasees + 4 * Alias, Alias);
+  FlatOrErr = FlatSummaryIndex::create(MemoryBufferRef(AliasCycle, "index"));
+  ASSERT_FALSE(!!FlatOrErr);
+  EXPECT_EQ("Malformed flat summary index: aliasee is an alias",
+            toString(FlatOrErr.takeError()));
+}
+
+} // end anonymous namespace
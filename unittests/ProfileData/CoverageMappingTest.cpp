@@ -579,6 +579,79 @@ TEST_P(CoverageMappingTest, skip_duplicate_function_record) {
   ASSERT_EQ(1U, NumFuncs);
 }
 
+TEST_P(CoverageMappingTest, cache_write_read) {
+  InstrProfRecord Record1("func1", 0x1234, {30, 20});
+  NoError(ProfileWriter.addRecord(std::move(Record1)));
+  InstrProfRecord Record2("func2", 0x2345, {10});
+  NoError(ProfileWriter.addRecord(std::move(Record2)));
+  InstrProfRecord Record3("func3", 0x3456, {1});
+  NoError(ProfileWriter.addRecord(std::move(Record3)));
+
+  startFunction("func1", 0x1234);
+  addCMR(Counter::getCounter(0), "file1", 1, 1, 9, 9);
+  addCMR(Counter::getCounter(1), "file1", 2, 1, 4, 7);
+  addExpansionCMR("file1", "file2", 5, 1, 5, 10);
+  addCMR(Counter::getZero(), "file2", 1, 1, 2, 2);
+  startFunction("func2", 0x2345);
+  addCMR(Counter::getCounter(0), "file2", 3, 1, 8, 1);
+  // A hash mismatch is counted but not loaded.
+  startFunction("func3", 0x4567);
+  addCMR(Counter::getCounter(0), "file1", 10, 1, 12, 1);
+  loadCoverageMapping();
+
+  std::string Cache;
+  raw_string_ostream OS(Cache);
+  LoadedCoverage->writeCache(OS);
+  OS.flush();
+  auto CoverageOrErr =
+      CoverageMapping::readCache(MemoryBufferRef(Cache, "cache"));
+  ASSERT_TRUE(NoError(CoverageOrErr.takeError()));
+  std::unique_ptr<CoverageMapping> Cached = std::move(CoverageOrErr.get());
+
+  EXPECT_EQ(LoadedCoverage->getMismatchedCount(), Cached->getMismatchedCount());
+  EXPECT_EQ(LoadedCoverage->getUniqueSourceFiles(),
+            Cached->getUniqueSourceFiles());
+  for (StringRef File : LoadedCoverage->getUniqueSourceFiles()) {
+    CoverageData Loaded = LoadedCoverage->getCoverageForFile(File);
+    CoverageData Read = Cached->getCoverageForFile(File);
+    EXPECT_EQ(std::vector<CoverageSegment>(Loaded.begin(), Loaded.end()),
+              std::vector<CoverageSegment>(Read.begin(), Read.end()));
+  }
+  auto ExpectedFuncs = LoadedCoverage->getCoveredFunctions();
+  auto ActualFuncs = Cached->getCoveredFunctions();
+  auto I = ActualFuncs.begin();
+  for (const auto &Function : ExpectedFuncs) {
+    ASSERT_NE(ActualFuncs.end(), I);
+    const FunctionRecord &Read = *I;
+    EXPECT_EQ(Function.Name, Read.Name);
+    EXPECT_EQ(Function.Filenames, Read.Filenames);
+    EXPECT_EQ(Function.ExecutionCount, Read.ExecutionCount);
+    ASSERT_EQ(Function.CountedRegions.size(), Read.CountedRegions.size());
+    for (unsigned J = 0, E = Function.CountedRegions.size(); J != E; ++J) {
+      const CountedRegion &L = Function.CountedRegions[J];
+      const CountedRegion &R = Read.CountedRegions[J];
+      EXPECT_EQ(L.Count, R.Count);
+      EXPECT_EQ(L.Kind, R.Kind);
+      EXPECT_EQ(L.FileID, R.FileID);
+      EXPECT_EQ(L.ExpandedFileID, R.ExpandedFileID);
+      EXPECT_EQ(L.startLoc(), R.startLoc());
+      EXPECT_EQ(L.endLoc(), R.endLoc());
+      EXPECT_EQ(L.ExecutionCount, R.ExecutionCount);
+    }
+    ++I;
+  }
+  EXPECT_EQ(ActualFuncs.end(), I);
+
+  // Truncated caches are rejected.
+  for (size_t Size : {size_t(0), size_t(8), Cache.size() / 2,
+                      Cache.size() - 1}) {
+    auto TruncatedOrErr = CoverageMapping::readCache(
+        MemoryBufferRef(StringRef(Cache).take_front(Size), "cache"));
+    EXPECT_FALSE(TruncatedOrErr);
+    consumeError(TruncatedOrErr.takeError());
+  }
+}
+
 // FIXME: Use ::testing::Combine() when llvm updates its copy of googletest.
 INSTANTIATE_TEST_CASE_P(ParameterizedCovMapTest, CoverageMappingTest,
                         ::testing::Values(std::pair<bool, bool>({false, false}),
@@ -14,6 +14,7 @@
 #include "llvm/ProfileData/InstrProfReader.h"
 #include "llvm/ProfileData/InstrProfWriter.h"
 #include "llvm/Support/Compression.h"
+#include "llvm/Support/FileSystem.h"
 #include "gtest/gtest.h"
 #include <cstdarg>
 
@@ -281,6 +282,84 @@ TEST_P(MaybeSparseInstrProfTest, get_icall_data_read_write) {
   ASSERT_EQ(StringRef((const char *)VD[2].Value, 7), StringRef("callee1"));
 }
 
+TEST_P(MaybeSparseInstrProfTest, get_instr_prof_record_view) {
+  InstrProfRecord Record1("foo", 0x1234, {1, 2});
+  InstrProfRecord Record2("foo", 0x1235, {3, 4, 5});
+  Record2.reserveSites(IPVK_IndirectCallTarget, 1);
+  InstrProfValueData VD0[] = {{(uint64_t)callee1, 1}};
+  Record2.addValueData(IPVK_IndirectCallTarget, 0, VD0, 1, nullptr);
+  NoError(Writer.addRecord(std::move(Record1)));
+  NoError(Writer.addRecord(std::move(Record2)));
+  auto Profile = Writer.writeBuffer();
+  const char *BufStart = Profile->getBufferStart();
+  const char *BufEnd = Profile->getBufferEnd();
+  readProfile(std::move(Profile));
+
+  Expected<InstrProfRecordView> V =
+      Reader->getInstrProfRecordView("foo", 0x1234);
+  ASSERT_TRUE(NoError(V.takeError()));
+  ASSERT_EQ(0x1234U, V->Hash);
+  ASSERT_EQ(2U, V->Counts.size());
+  ASSERT_EQ(1U, V->Counts[0]);
+  ASSERT_EQ(2U, V->Counts[1]);
+  // The name and the counters are not copied out of the profile buffer.
+  ASSERT_EQ(StringRef("foo"), V->Name);
+  ASSERT_TRUE(V->Name.data() >= BufStart && V->Name.data() < BufEnd);
+  const char *CountsPtr = reinterpret_cast<const char *>(V->Counts.data());
+  ASSERT_TRUE(CountsPtr >= BufStart && CountsPtr < BufEnd);
+
+  V = Reader->getInstrProfRecordView("foo", 0x1235);
+  ASSERT_TRUE(NoError(V.takeError()));
+  ASSERT_EQ(3U, V->Counts.size());
+  ASSERT_EQ(5U, V->Counts[2]);
+  ASSERT_FALSE(V->ValueData.empty());
+
+  V = Reader->getInstrProfRecordView("foo", 0x5678);
+  ASSERT_TRUE(ErrorEquals(instrprof_error::hash_mismatch, V.takeError()));
+
+  V = Reader->getInstrProfRecordView("bar", 0x1234);
+  ASSERT_TRUE(ErrorEquals(instrprof_error::unknown_function, V.takeError()));
+}
+
+TEST_F(InstrProfTest, get_shared_reader) {
+  NoError(Writer.addRecord(InstrProfRecord("foo", 0x1234, {1, 2})));
+
+  int FD;
+  SmallString<128> Path;
+  ASSERT_FALSE(sys::fs::createTemporaryFile("shared", "profdata", FD, Path));
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    Writer.write(OS);
+  }
+
+  auto R1 = IndexedInstrProfReader::getShared(Path);
+  ASSERT_TRUE(NoError(R1.takeError()));
+  auto R2 = IndexedInstrProfReader::getShared(Path);
+  ASSERT_TRUE(NoError(R2.takeError()));
+  ASSERT_EQ(R1->get(), R2->get());
+
+  // The record outlives the name it was looked up with.
+  std::string FuncName = "foo";
+  Expected<InstrProfRecord> R = (*R2)->getInstrProfRecord(FuncName, 0x1234);
+  FuncName = "bar";
+  ASSERT_TRUE(NoError(R.takeError()));
+  ASSERT_EQ(StringRef("foo"), R->Name);
+  ASSERT_EQ(2U, R->Counts.size());
+  ASSERT_EQ(2U, R->Counts[1]);
+
+  // The reader stays cached when its users are done with it.
+  const IndexedInstrProfReader *Reader = R1->get();
+  R1->reset();
+  R2->reset();
+  auto R3 = IndexedInstrProfReader::getShared(Path);
+  ASSERT_TRUE(NoError(R3.takeError()));
+  ASSERT_EQ(Reader, R3->get());
+  R3->reset();
+
+  IndexedInstrProfReader::releaseSharedReaders();
+  sys::fs::remove(Path);
+}
+
 TEST_P(MaybeSparseInstrProfTest, annotate_vp_data) {
   InstrProfRecord Record("caller", 0x1234, {1, 2});
   Record.reserveSites(IPVK_IndirectCallTarget, 1);
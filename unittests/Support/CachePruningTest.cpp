@@ -0,0 +1,137 @@
+//===- CachePruningTest.cpp - Tests for CachePruning.cpp ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class CachePruningTest : public testing::Test {
+protected:
+  SmallString<64> CacheDir;
+
+  void SetUp() override {
+    ASSERT_FALSE(sys::fs::createUniqueDirectory("CachePruningTest", CacheDir));
+  }
+
+  void TearDown() override {
+    std::error_code EC;
+    std::vector<std::string> Files;
+    for (sys::fs::directory_iterator File(CacheDir, EC), FileEnd;
+         File != FileEnd && !EC; File.increment(EC))
+      Files.push_back(File->path());
+    for (const std::string &File : Files)
+      sys::fs::remove(File);
+    sys::fs::remove(CacheDir);
+  }
+
+  /// Create the entry \p Name of \p Size bytes, last used \p Age seconds ago.
+  void addEntry(StringRef Name, size_t Size, unsigned Age) {
+    SmallString<64> Path(CacheDir);
+    sys::path::append(Path, Name);
+    int FD;
+    ASSERT_FALSE(sys::fs::openFileForWrite(Path, FD, sys::fs::F_None));
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << std::string(Size, 'x');
+    OS.flush();
+    ASSERT_FALSE(sys::fs::setLastModificationAndAccessTime(
+        FD, std::chrono::system_clock::now() - std::chrono::seconds(Age)));
+  }
+
+  bool hasEntry(StringRef Name) {
+    SmallString<64> Path(CacheDir);
+    sys::path::append(Path, Name);
+    return sys::fs::exists(Path);
+  }
+};
+
+TEST_F(CachePruningTest, MaxEntries) {
+  addEntry("a", 10, 300);
+  addEntry("b", 10, 200);
+  addEntry("c", 10, 100);
+  EXPECT_TRUE(CachePruning(CacheDir).setMaxEntries(2).prune());
+  EXPECT_FALSE(hasEntry("a"));
+  EXPECT_TRUE(hasEntry("b"));
+  EXPECT_TRUE(hasEntry("c"));
+  EXPECT_TRUE(hasEntry("llvmcache.timestamp"));
+  // The manifest is opt-in.
+  EXPECT_FALSE(hasEntry("llvmcache.manifest"));
+}
+
+TEST_F(CachePruningTest, MaxSizeBytes) {
+  addEntry("a", 10, 100);
+  addEntry("b", 10, 300);
+  addEntry("c", 10, 200);
+  EXPECT_TRUE(CachePruning(CacheDir).setMaxSizeBytes(25).prune());
+  EXPECT_TRUE(hasEntry("a"));
+  EXPECT_FALSE(hasEntry("b"));
+  EXPECT_TRUE(hasEntry("c"));
+}
+
+TEST_F(CachePruningTest, HardLinks) {
+  // a and b are the same 10 bytes: the cache holds 20 bytes, not 30.
+  addEntry("a", 10, 300);
+  SmallString<64> APath(CacheDir), BPath(CacheDir);
+  sys::path::append(APath, "a");
+  sys::path::append(BPath, "b");
+  ASSERT_FALSE(sys::fs::create_hard_link(APath, BPath));
+  addEntry("c", 10, 100);
+  EXPECT_TRUE(CachePruning(CacheDir).setMaxSizeBytes(25).prune());
+  EXPECT_TRUE(hasEntry("a"));
+  EXPECT_TRUE(hasEntry("b"));
+  EXPECT_TRUE(hasEntry("c"));
+
+  // Removing a frees nothing while b is left, so both go.
+  EXPECT_TRUE(
+      CachePruning(CacheDir).setMaxSizeBytes(15).setUseManifest(true).prune());
+  EXPECT_FALSE(hasEntry("a"));
+  EXPECT_FALSE(hasEntry("b"));
+  EXPECT_TRUE(hasEntry("c"));
+}
+
+TEST_F(CachePruningTest, Manifest) {
+  addEntry("a", 10, 300);
+  addEntry("b", 10, 200);
+  addEntry("c", 10, 100);
+  EXPECT_TRUE(
+      CachePruning(CacheDir).setMaxEntries(3).setUseManifest(true).prune());
+  EXPECT_TRUE(hasEntry("a"));
+  EXPECT_TRUE(hasEntry("llvmcache.manifest"));
+  EXPECT_TRUE(hasEntry("llvmcache.journal"));
+
+  // Using a makes b the least recently used entry. The entry d isn't
+  // recorded, so the pruning doesn't know about it until the next walk of the
+  // directory.
+  CachePruning::recordAccess(CacheDir, "a", 10);
+  addEntry("d", 10, 400);
+  EXPECT_TRUE(
+      CachePruning(CacheDir).setMaxEntries(2).setUseManifest(true).prune());
+  EXPECT_TRUE(hasEntry("a"));
+  EXPECT_FALSE(hasEntry("b"));
+  EXPECT_TRUE(hasEntry("c"));
+  EXPECT_TRUE(hasEntry("d"));
+  EXPECT_TRUE(hasEntry("llvmcache.journal"));
+  EXPECT_FALSE(hasEntry("llvmcache.journal.old"));
+
+  // Pruning without the manifest walks the directory again, and stops the
+  // journaling.
+  EXPECT_TRUE(CachePruning(CacheDir).setMaxEntries(2).prune());
+  EXPECT_TRUE(hasEntry("a"));
+  EXPECT_TRUE(hasEntry("c"));
+  EXPECT_FALSE(hasEntry("d"));
+  EXPECT_FALSE(hasEntry("llvmcache.manifest"));
+  EXPECT_FALSE(hasEntry("llvmcache.journal"));
+}
+
+} // end anonymous namespace
@@ -164,3 +164,63 @@ TEST_F(ThreadPoolTest, PoolDestruction) {
   }
   ASSERT_EQ(5, checked_in);
 }
+
+TEST_F(ThreadPoolTest, TaskGroup) {
+  CHECK_UNSUPPORTED();
+  // Test that a group only waits on its own tasks.
+  std::atomic_int checked_in{0};
+  ThreadPool Pool{2};
+  Pool.async([this] { waitForMainThread(); });
+  ThreadPoolTaskGroup Group(Pool);
+  for (size_t i = 0; i < 5; ++i)
+    Group.async([&checked_in] { ++checked_in; });
+  Group.wait();
+  ASSERT_EQ(5, checked_in);
+  ASSERT_TRUE(Group.isFinished());
+  setMainThreadReady();
+  Pool.wait();
+}
+
+TEST_F(ThreadPoolTest, TaskGroupArgs) {
+  CHECK_UNSUPPORTED();
+  std::atomic_int checked_in{0};
+  ThreadPool Pool;
+  ThreadPoolTaskGroup Group(Pool);
+  for (size_t i = 0; i < 5; ++i)
+    Group.async(TestFunc, std::ref(checked_in), i);
+  Group.wait();
+  ASSERT_EQ(10, checked_in);
+}
+
+TEST_F(ThreadPoolTest, NestedTaskGroup) {
+  CHECK_UNSUPPORTED();
+  // Test that waiting on a group from within a task does not deadlock, even
+  // when the pool has a single worker: the waiting task runs the subtasks.
+  for (unsigned Threads : {1u, 4u}) {
+    std::atomic_int checked_in{0};
+    ThreadPool Pool(Threads);
+    ThreadPoolTaskGroup Outer(Pool);
+    for (size_t i = 0; i < 4; ++i) {
+      Outer.async([&Pool, &checked_in] {
+        ThreadPoolTaskGroup Inner(Pool);
+        for (size_t j = 0; j < 4; ++j)
+          Inner.async([&checked_in] { ++checked_in; });
+        Inner.wait();
+        ++checked_in;
+      });
+    }
+    Outer.wait();
+    ASSERT_EQ(20, checked_in);
+    Pool.wait();
+  }
+}
+
+TEST_F(ThreadPoolTest, IsWorkerThread) {
+  CHECK_UNSUPPORTED();
+  ThreadPool Pool{2};
+  ASSERT_FALSE(Pool.isWorkerThread());
+  std::atomic_bool OnWorker{false};
+  Pool.async([&] { OnWorker = Pool.isWorkerThread(); }).get();
+  ASSERT_TRUE(OnWorker);
+  ASSERT_EQ(2u, Pool.getThreadCount());
+}